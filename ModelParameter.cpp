@@ -1,5 +1,8 @@
 #include "ModelParameter.h"
+#include "checkpoint.h"
+
 #include <cmath>
+#include <fstream>
 
 /*
  * RootParameter: parameters for a root type
@@ -45,41 +48,52 @@ void RootTypeParameter::set(int type, double lb, double lbs, double la, double l
  * The unique root id is not set, but must be set from outside.
  * (called by Root::Root())
  *
+ * @param g         generator of the random numbers (@see RootSystem::getRandomGenerator)
+ *
  * minimal ln distance is 1.e-9 per cut off
  *
  * \return Specific root parameters derived from the root type parameters
  */
-RootParameter RootTypeParameter::realize() {
+RootParameter RootTypeParameter::realize(RandomGenerator& g) const {
 	// type does not change
-	double lb_ = std::max(lb + randn()*lbs,double(1.e-5)); // length of basal zone
-	double la_ = std::max(la + randn()*las,double(1.e-5)); // length of apical zone
+	double lb_ = std::max(lb + g.randn()*lbs,double(1.e-5)); // length of basal zone
+	double la_ = std::max(la + g.randn()*las,double(1.e-5)); // length of apical zone
 	std::vector<double> ln_; // stores the inter-distances
-	int nob_ = std::max(round(nob + randn()*nobs),double(0)); // maximal number of branches
+	int nob_ = std::max(round(nob + g.randn()*nobs),double(0)); // maximal number of branches
 	for (int i = 0; i<nob_-1; i++) { // create inter-root distances
-		double d = std::max(ln + randn()*lns,1.e-5);
+		double d = std::max(ln + g.randn()*lns,1.e-5);
 		ln_.push_back(d);
 	}
-	double r_ = std::max(r + randn()*rs,double(0)); // initial elongation
-	double a_ = std::max(a + randn()*as,double(0)); // radius
-	double theta_ = std::max(theta + randn()*thetas,double(0)); // initial elongation
-	double rlt_ = std::max(rlt + randn()*rlts,double(0)); // root life time
+	double r_ = std::max(r + g.randn()*rs,double(0)); // initial elongation
+	double a_ = std::max(a + g.randn()*as,double(0)); // radius
+	double theta_ = std::max(theta + g.randn()*thetas,double(0)); // initial elongation
+	double rlt_ = std::max(rlt + g.randn()*rlts,double(0)); // root life time
 	RootParameter p(type,lb_,la_,ln_,nob_,r_,a_,theta_,rlt_);
 	return p;
 }
 
+/**
+ * Creates a specific root from the root type parameters, using the random numbers of the parameter set itself
+ */
+RootParameter RootTypeParameter::realize() const
+{
+	return realize(random);
+}
+
 /**
  * Choose (dice) lateral type based on root parameter set,
  * (since there can be more than one lateral type)
  *
  * @param pos       spatial position (for coupling to a soil model)
+ * @param g         generator of the random numbers (@see RootSystem::getRandomGenerator)
  */
-int RootTypeParameter::getLateralType(const Vector3d& pos)
+int RootTypeParameter::getLateralType(const Vector3d& pos, RandomGenerator& g) const
 {
 	assert(successor.size()==successorP.size());
 	double scale = sbp->getValue(pos);  //the current model makes not a lot of sense, we may come up with something more clever
 	if (successorP.size()>0) { // at least 1 successor type
 		if (successorP.size()>1) { // if there are more than one lateral we have to dice
-			double d = rand();
+			double d = g.rand();
 			int i=0;
 			double p=successorP.at(i)*scale;
 			while (p<=d) {
@@ -260,3 +274,313 @@ void RootSystemParameter::set(double pd, double fB, double dB, int mB, int nC, d
 	this->nz=nz;
 	this->simtime=simtime;
 }
+
+
+
+/*
+ * class ParameterSet
+ */
+
+/**
+ * Creates undefined root type parameters for the root types 1..maxtypes, and default plant parameters
+ *
+ * @param maxtypes      number of root types
+ */
+ParameterSet::ParameterSet(int maxtypes) : rtparam(std::vector<RootTypeParameter>(maxtypes)), maxtypes(maxtypes)
+{ }
+
+/**
+ * Reads a whole file
+ *
+ * @param name          file name
+ * @param content       the content of the file (output)
+ * \return              false if the file could not be opened
+ */
+bool ParameterSet::readText(const std::string& name, std::string& content)
+{
+	std::ifstream fis(name.c_str(), std::ios::binary);
+	if (!fis.good()) {
+		return false;
+	}
+	std::stringstream ss;
+	ss << fis.rdbuf();
+	content = ss.str();
+	return true;
+}
+
+/**
+ * Reads the root parameters from a file. Opens plant parameters with the same filename if available,
+ * othterwise assumes a tap root system at position (0,0,-3).
+ *
+ * @param name          filename without file extension
+ * @param subdir        directory ("modelparameter/" by default)
+ */
+void ParameterSet::openFile(std::string name, std::string subdir)
+{
+	std::string rp, pp;
+	if (!readText(subdir+name+".rparam", rp)) {
+		std::string s = "ParameterSet::openFile() could not open root parameter file ";
+		throw std::invalid_argument(s.append(subdir+name+".rparam"));
+	}
+	bool hasPlant = readText(subdir+name+".pparam", pp);
+	parse(rp, pp, hasPlant);
+	sourceHash = hash(rp, hasPlant ? pp : std::string());
+}
+
+/**
+ * Parses the content of the text files
+ *
+ * @param rparam        content of the root parameter file
+ * @param pparam        content of the plant parameter file
+ * @param hasPlant      false, if there is no plant parameter file (a tap root system is assumed)
+ */
+void ParameterSet::parse(const std::string& rparam, const std::string& pparam, bool hasPlant)
+{
+	std::istringstream ris(rparam);
+	numberOfTypes = readParameters(ris);
+	std::cout << "Read " << numberOfTypes << " root type parameters \n"; // debug
+	if (hasPlant) {
+		std::istringstream pis(pparam);
+		rsparam.read(pis);
+	} else { // create a tap root system
+		std::cout << "No root system parameters found, using default tap root system \n";
+		rsparam = RootSystemParameter();
+	}
+}
+
+/**
+ * Reads parameter from input stream (there is a Matlab script exporting these, @see writeParams.m),
+ * all root types that are not read are undefined
+ *
+ * @param cin  in stream
+ * \return     number of read root type parameter sets
+ */
+int ParameterSet::readParameters(std::istream& cin)
+{
+	std::vector<RootTypeParameter> rtp(maxtypes);
+	int c = 0;
+	while (cin.good()) {
+		RootTypeParameter p;
+		p.read(cin);
+		rtp.at(p.type-1) = p; // sets the param to the index (p.type-1)
+		c++;
+	}
+	rtparam = CopyOnWrite<std::vector<RootTypeParameter>>(std::move(rtp));
+	return c;
+}
+
+/**
+ * Hash of the content of the parameter files (64 bit FNV-1a), to detect outdated cache files
+ *
+ * @param rparam        content of the root parameter file
+ * @param pparam        content of the plant parameter file (empty if there is none)
+ */
+uint64_t ParameterSet::hash(const std::string& rparam, const std::string& pparam)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	auto add = [&](const std::string& s) {
+		for (unsigned char c : s) {
+			h = (h^c)*0x100000001b3ULL;
+		}
+		h = (h^0xff)*0x100000001b3ULL; // separates the files
+	};
+	add(rparam);
+	add(pparam);
+	return h;
+}
+
+/**
+ * Writes the plant and root type parameters (the records PARA and RTPS of the binary formats)
+ *
+ * @param cw            the writer
+ * @param rsp           plant parameters
+ * @param rtp           root type parameters
+ * @param random        generators of the root types (@see RootSystem::getRandomGenerator), the states of the defined
+ *                      root types are written, or nullptr
+ */
+void ParameterSet::write(CheckpointWriter& cw, const RootSystemParameter& rsp, const std::vector<RootTypeParameter>& rtp, const std::vector<RandomGenerator>* random)
+{
+	cw.putTag("PARA");
+	const RootSystemParameter& rs = rsp;
+	cw.put(rs.seedPos.x); cw.put(rs.seedPos.y); cw.put(rs.seedPos.z);
+	cw.put(rs.firstB); cw.put(rs.delayB); cw.put(int32_t(rs.maxB));
+	cw.put(int32_t(rs.nC)); cw.put(rs.firstSB); cw.put(rs.delaySB); cw.put(rs.delayRC); cw.put(rs.nz);
+	cw.put(rs.simtime);
+	cw.putTag("RTPS");
+	cw.put(uint64_t(rtp.size()));
+	for (size_t i=0; i<rtp.size(); i++) {
+		const RootTypeParameter& p = rtp[i];
+		cw.put(int32_t(p.type));
+		const double v[] = { p.lb, p.lbs, p.la, p.las, p.ln, p.lns, p.nob, p.nobs, p.r, p.rs, p.a, p.as, p.colorR, p.colorG, p.colorB,
+			p.tropismN, p.tropismS, p.dx, p.theta, p.thetas, p.rlt, p.rlts };
+		cw.putArray(v, sizeof(v)/sizeof(double));
+		cw.put(int32_t(p.tropismT));
+		cw.put(int32_t(p.gf));
+		cw.putString(p.name);
+		cw.putVector(p.successor);
+		cw.putVector(p.successorP);
+		cw.putString(((random!=nullptr) && (p.type>0)) ? random->at(i).getState() : std::string()); // generators of undefined types are unused
+	}
+}
+
+/**
+ * Reads the plant and root type parameters (the records PARA and RTPS of the binary formats),
+ * the scale functions of the root type parameters are kept
+ *
+ * @param cr            the reader
+ * @param rsp           plant parameters (output)
+ * @param rtp           root type parameters (output)
+ * @param random        generators of the root types (output), or nullptr to skip the written states
+ */
+void ParameterSet::read(CheckpointReader& cr, RootSystemParameter& rsp, std::vector<RootTypeParameter>& rtp, std::vector<RandomGenerator>* random)
+{
+	cr.expectTag("PARA");
+	RootSystemParameter& rs = rsp;
+	rs.seedPos.x = cr.get<double>(); rs.seedPos.y = cr.get<double>(); rs.seedPos.z = cr.get<double>();
+	rs.firstB = cr.get<double>(); rs.delayB = cr.get<double>(); rs.maxB = cr.get<int32_t>();
+	rs.nC = cr.get<int32_t>(); rs.firstSB = cr.get<double>(); rs.delaySB = cr.get<double>(); rs.delayRC = cr.get<double>(); rs.nz = cr.get<double>();
+	rs.simtime = cr.get<double>();
+	cr.expectTag("RTPS");
+	rtp.resize(cr.get<uint64_t>());
+	if (random!=nullptr) {
+		random->resize(rtp.size());
+	}
+	for (size_t i=0; i<rtp.size(); i++) {
+		RootTypeParameter& p = rtp[i];
+		p.type = cr.get<int32_t>();
+		std::vector<double> v = cr.getVector<double>();
+		if (v.size()!=22) {
+			throw std::invalid_argument("ParameterSet::read() corrupt file, wrong number of root type parameters");
+		}
+		p.lb = v[0]; p.lbs = v[1]; p.la = v[2]; p.las = v[3]; p.ln = v[4]; p.lns = v[5]; p.nob = v[6]; p.nobs = v[7];
+		p.r = v[8]; p.rs = v[9]; p.a = v[10]; p.as = v[11]; p.colorR = v[12]; p.colorG = v[13]; p.colorB = v[14];
+		p.tropismN = v[15]; p.tropismS = v[16]; p.dx = v[17]; p.theta = v[18]; p.thetas = v[19]; p.rlt = v[20]; p.rlts = v[21];
+		p.tropismT = cr.get<int32_t>();
+		p.gf = cr.get<int32_t>();
+		p.name = cr.getString();
+		p.successor = cr.getVector<int>();
+		p.successorP = cr.getVector<double>();
+		std::string state = cr.getString();
+		if ((random!=nullptr) && !state.empty()) {
+			random->at(i).setState(state);
+		}
+	}
+}
+
+/**
+ * Writes the parameters as binary cache file (the header of the checkpoint format, @see CheckpointWriter,
+ * the record PSET with the hash of the text files, and the records PARA and RTPS)
+ *
+ * @param filename      name of the cache file
+ */
+void ParameterSet::writeCache(std::string filename) const
+{
+	std::ofstream os(filename.c_str(), std::ios::binary);
+	if (!os.good()) {
+		throw std::invalid_argument("ParameterSet::writeCache() could not open file "+filename);
+	}
+	CheckpointWriter cw(os);
+	cw.putTag("PSET");
+	cw.put(sourceHash);
+	cw.put(int32_t(numberOfTypes));
+	write(cw, rsparam, *rtparam, nullptr);
+}
+
+/**
+ * Reads a binary cache file written by ParameterSet::writeCache
+ *
+ * @param filename      name of the cache file
+ * @param hash          hash of the current text files (@see ParameterSet::hash)
+ * \return              false if the file does not exist, is corrupt, or was written for other text files (the parameters are unchanged)
+ */
+bool ParameterSet::readCache(std::string filename, uint64_t hash)
+{
+	if (!std::ifstream(filename.c_str()).good()) {
+		return false;
+	}
+	try {
+		CheckpointReader cr(filename);
+		cr.expectTag("PSET");
+		if (cr.get<uint64_t>()!=hash) {
+			return false;
+		}
+		int n = cr.get<int32_t>();
+		RootSystemParameter rsp;
+		std::vector<RootTypeParameter> rtp;
+		read(cr, rsp, rtp, nullptr);
+		rsparam = rsp;
+		rtparam = CopyOnWrite<std::vector<RootTypeParameter>>(std::move(rtp));
+		numberOfTypes = n;
+		sourceHash = hash;
+		return true;
+	} catch (const std::exception& e) { // e.g. written by an older version
+		return false;
+	}
+}
+
+/**
+ * Returns the parameter set of the library. At the first call per parameter file, the set is read from the cache file,
+ * if the cache file was written for the same content of the text files, otherwise the text files are parsed,
+ * and the cache file is (re)written (if possible).
+ *
+ * @param name          filename without file extension
+ * @param subdir        directory ("modelparameter/" by default)
+ * @param cache         name of the binary cache file (empty for no cache file)
+ * \return              the parameter set, shared by all callers
+ */
+std::shared_ptr<const ParameterSet> ParameterSet::load(std::string name, std::string subdir, std::string cache)
+{
+	std::lock_guard<std::mutex> lock(libraryMutex());
+	std::string key = subdir+name;
+	auto it = library().find(key);
+	if (it!=library().end()) {
+		return it->second;
+	}
+	std::string rp, pp;
+	if (!readText(subdir+name+".rparam", rp)) {
+		std::string s = "ParameterSet::load() could not open root parameter file ";
+		throw std::invalid_argument(s.append(subdir+name+".rparam"));
+	}
+	bool hasPlant = readText(subdir+name+".pparam", pp);
+	uint64_t h = hash(rp, hasPlant ? pp : std::string());
+	std::shared_ptr<ParameterSet> ps = std::make_shared<ParameterSet>();
+	if (cache.empty() || !ps->readCache(cache, h)) {
+		ps->parse(rp, pp, hasPlant);
+		ps->sourceHash = h;
+		if (!cache.empty()) {
+			try {
+				ps->writeCache(cache);
+			} catch (const std::invalid_argument& e) { // e.g. a read only directory, the cache is optional
+			}
+		}
+	}
+	library()[key] = ps;
+	return ps;
+}
+
+/**
+ * Forgets all parameter sets of the library, the root systems keep their parameters
+ */
+void ParameterSet::clearLibrary()
+{
+	std::lock_guard<std::mutex> lock(libraryMutex());
+	library().clear();
+}
+
+/**
+ * The parameter sets of the library (by directory and file name)
+ */
+std::map<std::string, std::shared_ptr<const ParameterSet>>& ParameterSet::library()
+{
+	static std::map<std::string, std::shared_ptr<const ParameterSet>> sets;
+	return sets;
+}
+
+/**
+ * Guards the library (ParameterSet::load may be called by multiple threads)
+ */
+std::mutex& ParameterSet::libraryMutex()
+{
+	static std::mutex m;
+	return m;
+}
@@ -9,16 +9,24 @@
  */
 
 #include <string>
+#include <sstream>
 #include <vector>
 #include <iostream>
 #include <chrono>
 #include <random>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <cstdint>
 #include <assert.h>
 
 #include "mymath.h"
 #include "soil.h"
+#include "random_stream.h"
 
 class RootParameter;
+class CheckpointWriter;
+class CheckpointReader;
 
 
 
@@ -38,8 +46,10 @@ public:
 			double dx, const std::vector<int>& successor, const std::vector<double>& successorP, double theta, double thetas, double rlt, double rlts,
 			int gf, const std::string& name); ///< sets all parameters
 
-	RootParameter realize(); ///< Creates a specific root from the root parameter set
-	int getLateralType(const Vector3d& pos); ///< Choose (dice) lateral type based on root parameter set
+	RootParameter realize(RandomGenerator& g) const; ///< Creates a specific root from the root parameter set, using the random numbers of g
+	RootParameter realize() const; ///< Creates a specific root from the root parameter set
+	int getLateralType(const Vector3d& pos, RandomGenerator& g) const; ///< Choose (dice) lateral type based on root parameter set, using the random numbers of g
+	int getLateralType(const Vector3d& pos) const { return getLateralType(pos, random); } ///< Choose (dice) lateral type based on root parameter set
 	double getK() const { return std::max(nob-1,double(0))*ln+la+lb; }  ///< returns the mean maximal root length [cm]
 
 	// IO
@@ -47,10 +57,14 @@ public:
 	void write(std::ostream & cout) const; ///< writes a single root parameter set
 	std::string toString() const { std::stringstream ss; write(ss); return ss.str(); } ///< writes parameter to a string
 
-	// random numbers
-	void setSeed(unsigned int  seed) const { gen = std::mt19937(seed); } ///< Sets the seed of the random number generator
-	double rand() const { return UD(gen); } ///< Uniformly distributed random number (0,1)
-	double randn() const { return ND(gen); } ///< Normally distributed random number (0,1)
+	// random numbers of the parameter set itself (a root system draws from its own generators, @see RootSystem::getRandomGenerator)
+	void setSeed(unsigned int  seed) const { random.seed(seed); } ///< Sets the seed of the random number generator
+	double rand() const { return random.rand(); }
+	///< Uniformly distributed random number (0,1), from the stream of the current thread if there is one (@see RandomStreamScope)
+	double randn() const { return random.randn(); }
+	///< Normally distributed random number (0,1), from the stream of the current thread if there is one (@see RandomStreamScope)
+	std::string getRandomState() const { return random.getState(); } ///< state of the random number generator (e.g. for checkpoints)
+	void setRandomState(const std::string& s) const { random.setState(s); } ///< restores a state of the random number generator
 
 	/*
 	 * Rootbox parameters per root type
@@ -89,9 +103,7 @@ public:
 	SoilLookUp* sbp = new SoilLookUp(); ///< scale branching probability function
 
 private:
-	mutable std::mt19937 gen = std::mt19937(std::chrono::system_clock::now().time_since_epoch().count());  // random stuff
-	mutable std::uniform_real_distribution<double> UD = std::uniform_real_distribution<double>(0,1);
-	mutable std::normal_distribution<double> ND = std::normal_distribution<double>(0,1);
+	mutable RandomGenerator random = RandomGenerator(std::chrono::system_clock::now().time_since_epoch().count()); // random stuff (created at the first draw)
 
 };
 
@@ -175,4 +187,97 @@ public:
 };
 
 
+
+/**
+ * CopyOnWrite: a value that is shared by copies, until one of them modifies it (e.g. the root type parameters of the plants
+ * of an ensemble, @see ParameterSet)
+ *
+ * References returned by CopyOnWrite::edit may be kept (e.g. RootSystem::getRootTypeParameter), therefore the value is never
+ * shared again afterwards: copies copy it immediately. CopyOnWrite::write is for modifications that do not keep references.
+ */
+template<class T>
+class CopyOnWrite
+{
+
+public:
+
+	CopyOnWrite() : p(std::make_shared<T>()) { }
+	explicit CopyOnWrite(T v) : p(std::make_shared<T>(std::move(v))) { } ///< takes the value, that can be shared
+	CopyOnWrite(const CopyOnWrite& c) : p(c.shareable ? c.p : std::make_shared<T>(*c.p)), shareable(c.shareable) { }
+	CopyOnWrite(CopyOnWrite&& c) : p(std::move(c.p)), shareable(c.shareable) { c.p = std::make_shared<T>(); c.shareable = true; }
+	CopyOnWrite& operator=(const CopyOnWrite& c) {
+		if (this!=&c) {
+			p = c.shareable ? c.p : std::make_shared<T>(*c.p);
+			shareable = c.shareable;
+		}
+		return *this;
+	}
+	CopyOnWrite& operator=(CopyOnWrite&& c) { std::swap(p, c.p); std::swap(shareable, c.shareable); return *this; }
+
+	const T& operator*() const { return *p; } ///< the value (read only)
+	const T* operator->() const { return p.get(); } ///< the value (read only)
+	T& write() {
+		if (p.use_count()>1) {
+			p = std::make_shared<T>(*p);
+		}
+		return *p;
+	} ///< the value for a modification, that is copied first if it is shared (do not keep the reference)
+	T& edit() { T& v = write(); shareable = false; return v; } ///< the value for modifications (the reference may be kept)
+	bool isShared() const { return p.use_count()>1; } ///< true if the value is shared with copies
+
+private:
+
+	std::shared_ptr<T> p;
+	bool shareable = true; // false after edit()
+
+};
+
+
+
+/**
+ * ParameterSet: the root type parameters and the plant parameters of a parameter file (.rparam and .pparam), parsed once,
+ * and shared by many root systems (@see RootSystem::setParameterSet). The root systems share the root type parameters
+ * until they modify them (@see CopyOnWrite), before that, a copy of a root system does not copy its parameters.
+ *
+ * ParameterSet::load keeps a library of the parameter sets of the process, and (optionally) a binary cache file per set, that
+ * is used instead of parsing the text files, as long as their content is unchanged.
+ */
+class ParameterSet
+{
+
+public:
+
+	ParameterSet(int maxtypes = 100); ///< undefined root types 1..maxtypes, and default plant parameters
+
+	void openFile(std::string name, std::string subdir="modelparameter/"); ///< parses the root and plant parameters
+	int readParameters(std::istream & cin); ///< parses root type parameters from an input stream
+	void writeCache(std::string filename) const; ///< writes the parameters as binary cache file
+	bool readCache(std::string filename, uint64_t hash); ///< reads a binary cache file, false if it is missing, or was written for other text files
+	static std::shared_ptr<const ParameterSet> load(std::string name, std::string subdir="modelparameter/", std::string cache="");
+	///< the parameter set of the library (loaded at the first call, from the cache file if it is valid, otherwise parsed and cached)
+	static void clearLibrary(); ///< forgets all parameter sets of the library (e.g. to reload modified files)
+
+	static void write(CheckpointWriter& cw, const RootSystemParameter& rsp, const std::vector<RootTypeParameter>& rtp, const std::vector<RandomGenerator>* random);
+	///< writes the plant and root type parameters, and the generators of the root types if not nullptr (records PARA and RTPS of the binary formats, @see RootSystem::writeState)
+	static void read(CheckpointReader& cr, RootSystemParameter& rsp, std::vector<RootTypeParameter>& rtp, std::vector<RandomGenerator>* random);
+	///< reads the plant and root type parameters (keeps the scale functions), and the generators of the root types if not nullptr (@see RootSystem::readState)
+	static uint64_t hash(const std::string& rparam, const std::string& pparam); ///< hash of the content of the text files (FNV-1a)
+
+	CopyOnWrite<std::vector<RootTypeParameter>> rtparam; ///< parameter set of each root type (index type-1)
+	RootSystemParameter rsparam; ///< plant parameters
+	int numberOfTypes = 0; ///< number of parsed root type parameter sets
+	uint64_t sourceHash = 0; ///< hash of the text files (@see ParameterSet::hash)
+
+private:
+
+	void parse(const std::string& rparam, const std::string& pparam, bool hasPlant); // parses the content of the text files
+	static bool readText(const std::string& name, std::string& content); // reads a whole file, false if it does not exist
+	static std::map<std::string, std::shared_ptr<const ParameterSet>>& library(); // parameter sets by directory and file name
+	static std::mutex& libraryMutex();
+
+	int maxtypes;
+
+};
+
+
 #endif
@@ -0,0 +1,184 @@
+#ifndef NODESTORE_H_
+#define NODESTORE_H_
+
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+#include "mymath.h"
+
+class Root;
+
+/**
+ * NodeStore
+ *
+ * Contiguous structure of arrays of all nodes of a root system, indexed by the unique node id.
+ * The store is owned and kept up to date by RootSystem, use it for post processing or coupling
+ * without copying (@see RootSystem::getNodeStore).
+ *
+ * Each node i>0 that is not the first node of a base root is the end node of exactly one segment,
+ * connecting parents[i] to i. For all other nodes (artificial shoot, seed, and root crowns) parents[i] is -1.
+ *
+ * If CRootBox is built with CROOTBOX_COMPACT, coordinates and times are stored in single precision,
+ * and the coordinates are relative to the origin (the seed position), use NodeStore::getNode for absolute coordinates.
+ *
+ * The segment getters of RootSystem are served from the store. The roots keep their own nodes, node ids, and emergence times,
+ * since they grow from them (also within growth tasks, which do not write to the store), so the node data is held twice:
+ * the store adds 40 bytes per node (24 bytes with CROOTBOX_COMPACT).
+ */
+class NodeStore
+{
+
+public:
+
+	void clear() { x.clear(); y.clear(); z.clear(); netimes.clear(); rootIds.clear(); parents.clear(); } ///< removes all nodes
+	void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); netimes.resize(n); rootIds.resize(n, -1); parents.resize(n, -1); } ///< sets the number of nodes
+	void reserve(size_t n) { x.reserve(n); y.reserve(n); z.reserve(n); netimes.reserve(n); rootIds.reserve(n); parents.reserve(n); } ///< reserves memory for n nodes
+	size_t size() const { return x.size(); } ///< number of nodes
+
+	void set(int i, const Vector3d& n, double t, int rootId, int parent) {
+		if (size_t(i)>=size()) {
+			resize(i+1);
+		}
+		setNode(i, n, t);
+		rootIds[i] = rootId;
+		parents[i] = parent;
+	} ///< sets all values of node i, the store grows if necessary
+	void setNode(int i, const Vector3d& n, double t) { setPosition(i, n); netimes[i] = t; } ///< moves an existing node i (e.g. shifted root tips)
+#ifdef CROOTBOX_COMPACT
+	void setPosition(int i, const Vector3d& n) { x[i] = n.x-origin.x; y[i] = n.y-origin.y; z[i] = n.z-origin.z; } ///< sets the coordinates of an existing node i
+	Vector3d getNode(int i) const { return Vector3d(origin.x+x[i], origin.y+y[i], origin.z+z[i]); } ///< coordinates of node i
+	bool isAt(int i, const Vector3d& n) const { return (x[i]==StoredReal(n.x-origin.x)) && (y[i]==StoredReal(n.y-origin.y)) && (z[i]==StoredReal(n.z-origin.z)); }
+	///< true if node i is stored at n (after rounding)
+	void setOrigin(const Vector3d& o) { assert(size()==0); origin = o; } ///< sets the origin of the coordinates, the store must be empty
+#else
+	void setPosition(int i, const Vector3d& n) { x[i] = n.x; y[i] = n.y; z[i] = n.z; } ///< sets the coordinates of an existing node i
+	Vector3d getNode(int i) const { return Vector3d(x[i], y[i], z[i]); } ///< coordinates of node i
+	bool isAt(int i, const Vector3d& n) const { return (x[i]==n.x) && (y[i]==n.y) && (z[i]==n.z); } ///< true if node i is stored at n
+	void setOrigin(const Vector3d& o) { } ///< the origin is only used with CROOTBOX_COMPACT
+#endif
+	const Vector3d& getOrigin() const { return origin; } ///< origin of the stored coordinates [cm], (0,0,0) unless built with CROOTBOX_COMPACT
+
+	std::vector<StoredReal> x; ///< x-coordinates [cm]
+	std::vector<StoredReal> y; ///< y-coordinates [cm]
+	std::vector<StoredReal> z; ///< z-coordinates [cm]
+	std::vector<StoredReal> netimes; ///< node emergence times [days]
+	std::vector<int> rootIds; ///< unique id of the root that created the node (-1 for the artificial shoot)
+	std::vector<int> parents; ///< node id of the segment's start node (-1 if the node ends no segment)
+
+private:
+
+	Vector3d origin = Vector3d(0.,0.,0.);
+
+};
+
+
+
+/**
+ * NodeVector
+ *
+ * The nodes of a root, nodes are returned by value and changed with NodeVector::set.
+ *
+ * If CRootBox is built with CROOTBOX_COMPACT, the nodes are stored in single precision relative to the first node,
+ * except for the last node (the root tip), which is kept in double precision. Otherwise the nodes are stored as they are.
+ */
+class NodeVector
+{
+
+public:
+
+#ifdef CROOTBOX_COMPACT
+	size_t size() const { return n; } ///< number of nodes
+	void reserve(size_t m) { offsets.reserve((m>0) ? m-1 : 0); } ///< reserves memory for m nodes
+	void clear() { offsets.clear(); n = 0; } ///< removes all nodes
+	void push_back(const Vector3d& v) {
+		if (n==0) {
+			origin = v;
+		} else {
+			offsets.push_back(Vector3f(tip.minus(origin)));
+		}
+		tip = v;
+		n++;
+	} ///< adds a node, the previous tip is rounded
+	Vector3d operator[](size_t i) const { return (i+1==n) ? tip : origin.plus(offsets[i]); } ///< node i
+	void set(size_t i, const Vector3d& v) {
+		if (i+1==n) {
+			tip = v;
+		} else {
+			offsets[i] = Vector3f(v.minus(origin));
+		}
+	} ///< sets node i
+	void resize(size_t m) {
+		if (m<n) {
+			if (m>0) {
+				tip = (*this)[m-1];
+			}
+			offsets.resize((m>0) ? m-1 : 0);
+			n = m;
+		}
+		while (n<m) {
+			push_back(Vector3d());
+		}
+	} ///< removes nodes, or adds nodes at (0,0,0)
+#else
+	size_t size() const { return nodes.size(); } ///< number of nodes
+	void reserve(size_t m) { nodes.reserve(m); } ///< reserves memory for m nodes
+	void clear() { nodes.clear(); } ///< removes all nodes
+	void push_back(const Vector3d& v) { nodes.push_back(v); } ///< adds a node
+	Vector3d operator[](size_t i) const { return nodes[i]; } ///< node i
+	void set(size_t i, const Vector3d& v) { nodes[i] = v; } ///< sets node i
+	void resize(size_t m) { nodes.resize(m); } ///< removes nodes, or adds nodes at (0,0,0)
+#endif
+	bool empty() const { return size()==0; } ///< true if there are no nodes
+	Vector3d at(size_t i) const {
+		if (i>=size()) {
+			throw std::out_of_range("NodeVector::at() index out of range");
+		}
+		return (*this)[i];
+	} ///< node i (bounds checked)
+	Vector3d back() const { return (*this)[size()-1]; } ///< last node
+
+private:
+
+#ifdef CROOTBOX_COMPACT
+	Vector3d origin; // first node
+	Vector3d tip; // last node
+	std::vector<Vector3f> offsets; // nodes 0..n-2 relative to the first node
+	size_t n = 0;
+#else
+	std::vector<Vector3d> nodes;
+#endif
+
+};
+
+
+
+/**
+ * StepDelta
+ *
+ * The changes of the root system during the last call of RootSystem::simulate(dt), @see RootSystem::getStepDelta.
+ * New nodes have the consecutive ids firstNewNode, firstNewNode+1, ..., each new node ends exactly one new segment
+ * (except the nodes without segment after RootSystem::initialize, @see NodeStore::parents).
+ * Moved nodes are nodes that existed before the time step, and changed their coordinates or emergence time (e.g. shifted root tips).
+ */
+class StepDelta
+{
+
+public:
+
+	int getNumberOfNewNodes() const { return newNodes.size(); } ///< number of new nodes
+
+	double simtime = 0; ///< simulation time after the step [days]
+	int firstNewNode = 0; ///< id of the first new node
+	std::vector<Vector3d> newNodes; ///< coordinates of the new nodes [cm]
+	std::vector<double> newNETimes; ///< node emergence times of the new nodes [days]
+	std::vector<Vector2i> newSegments; ///< new segments, the second node is the new node
+	std::vector<int> newSegmentRootIds; ///< unique id of the root containing the new segment
+	std::vector<int> movedNodeIds; ///< ids of moved nodes (sorted)
+	std::vector<Vector3d> movedNodes; ///< new coordinates of the moved nodes [cm]
+	std::vector<double> movedNETimes; ///< new node emergence times of the moved nodes [days]
+	std::vector<Root*> newRoots; ///< roots created in the step (in order of their ids, including roots that have not emerged yet)
+
+};
+
+#endif
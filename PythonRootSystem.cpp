@@ -1,10 +1,10 @@
 #ifndef PY_ROOTBOX_H_
 #define PY_ROOTBOX_H_
 
-// copy paste for daniel
-// 1.  g++ -std=c++11 -O3 -fpic -shared -o py_rootbox.so -Wl,-soname,"py_rootbox.so" PythonRootSystem.cpp -I/usr/include/python3.5 -L/home/daniel/boost_1_62_0/stage/lib -lboost_python Debug/ModelParameter.o Debug/Root.o Debug/RootSystem.o Debug/analysis.o Debug/sdf.o Debug/tropism.o Debug/examples/Exudation/gauss_legendre.o
-// 2.  g++ -std=c++11 -O3 -fpic -shared -o py_rootbox.so -Wl,-soname,"py_rootbox.so" PythonRootSystem.cpp -I/usr/include/python3.5 -lboost_python-py35 Debug/ModelParameter.o Debug/Root.o Debug/RootSystem.o Debug/analysis.o Debug/sdf.o Debug/tropism.o Debug/examples/Exudation/gauss_legendre.o
-// 3.  g++ -std=c++11 -O3 -fpic -shared -o py_rootbox.so -Wl,-soname,"py_rootbox.so" PythonRootSystem.cpp -I/usr/include/python3.6 -lboost_python-py36 Debug/ModelParameter.o Debug/Root.o Debug/RootSystem.o Debug/analysis.o Debug/sdf.o Debug/tropism.o Debug/examples/Exudation/gauss_legendre.o
+// copy paste for daniel (see 'python building guide.txt', or use the CMake target py_rootbox)
+// 1.  g++ -std=c++11 -O3 -fpic -pthread -shared -o py_rootbox.so -Wl,-soname,"py_rootbox.so" PythonRootSystem.cpp -I/usr/include/python3.5 -L/home/daniel/boost_1_62_0/stage/lib -lboost_python Debug/ModelParameter.o Debug/Root.o Debug/RootSystem.o Debug/RootSystemEnsemble.o Debug/analysis.o Debug/sdf.o Debug/tropism.o Debug/vtp.o Debug/checkpoint.o Debug/xylem_flux.o Debug/exudation.o
+// 2.  g++ -std=c++11 -O3 -fpic -pthread -shared -o py_rootbox.so -Wl,-soname,"py_rootbox.so" PythonRootSystem.cpp -I/usr/include/python3.5 -lboost_python-py35 Debug/ModelParameter.o Debug/Root.o Debug/RootSystem.o Debug/RootSystemEnsemble.o Debug/analysis.o Debug/sdf.o Debug/tropism.o Debug/vtp.o Debug/checkpoint.o Debug/xylem_flux.o Debug/exudation.o
+// 3.  g++ -std=c++11 -O3 -fpic -pthread -shared -o py_rootbox.so -Wl,-soname,"py_rootbox.so" PythonRootSystem.cpp -I/usr/include/python3.6 -lboost_python-py36 Debug/ModelParameter.o Debug/Root.o Debug/RootSystem.o Debug/RootSystemEnsemble.o Debug/analysis.o Debug/sdf.o Debug/tropism.o Debug/vtp.o Debug/checkpoint.o Debug/xylem_flux.o Debug/exudation.o
 
 
 /**
@@ -25,11 +25,18 @@
 #include <boost/python/wrapper.hpp>
 #include <boost/python/call.hpp>
 
+#include <algorithm>
+#include <map>
+#include <memory>
+
 #include "mymath.h"
 #include "sdf.h"
 #include "RootSystem.h"
 #include "analysis.h"
-#include "examples/Exudation/example_exudation.h"
+#include "RootSystemEnsemble.h"
+#include "vtp.h"
+#include "xylem_flux.h"
+#include "exudation.h"
 
 using namespace boost::python;
 
@@ -53,6 +60,9 @@ Vector3d (Matrix3d::*times4)(const Vector3d&) const = &Matrix3d::times;
 
 std::string (SignedDistanceFunction::*writePVPScript)() const = &SignedDistanceFunction::writePVPScript; // because of default value
 
+RootParameter (RootTypeParameter::*realize1)() const = &RootTypeParameter::realize;
+int (RootTypeParameter::*getLateralType1)(const Vector3d& pos) const = &RootTypeParameter::getLateralType;
+
 void (RootSystem::*simulate1)(double dt, bool silence) = &RootSystem::simulate;
 void (RootSystem::*simulate2)() = &RootSystem::simulate;
 void (RootSystem::*simulate3)(double dt, double maxinc, ProportionalElongation* se, bool silence) = &RootSystem::simulate;
@@ -61,14 +71,31 @@ void (SegmentAnalyser::*addSegments1)(const RootSystem& rs) = &SegmentAnalyser::
 void (SegmentAnalyser::*addSegments2)(const SegmentAnalyser& a) = &SegmentAnalyser::addSegments;
 void (SegmentAnalyser::*filter1)(int st, double min, double max) = &SegmentAnalyser::filter;
 void (SegmentAnalyser::*filter2)(int st, double value) = &SegmentAnalyser::filter;
+std::vector<double> (SegmentAnalyser::*getScalar1)(int st) const = &SegmentAnalyser::getScalar;
+double (SegmentAnalyser::*getScalar2)(int st, int i) const = &SegmentAnalyser::getScalar;
 double (SegmentAnalyser::*getSummed1)(int st) const = &SegmentAnalyser::getSummed;
 double (SegmentAnalyser::*getSummed2)(int st, SignedDistanceFunction* geometry) const = &SegmentAnalyser::getSummed;
 std::vector<double> (SegmentAnalyser::*distribution_1)(int st, double top, double bot, int n, bool exact) const = &SegmentAnalyser::distribution;
 std::vector<SegmentAnalyser> (SegmentAnalyser::*distribution_2)(double top, double bot, int n) const = &SegmentAnalyser::distribution;
 std::vector<std::vector<double>> (SegmentAnalyser::*distribution2_1)(int st, double top, double bot, double left, double right, int n, int m, bool exact) const = &SegmentAnalyser::distribution2;
 std::vector<std::vector<SegmentAnalyser>> (SegmentAnalyser::*distribution2_2)(double top, double bot, double left, double right, int n, int m) const = &SegmentAnalyser::distribution2;
+std::vector<double> (SegmentAnalyser::*distribution3_1)(int st, Vector3d min, Vector3d max, int nx, int ny, int nz, bool exact) const = &SegmentAnalyser::distribution3;
+void (SegmentAnalyser::*distribution3_2)(int st, RectilinearGrid3D& grid, bool exact) const = &SegmentAnalyser::distribution3;
 SegmentAnalyser (SegmentAnalyser::*cut1)(const SDF_HalfPlane& plane) const = &SegmentAnalyser::cut;
 
+void (SegmentView::*view_filter1)(int st, double min, double max) = &SegmentView::filter;
+void (SegmentView::*view_filter2)(int st, double value) = &SegmentView::filter;
+double (SegmentView::*view_getSummed1)(int st) const = &SegmentView::getSummed;
+double (SegmentView::*view_getSummed2)(int st, SignedDistanceFunction* geometry) const = &SegmentView::getSummed;
+std::vector<double> (SegmentView::*view_distribution3_1)(int st, Vector3d min, Vector3d max, int nx, int ny, int nz, bool exact) const = &SegmentView::distribution3;
+void (SegmentView::*view_distribution3_2)(int st, RectilinearGrid3D& grid, bool exact) const = &SegmentView::distribution3;
+
+void (RootSystemEnsemble::*ensemble_simulate1)(double dt, bool silence) = &RootSystemEnsemble::simulate;
+void (RootSystemEnsemble::*ensemble_simulate2)() = &RootSystemEnsemble::simulate;
+
+void (VTPSeries::*series_write1)(const RootSystem& rs) = &VTPSeries::write;
+void (VTPSeries::*series_write2)(const SegmentAnalyser& a, double time, std::vector<int> types) = &VTPSeries::write;
+
 
 
 /**
@@ -76,11 +103,296 @@ SegmentAnalyser (SegmentAnalyser::*cut1)(const SDF_HalfPlane& plane) const = &Se
  */
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(initialize_overloads,initialize,0,2);
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(openFile_overloads,openFile,1,2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(loadParameters_overloads,loadParameters,1,3);
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(simulate1_overloads,simulate,1,2);
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(simulate3_overloads,simulate,3,4);
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(getValue_overloads,getValue,1,2);
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(tropismObjective_overloads,tropismObjective,5,6);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(setParallelGrowth_overloads,setParallelGrowth,1,2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(setElongationCandidates_overloads,setElongationCandidates,1,2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(buildIndex_overloads,buildIndex,0,2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(setGeometry_overloads,setGeometry,1,2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(getGradient_overloads,getGradient,1,2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(write_overloads,write,1,3);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(series_write_overloads,write,2,3);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(getProfile_overloads,getProfile,0,1);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(reduce_overloads,reduce,3,4);
+
+
+
+/**
+ * Access to contiguous C++ arrays without conversion to Python lists (read only buffer protocol, e.g. numpy.asarray(rs.getNodesArray()))
+ *
+ * An ArrayOwner either keeps the Python object owning the memory alive (views of existing data),
+ * or owns a moved std::vector (results that are computed on the fly, and snapshots of detached views, @see detachViews).
+ */
+struct ArrayOwner {
+    PyObject_HEAD
+    void* buf; // first element
+    PyObject* base; // Python object owning the memory (or nullptr)
+    const void* viewed; // the viewed std::vector, while it is registered in liveViews (or nullptr)
+    void* data; // owned data (or nullptr)
+    void (*free)(void*); // deletes owned data
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+    int ndim;
+    Py_ssize_t itemsize;
+    const char* format; // struct module format, "d" or "i"
+};
+
+static int ArrayOwner_getbuffer(PyObject* obj, Py_buffer* view, int flags)
+{
+    ArrayOwner* a = (ArrayOwner*)obj;
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "py_rootbox arrays are read only");
+        view->obj = nullptr;
+        return -1;
+    }
+    view->buf = a->buf;
+    view->obj = obj;
+    Py_INCREF(obj);
+    view->len = a->shape[0]*a->strides[0];
+    view->readonly = 1;
+    view->itemsize = a->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char*)a->format : nullptr;
+    view->ndim = a->ndim;
+    view->shape = (flags & PyBUF_ND) ? a->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) ? a->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+/**
+ * Views of vectors that C++ changes (node store, segment analyser), by vector (all access holds the GIL)
+ */
+static std::map<const void*, std::vector<ArrayOwner*>> liveViews;
+
+static void ArrayOwner_dealloc(PyObject* obj)
+{
+    ArrayOwner* a = (ArrayOwner*)obj;
+    if (a->viewed!=nullptr) {
+        auto it = liveViews.find(a->viewed);
+        it->second.erase(std::remove(it->second.begin(), it->second.end(), a), it->second.end());
+        if (it->second.empty()) {
+            liveViews.erase(it);
+        }
+    }
+    Py_XDECREF(a->base);
+    if (a->data!=nullptr) {
+        a->free(a->data);
+    }
+    Py_TYPE(obj)->tp_free(obj);
+}
+
+static PyBufferProcs ArrayOwner_as_buffer;
+static PyTypeObject ArrayOwnerType;
+
+static void initArrayOwnerType()
+{
+    ArrayOwner_as_buffer.bf_getbuffer = ArrayOwner_getbuffer;
+    ArrayOwner_as_buffer.bf_releasebuffer = nullptr;
+#if PY_VERSION_HEX >= 0x03090000
+    Py_SET_REFCNT(&ArrayOwnerType, 1);
+#else
+    Py_REFCNT(&ArrayOwnerType) = 1;
+#endif
+    ArrayOwnerType.tp_name = "py_rootbox.ArrayOwner";
+    ArrayOwnerType.tp_basicsize = sizeof(ArrayOwner);
+    ArrayOwnerType.tp_dealloc = ArrayOwner_dealloc;
+    ArrayOwnerType.tp_as_buffer = &ArrayOwner_as_buffer;
+    ArrayOwnerType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ArrayOwnerType.tp_doc = "owner of a contiguous array, use memoryview or numpy.asarray";
+    if (PyType_Ready(&ArrayOwnerType)<0) {
+        throw_error_already_set();
+    }
+}
+
+/**
+ * Returns a memoryview of n rows with cols entries of type T (cols = 1 for vectors)
+ *
+ * @param buf       first element
+ * @param base      Python object owning the memory (or nullptr if data is set)
+ * @param data      owned data that is deleted with free (or nullptr)
+ */
+template<class T>
+object arrayView(const void* buf, size_t n, int cols, const char* format, PyObject* base, void* data = nullptr, void (*free)(void*) = nullptr)
+{
+    ArrayOwner* a = PyObject_New(ArrayOwner, &ArrayOwnerType);
+    if (a==nullptr) {
+        if (data!=nullptr) {
+            free(data);
+        }
+        throw_error_already_set();
+    }
+    a->buf = const_cast<void*>(buf);
+    a->base = base;
+    Py_XINCREF(base);
+    a->viewed = nullptr;
+    a->data = data;
+    a->free = free;
+    a->itemsize = sizeof(T);
+    a->format = format;
+    a->ndim = (cols>1) ? 2 : 1;
+    a->shape[0] = n;
+    a->shape[1] = cols;
+    a->strides[0] = cols*sizeof(T);
+    a->strides[1] = sizeof(T);
+    PyObject* view = PyMemoryView_FromObject((PyObject*)a);
+    Py_DECREF(a); // the memoryview holds the reference
+    if (view==nullptr) {
+        throw_error_already_set();
+    }
+    return object(handle<>(view));
+}
+
+/**
+ * Moves a vector (of T or of structs of cols times T) into a read only array
+ */
+template<class T, class V>
+object arrayMove(std::vector<V>&& v, int cols, const char* format)
+{
+    static_assert(sizeof(V)==sizeof(T)*(sizeof(V)/sizeof(T)), "struct must be an array of T");
+    std::vector<V>* owned = new std::vector<V>(std::move(v));
+    return arrayView<T>(owned->data(), owned->size(), cols, format, nullptr, owned, [](void* d) { delete static_cast<std::vector<V>*>(d); });
+}
+
+/**
+ * Returns a view of a vector that C++ changes, the view is registered in liveViews and is detached before the change (@see detachViews)
+ *
+ * @param base      Python object owning the vector
+ */
+template<class T, class V>
+object arrayLiveView(const std::vector<V>& v, int cols, const char* format, PyObject* base)
+{
+    object view = arrayView<T>(v.data(), v.size(), cols, format, base);
+    ArrayOwner* a = (ArrayOwner*)PyMemoryView_GET_BUFFER(view.ptr())->obj;
+    a->viewed = &v;
+    liveViews[&v].push_back(a);
+    return view;
+}
+
+/**
+ * Detaches the views of a vector before C++ changes it: the vector's memory is moved into a snapshot that is owned by the views,
+ * and C++ continues with a copy (made once, and only if there are views). The views keep the values they had before the change.
+ */
+template<class V>
+void detachVector(const std::vector<V>& cv)
+{
+    auto it = liveViews.find(&cv);
+    if (it==liveViews.end()) {
+        return;
+    }
+    std::vector<V>& v = const_cast<std::vector<V>&>(cv); // the vectors are members of non const objects (only exposed as const)
+    auto snapshot = std::make_shared<std::vector<V>>(std::move(v)); // keeps the memory the views point to
+    v = *snapshot;
+    for (ArrayOwner* a : it->second) {
+        a->viewed = nullptr;
+        a->data = new std::shared_ptr<std::vector<V>>(snapshot);
+        a->free = [](void* d) { delete static_cast<std::shared_ptr<std::vector<V>>*>(d); };
+    }
+    liveViews.erase(it);
+}
+
+/**
+ * Vector3d and Vector2i are passed as rows of three doubles, and two ints
+ */
+static_assert(sizeof(Vector3d)==3*sizeof(double), "Vector3d must consist of three doubles");
+static_assert(sizeof(Vector2i)==2*sizeof(int), "Vector2i must consist of two ints");
+
+object RootSystem_getNodesArray(RootSystem& rs) { return arrayMove<double>(rs.getNodes(), 3, "d"); }
+object RootSystem_getSegmentsArray(RootSystem& rs) { return arrayMove<int>(rs.getSegments(), 2, "i"); }
+object RootSystem_getNETimesArray(RootSystem& rs) { return arrayMove<double>(rs.getNETimes(), 1, "d"); }
+object RootSystem_getScalarArray(RootSystem& rs, int st) { return arrayMove<double>(rs.getScalar(st), 1, "d"); }
+object RootSystem_getNewNodesArray(RootSystem& rs) { return arrayMove<double>(rs.getNewNodes(), 3, "d"); }
+object RootSystem_getNewSegmentsArray(RootSystem& rs) { return arrayMove<int>(rs.getNewSegments(), 2, "i"); }
+
+/**
+ * Views of the node store (no copy). The methods that change the store detach the views first (@see detach_views),
+ * afterwards the views keep the values of the previous simulation step.
+ */
+static const char* storedFormat = (sizeof(StoredReal)==sizeof(float)) ? "f" : "d"; // CROOTBOX_COMPACT stores single precision
+object NodeStore_view(object self, const std::vector<StoredReal>& v) { return arrayLiveView<StoredReal>(v, 1, storedFormat, self.ptr()); }
+object NodeStore_viewi(object self, const std::vector<int>& v) { return arrayLiveView<int>(v, 1, "i", self.ptr()); }
+object NodeStore_x(object self) { return NodeStore_view(self, extract<NodeStore&>(self)().x); }
+object NodeStore_y(object self) { return NodeStore_view(self, extract<NodeStore&>(self)().y); }
+object NodeStore_z(object self) { return NodeStore_view(self, extract<NodeStore&>(self)().z); }
+object NodeStore_netimes(object self) { return NodeStore_view(self, extract<NodeStore&>(self)().netimes); }
+object NodeStore_rootIds(object self) { return NodeStore_viewi(self, extract<NodeStore&>(self)().rootIds); }
+object NodeStore_parents(object self) { return NodeStore_viewi(self, extract<NodeStore&>(self)().parents); }
+
+/**
+ * Views of the segment analyser data (no copy). The methods that change the analyser (e.g. crop, filter, or pack)
+ * detach the views first (@see detach_views), afterwards the views keep the previous values.
+ */
+object SegmentAnalyser_getNodesArray(object self) {
+    return arrayLiveView<StoredReal>(extract<SegmentAnalyser&>(self)().nodes, 3, storedFormat, self.ptr());
+}
+object SegmentAnalyser_getSegmentsArray(object self) {
+    return arrayLiveView<int>(extract<SegmentAnalyser&>(self)().segments, 2, "i", self.ptr());
+}
+object SegmentAnalyser_getCTimesArray(object self) {
+    return arrayLiveView<StoredReal>(extract<SegmentAnalyser&>(self)().ctimes, 1, storedFormat, self.ptr());
+}
+object SegmentAnalyser_getScalarArray(SegmentAnalyser& a, int st) { return arrayMove<double>(a.getScalar(st), 1, "d"); }
+
+/**
+ * Detaches the views of the data that a method of the object changes
+ */
+void detachViews(const NodeStore& ns) {
+    detachVector(ns.x); detachVector(ns.y); detachVector(ns.z); detachVector(ns.netimes); detachVector(ns.rootIds); detachVector(ns.parents);
+}
+void detachViews(RootSystem& rs) { detachViews(rs.getNodeStore()); }
+void detachViews(SegmentAnalyser& a) { detachVector(a.nodes); detachVector(a.segments); detachVector(a.ctimes); }
+void detachViews(RootSystemEnsemble& e) {
+    for (RootSystem* p : e.getPlants()) {
+        detachViews(*p);
+    }
+}
+
+/**
+ * Call policy of the methods that change the node store or the segment analyser of self (of type T)
+ */
+template<class T>
+struct detach_views : default_call_policies {
+    static bool precall(PyObject* args) {
+        T* self = extract<T*>(PyTuple_GET_ITEM(args, 0));
+        detachViews(*self);
+        return true;
+    }
+};
 
+/**
+ * Views of the step delta data (the StepDelta object is kept alive, and cannot be changed from Python)
+ */
+object StepDelta_getNewNodesArray(object self) {
+    const auto& n = extract<StepDelta&>(self)().newNodes;
+    return arrayView<double>(n.data(), n.size(), 3, "d", self.ptr());
+}
+object StepDelta_getNewSegmentsArray(object self) {
+    const auto& s = extract<StepDelta&>(self)().newSegments;
+    return arrayView<int>(s.data(), s.size(), 2, "i", self.ptr());
+}
+object StepDelta_getMovedNodesArray(object self) {
+    const auto& n = extract<StepDelta&>(self)().movedNodes;
+    return arrayView<double>(n.data(), n.size(), 3, "d", self.ptr());
+}
+object StepDelta_getMovedNodeIdsArray(object self) {
+    const auto& i = extract<StepDelta&>(self)().movedNodeIds;
+    return arrayView<int>(i.data(), i.size(), 1, "i", self.ptr());
+}
+
+
+/**
+ * The linear system as tuple (data, indices, indptr, b), e.g. for scipy.sparse.csr_matrix((data, indices, indptr))
+ */
+tuple XylemFlux_getCSR(XylemFlux& x) {
+    std::vector<int> indptr, indices;
+    std::vector<double> values, b;
+    x.getCSR(indptr, indices, values, b);
+    return make_tuple(arrayMove<double>(std::move(values), 1, "d"), arrayMove<int>(std::move(indices), 1, "i"),
+        arrayMove<int>(std::move(indptr), 1, "i"), arrayMove<double>(std::move(b), 1, "d"));
+}
 
 
 /**
@@ -117,11 +429,23 @@ public:
 
 
 
+/**
+ * Python doc string of the 3D soil grids (the data layout changed, scripts that fill data directly must be adapted)
+ */
+static const char* rectilinearGrid3D_doc =
+    "3D look up table, data holds one value per grid point, grid point (i,j,k) at index (i*ny+j)*nz+k (z varies fastest).\n"
+    "Previous versions used the index i*nx*ny+j*ny+k, which only agrees if nx==ny==nz:\n"
+    "scripts that set data[i*nx*ny+j*ny+k] must set data[(i*ny+j)*nz+k], or use setData(i, j, k, value).";
+
+
+
 /**
  * Expose classes to Python module
  */
 BOOST_PYTHON_MODULE(py_rootbox)
 {
+    initArrayOwnerType();
+
     /*
      * general
      */
@@ -188,6 +512,8 @@ BOOST_PYTHON_MODULE(py_rootbox)
 	 */
 	class_<SignedDistanceFunction>("SignedDistanceFunction")
 			.def("getDist",&SignedDistanceFunction::getDist)
+			.def("getGradient",&SignedDistanceFunction::getGradient, getGradient_overloads())
+			.def("getDists",&SignedDistanceFunction::getDists)
 			.def("writePVPScript", writePVPScript)
 			.def("__str__",&SignedDistanceFunction::toString)
 	;
@@ -241,6 +567,12 @@ BOOST_PYTHON_MODULE(py_rootbox)
 			.def_readwrite("p2", &SDF_HalfPlane::p2)
 			.def("__str__",&SDF_HalfPlane::toString)
 	;
+	class_<SDF_Compiled, bases<SignedDistanceFunction>>("SDF_Compiled",init<SignedDistanceFunction*>()[with_custodian_and_ward<1,2>()])
+			.def("getDist",&SDF_Compiled::getDist)
+			.def("getNumberOfInstructions",&SDF_Compiled::getNumberOfInstructions)
+			.def("getNumberOfCalls",&SDF_Compiled::getNumberOfCalls)
+			.def("__str__",&SDF_Compiled::toString)
+	;
 	/*
 	 * soil.h
 	 */
@@ -280,6 +612,25 @@ BOOST_PYTHON_MODULE(py_rootbox)
 			.def_readwrite("grid", &EquidistantGrid1D::grid)
 			.def_readwrite("data", &EquidistantGrid1D::data)
 	;
+	class_<RectilinearGrid3D, RectilinearGrid3D*, bases<SoilLookUp>>("RectilinearGrid3D", rectilinearGrid3D_doc, init<Grid1D*, Grid1D*, Grid1D*>())
+			.def("getValue", &RectilinearGrid3D::getValue, getValue_overloads())
+			.def("__str__",&RectilinearGrid3D::toString)
+			.def("map",&RectilinearGrid3D::map)
+			.def("index",&RectilinearGrid3D::index, "index(i, j, k): index (i*ny+j)*nz+k of grid point (i,j,k) in data")
+			.def("setInterpolation",&RectilinearGrid3D::setInterpolation)
+			.def("getInterpolation",&RectilinearGrid3D::getInterpolation)
+			.def("getData",&RectilinearGrid3D::getData, "getData(i, j, k): value at grid point (i,j,k)")
+			.def("setData",&RectilinearGrid3D::setData, "setData(i, j, k, value): sets the value at grid point (i,j,k)")
+			.def("swapData",&RectilinearGrid3D::swapData)
+			.def_readonly("nx", &RectilinearGrid3D::nx)
+			.def_readonly("ny", &RectilinearGrid3D::ny)
+			.def_readonly("nz", &RectilinearGrid3D::nz)
+			.def_readwrite("data", &RectilinearGrid3D::data, "values per grid point, grid point (i,j,k) at index (i*ny+j)*nz+k")
+	;
+	class_<EquidistantGrid3D, EquidistantGrid3D*, bases<RectilinearGrid3D>, boost::noncopyable>("EquidistantGrid3D", rectilinearGrid3D_doc, init<double, double, int, double, double, int, double, double, int>())
+			.def("getValue", &EquidistantGrid3D::getValue, getValue_overloads())
+			.def("__str__",&EquidistantGrid3D::toString)
+	;
 	/**
 	 * tropism.h
 	 */
@@ -289,7 +640,7 @@ BOOST_PYTHON_MODULE(py_rootbox)
 			.def("copy",&Tropism_Wrap::copy, return_value_policy<reference_existing_object>())
 			.def("setTropismParameter",&Tropism_Wrap::setTropismParameter)
 			.def("setSeed",&Tropism_Wrap::setSeed)
-			.def("setGeometry",&Tropism_Wrap::setGeometry)
+			.def("setGeometry",&Tropism_Wrap::setGeometry, setGeometry_overloads())
 			.def("rand",&Tropism_Wrap::rand)
 			.def("randn",&Tropism_Wrap::randn)
 	;
@@ -299,7 +650,7 @@ BOOST_PYTHON_MODULE(py_rootbox)
 			.def("copy",&Tropism::copy, return_value_policy<reference_existing_object>())
 			.def("setTropismParameter",&Tropism::setTropismParameter)
 			.def("setSeed",&Tropism::setSeed)
-			.def("setGeometry",&Tropism::setGeometry)
+			.def("setGeometry",&Tropism::setGeometry, setGeometry_overloads())
 			.def("rand",&Tropism::rand)
 			.def("randn",&Tropism::randn)
 	;
@@ -317,8 +668,8 @@ BOOST_PYTHON_MODULE(py_rootbox)
 	 * ModelParameter.h
 	 */
 	class_<RootTypeParameter>("RootTypeParameter", init<>())
-			.def("realize",&RootTypeParameter::realize)
-			.def("getLateralType",&RootTypeParameter::getLateralType)
+			.def("realize",realize1)
+			.def("getLateralType",getLateralType1)
 			.def("getK",&RootTypeParameter::getK)
 			.def_readwrite("type", &RootTypeParameter::type)
 			.def_readwrite("lb", &RootTypeParameter::lb)
@@ -392,9 +743,10 @@ BOOST_PYTHON_MODULE(py_rootbox)
 	    .def_readwrite("id", &Root::id)
 	    .def_readwrite("parent_base_length", &Root::parent_base_length)
 	    .def_readwrite("parent_ni", &Root::parent_ni)
-	    .def_readwrite("alive", &Root::alive)
+	    .add_property("alive", &Root::isAlive)
 	    .def_readwrite("active", &Root::active)
-	    .def_readwrite("age", &Root::age)
+	    .add_property("age", &Root::getCurrentAge)
+	    .def_readonly("quiescent", &Root::quiescent)
 	    .def_readwrite("length", &Root::length)
 	    .def_readwrite("parent", &Root::parent)
 	    .def_readwrite("laterals", &Root::laterals)
@@ -408,6 +760,37 @@ BOOST_PYTHON_MODULE(py_rootbox)
     class_<std::vector<std::vector<double>>>("std_vector_vector_double_")
 		.def(vector_indexing_suite<std::vector<std::vector<double>>>() )
 	;
+	/*
+	 * NodeStore.h
+	 */
+    class_<NodeStore>("NodeStore", no_init)
+    	.def("size", &NodeStore::size)
+    	.def("getNode", &NodeStore::getNode)
+    	.def("getOrigin", &NodeStore::getOrigin, return_value_policy<copy_const_reference>())
+    	.add_property("x", &NodeStore_x)
+    	.add_property("y", &NodeStore_y)
+    	.add_property("z", &NodeStore_z)
+    	.add_property("netimes", &NodeStore_netimes)
+    	.add_property("rootIds", &NodeStore_rootIds)
+    	.add_property("parents", &NodeStore_parents)
+    ;
+    class_<StepDelta>("StepDelta")
+    	.def("getNumberOfNewNodes", &StepDelta::getNumberOfNewNodes)
+    	.def_readonly("simtime", &StepDelta::simtime)
+    	.def_readonly("firstNewNode", &StepDelta::firstNewNode)
+    	.def_readonly("newNodes", &StepDelta::newNodes)
+    	.def_readonly("newNETimes", &StepDelta::newNETimes)
+    	.def_readonly("newSegments", &StepDelta::newSegments)
+    	.def_readonly("newSegmentRootIds", &StepDelta::newSegmentRootIds)
+    	.def_readonly("movedNodeIds", &StepDelta::movedNodeIds)
+    	.def_readonly("movedNodes", &StepDelta::movedNodes)
+    	.def_readonly("movedNETimes", &StepDelta::movedNETimes)
+    	.def_readonly("newRoots", &StepDelta::newRoots)
+    	.def("getNewNodesArray", &StepDelta_getNewNodesArray)
+    	.def("getNewSegmentsArray", &StepDelta_getNewSegmentsArray)
+    	.def("getMovedNodesArray", &StepDelta_getMovedNodesArray)
+    	.def("getMovedNodeIdsArray", &StepDelta_getMovedNodeIdsArray)
+    ;
 	/*
 	 * RootSystem.h
 	 */
@@ -418,18 +801,24 @@ BOOST_PYTHON_MODULE(py_rootbox)
 		.def("setRootSystemParameter", &RootSystem::setRootSystemParameter)
 		.def("getRootSystemParameter", &RootSystem::getRootSystemParameter, return_value_policy<reference_existing_object>()) // tutorial: "naive (dangerous) approach"
 		.def("openFile", &RootSystem::openFile, openFile_overloads())
-		.def("setGeometry", &RootSystem::setGeometry)
+		.def("loadParameters", &RootSystem::loadParameters, loadParameters_overloads())
+		.def("hasSharedParameters", &RootSystem::hasSharedParameters)
+		.def("setGeometry", &RootSystem::setGeometry, setGeometry_overloads())
 		.def("setSoil", &RootSystem::setSoil)
-		.def("reset", &RootSystem::reset)
-		.def("initialize", &RootSystem::initialize, initialize_overloads())
+		.def("reset", &RootSystem::reset, detach_views<RootSystem>())
+		.def("initialize", &RootSystem::initialize, initialize_overloads()[detach_views<RootSystem>()])
 		.def("setTropism", &RootSystem::setTropism)
-		.def("simulate",simulate1, simulate1_overloads())
-		.def("simulate",simulate2)
-		.def("simulate",simulate3, simulate3_overloads())
+		.def("simulate",simulate1, simulate1_overloads()[detach_views<RootSystem>()])
+		.def("simulate",simulate2, detach_views<RootSystem>())
+		.def("simulate",simulate3, simulate3_overloads()[detach_views<RootSystem>()])
 		.def("getSimTime", &RootSystem::getSimTime)
+		.def("setParallelGrowth", &RootSystem::setParallelGrowth, setParallelGrowth_overloads())
+		.def("setElongationCandidates", &RootSystem::setElongationCandidates, setElongationCandidates_overloads())
+		.def("setReserveNodes", &RootSystem::setReserveNodes)
 		.def("getNumberOfNodes", &RootSystem::getNumberOfNodes)
 		.def("getNumberOfSegments", &RootSystem::getNumberOfSegments)
 		.def("getRoots", &RootSystem::getRoots)
+		.def("getRoot", &RootSystem::getRoot, return_value_policy<reference_existing_object>())
 		.def("getBaseRoots", &RootSystem::getBaseRoots)
 		.def("getNodes", &RootSystem::getNodes)
 		.def("getPolylines", &RootSystem::getPolylines)
@@ -440,7 +829,16 @@ BOOST_PYTHON_MODULE(py_rootbox)
 		.def("getScalar", &RootSystem::getScalar)
 		.def("getRootTips", &RootSystem::getRootTips)
 		.def("getRootBases", &RootSystem::getRootBases)
-		.def("write", &RootSystem::write)
+		.def("getNodeStore", &RootSystem::getNodeStore, return_internal_reference<>())
+		.def("getNodesArray", &RootSystem_getNodesArray)
+		.def("getSegmentsArray", &RootSystem_getSegmentsArray)
+		.def("getNETimesArray", &RootSystem_getNETimesArray)
+		.def("getScalarArray", &RootSystem_getScalarArray)
+		.def("getNewNodesArray", &RootSystem_getNewNodesArray)
+		.def("getNewSegmentsArray", &RootSystem_getNewSegmentsArray)
+		.def("write", &RootSystem::write, write_overloads())
+		.def("setOutputTolerance", &RootSystem::setOutputTolerance)
+		.def("getOutputTolerance", &RootSystem::getOutputTolerance)
 		.def("setSeed",&RootSystem::setSeed)
 		.def("getNumberOfNewNodes",&RootSystem::getNumberOfNewNodes)
 		.def("getNumberOfNewRoots",&RootSystem::getNumberOfNewRoots)
@@ -449,10 +847,19 @@ BOOST_PYTHON_MODULE(py_rootbox)
 		.def("getNewNodes",&RootSystem::getNewNodes)
 		.def("getNewSegments",&RootSystem::getNewSegments)
 		.def("getNewSegmentsOrigin",&RootSystem::getNewSegmentsOrigin)
+		.def("getStepDelta",&RootSystem::getStepDelta)
+		.def("getLengthIncrement",&RootSystem::getLengthIncrement)
 		.def("push",&RootSystem::push)
-		.def("pop",&RootSystem::pop)
+		.def("pop",&RootSystem::pop, detach_views<RootSystem>())
+		.def("setJournaling",&RootSystem::setJournaling)
+		.def("saveState",&RootSystem::saveState)
+		.def("loadState",&RootSystem::loadState, detach_views<RootSystem>())
 		.def("rand",&RootSystem::rand)
 		.def("randn",&RootSystem::randn)
+		.def("setRandomStreams",&RootSystem::setRandomStreams)
+		.def("hasRandomStreams",&RootSystem::hasRandomStreams)
+		.def("getProfile",&RootSystem::getProfile, getProfile_overloads())
+		.def("resetProfile",&RootSystem::resetProfile)
 	;
     enum_<RootSystem::TropismTypes>("TropismType")
     	.value("plagio", RootSystem::TropismTypes::tt_plagio)
@@ -492,13 +899,22 @@ BOOST_PYTHON_MODULE(py_rootbox)
     class_<SegmentAnalyser, SegmentAnalyser*>("SegmentAnalyser")
     .def(init<RootSystem&>())
     .def(init<SegmentAnalyser&>())
-	.def("addSegments",addSegments1)
-	.def("addSegments",addSegments2)
-	.def("crop", &SegmentAnalyser::crop)
-	.def("filter", filter1)
-	.def("filter", filter2)
-	.def("pack", &SegmentAnalyser::pack)
-	.def("getScalar", &SegmentAnalyser::getScalar)
+	.def("addSegments",addSegments1, detach_views<SegmentAnalyser>())
+	.def("addSegments",addSegments2, detach_views<SegmentAnalyser>())
+	.def("crop", &SegmentAnalyser::crop, detach_views<SegmentAnalyser>())
+	.def("filter", filter1, detach_views<SegmentAnalyser>())
+	.def("filter", filter2, detach_views<SegmentAnalyser>())
+	.def("pack", &SegmentAnalyser::pack, detach_views<SegmentAnalyser>())
+	.def("simplify", &SegmentAnalyser::simplify, detach_views<SegmentAnalyser>())
+	.def("buildIndex", &SegmentAnalyser::buildIndex, buildIndex_overloads())
+	.def("clearIndex", &SegmentAnalyser::clearIndex)
+	.def("hasIndex", &SegmentAnalyser::hasIndex)
+	.def("getScalar", getScalar1)
+	.def("getScalar", getScalar2)
+	.def("getNodesArray", &SegmentAnalyser_getNodesArray)
+	.def("getSegmentsArray", &SegmentAnalyser_getSegmentsArray)
+	.def("getCTimesArray", &SegmentAnalyser_getCTimesArray)
+	.def("getScalarArray", &SegmentAnalyser_getScalarArray)
 	.def("getSegmentLength", &SegmentAnalyser::getSegmentLength)
 	.def("getSummed", getSummed1)
 	.def("getSummed", getSummed2)
@@ -506,19 +922,162 @@ BOOST_PYTHON_MODULE(py_rootbox)
 	.def("distribution", distribution_2)
 	.def("distribution2", distribution2_1)
 	.def("distribution2", distribution2_2)
+	.def("distribution3", distribution3_1)
+	.def("distribution3", distribution3_2)
     .def("getRoots", &SegmentAnalyser::getRoots)
 	.def("getNumberOfRoots", &SegmentAnalyser::getNumberOfRoots)
 	.def("cut", cut1)
 	.def("addUserData", &SegmentAnalyser::addUserData)
 	.def("clearUserData", &SegmentAnalyser::clearUserData)
-	.def("write", &SegmentAnalyser::write)
+	.def("write", &SegmentAnalyser::write, write_overloads())
 	// .def("cut", cut2) // not working, see top definition of cut2
     ;
     class_<std::vector<SegmentAnalyser>>("std_vector_SegmentAnalyser_")
         .def(vector_indexing_suite<std::vector<SegmentAnalyser>>() )
 	;
+    class_<SegmentView>("SegmentView", init<SegmentAnalyser&>()[with_custodian_and_ward<1,2>()])
+    .def(init<SegmentAnalyser&, std::vector<int>>()[with_custodian_and_ward<1,2>()])
+	.def("crop", &SegmentView::crop, with_custodian_and_ward<1,2>())
+	.def("filter", view_filter1)
+	.def("filter", view_filter2)
+	.def("getSelection", &SegmentView::getSelection)
+	.def("getNumberOfSegments", &SegmentView::getNumberOfSegments)
+	.def("getScalar", &SegmentView::getScalar)
+	.def("getSummed", view_getSummed1)
+	.def("getSummed", view_getSummed2)
+	.def("distribution", &SegmentView::distribution)
+	.def("distribution2", &SegmentView::distribution2)
+	.def("distribution3", view_distribution3_1)
+	.def("distribution3", view_distribution3_2)
+	.def("pack", &SegmentView::pack)
+	.def("write", &SegmentView::write, write_overloads())
+    ;
+    /*
+     * RootSystemEnsemble.h
+     */
+    class_<std::vector<RootSystem*>>("std_vector_RootSystem_")
+        .def(vector_indexing_suite<std::vector<RootSystem*>>() )
+	;
+    class_<RootSystemEnsemble, boost::noncopyable>("RootSystemEnsemble", init<>())
+    .def(init<int>())
+	.def("openFile", &RootSystemEnsemble::openFile, openFile_overloads())
+	.def("getParameters", &RootSystemEnsemble::getParameters, return_value_policy<reference_existing_object>())
+	.def("setPositions", &RootSystemEnsemble::setPositions)
+	.def("setGrid", &RootSystemEnsemble::setGrid)
+	.def("setGeometry", &RootSystemEnsemble::setGeometry, setGeometry_overloads())
+	.def("setSoil", &RootSystemEnsemble::setSoil)
+	.def("setSeed", &RootSystemEnsemble::setSeed)
+	.def("setNumberOfThreads", &RootSystemEnsemble::setNumberOfThreads)
+	.def("getNumberOfThreads", &RootSystemEnsemble::getNumberOfThreads)
+	.def("initialize", &RootSystemEnsemble::initialize, initialize_overloads()[detach_views<RootSystemEnsemble>()])
+	.def("simulate", ensemble_simulate1, simulate1_overloads()[detach_views<RootSystemEnsemble>()])
+	.def("simulate", ensemble_simulate2, detach_views<RootSystemEnsemble>())
+	.def("getSimTime", &RootSystemEnsemble::getSimTime)
+	.def("reset", &RootSystemEnsemble::reset, detach_views<RootSystemEnsemble>())
+	.def("getNumberOfPlants", &RootSystemEnsemble::getNumberOfPlants)
+	.def("getPlant", &RootSystemEnsemble::getPlant, return_value_policy<reference_existing_object, with_custodian_and_ward_postcall<0,1>>()) // the plant keeps the ensemble alive
+	.def("getPlants", &RootSystemEnsemble::getPlants)
+	.def("getNumberOfNodes", &RootSystemEnsemble::getNumberOfNodes)
+	.def("getNumberOfSegments", &RootSystemEnsemble::getNumberOfSegments)
+	.def("getSegmentAnalyser", &RootSystemEnsemble::getSegmentAnalyser)
+	.def("reduce", &RootSystemEnsemble::reduce, reduce_overloads())
+    ;
+    class_<EnsembleDistribution>("EnsembleDistribution", init<int, double, double, int, optional<bool>>())
+    .def(init<int, double, double, double, double, int, int, optional<bool>>())
+	.def("size", &EnsembleDistribution::size)
+	.def("evaluate", &EnsembleDistribution::evaluate)
+	.def_readwrite("st", &EnsembleDistribution::st)
+	.def_readwrite("top", &EnsembleDistribution::top)
+	.def_readwrite("bot", &EnsembleDistribution::bot)
+	.def_readwrite("left", &EnsembleDistribution::left)
+	.def_readwrite("right", &EnsembleDistribution::right)
+	.def_readwrite("n", &EnsembleDistribution::n)
+	.def_readwrite("m", &EnsembleDistribution::m)
+	.def_readwrite("exact", &EnsembleDistribution::exact)
+    ;
+    class_<std::vector<EnsembleDistribution>>("std_vector_EnsembleDistribution_")
+        .def(vector_indexing_suite<std::vector<EnsembleDistribution>>() )
+	;
+    /*
+     * statistics.h
+     */
+    class_<EnsembleStatistics>("EnsembleStatistics", init<optional<size_t, std::vector<double>>>())
+	.def("add", &EnsembleStatistics::add)
+	.def("size", &EnsembleStatistics::size)
+	.def("getNumberOfSamples", &EnsembleStatistics::getNumberOfSamples)
+	.def("getProbabilities", &EnsembleStatistics::getProbabilities)
+	.def("getMean", &EnsembleStatistics::getMean)
+	.def("getVariance", &EnsembleStatistics::getVariance)
+	.def("getStd", &EnsembleStatistics::getStd)
+	.def("getQuantile", &EnsembleStatistics::getQuantile)
+    ;
+    class_<std::vector<EnsembleStatistics>>("std_vector_EnsembleStatistics_")
+        .def(vector_indexing_suite<std::vector<EnsembleStatistics>>() )
+	;
+    /*
+     * profile.h
+     */
+    class_<ProfileCounters>("ProfileCounters", init<>())
+	.def("getCount", &ProfileCounters::getCount)
+	.def("getTime", &ProfileCounters::getTime)
+	.def("reset", &ProfileCounters::reset)
+	.def("__str__", &ProfileCounters::toString)
+    ;
+    enum_<ProfileCounters::Counter>("ProfileCounter")
+            .value("sdf", ProfileCounters::pc_sdf)
+            .value("objectives", ProfileCounters::pc_objectives)
+            .value("rejections", ProfileCounters::pc_rejections)
+            .value("nodes", ProfileCounters::pc_nodes)
+            .value("roots", ProfileCounters::pc_roots)
+            .value("soil", ProfileCounters::pc_soil)
+    ;
+    enum_<ProfileCounters::Phase>("ProfilePhase")
+            .value("simulate", ProfileCounters::pp_simulate)
+            .value("heading", ProfileCounters::pp_heading)
+            .value("segments", ProfileCounters::pp_segments)
+            .value("laterals", ProfileCounters::pp_laterals)
+            .value("soil", ProfileCounters::pp_soil)
+            .value("output", ProfileCounters::pp_output)
+    ;
+    def("hasProfiling", &ProfileCounters::hasProfiling);
+    /*
+     * vtp.h
+     */
+    enum_<VTPWriter::Encoding>("VTPEncoding")
+            .value("ascii", VTPWriter::vtp_ascii)
+            .value("raw", VTPWriter::vtp_raw)
+            .value("base64", VTPWriter::vtp_base64)
+    ;
+    class_<VTPSeries>("VTPSeries", init<std::string>())
+    .def(init<std::string, int>())
+    .def(init<std::string, int, bool>())
+	.def("write", series_write1)
+	.def("write", series_write2, series_write_overloads())
+	.def("getNumberOfSteps", &VTPSeries::getNumberOfSteps)
+    ;
+    def("hasVTPCompression", &VTPWriter::hasCompression);
+    /*
+     * xylem_flux.h
+     */
+    class_<XylemFlux>("XylemFlux", init<RootSystem*>())
+	.def_readwrite("rho", &XylemFlux::rho)
+	.def_readwrite("g", &XylemFlux::g)
+	.def("setKr", &XylemFlux::setKr)
+	.def("setKz", &XylemFlux::setKz)
+	.def("setShootParameters", &XylemFlux::setShootParameters)
+	.def("setScale", &XylemFlux::setScale)
+	.def("linearSystem", &XylemFlux::linearSystem)
+	.def("addDirichlet", &XylemFlux::addDirichlet)
+	.def("addNeumann", &XylemFlux::addNeumann)
+	.def("solve", &XylemFlux::solve)
+	.def("getSegments", &XylemFlux::getSegments)
+	.def("axialFlux", &XylemFlux::axialFlux)
+	.def("radialFlux", &XylemFlux::radialFlux)
+	.def("getCSR", &XylemFlux_getCSR)
+	.def("getNumberOfNodes", &XylemFlux::getNumberOfNodes)
+    ;
     /*
-     * example_exudation.h (rather specific for Cheng)
+     * exudation.h (rather specific for Cheng)
      */
     class_<ExudationParameters>("ExudationParameters")
 		.def_readwrite("M", &ExudationParameters::M)
@@ -527,12 +1086,15 @@ BOOST_PYTHON_MODULE(py_rootbox)
 		.def_readwrite("theta", &ExudationParameters::theta)
 		.def_readwrite("R", &ExudationParameters::R)
 		.def_readwrite("lambda_", &ExudationParameters::lambda_)
+		.def_readwrite("tol", &ExudationParameters::tol)
+		.def_readwrite("threads", &ExudationParameters::threads)
 		.def_readwrite("age_r", &ExudationParameters::age_r)
 		.def_readwrite("tip", &ExudationParameters::tip)
 		.def_readwrite("v", &ExudationParameters::v)
 		.def_readwrite("pos", &ExudationParameters::pos)
 		;
      def("getExudateConcentration", getExudateConcentration);
+     def("getExudationRadius", getExudationRadius);
 }
 
 /*
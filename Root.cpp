@@ -1,4 +1,8 @@
 #include "Root.h"
+#include "polyline.h"
+
+#include <algorithm>
+#include <typeinfo>
 
 /**
  * Constructor
@@ -18,13 +22,19 @@ Root::Root(RootSystem* rs, int type, Vector3d pheading, double delay,  Root* par
 {
 	//std::cout << "Root constructor \n";
 	rootsystem=rs; // remember
-	param = rs->getRootTypeParameter(type)->realize(); // throw the dice
+	randomKey = RandomStream::getKey((parent!=nullptr) ? parent->randomKey : 0, (parent!=nullptr) ? parent->laterals.size() : rs->baseRoots.size());
+	RandomStream random = rs->getRandomStream(this, RandomStream::dp_create, 0); // inactive, unless RootSystem::setRandomStreams
+	RandomStreamScope scope(random);
+	param = rs->readRootTypeParameter(type)->realize(rs->getRandomGenerator(type)); // throw the dice
+	CROOTBOX_PROFILE_COUNT(getProfileCounters(), ProfileCounters::pc_roots, 1);
 	double beta = 2*M_PI*rs->rand(); // initial rotation
 	Matrix3d ons = Matrix3d::ons(pheading);
 	ons.times(Matrix3d::rotX(beta));
 	double theta = param.theta;
 	if (parent!=nullptr) { // scale if not a baseRoot
-		double scale = rs->getRootTypeParameter(type)->sa->getValue(parent->getNode(pni),this);
+		CROOTBOX_PROFILE_COUNT(getProfileCounters(), ProfileCounters::pc_soil, 1);
+		CROOTBOX_PROFILE_TIME(getProfileCounters(), ProfileCounters::pp_soil);
+		double scale = rs->readRootTypeParameter(type)->sa->getValue(parent->getNode(pni),this);
 		theta*=scale;
 	}
 	ons.times(Matrix3d::rotZ(theta));
@@ -32,11 +42,22 @@ Root::Root(RootSystem* rs, int type, Vector3d pheading, double delay,  Root* par
 	//
 	age = -delay; // the root starts growing when age>0
 	alive = 1; // alive per default
-	id = rs->getRootIndex(); // root id
+	id = rs->getRootIndex(this); // root id
 	this->parent = parent;
 	parent_base_length=pbl;
 	parent_ni=pni;
 	length = 0;
+	epoch = rs->epoch; // created after the state was saved, nothing to record
+	if (parent!=nullptr) { // constant part of the node creation times
+		parentCreationTime = parent->getCreationTime(parent_base_length+parent->param.la); // parent length, when this root was created
+		assert(parentCreationTime>=0);
+	}
+	if (rs->reserveNodes) { // expected number of nodes, @see RootSystem::setReserveNodes
+		size_t n = size_t(param.getK()/dx())+std::max(param.nob, 0)+2;
+		nodes.reserve(n);
+		nodeIds.reserve(n);
+		netimes.reserve(n);
+	}
 	// initial node
 	if (parent!=nullptr) { // the first node of the base roots must be created in RootSystem::initialize()
 		// otherwise, don't use addNode for the first node of the root,
@@ -50,12 +71,12 @@ Root::Root(RootSystem* rs, int type, Vector3d pheading, double delay,  Root* par
 /**
  * Copies the root tree
  */
-Root::Root(const Root& r, RootSystem& rs) :rootsystem(&rs), param(r.param), iheading(r.iheading), id(r.id), parent_base_length(r.parent_base_length), parent_ni(r.parent_ni), alive(r.alive),
-		active(r.active), age(r.age), length(r.length), old_non(r.old_non), parent(r.parent), smallDx(r.smallDx), nodes(r.nodes), nodeIds(r.nodeIds), netimes(r.netimes)
+Root::Root(const Root& r, RootSystem& rs) :rootsystem(&rs), param(r.param), iheading(r.iheading), id(r.id), parent_base_length(r.parent_base_length), parent_ni(r.parent_ni), parentCreationTime(r.parentCreationTime), randomKey(r.randomKey),
+		active(r.active), length(r.length), old_non(r.old_non), quiescent(r.quiescent), sleepStep(r.sleepStep), sleepEnd(r.sleepEnd), parent(r.parent), smallDx(r.smallDx), alive(r.alive), age(r.age), nodes(r.nodes), nodeIds(r.nodeIds), netimes(r.netimes)
 {
 	laterals = std::vector<Root*>(r.laterals.size());
 	for (size_t i=0; i< r.laterals.size(); i++) {
-		laterals[i] = new Root(*r.laterals[i], rs); // copy lateral
+		laterals[i] = new(rs.pool) Root(*r.laterals[i], rs); // copy lateral
 		laterals[i]->parent = this; // set parent
 	}
 }
@@ -70,6 +91,51 @@ Root::~Root()
 	}
 }
 
+/**
+ * Allocates a root from the global heap (e.g. roots created in Python)
+ */
+void* Root::operator new(size_t size)
+{
+	return operator new(size, nullptr);
+}
+
+/**
+ * Allocates a root from a pool. The pool is stored in front of the root,
+ * roots of derived classes that do not fit into the pool, are allocated from the global heap.
+ *
+ * @param size      size of the object [bytes]
+ * @param pool      the pool (or nullptr for the global heap)
+ */
+void* Root::operator new(size_t size, RootPool* pool)
+{
+	char* p;
+	if ((pool!=nullptr) && (RootPool::headerSize+size<=RootPool::slotSize)) {
+		p = static_cast<char*>(pool->allocate());
+	} else {
+		p = static_cast<char*>(::operator new(RootPool::headerSize+size));
+		pool = nullptr;
+	}
+	*reinterpret_cast<RootPool**>(p) = pool;
+	return p+RootPool::headerSize;
+}
+
+/**
+ * Returns the memory of a root to its pool, or to the global heap
+ */
+void Root::operator delete(void* p)
+{
+	if (p==nullptr) {
+		return;
+	}
+	char* h = static_cast<char*>(p)-RootPool::headerSize;
+	RootPool* pool = *reinterpret_cast<RootPool**>(h);
+	if (pool!=nullptr) {
+		pool->deallocate(h);
+	} else {
+		::operator delete(h);
+	}
+}
+
 /**
  * Simulates growth of this root for a time span dt
  *
@@ -78,14 +144,22 @@ Root::~Root()
  */
 void Root::simulate(double dt, bool silence)
 {
+	rootsystem->journalRoot(this);
 	old_non = 0; // is set in Root:createSegments, (the zero indicates the first call to createSegments)
 
 	const RootParameter &p = param; // rename
+	double length0 = length;
 
 	// increase age
 	if (age+dt>p.rlt) { // root life time
 		dt=p.rlt-age; // remaining life span
 		alive = false; // this root is dead
+		for (auto l:laterals) { // the subtrees receive no further time steps (@see Root::getCurrentState)
+			if (l->sleepEnd<0) {
+				rootsystem->journalRoot(l);
+				l->sleepEnd = rootsystem->getNumberOfTimeSteps()-1;
+			}
+		}
 	}
 	age+=dt;
 
@@ -93,10 +167,17 @@ void Root::simulate(double dt, bool silence)
 
 		// probabilistic branching model (todo test)
 		if ((age>0) && (age-dt<=0)) { // the root emerges in this time step
-			double P = rootsystem->getRootTypeParameter(param.type)->sbp->getValue(nodes.back(),this);
+			double P;
+			{
+				CROOTBOX_PROFILE_COUNT(getProfileCounters(), ProfileCounters::pc_soil, 1);
+				CROOTBOX_PROFILE_TIME(getProfileCounters(), ProfileCounters::pp_soil);
+				P = rootsystem->readRootTypeParameter(param.type)->sbp->getValue(nodes.back(),this);
+			}
 			if (P<1.) { // P==1 means the lateral emerges with probability 1 (default case)
 				double p = 1.-std::pow((1.-P), dt); //probability of emergence in this time step
 				std::cout <<P<<", "<<p<< "\n";
+				RandomStream random = rootsystem->getRandomStream(this, RandomStream::dp_emergence, RandomStream::getIndex(rootsystem->getSimTime()));
+				RandomStreamScope scope(random);
 				if (rootsystem->rand()>p) { // not rand()<p
 					age -= dt; // the root does not emerge in this time step
 				}
@@ -107,7 +188,7 @@ void Root::simulate(double dt, bool silence)
 
 			// children first (lateral roots grow even if base root is inactive)
 			for (auto l:laterals) {
-				l->simulate(dt,silence);
+				rootsystem->simulateLateral(l,dt,silence);
 			}
 
 			if (active) {
@@ -118,7 +199,12 @@ void Root::simulate(double dt, bool silence)
 				double length_ = (lengthMax+lengthMin)/2.; // best i could think of
 				double targetlength = getLength(age);
 				double e = targetlength-length_; //elongation in time step dt
-				double scale = rootsystem->getRootTypeParameter(param.type)->se->getValue(nodes.back(),this); // hope some of this is optimized out if not set
+				double scale;
+				{
+					CROOTBOX_PROFILE_COUNT(getProfileCounters(), ProfileCounters::pc_soil, 1);
+					CROOTBOX_PROFILE_TIME(getProfileCounters(), ProfileCounters::pp_soil);
+					scale = rootsystem->readRootTypeParameter(param.type)->se->getValue(nodes.back(),this); // hope some of this is optimized out if not set
+				}
 				double dl = std::max(scale*e, double(0)); // length increment, dt is not used anymore
 
 				// create geometry
@@ -177,10 +263,85 @@ void Root::simulate(double dt, bool silence)
 		}
 	} // if alive
 
+	if (length>length0) {
+		rootsystem->addLengthIncrement(length-length0);
+	}
+
 	if (old_non==0) { // if createSegments was not called
 		old_non = -nodes.size();
+	} else {
+		rootsystem->addGrownRoot(this);
 	}
 
+	// from now on the subtree only ages, if the root is dead, or finished growing with all laterals quiescent
+	quiescent = (old_non==-int(nodes.size())) && ((!alive) || ((age>0) && (!active) &&
+		std::all_of(laterals.begin(), laterals.end(), [](const Root* l) { return l->quiescent; })));
+
+}
+
+/**
+ * Current age of the root, including the time steps that were skipped because its subtree is quiescent
+ * (the age member is the age when the subtree started to be skipped)
+ */
+double Root::getCurrentAge() const
+{
+	double a;
+	bool al;
+	getCurrentState(a, al);
+	return a;
+}
+
+/**
+ * Current life state of the root, including the time steps that were skipped because its subtree is quiescent
+ */
+bool Root::isAlive() const
+{
+	double a;
+	bool al;
+	getCurrentState(a, al);
+	return al;
+}
+
+/**
+ * Age and life state of the root. The time steps skipped by quiescent subtrees (@see RootSystem::skipQuiescent)
+ * are replayed from the base root down to this root, exactly as Root::simulate would have aged the roots.
+ *
+ * @param age      current age [days]
+ * @param alive    current life state
+ */
+void Root::getCurrentState(double& age, bool& alive) const
+{
+	std::vector<const Root*> path; // this root and its ancestors
+	for (const Root* r = this; r!=nullptr; r = r->parent) {
+		path.push_back(r);
+	}
+	int n = rootsystem->getNumberOfTimeSteps();
+	int start = n; // first time step the root skipped (n if it was simulated)
+	int end = n; // end of the time steps that reached the root
+	for (auto it = path.rbegin(); it!=path.rend(); ++it) {
+		const Root* r = *it;
+		if (r->sleepStep>=0) {
+			start = r->sleepStep;
+		}
+		if (r->sleepEnd>=0) {
+			end = std::min(end, r->sleepEnd);
+		}
+		age = r->age;
+		alive = r->alive;
+		int lend = alive ? end : start; // end of the time steps that reached the laterals
+		for (int i=start; i<end; i++) { // as in Root::simulate
+			double dt = rootsystem->getTimeStep(i);
+			if (age+dt>r->param.rlt) {
+				dt = r->param.rlt-age;
+				if (alive) {
+					lend = i;
+				}
+				alive = false;
+			}
+			age += dt;
+		}
+		end = lend;
+	}
 }
 
 /**
@@ -197,14 +358,7 @@ double Root::getCreationTime(double length)
 		std::cout.flush();
 		throw std::invalid_argument( "bugbugbug" );
 	}
-	if (parent!=nullptr) {
-		double pl = parent_base_length+parent->param.la; // parent length, when this root was created
-		double page=parent->getCreationTime(pl);
-		assert(page>=0);
-		return rootage+page;
-	} else {
-		return rootage;
-	}
+	return rootage+parentCreationTime; // the parent part is computed once by the constructor
 }
 
 /**
@@ -215,7 +369,14 @@ double Root::getCreationTime(double length)
 double Root::getLength(double age)
 {
 	assert(age>=0);
-	return rootsystem->gf.at(param.type-1)->getLength(age,param.r,param.getK(),this);
+	if (growthType<0) {
+		setGrowthType();
+	}
+	switch (growthType) {
+	case RootSystem::gft_negexp: return ExponentialGrowth::length(age,param.r,param.getK());
+	case RootSystem::gft_linear: return LinearGrowth::length(age,param.r,param.getK());
+	default: return rootsystem->gf.at(param.type-1)->getLength(age,param.r,param.getK(),this);
+	}
 }
 
 /**
@@ -226,12 +387,36 @@ double Root::getLength(double age)
 double Root::getAge(double length)
 {
 	assert(length>=0);
-	return rootsystem->gf.at(param.type-1)->getAge(length,param.r,param.getK(),this);
+	if (growthType<0) {
+		setGrowthType();
+	}
+	switch (growthType) {
+	case RootSystem::gft_negexp: return ExponentialGrowth::age(length,param.r,param.getK());
+	case RootSystem::gft_linear: return LinearGrowth::age(length,param.r,param.getK());
+	default: return rootsystem->gf.at(param.type-1)->getAge(length,param.r,param.getK(),this);
+	}
+}
+
+/**
+ * The built in growth functions are evaluated without virtual calls, if the growth function of the root type is exactly
+ * ExponentialGrowth or LinearGrowth (i.e. not a derived class). Called on first use, since the growth functions
+ * are created after the base roots (@see RootSystem::initialize).
+ */
+void Root::setGrowthType()
+{
+	const GrowthFunction* f = rootsystem->gf.at(param.type-1);
+	if (typeid(*f)==typeid(ExponentialGrowth)) {
+		growthType = RootSystem::gft_negexp;
+	} else if (typeid(*f)==typeid(LinearGrowth)) {
+		growthType = RootSystem::gft_linear;
+	} else {
+		growthType = 0;
+	}
 }
 
-RootTypeParameter* Root::getRootTypeParameter() const
+const RootTypeParameter* Root::getRootTypeParameter() const
 {
-	return rootsystem->getRootTypeParameter(param.type);
+	return rootsystem->readRootTypeParameter(param.type);
 }
 
 /**
@@ -244,7 +429,12 @@ void Root::createLateral(bool silence)
 	// std::cout << "createLateral()\n";
 	const RootParameter &p = param; // rename
 
-	int lt = rootsystem->getRootTypeParameter(p.type)->getLateralType(nodes.back());
+	int lt;
+	{
+		RandomStream random = rootsystem->getRandomStream(this, RandomStream::dp_lateral, nodes.size()-1);
+		RandomStreamScope scope(random);
+		lt = rootsystem->readRootTypeParameter(p.type)->getLateralType(nodes.back(), rootsystem->getRandomGenerator(p.type));
+	}
 	//std::cout << "lateral type " << lt << "\n";
 
 	if (lt>0) {
@@ -261,9 +451,13 @@ void Root::createLateral(bool silence)
 		double ageLG = this->getAge(length+p.la); // age of the root, when the lateral starts growing (i.e when the apical zone is developed)
 		double delay = ageLG-ageLN; // time the lateral has to wait
 
-		Root* lateral = rootsystem->createRoot(lt,  h, delay,  this, length, nodes.size()-1);
+		Root* lateral;
+		{
+			CROOTBOX_PROFILE_TIME(getProfileCounters(), ProfileCounters::pp_laterals);
+			lateral = rootsystem->createRoot(lt,  h, delay,  this, length, nodes.size()-1);
+		}
 		laterals.push_back(lateral);
-		lateral->simulate(age-ageLN,silence); // pass time overhead (age we want to achieve minus current age)
+		rootsystem->simulateLateral(lateral,age-ageLN,silence); // pass time overhead (age we want to achieve minus current age)
 		//cout << "time overhead " << age-ageLN << "\n";
 	}
 }
@@ -280,6 +474,7 @@ void Root::createSegments(double l, bool silence)
 {
 	// std::cout << "createSegments("<< l << ")\n";
 	assert(l>0);
+	CROOTBOX_PROFILE_TIME(getProfileCounters(), ProfileCounters::pp_segments);
 	double sl=0; // summed length of created segment
 
 	// shift first node to axial resolution
@@ -301,7 +496,13 @@ void Root::createSegments(double l, bool silence)
 				double sdx = std::min(dx()-olddx,l);
 
 				Matrix3d ons = Matrix3d::ons(h);
-				Vector2d ab = rootsystem->tf.at(param.type-1)->getHeading(nodes.back(),ons,olddx+sdx,this);
+				Vector2d ab;
+				{
+					uint64_t i = RandomStream::hash(nn-1, RandomStream::getIndex(rootsystem->getSimTime())); // the node might be moved in several time steps
+					RandomStream random = rootsystem->getRandomStream(this, RandomStream::dp_shift, i);
+					RandomStreamScope scope(random);
+					ab = rootsystem->getTropism(param.type)->getHeading(nodes.back(),ons,olddx+sdx,this);
+				}
 				ons.times(Matrix3d::rotX(ab.y));
 				ons.times(Matrix3d::rotZ(ab.x));
 				Vector3d newdx = Vector3d(ons.column(0).times(sdx));
@@ -309,8 +510,9 @@ void Root::createSegments(double l, bool silence)
 				Vector3d newnode = Vector3d(nodes.back().plus(newdx));
 				sl = sdx;
 				double et = this->getCreationTime(length+sl);
-				nodes[nn-1] = newnode;
+				nodes.set(nn-1, newnode);
 				netimes[nn-1] = std::max(et,rootsystem->getSimTime()); // in case of impeded growth the node emergence time is not exact anymore, but might break down to temporal resolution
+				rootsystem->moveNode(this, nn-1);
 				old_non = nn;
 				l -= sdx;
 				if (l<=0) { // ==0 should be enough
@@ -358,7 +560,12 @@ void Root::createSegments(double l, bool silence)
 		sl+=sdx;
 
 		Matrix3d ons = Matrix3d::ons(h);
-		Vector2d ab = rootsystem->tf.at(param.type-1)->getHeading(nodes.back(),ons,sdx,this);
+		Vector2d ab;
+		{
+			RandomStream random = rootsystem->getRandomStream(this, RandomStream::dp_heading, nodes.size());
+			RandomStreamScope scope(random);
+			ab = rootsystem->getTropism(param.type)->getHeading(nodes.back(),ons,sdx,this);
+		}
 		ons.times(Matrix3d::rotX(ab.y));
 		ons.times(Matrix3d::rotZ(ab.x));
 		Vector3d newdx = Vector3d(ons.column(0).times(sdx));
@@ -412,8 +619,53 @@ void Root::addNode(Vector3d n, double t)
 {
 	assert(t>=0.);
 	nodes.push_back(n); // node
-	nodeIds.push_back(rootsystem->getNodeIndex()); // new unique id
 	netimes.push_back(t); // exact creation time
+	nodeIds.push_back(rootsystem->getNodeIndex(this)); // new unique id (and add to the node store)
+	CROOTBOX_PROFILE_COUNT(getProfileCounters(), ProfileCounters::pc_nodes, 1);
+}
+
+/**
+ * Instrumentation counters of the root type (nullptr for an undefined type, or without CROOTBOX_PROFILE)
+ */
+ProfileCounters* Root::getProfileCounters() const
+{
+#ifdef CROOTBOX_PROFILE
+	if ((param.type<0) || (param.type>=int(rootsystem->profile.size()))) {
+		return nullptr;
+	}
+	return rootsystem->getProfileCounters(param.type);
+#else
+	return nullptr;
+#endif
+}
+
+/**
+ * Simplifies the polyline of the root (@see Polyline::simplify), keeping the root base, the tip, and the branch points of the laterals
+ *
+ * @param tolerance     maximal distance of a removed node to the simplified polyline [cm], all nodes are kept if tolerance<=0
+ * \return              indices of the kept nodes
+ */
+std::vector<int> Root::getSimplifiedNodes(double tolerance) const
+{
+	std::vector<int> ni;
+	if (tolerance<=0) {
+		ni.resize(nodes.size());
+		for (size_t i=0; i<ni.size(); i++) {
+			ni[i] = i;
+		}
+		return ni;
+	}
+	std::vector<Vector3d> p(nodes.size());
+	for (size_t i=0; i<p.size(); i++) {
+		p[i] = nodes[i];
+	}
+	std::vector<bool> fixed(nodes.size(), false);
+	for (auto l : laterals) {
+		if ((l->parent_ni>=0) && (l->parent_ni<int(fixed.size()))) {
+			fixed[l->parent_ni] = true;
+		}
+	}
+	return Polyline::simplify(p, fixed, tolerance);
 }
 
 /**
@@ -431,18 +683,23 @@ void Root::writeRSML(std::ostream & cout, std::string indent) const
 		cout << indent << "\t<geometry>\n"; // open geometry
 		cout << indent << "\t\t<polyline>\n"; // open polyline
 		// polyline nodes
-		cout << indent << "\t\t\t" << "<point ";
-		Vector3d v = nodes.at(0);
-		cout << "x=\"" << v.x << "\" y=\"" << v.z << "\" z=\"" << v.y << "\"/>\n";
-		int n = this->rootsystem->rsmlReduction;
-		for (size_t i = 1; i<nodes.size()-1; i+=n) {
+		std::vector<int> ni; // written nodes
+		double tol = this->rootsystem->getOutputTolerance();
+		if (tol>0) { // simplified polyline
+			ni = getSimplifiedNodes(tol);
+		} else { // each n-th node
+			ni.push_back(0);
+			int n = this->rootsystem->rsmlReduction;
+			for (size_t i = 1; i<nodes.size()-1; i+=n) {
+				ni.push_back(i);
+			}
+			ni.push_back(nodes.size()-1);
+		}
+		for (int i : ni) {
 			cout << indent << "\t\t\t" << "<point ";
 			Vector3d v = nodes.at(i);
 			cout << "x=\"" << v.x << "\" y=\"" << v.z << "\" z=\"" << v.y << "\"/>\n";
 		}
-		cout << indent << "\t\t\t" << "<point ";
-		v = nodes.at(nodes.size()-1);
-		cout << "x=\"" << v.x << "\" y=\"" << v.z << "\" z=\"" << v.y << "\"/>\n";
 		cout << indent << "\t\t</polyline>\n"; // close polyline
 		cout << indent << "\t</geometry>\n"; // close geometry
 
@@ -453,12 +710,9 @@ void Root::writeRSML(std::ostream & cout, std::string indent) const
 
 		cout << indent << "\t<functions>\n"; // open functions
 		cout << indent << "\t\t<function name='emergence_time' domain='polyline'>\n"; // open functions
-		cout << indent << "\t\t\t" << "<sample>" << netimes.at(0) << "</sample>\n";
-		for (size_t i = 1; i<netimes.size()-1; i+=n) {
+		for (int i : ni) {
 			cout << indent << "\t\t\t" << "<sample>" << netimes.at(i) << "</sample>\n";
-
 		}
-		cout << indent << "\t\t\t" << "<sample>" << netimes.at(netimes.size()-1) << "</sample>\n";
 
 		cout << indent << "\t\t</function>\n"; // close functions
 		cout << indent << "\t</functions>\n"; // close functions
@@ -478,22 +732,26 @@ void Root::writeRSML(std::ostream & cout, std::string indent) const
 std::string Root::toString() const
 {
 	std::stringstream str;
-	str << "Root #"<< id <<": type "<<param.type << ", length: "<< length << ", age: " <<age<<" with "<< laterals.size() << " laterals\n";
+	str << "Root #"<< id <<": type "<<param.type << ", length: "<< length << ", age: " <<getCurrentAge()<<" with "<< laterals.size() << " laterals\n";
 	return str.str();
 }
 
 
 
 
-RootState::RootState(const Root& r): alive(r.alive), active(r.active), age(r.age), length(r.length), old_non(r.old_non)
+RootState::RootState(const Root& r, bool recursive): alive(r.alive), active(r.active), age(r.age), length(r.length), old_non(r.old_non),
+	quiescent(r.quiescent), sleepStep(r.sleepStep), sleepEnd(r.sleepEnd)
 {
 	lNode = r.nodes.back();
 	lNodeId = r.nodeIds.back();
 	lneTime = r.netimes.back();
 	non = r.nodes.size();
-	laterals = std::vector<RootState>(r.laterals.size());
-	for (size_t i=0; i<laterals.size(); i++) {
-		laterals[i] = RootState(*(r.laterals[i]));
+	nol = r.laterals.size();
+	if (recursive && (r.sleepStep<0)) { // skipped subtrees do not change
+		laterals = std::vector<RootState>(r.laterals.size());
+		for (size_t i=0; i<laterals.size(); i++) {
+			laterals[i] = RootState(*(r.laterals[i]));
+		}
 	}
 }
 
@@ -504,16 +762,19 @@ void RootState::restore(Root& r)
 	r.age = age;
 	r.length = length;
 	r.old_non = old_non;
+	r.quiescent = quiescent;
+	r.sleepStep = sleepStep;
+	r.sleepEnd = sleepEnd;
 	r.nodes.resize(non); // shrink vectors
 	r.nodeIds.resize(non);
 	r.netimes.resize(non);
-	r.nodes.back() = lNode; // restore last value
+	r.nodes.set(non-1, lNode); // restore last value
 	r.nodeIds.back() = lNodeId;
 	r.netimes.back() = lneTime;
-	for (size_t i = laterals.size(); i<r.laterals.size(); i++) { // delete roots that have not been created
+	for (size_t i = nol; i<r.laterals.size(); i++) { // delete roots that have not been created
 		delete r.laterals[i];
 	}
-	r.laterals.resize(laterals.size()); // shrink and restore laterals
+	r.laterals.resize(nol); // shrink and restore laterals
 	for (size_t i=0; i<laterals.size(); i++) {
 		laterals[i].restore(*(r.laterals[i]));
 	}
@@ -521,6 +782,51 @@ void RootState::restore(Root& r)
 
 
 
+const size_t RootPool::headerSize;
+const size_t RootPool::slotSize;
 
+/**
+ * Returns memory for one root, reuses the memory of deleted roots, or takes the next slot of the last chunk
+ */
+void* RootPool::allocate()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	live++;
+	if (!freeSlots.empty()) {
+		void* p = freeSlots.back();
+		freeSlots.pop_back();
+		return p;
+	}
+	if (chunks.empty() || (used==chunkSize)) {
+		chunks.push_back(static_cast<char*>(::operator new(chunkSize*slotSize)));
+		used = 0;
+	}
+	return chunks.back()+slotSize*(used++);
+}
 
+/**
+ * Returns the memory of a root for reuse
+ *
+ * @param p         memory obtained by RootPool::allocate
+ */
+void RootPool::deallocate(void* p)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	live--;
+	freeSlots.push_back(p);
+}
 
+/**
+ * Frees all chunks at once (e.g. after RootSystem::reset() deleted all roots)
+ */
+void RootPool::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	assert(live==0);
+	for (auto c : chunks) {
+		::operator delete(c);
+	}
+	chunks.clear();
+	freeSlots.clear();
+	used = 0;
+}
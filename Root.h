@@ -3,16 +3,21 @@
 
 #include <iostream>
 #include <assert.h>
+#include <mutex>
 
 #include "mymath.h"
+#include "NodeStore.h"
 #include "sdf.h"
 #include "tropism.h"
 #include "growth.h"
 #include "ModelParameter.h"
+#include "profile.h"
 #include "RootSystem.h"
 
 class RootSystem;
 class RootState;
+class GrowthTask;
+class RootPool;
 
 /**
  * Root
@@ -26,6 +31,7 @@ class Root
 
     friend RootSystem;
     friend RootState;
+    friend GrowthTask;
 
 public:
 
@@ -33,14 +39,21 @@ public:
     Root(const Root& r, RootSystem& rs); ///< deep copy of the tree
     virtual ~Root();
 
+    static void* operator new(size_t size); ///< allocates from the global heap
+    static void* operator new(size_t size, RootPool* pool); ///< allocates from the pool of a root system (@see RootPool)
+    static void operator delete(void* p); ///< returns the memory to its pool, or to the global heap
+    static void operator delete(void* p, RootPool* pool) { operator delete(p); } ///< called if the constructor throws
+
     void simulate(double dt, bool silence = false); ///< root growth for a time span of \param dt
+    double getCurrentAge() const; ///< current age [days], including the time steps skipped by a quiescent subtree
+    bool isAlive() const; ///< current life state, including the time steps skipped by a quiescent subtree
 
     /* exact from analytical equations */
     double getCreationTime(double lenght); ///< analytical creation (=emergence) time of a node at a length
     double getLength(double age); ///< analytical length of the root
     double getAge(double length); ///< analytical age of the root
 
-    RootTypeParameter* getRootTypeParameter() const;  ///< returns the root type parameter of the root
+    const RootTypeParameter* getRootTypeParameter() const;  ///< returns the root type parameter of the root
     double dx() const { return getRootTypeParameter()->dx; } ///< returns the axial resolution
 
     std::vector<Root*> getRoots(); ///< return the root including laterals as sequential vector
@@ -51,7 +64,9 @@ public:
     double getNodeETime(int i) const { return netimes.at(i); } ///< creation time of i-th node
     int getNodeId(int i) const {return nodeIds.at(i); } ///< unique identifier of i-th node
     size_t getNumberOfNodes() const {return nodes.size(); }  ///< return the number of the nodes of the root
+    std::vector<int> getSimplifiedNodes(double tolerance) const; ///< indices of the nodes of the simplified polyline (@see Polyline), all nodes if tolerance<=0
     void addNode(Vector3d n,double t); //< adds a node to the root
+    ProfileCounters* getProfileCounters() const; ///< instrumentation counters of the root type (@see RootSystem::getProfile)
 
     /* IO */
     void writeRSML(std::ostream & cout, std::string indent) const; ///< writes a RSML root tag
@@ -65,13 +80,17 @@ public:
     int id; ///< unique root id, (not used so far)
     double parent_base_length; ///< length [cm]
     int parent_ni; ///< parent node index
+    double parentCreationTime = 0; ///< creation time of the parent node when the root starts to develop, constant (@see Root::getCreationTime)
+    uint64_t randomKey = 0; ///< key of the random streams of the root, derived from the parent and the lateral index (@see RootSystem::setRandomStreams)
 
-    /* parameters that are given per root that may change with time */
-    bool alive = 1; ///< true: alive, false: dead
+    /* parameters that are given per root that may change with time (age and life state, @see Root::getCurrentAge, Root::isAlive) */
     bool active = 1; ///< true: active, false: root stopped growing
-    double age = 0; ///< current age [days]
     double length = 0; ///< actual length [cm] of the root. might differ from getLength(age) in case of impeded root growth
     int old_non = 1; ///< number of old nodes, the sign is positive if the last node was updated, otherwise its negative
+    unsigned int epoch = 0; ///< journaled state the root was last recorded in (@see RootSystem::setJournaling)
+    bool quiescent = false; ///< true: the root and its laterals will only age, the subtree is not simulated anymore (@see RootSystem::skipQuiescent)
+    int sleepStep = -1; ///< first time step that was skipped (@see RootSystem::getTimeStep), -1 if the root is simulated
+    int sleepEnd = -1; ///< time step in which the parent died (the subtree receives no further time steps), -1 if the parent is alive
 
     /* up and down */
     Root* parent; ///< pointer to the parent root (equals nullptr if it is a base root)
@@ -81,13 +100,23 @@ public:
 
 protected:
 
+    Root(RootSystem* rs) : rootsystem(rs), parent(nullptr) { } ///< empty root, filled by RootSystem::readState()
+
     void createSegments(double l, bool silence); ///< creates segments of length l, called by Root::simulate()
     void createLateral(bool silence); ///< creates a new lateral, called by Root::simulate()
 
+    int growthType = -1; ///< growth function evaluated inline (RootSystem::gft_negexp, or gft_linear), 0 for virtual calls, -1 if not known yet
+    void setGrowthType(); ///< sets growthType from the dynamic type of the growth function of the root type
+    void getCurrentState(double& age, bool& alive) const; ///< age and life state, replays the skipped time steps
+
+    /* age and life state of the last simulated time step, stale while the subtree is quiescent (@see RootSystem::skipQuiescent) */
+    bool alive = 1; ///< true: alive, false: dead
+    double age = 0; ///< age [days]
+
     /* parameters that are given per node */
-    std::vector<Vector3d> nodes = std::vector<Vector3d>(0); ///< nodes of the root
+    NodeVector nodes; ///< nodes of the root
     std::vector<int> nodeIds = std::vector<int>(0); ///< unique node identifier
-    std::vector<double> netimes = std::vector<double>(0); ///< node emergence times [days]
+    std::vector<StoredReal> netimes = std::vector<StoredReal>(0); ///< node emergence times [days]
 
 };
 
@@ -102,7 +131,7 @@ public:
 
 	RootState() { };
 
-	RootState(const Root& r);
+	RootState(const Root& r, bool recursive = true); ///< stores the state of the root, and of its laterals if recursive
 
 	void restore(Root& r);
 
@@ -114,9 +143,13 @@ private:
     double age = 0; ///< current age [days]
     double length = 0; ///< actual length [cm] of the root. might differ from getLength(age) in case of impeded root growth
     int old_non = 1; ///< number of old nodes, the sign is positive if the last node was updated, otherwise its negative
+    bool quiescent = false; ///< the subtree will only age
+    int sleepStep = -1; ///< first skipped time step
+    int sleepEnd = -1; ///< time step in which the parent died
 
     /* down the root branch*/
-    std::vector<RootState> laterals = std::vector<RootState>(0); ///< the lateral roots of this root
+    std::vector<RootState> laterals = std::vector<RootState>(0); ///< the lateral roots of this root (empty if not recursive, or if the subtree is skipped)
+    size_t nol = 0; ///< number of laterals
 
     /* last node */
     Vector3d lNode = Vector3d(0.,0.,0.);
@@ -128,4 +161,45 @@ private:
 
 
 
+/**
+ * RootPool
+ *
+ * Allocates the memory of the roots of a root system in chunks, the memory of deleted roots is reused.
+ * Roots created with new(pool) Root(...) remember their pool, therefore they are deleted as usual.
+ * Derived classes that are larger than Root are allocated from the global heap.
+ *
+ * The pool is thread safe, since roots are created concurrently by growth tasks (@see RootSystem::setParallelGrowth).
+ */
+class RootPool
+{
+
+public:
+
+    RootPool(size_t chunkSize = 1024) : chunkSize(chunkSize) { } ///< number of roots per chunk
+    RootPool(const RootPool& p) = delete;
+    virtual ~RootPool() { clear(); }
+
+    void* allocate(); ///< memory for one root (including the header, @see Root::operator new)
+    void deallocate(void* p); ///< returns the memory of a root
+    void clear(); ///< frees all chunks at once, the pool must be empty
+
+    size_t getNumberOfRoots() const { return live; } ///< number of roots currently allocated from the pool
+    size_t getCapacity() const { return chunks.size()*chunkSize; } ///< number of roots that fit into the allocated chunks
+
+    static const size_t headerSize = 16; ///< bytes in front of each root, holding its pool (keeps the alignment)
+    static const size_t slotSize = (headerSize+sizeof(Root)+15)/16*16; ///< bytes per root
+
+private:
+
+    size_t chunkSize;
+    std::vector<char*> chunks;
+    size_t used = 0; // slots used in the last chunk
+    std::vector<void*> freeSlots; // slots of deleted roots
+    size_t live = 0;
+    std::mutex mutex;
+
+};
+
+
+
 #endif /* ROOT_H_ */
@@ -1,14 +1,24 @@
 #include "RootSystem.h"
+#include "parallel.h"
+#include "vtp.h"
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
 
 const std::vector<std::string> RootSystem::scalarTypeNames = {"type","radius","order","time","length","surface","volume","1","userdata 1", "userdata 2", "userdata 3", "parent type",
 		"basal length", "apical length", "number of branches", "initial growth rate", "insertion angle", "root life time", "mean inter nodal distance", "standard deviation of inter nodal distance"};
 
+thread_local GrowthTask* RootSystem::task = nullptr;
+
 /**
  * Constructor
  */
 RootSystem::RootSystem() :gen(std::mt19937(std::chrono::system_clock::now().time_since_epoch().count())),
 		UD(std::uniform_real_distribution<double>(0,1)), UID(std::uniform_int_distribution<unsigned int>()), ND(std::normal_distribution<double>(0,1))
 {
+	pool = new RootPool();
 	initRTP();
 };
 
@@ -19,18 +29,38 @@ RootSystem::RootSystem() :gen(std::mt19937(std::chrono::system_clock::now().time
  * does not deep copy geometry, elongation functions, and soil (all not owned by rootsystem)
  * empties buffer
  */
-RootSystem::RootSystem(const RootSystem& rs) : rsmlReduction(rs.rsmlReduction), rsparam(rs.rsparam), rtparam(rs.rtparam), gf(rs.gf), tf(rs.tf), geometry(rs.geometry), soil(rs.soil),
-		simtime(rs.simtime), rid(rs.rid), nid(rs.nid), old_non(rs.old_non), old_nor(rs.old_nor), maxtypes(rs.maxtypes), gen(rs.gen), UD(rs.UD), ND(rs.ND)
+RootSystem::RootSystem(const RootSystem& rs) : rsmlReduction(rs.rsmlReduction), outputTolerance(rs.outputTolerance), rsparam(rs.rsparam), rtparam(rs.rtparam), rtrandom(rs.rtrandom), gf(rs.gf), tf(rs.tf), pool(new RootPool()), reserveNodes(rs.reserveNodes), geometry(rs.geometry), geometryProjection(rs.geometryProjection), soil(rs.soil),
+		simtime(rs.simtime), rid(rs.rid), nid(rs.nid), old_non(rs.old_non), old_nor(rs.old_nor), nodeStore(rs.nodeStore),
+		deltaFirstNode(rs.deltaFirstNode), deltaMovedNodes(rs.deltaMovedNodes), lengthIncrement(rs.lengthIncrement),
+		grownRoots(rs.grownRoots), timeSteps(rs.timeSteps), maxtypes(rs.maxtypes),
+		numberOfCrowns(rs.numberOfCrowns), manualSeed(rs.manualSeed), parallelGrowth(rs.parallelGrowth), threads(rs.threads),
+		candidates(rs.candidates), candidateThreads(rs.candidateThreads), randomStreams(rs.randomStreams), randomSeed(rs.randomSeed),
+		gen(rs.gen), UD(rs.UD), ND(rs.ND), journaling(rs.journaling)
 {
 	// std::cout << "Copying root system ("<<rs.baseRoots.size()<< " base roots) \n";
 
 	// copy base Roots
 	baseRoots = std::vector<Root*>(rs.baseRoots.size());
 	for (size_t i=0; i<rs.baseRoots.size(); i++) {
-		baseRoots[i] = new Root(*rs.baseRoots[i], *this); // deep copy root tree
+		baseRoots[i] = new(pool) Root(*rs.baseRoots[i], *this); // deep copy root tree
 	}
 
-	roots = std::vector<Root*>(0); // new empty buffer
+	rebuildRootIndex();
+
+	// new roots of the last time step have consecutive ids
+	if (!rs.deltaNewRoots.empty()) {
+		int firstId = rs.deltaNewRoots.front()->id;
+		deltaNewRoots = std::vector<Root*>(rs.deltaNewRoots.size());
+		std::vector<Root*> stack(baseRoots.begin(), baseRoots.end());
+		while (!stack.empty()) {
+			Root* r = stack.back();
+			stack.pop_back();
+			if ((r->id>=firstId) && (r->id-firstId<int(deltaNewRoots.size()))) {
+				deltaNewRoots[r->id-firstId] = r;
+			}
+			stack.insert(stack.end(), r->laterals.begin(), r->laterals.end());
+		}
+	}
 
 	// deep copy tropisms
 	tf = std::vector<Tropism*>(rs.tf.size());
@@ -52,6 +82,7 @@ RootSystem::RootSystem(const RootSystem& rs) : rsmlReduction(rs.rsmlReduction),
 RootSystem::~RootSystem()
 {
 	reset();
+	delete pool;
 }
 
 /**
@@ -69,11 +100,24 @@ void RootSystem::reset()
 		delete f;
 	}
 	baseRoots.clear();
+	roots.clear();
+	sortedRoots = 0;
+	rootsById.clear();
+	if (pool->getNumberOfRoots()==0) { // free the memory of all roots at once
+		pool->clear();
+	}
 	gf.clear();
 	tf.clear();
 	simtime=0;
 	rid = -1;
 	nid = -1;
+	nodeStore.clear();
+	deltaFirstNode = 0;
+	deltaMovedNodes.clear();
+	deltaNewRoots.clear();
+	lengthIncrement = 0;
+	grownRoots.clear();
+	timeSteps.clear();
 }
 
 /**
@@ -81,10 +125,20 @@ void RootSystem::reset()
  */
 void RootSystem::initRTP()
 {
-	rtparam = std::vector<RootTypeParameter> (maxtypes);
-	for (auto& rtp:rtparam) {
-		rtp = RootTypeParameter();
+	rtparam = CopyOnWrite<std::vector<RootTypeParameter>>(std::vector<RootTypeParameter>(maxtypes));
+}
+
+/**
+ * Creates one random number generator per root type, new generators are seeded by the clock (like new root type parameters)
+ */
+void RootSystem::initRandomGenerators()
+{
+	size_t n = rtparam->size();
+	rtrandom.reserve(n);
+	while (rtrandom.size()<n) {
+		rtrandom.push_back(RandomGenerator(std::chrono::system_clock::now().time_since_epoch().count()));
 	}
+	rtrandom.resize(n);
 }
 
 /**
@@ -96,34 +150,22 @@ void RootSystem::initRTP()
  */
 void RootSystem::openFile(std::string name, std::string subdir)
 {
-	std::ifstream fis;
-	// open root parameter
-	std::string rp_name = subdir;
-	rp_name.append(name);
-	rp_name.append(".rparam");
-	fis.open(rp_name.c_str());
-	int c = 0;
-	if (fis.good()) { // did it work?
-		c = readParameters(fis);
-		fis.close();
-	} else {
-		std::string s = "RootSystem::openFile() could not open root parameter file ";
-		throw std::invalid_argument(s.append(rp_name));
-	}
-	std::cout << "Read " << c << " root type parameters \n"; // debug
+	ParameterSet ps(maxtypes);
+	ps.openFile(name, subdir);
+	setParameterSet(ps);
+}
 
-	// open plant parameter
-	std::string pp_name = subdir;
-	pp_name.append(name);
-	pp_name.append(".pparam");
-	fis.open(pp_name.c_str());
-	if (fis.good()) { // did it work?
-		rsparam.read(fis);
-		fis.close();
-	} else { // create a tap root system
-		std::cout << "No root system parameters found, using default tap root system \n";
-		rsparam = RootSystemParameter();
-	}
+/**
+ * Sets the parameters of a file from the library of parsed parameter sets (@see ParameterSet::load),
+ * the root type parameters are shared with all root systems using the same set, until they are modified
+ *
+ * @param name          filename without file extension
+ * @param subdir        directory ("modelparameter/" by default)
+ * @param cache         optional binary cache file, that is used instead of parsing the text files (if it is up to date)
+ */
+void RootSystem::loadParameters(std::string name, std::string subdir, std::string cache)
+{
+	setParameterSet(*ParameterSet::load(name, subdir, cache));
 }
 
 /**
@@ -133,14 +175,9 @@ void RootSystem::openFile(std::string name, std::string subdir)
  */
 int RootSystem::readParameters(std::istream& cin)
 {
-	initRTP();
-	int c = 0;
-	while (cin.good()) {
-		RootTypeParameter p;
-		p.read(cin);
-		setRootTypeParameter(p); // sets the param to the index (p.type-1)
-		c++;
-	}
+	ParameterSet ps(maxtypes);
+	int c = ps.readParameters(cin);
+	rtparam = ps.rtparam;
 	return c;
 }
 
@@ -152,7 +189,7 @@ int RootSystem::readParameters(std::istream& cin)
 void RootSystem::writeParameters(std::ostream& os) const
 {
 	int t = 0;
-	for (auto const& rp:rtparam) {
+	for (auto const& rp : *rtparam) {
 		t++;
 		if (rp.type>0) {
 			assert(rp.type==t); // check if index is really type-1
@@ -172,15 +209,17 @@ void RootSystem::initialize(int basaltype, int shootbornetype)
 	//cout << "Root system initialize\n";
 	reset(); // just in case
 
-	// fix randomness of root type parameters if the seed was set manually
+	// fix randomness of root types if the seed was set manually
+	initRandomGenerators();
 	if (manualSeed) {
-		for (auto& rtp : rtparam) {
-			rtp.setSeed(UID(gen));
+		for (auto& g : rtrandom) {
+			g.seed(UID(gen));
 		}
 	}
 
 	// introduce an extra node at nodes[0]
-	getNodeIndex();
+	nodeStore.setOrigin(rsparam.seedPos); // coordinates are stored relative to the seed (@see NodeStore)
+	nodeStore.set(getNodeIndex(), Vector3d(0.,0.,3.), 0., -1, -1); // artificial shoot
 
 	// Create root system from the root system parameter
 	const double maxT = 365.; // maximal simulation time
@@ -188,17 +227,18 @@ void RootSystem::initialize(int basaltype, int shootbornetype)
 	Vector3d iheading(0,0,-1);
 
 	// Taproot
-	Root* taproot = new Root(this, 1, iheading ,0, nullptr, 0, 0); // tap root has root type 1
+	Root* taproot = new(pool) Root(this, 1, iheading ,0, nullptr, 0, 0); // tap root has root type 1
 	taproot->addNode(rs.seedPos,0);
 	baseRoots.push_back(taproot);
 
 	// Basal roots
 	if (rs.maxB>0) {
-		if (getRootTypeParameter(basaltype)->type<1) { // if the type is not defined, copy tap root
+		if (readRootTypeParameter(basaltype)->type<1) { // if the type is not defined, copy tap root
 			std::cout << "Basal root type #" << basaltype << " was not defined, using tap root parameters instead\n";
-			RootTypeParameter brtp = RootTypeParameter(*getRootTypeParameter(1));
+			RootTypeParameter brtp = RootTypeParameter(*readRootTypeParameter(1));
 			brtp.type = basaltype;
 			setRootTypeParameter(brtp);
+			rtrandom.at(basaltype-1) = rtrandom.at(0); // continues like a copy of the tap root parameters
 		}
 		int maxB = rs.maxB;
 		if (rs.delayB>0) { // limit if possible
@@ -206,7 +246,7 @@ void RootSystem::initialize(int basaltype, int shootbornetype)
 		}
 		double delay = rs.firstB;
 		for (int i=0; i<maxB; i++) {
-			Root* basalroot = new Root(this, basaltype, iheading ,delay, nullptr, 0, 0);
+			Root* basalroot = new(pool) Root(this, basaltype, iheading ,delay, nullptr, 0, 0);
 			basalroot->nodes.push_back(taproot->getNode(0));
 			basalroot->nodeIds.push_back(taproot->getNodeId(0));
 			basalroot->netimes.push_back(delay);
@@ -217,24 +257,25 @@ void RootSystem::initialize(int basaltype, int shootbornetype)
 
 	// Shoot borne roots
 	if ((rs.nC>0) && (rs.delaySB<maxT)) { // if the type is not defined, copy basal root
-		if (getRootTypeParameter(shootbornetype)->type<1) {
+		if (readRootTypeParameter(shootbornetype)->type<1) {
 			std::cout << "Shootborne root type #" << shootbornetype << " was not defined, using tap root parameters instead\n";
-			RootTypeParameter srtp = RootTypeParameter(*getRootTypeParameter(1));
+			RootTypeParameter srtp = RootTypeParameter(*readRootTypeParameter(1));
 			srtp.type = shootbornetype;
 			setRootTypeParameter(srtp);
+			rtrandom.at(shootbornetype-1) = rtrandom.at(0);
 		}
 		Vector3d sbpos = rs.seedPos;
 		sbpos.z=sbpos.z/2.; // half way up the mesocotyl
 		numberOfCrowns = ceil((maxT-rs.firstSB)/rs.delayRC); // maximal number of root crowns
 		double delay = rs.firstSB;
 		for (int i=0; i<numberOfCrowns; i++) {
-			Root* shootborne0 = new Root(this, shootbornetype, iheading ,delay, nullptr, 0, 0);
+			Root* shootborne0 = new(pool) Root(this, shootbornetype, iheading ,delay, nullptr, 0, 0);
 			// TODO fix the initial radial heading
 			shootborne0->addNode(sbpos,delay);
 			baseRoots.push_back(shootborne0);
 			delay += rs.delaySB;
 			for (int j=1; j<rs.nC; j++) {
-				Root* shootborne = new Root(this, shootbornetype, iheading ,delay, nullptr, 0, 0);
+				Root* shootborne = new(pool) Root(this, shootbornetype, iheading ,delay, nullptr, 0, 0);
 				// TODO fix the initial radial heading
 				shootborne->nodes.push_back(shootborne0->getNode(0));
 				shootborne->nodeIds.push_back(shootborne0->getNodeId(0));
@@ -250,16 +291,16 @@ void RootSystem::initialize(int basaltype, int shootbornetype)
 	}
 
 	// Create tropisms and growth functions per root type
-	for (size_t i=0; i<rtparam.size(); i++) {
-		int type = rtparam.at(i).tropismT;
-		double N = rtparam.at(i).tropismN;
-		double sigma = rtparam.at(i).tropismS;
+	for (size_t i=0; i<rtparam->size(); i++) {
+		int type = rtparam->at(i).tropismT;
+		double N = rtparam->at(i).tropismN;
+		double sigma = rtparam->at(i).tropismS;
 		Tropism* tropism = this->createTropismFunction(type,N,sigma);
 		tropism->setSeed(UID(gen)); // fix randomness
-		tropism->setGeometry(geometry);
+		tropism->setGeometry(geometry, geometryProjection);
 		// std::cout << "#" << i << ": type " << type << ", N " << N << ", sigma " << sigma << "\n";
 		tf.push_back(tropism); // wrap confinedTropism around baseTropism
-		int gft = rtparam.at(i).gf;
+		int gft = rtparam->at(i).gf;
 		GrowthFunction* gf_ = this->createGrowthFunction(gft);
 		gf_->getAge(1,1,1,nullptr);  // check if getAge is implemented (otherwise an exception is thrown)
 		gf.push_back(gf_);
@@ -291,16 +332,26 @@ void RootSystem::setTropism(Tropism* tf_, int rt)
  */
 void RootSystem::simulate(double dt, bool silence)
 {
+	CROOTBOX_PROFILE_TIME(getProfileCounters(0), ProfileCounters::pp_simulate);
 	if (!silence) {
 		std::cout << "RootSystem.simulate(dt) from "<< simtime << " to " << simtime+dt << " days \n";
 	}
 	old_non = getNumberOfNodes();
-	old_nor = getRoots().size();
+	old_nor = getNumberOfRoots();
+	deltaFirstNode = getNumberOfNodes();
+	deltaMovedNodes.clear();
+	deltaNewRoots.clear();
+	lengthIncrement = 0;
+	grownRoots.clear();
+	timeSteps.push_back(dt);
 	for (auto const& r: baseRoots) {
-		r->simulate(dt, silence);
+		if (parallelGrowth || (!skipQuiescent(r))) { // the growth tasks are formed from the laterals of all base roots
+			r->simulate(dt, silence);
+		}
 	}
+	simulateTasks(silence); // in case of parallel growth
+	std::sort(grownRoots.begin(), grownRoots.end()); // in the order of RootSystem::getRoots
 	simtime+=dt;
-	roots.clear(); // empty buffer
 }
 
 /**
@@ -314,7 +365,12 @@ void RootSystem::simulate()
 /**
  * Simulates root system growth for the time span dt [days],
  * elongates a maximum of maxinc total length [cm/day]
- * using the proportional elongation se
+ * using the proportional elongation se.
+ *
+ * The scale of se is found by bisection, each trial is simulated from the current state,
+ * and its length increase is summed up during growth (@see RootSystem::getLengthIncrement).
+ * The last trial is kept as result. Optionally, several scales are simulated in parallel
+ * per search step (@see RootSystem::setElongationCandidates).
  */
 void RootSystem::simulate(double dt, double maxinc_, ProportionalElongation* se, bool silence)
 {
@@ -322,37 +378,35 @@ void RootSystem::simulate(double dt, double maxinc_, ProportionalElongation* se,
 	const int maxiter = 20;
 
 	double maxinc = dt*maxinc_;
-	auto v_ = this->getScalar(RootSystem::st_length);
-	double ol = std::accumulate(v_.begin(), v_.end(), 0.0);
 
 	int i = 0;
 
 	push();
 	se->setScale(1.);
 	simulate(dt, silence);
-	v_ = getScalar(RootSystem::st_length);
-	double l = std::accumulate(v_.begin(), v_.end(), 0.0);
-	double inc_ = l - ol;
+	double inc_ = lengthIncrement;
 	if (!silence) {
 		std::cout << "expected increase is " << inc_ << "\n";
 	}
-	pop();
 
 	if ((inc_>maxinc) && (std::abs(inc_-maxinc)>accuracy)) { // check if we have to perform a binary search
 
+		pop();
+		if ((candidates>1) && (journal==nullptr)) { // the copies would replace journaled roots
+			simulateCandidates(dt, maxinc, se, accuracy, maxiter, silence);
+			return;
+		}
+
 		double sl = 0.; // left
 		double sr = 1.; // right
 
-		while ( ((std::abs(inc_-maxinc)) > accuracy) && (i<maxiter) )  { // binary search
+		while (true) { // binary search
 
 			double m = (sl+sr)/2.; // mid
 			push();
 			se->setScale(m);
 			simulate(dt, silence);
-			v_ = getScalar(RootSystem::st_length);
-			l = std::accumulate(v_.begin(), v_.end(), 0.0);
-			inc_ = l - ol;
-			pop();
+			inc_ = lengthIncrement;
 			if (!silence) {
 				std::cout << "\t(sl, mid, sr) = (" << sl << ", " <<  m << ", " <<  sr << "), inc " <<  inc_ << ", err: " << std::abs(inc_-maxinc) << " > " << accuracy << "\n";
 			}
@@ -364,9 +418,198 @@ void RootSystem::simulate(double dt, double maxinc_, ProportionalElongation* se,
 			}
 			i++;
 
+			if ((std::abs(inc_-maxinc)<=accuracy) || (i>=maxiter)) {
+				break; // keep the trial
+			}
+			pop();
+
+		}
+	}
+	discardState(); // the last trial is the result
+}
+
+/**
+ * Searches the scale of the proportional elongation se, simulating the candidate scales of each search step
+ * in parallel on copies of the root system (@see RootSystem::setElongationCandidates).
+ * Each step shrinks the search interval by a factor of (number of candidates + 1).
+ * The copy closest to maxinc replaces the state of the root system, and the scale of se is set to its value.
+ *
+ * Note that the soil look ups and the geometry are shared by the copies, they must be thread safe.
+ * Each copy uses a ProportionalElongation copied from se (i.e. derived classes are sliced).
+ *
+ * @param dt        time step [days]
+ * @param maxinc    maximal total length increase in the time step [cm]
+ * @param se        the proportional elongation
+ * @param accuracy  accepted deviation from maxinc [cm]
+ * @param maxiter   maximal number of search steps
+ * @param silence   indicates if status is written to the console (cout)
+ */
+void RootSystem::simulateCandidates(double dt, double maxinc, ProportionalElongation* se, double accuracy, int maxiter, bool silence)
+{
+	size_t n = candidates;
+	std::vector<RootSystem*> copies(n, nullptr);
+	std::vector<ProportionalElongation*> scales(n, nullptr);
+	std::vector<double> m(n), inc(n);
+	double sl = 0.; // left
+	double sr = 1.; // right
+	RootSystem* result = nullptr;
+	ProportionalElongation* resultSe = nullptr;
+	double resultScale = 1.;
+
+	for (int i=0; (i<maxiter) && (result==nullptr); i++) {
+
+		for (size_t j=0; j<n; j++) {
+			m[j] = sl+(sr-sl)*double(j+1)/double(n+1);
+			scales[j] = new ProportionalElongation(*se);
+			scales[j]->setScale(m[j]);
+		}
+		try {
+			parallelFor(n, candidateThreads, [&](size_t j) {
+				copies[j] = new RootSystem(*this);
+				for (auto& p : copies[j]->rtparam.write()) {
+					if (p.se==se) {
+						p.se = scales[j];
+					}
+				}
+				copies[j]->simulate(dt, true);
+				inc[j] = copies[j]->lengthIncrement;
+			});
+		} catch (...) {
+			for (size_t j=0; j<n; j++) {
+				delete copies[j];
+				delete scales[j];
+			}
+			throw;
+		}
+
+		size_t k = 0; // closest candidate
+		double nsl = sl;
+		double nsr = sr;
+		for (size_t j=0; j<n; j++) {
+			if (std::abs(inc[j]-maxinc)<std::abs(inc[k]-maxinc)) {
+				k = j;
+			}
+			if (inc[j]>maxinc) { // concatenate
+				nsr = std::min(nsr, m[j]);
+			} else {
+				nsl = std::max(nsl, m[j]);
+			}
 		}
+		if (!silence) {
+			std::cout << "\t(sl, sr) = (" << sl << ", " << sr << "), best " << m[k] << ", inc " << inc[k] << ", err: " << std::abs(inc[k]-maxinc) << " > " << accuracy << "\n";
+		}
+		if ((std::abs(inc[k]-maxinc)<=accuracy) || (i+1>=maxiter)) {
+			result = copies[k];
+			resultSe = scales[k];
+			resultScale = m[k];
+			copies[k] = nullptr;
+			scales[k] = nullptr;
+		}
+		for (size_t j=0; j<n; j++) {
+			delete copies[j];
+			delete scales[j];
+			copies[j] = nullptr;
+			scales[j] = nullptr;
+		}
+		sl = nsl;
+		sr = nsr;
 	}
-	this->simulate(dt, silence);
+
+	swapState(*result); // keeps the root type parameters of this root system
+	delete result; // holds the previous state
+	delete resultSe;
+	se->setScale(resultScale);
+}
+
+/**
+ * Exchanges all data that changes during the simulation with rs, which must be a copy of this root system
+ * (used to keep the result of a trial simulation, @see RootSystem::simulateCandidates)
+ *
+ * @param rs        the other root system
+ */
+void RootSystem::swapState(RootSystem& rs)
+{
+	std::swap(baseRoots, rs.baseRoots);
+	std::swap(pool, rs.pool); // the roots stay in their pool
+	std::swap(tf, rs.tf);
+	std::swap(gf, rs.gf);
+	std::swap(rtrandom, rs.rtrandom);
+	std::swap(simtime, rs.simtime);
+	std::swap(rid, rs.rid);
+	std::swap(nid, rs.nid);
+	std::swap(old_non, rs.old_non);
+	std::swap(old_nor, rs.old_nor);
+	std::swap(nodeStore, rs.nodeStore);
+	std::swap(deltaFirstNode, rs.deltaFirstNode);
+	std::swap(deltaMovedNodes, rs.deltaMovedNodes);
+	std::swap(deltaNewRoots, rs.deltaNewRoots);
+	std::swap(lengthIncrement, rs.lengthIncrement);
+	std::swap(grownRoots, rs.grownRoots);
+	std::swap(timeSteps, rs.timeSteps);
+	std::swap(gen, rs.gen);
+	std::swap(UD, rs.UD);
+	std::swap(ND, rs.ND);
+	std::swap(roots, rs.roots);
+	std::swap(sortedRoots, rs.sortedRoots);
+	std::swap(rootsById, rs.rootsById);
+	for (RootSystem* s : { this, &rs }) { // the roots point to their root system
+		std::vector<Root*> stack(s->baseRoots.begin(), s->baseRoots.end());
+		while (!stack.empty()) {
+			Root* r = stack.back();
+			stack.pop_back();
+			r->rootsystem = s;
+			stack.insert(stack.end(), r->laterals.begin(), r->laterals.end());
+		}
+	}
+}
+
+/**
+ * Adds the length increase of a root during the time step, within a growth task the increase is added to the task
+ *
+ * @param dl        length increase [cm]
+ */
+void RootSystem::addLengthIncrement(double dl)
+{
+	if ((task!=nullptr) && (task->rs==this)) {
+		task->lengthIncrement += dl;
+	} else {
+		lengthIncrement += dl;
+	}
+}
+
+/**
+ * Notes a root that called createSegments in this time step, i.e. that might have new, or updated nodes
+ * (@see RootSystem::getNewSegments, RootSystem::getUpdatedNodes)
+ *
+ * @param r         the root
+ */
+void RootSystem::addGrownRoot(Root* r)
+{
+	if ((task!=nullptr) && (task->rs==this)) {
+		task->grownRoots.push_back(r);
+	} else {
+		grownRoots.push_back(r->id);
+	}
+}
+
+/**
+ * Quiescent subtrees (the roots are dead, or finished growing, and all laterals emerged and are quiescent) only
+ * age in Root::simulate, they are skipped, and the skipped time steps are replayed on demand (@see Root::getCurrentAge).
+ * Therefore, the costs of a time step are proportional to the growing roots. The results are the same.
+ *
+ * @param r         the root of the subtree
+ * \return          true if the subtree is skipped in this time step
+ */
+bool RootSystem::skipQuiescent(Root* r)
+{
+	if ((!r->quiescent) || timeSteps.empty()) {
+		return false;
+	}
+	if (r->sleepStep<0) { // first skipped time step
+		journalRoot(r);
+		r->sleepStep = timeSteps.size()-1;
+	}
+	return true;
 }
 
 /**
@@ -379,13 +622,357 @@ void RootSystem::simulate(double dt, double maxinc_, ProportionalElongation* se,
  */
 void RootSystem::setSeed(unsigned int seed) {
 	manualSeed = true;
+	randomSeed = seed;
 	this->gen = std::mt19937(seed);
 	// set UD UID ND?
 	for (auto& t : tf) {
 		t->setSeed(UID(gen));
 	}
-	for (auto& rp : rtparam) {
-		rp.setSeed(UID(gen));
+	initRandomGenerators();
+	for (auto& g : rtrandom) {
+		g.seed(UID(gen));
+	}
+}
+
+/**
+ * Returns the root type parameter of a root type for modifications, the parameters are copied if they are shared,
+ * and are not shared by later copies of the root system (the pointer may be kept, @see CopyOnWrite::edit).
+ * Use RootSystem::readRootTypeParameter to read the parameters.
+ *
+ * @param type      root type (1..n)
+ */
+RootTypeParameter* RootSystem::getRootTypeParameter(int type)
+{
+	if ((journal!=nullptr) && (rtparamEpochs.at(type-1)!=epoch)) { // first use after push()
+		rtparamEpochs[type-1] = epoch;
+		journal->rtparams.push_back(std::make_pair(type-1, rtparam->at(type-1)));
+	}
+	return &rtparam.edit().at(type-1);
+}
+
+/**
+ * Returns the generator of the random root parameters and lateral types of a root type (the root type parameters
+ * hold no state of the root system, and can be shared), within a growth task the task's copy is returned
+ * (@see RootSystem::setParallelGrowth)
+ *
+ * @param type      root type (1..n)
+ */
+RandomGenerator& RootSystem::getRandomGenerator(int type)
+{
+	if ((task!=nullptr) && (task->rs==this)) {
+		RandomGenerator*& g = task->rtrandom.at(type-1);
+		if (g==nullptr) {
+			g = new RandomGenerator(rtrandom.at(type-1));
+			g->seed(task->getSeed(2*type));
+		}
+		return *g;
+	}
+	if ((journal!=nullptr) && (rtrandomEpochs.at(type-1)!=epoch)) { // first use after push()
+		rtrandomEpochs[type-1] = epoch;
+		journal->rtrandoms.push_back(std::make_pair(type-1, rtrandom.at(type-1)));
+	}
+	return rtrandom.at(type-1);
+}
+
+/**
+ * Returns the tropism of a root type,
+ * within a growth task the task's copy is returned (@see RootSystem::setParallelGrowth)
+ *
+ * @param type      root type (1..n)
+ */
+Tropism* RootSystem::getTropism(int type)
+{
+	if ((task!=nullptr) && (task->rs==this)) {
+		Tropism*& t = task->tf.at(type-1);
+		if (t==nullptr) {
+			t = tf.at(type-1)->copy();
+			t->setSeed(task->getSeed(2*type+1));
+		}
+		return t;
+	}
+	if ((journal!=nullptr) && (tfEpochs.at(type-1)!=epoch)) { // first use after push()
+		tfEpochs[type-1] = epoch;
+		journal->tfs.push_back(std::make_pair(type-1, tf.at(type-1)->copy()));
+	}
+	return tf.at(type-1);
+}
+
+/**
+ * Uniformly distributed random number (0,1), uses the stream of the current thread (@see RandomStreamScope),
+ * or the generator of the growth task if called within one
+ */
+double RootSystem::rand()
+{
+	RandomStream* s = RandomStream::current();
+	if (s!=nullptr) {
+		return s->rand();
+	}
+	if ((task!=nullptr) && (task->rs==this)) {
+		return task->UD(task->gen);
+	}
+	return UD(gen);
+}
+
+/**
+ * Normally distributed random number (0,1), uses the stream of the current thread (@see RandomStreamScope),
+ * or the generator of the growth task if called within one
+ */
+double RootSystem::randn()
+{
+	RandomStream* s = RandomStream::current();
+	if (s!=nullptr) {
+		return s->randn();
+	}
+	if ((task!=nullptr) && (task->rs==this)) {
+		return task->ND(task->gen);
+	}
+	return ND(gen);
+}
+
+/**
+ * Returns the random stream of a root for a purpose, the stream only depends on the seed, the root, the purpose, and the index
+ * (@see RootSystem::setRandomStreams). Use it with a RandomStreamScope.
+ *
+ * @param r         the root
+ * @param purpose   purpose of the draws (@see RandomStream::Purpose)
+ * @param index     e.g. the node index
+ *
+ * \return the stream, or an inactive stream if the random streams are not used
+ */
+RandomStream RootSystem::getRandomStream(const Root* r, int purpose, uint64_t index) const
+{
+	if (!randomStreams) {
+		return RandomStream();
+	}
+	return RandomStream(randomSeed, r->randomKey, purpose, index);
+}
+
+/**
+ * Returns the next unique root id. Within a growth task the root is recorded, and -1 is returned.
+ *
+ * @param r         the new root
+ */
+int RootSystem::getRootIndex(Root* r)
+{
+	if ((task!=nullptr) && (task->rs==this)) {
+		task->roots.push_back(r);
+		return -1;
+	}
+	deltaNewRoots.push_back(r);
+	rootsById.push_back(r);
+	return getRootIndex();
+}
+
+/**
+ * Returns the next unique node id for the last node of root r. Within a growth task the node is recorded, and -1 is returned.
+ *
+ * If CRootBox is built with CROOTBOX_COMPACT, the root rounded its previous tip (@see NodeVector::push_back),
+ * the node store takes the rounded node, like RootSystem::rebuildNodeStore and GrowthTask::renumber do.
+ *
+ * @param r         the root containing the new node
+ */
+int RootSystem::getNodeIndex(Root* r)
+{
+	int parent = r->nodeIds.empty() ? -1 : r->nodeIds.back();
+#ifdef CROOTBOX_COMPACT
+	int pi = int(r->nodes.size())-2; // the first node of a root is not rounded
+	bool branched = (!r->laterals.empty()) && (r->laterals.back()->parent_ni==pi) && (r->laterals.back()->nodes.size()>1);
+	if ((pi>0) && (parent>=0) && (!branched) && (!nodeStore.isAt(parent, r->nodes[pi]))) { // existing entry (only written by the task that owns the root)
+		journalNode(parent);
+		nodeStore.setPosition(parent, r->nodes[pi]);
+		if (parent<deltaFirstNode) {
+			if ((task!=nullptr) && (task->rs==this)) {
+				task->movedNodes.push_back(parent);
+			} else {
+				deltaMovedNodes.push_back(parent);
+			}
+		}
+	}
+#endif
+	if ((task!=nullptr) && (task->rs==this)) {
+		task->nodes.push_back(std::make_pair(r, int(r->nodes.size())-1));
+		return -1;
+	}
+	int i = getNodeIndex();
+	nodeStore.set(i, r->nodes.back(), r->netimes.back(), r->id, parent);
+	if (r->nodes.size()==2) { // the root emerged, it is sorted in by the next updateRoots()
+		roots.push_back(r);
+	}
+	if ((r->parent!=nullptr) && (r->nodes.size()==2)) { // emerged lateral
+		setBranchingNode(r);
+	}
+	return i;
+}
+
+/**
+ * Uses the lateral's copy of its first node for the node store (as in previous versions, the copy
+ * might differ from the parent's node, if the parent's tip was shifted after the lateral was created).
+ *
+ * @param r         the lateral
+ */
+void RootSystem::setBranchingNode(Root* r)
+{
+	int ni = r->nodeIds[0];
+	if (!nodeStore.isAt(ni, r->nodes[0])) {
+		journalNode(ni);
+		nodeStore.setPosition(ni, r->nodes[0]);
+		if (ni<deltaFirstNode) {
+			deltaMovedNodes.push_back(ni);
+		}
+	}
+}
+
+/**
+ * Updates the node store after node i of root r was moved (e.g. shifted root tips).
+ * Nodes that were created within a growth task are stored after renumbering.
+ *
+ * If an emerged lateral (more than one node) is attached to the node, the lateral's copy of the node is kept (as in previous versions),
+ * the emergence time is the one of root r (as after RootSystem::rebuildNodeStore).
+ *
+ * @param r         the root
+ * @param i         local node index of the root
+ */
+void RootSystem::moveNode(Root* r, int i)
+{
+	int ni = r->nodeIds.at(i);
+	if (ni<0) { // created within a growth task
+		return;
+	}
+	bool branched = (!r->laterals.empty()) && (r->laterals.back()->parent_ni==i) && (r->laterals.back()->nodes.size()>1);
+	journalNode(ni); // existing entry (only written by the task that owns the root)
+	if (branched) {
+		nodeStore.netimes[ni] = r->netimes.at(i);
+	} else {
+		nodeStore.setNode(ni, r->nodes.at(i), r->netimes.at(i));
+	}
+	if (ni<deltaFirstNode) {
+		if ((task!=nullptr) && (task->rs==this)) {
+			task->movedNodes.push_back(ni);
+		} else {
+			deltaMovedNodes.push_back(ni);
+		}
+	}
+}
+
+/**
+ * Returns all changes of the previous time step (nodes, segments, moved nodes, and new roots),
+ * the costs are proportional to the number of changes, and not to the size of the root system.
+ */
+StepDelta RootSystem::getStepDelta() const
+{
+	StepDelta d;
+	d.simtime = simtime;
+	d.firstNewNode = deltaFirstNode;
+	int n = getNumberOfNodes()-deltaFirstNode;
+	d.newNodes.reserve(n);
+	d.newNETimes.reserve(n);
+	d.newSegments.reserve(n);
+	d.newSegmentRootIds.reserve(n);
+	for (int i=deltaFirstNode; i<getNumberOfNodes(); i++) {
+		d.newNodes.push_back(nodeStore.getNode(i));
+		d.newNETimes.push_back(nodeStore.netimes[i]);
+		if (nodeStore.parents[i]>=0) {
+			d.newSegments.push_back(Vector2i(nodeStore.parents[i], i));
+			d.newSegmentRootIds.push_back(nodeStore.rootIds[i]);
+		}
+	}
+	d.movedNodeIds = deltaMovedNodes;
+	std::sort(d.movedNodeIds.begin(), d.movedNodeIds.end());
+	d.movedNodeIds.erase(std::unique(d.movedNodeIds.begin(), d.movedNodeIds.end()), d.movedNodeIds.end());
+	for (int i : d.movedNodeIds) {
+		d.movedNodes.push_back(nodeStore.getNode(i));
+		d.movedNETimes.push_back(nodeStore.netimes[i]);
+	}
+	d.newRoots = deltaNewRoots;
+	return d;
+}
+
+/**
+ * Recreates the node store from the root tree
+ */
+void RootSystem::rebuildNodeStore()
+{
+	nodeStore.clear();
+	nodeStore.resize(getNumberOfNodes());
+	if (getNumberOfNodes()>0) {
+		nodeStore.set(0, Vector3d(0.,0.,3.), 0., -1, -1); // artificial shoot
+	}
+	std::vector<Root*> stack(baseRoots.rbegin(), baseRoots.rend()); // preorder, like Root::getRoots
+	while (!stack.empty()) {
+		Root* r = stack.back();
+		stack.pop_back();
+		size_t i0 = 0;
+		if (r->parent!=nullptr) { // the first node of a lateral belongs to its parent
+			if (r->nodes.size()>1) { // emerged lateral, its copy of the branching node is used (@see RootSystem::setBranchingNode)
+				nodeStore.setPosition(r->nodeIds[0], r->nodes[0]);
+			}
+			i0 = 1;
+		}
+		for (size_t i = i0; i<r->nodes.size(); i++) {
+			nodeStore.set(r->nodeIds[i], r->nodes[i], r->netimes[i], r->id, (i>0) ? r->nodeIds[i-1] : -1);
+		}
+		stack.insert(stack.end(), r->laterals.rbegin(), r->laterals.rend());
+	}
+}
+
+/**
+ * Simulates a lateral root for time span dt (called by Root::simulate and Root::createLateral).
+ * In parallel growth mode, the laterals of base roots are deferred, and simulated by RootSystem::simulateTasks.
+ * Quiescent laterals are skipped (@see RootSystem::skipQuiescent), deferred laterals by their task.
+ *
+ * @param lateral   the lateral root
+ * @param dt        time step [days]
+ * @param silence   indicates if status is written to the console (cout)
+ */
+void RootSystem::simulateLateral(Root* lateral, double dt, bool silence)
+{
+	if (parallelGrowth && (task==nullptr) && (lateral->parent!=nullptr) && (lateral->parent->parent==nullptr)) {
+		pendingTasks.push_back(std::make_pair(lateral, dt)); // also if quiescent, the tasks do not depend on it
+	} else if (!skipQuiescent(lateral)) {
+		lateral->simulate(dt, silence);
+	}
+}
+
+/**
+ * Simulates all deferred lateral subtrees in parallel (@see RootSystem::setParallelGrowth).
+ *
+ * The task generators are seeded in task order, and ids are assigned in task order after all tasks have finished,
+ * therefore the result only depends on the seed, and not on the number of threads.
+ *
+ * Note that all soil look ups and the geometry are shared by the tasks, they must be thread safe
+ * (i.e. use a single thread for classes implemented in Python).
+ *
+ * @param silence   indicates if status is written to the console (cout)
+ */
+void RootSystem::simulateTasks(bool silence)
+{
+	if (pendingTasks.empty()) {
+		return;
+	}
+	const size_t maxLaterals = 32; // per task, fixed to keep the results independent of the number of threads
+	std::vector<GrowthTask*> tasks;
+	Root* base = nullptr;
+	for (const auto& t : pendingTasks) {
+		if ((t.first->parent!=base) || (tasks.back()->laterals.size()>=maxLaterals)) {
+			base = t.first->parent;
+			tasks.push_back(new GrowthTask(this, UID(gen)));
+		}
+		tasks.back()->addLateral(t.first, t.second);
+	}
+	pendingTasks.clear();
+	try {
+		parallelFor(tasks.size(), threads, [&](size_t i) {
+			tasks[i]->simulate(silence);
+		});
+	} catch (...) {
+		for (auto t : tasks) {
+			delete t;
+		}
+		throw;
+	}
+	for (auto t : tasks) { // sequential, in task order
+		t->renumber();
+		delete t;
 	}
 }
 
@@ -402,7 +989,7 @@ void RootSystem::setSeed(unsigned int seed) {
  */
 Root* RootSystem::createRoot(int lt, Vector3d  h, double delay, Root* parent, double pbl, int pni) {
 	// call Root* lateral = rootsystem->createRoot(lt,  h, delay,  this, length, nodes.size()-1);
-	return new Root(this,lt,h,delay,parent,pbl,pni);
+	return new(pool) Root(this,lt,h,delay,parent,pbl,pni);
 }
 
 /**
@@ -439,20 +1026,51 @@ GrowthFunction* RootSystem::createGrowthFunction(int gft) {
 /**
  * Represents the root system as sequential vector of roots,
  * copies the root only, if it has more than 1 node.
- * buffers the result, until next call of simulate(dt)
+ *
+ * The roots are kept in a persistent index that is updated when roots emerge, i.e. the tree is not traversed.
+ * The order is the order of the root ids (i.e. the order of creation), which is stable over time.
  *
  * \return sequential vector of roots with more than 1 node
  */
 std::vector<Root*> RootSystem::getRoots() const
 {
-	if (roots.empty()) { // create buffer
-		for (auto const& br:this->baseRoots) {
-			br->getRoots(roots);
+	updateRoots();
+	return roots;
+}
+
+/**
+ * Merges the roots that emerged since the last call into the roots sorted by id
+ */
+void RootSystem::updateRoots() const
+{
+	if (sortedRoots<roots.size()) {
+		auto byId = [](const Root* a, const Root* b) { return a->id<b->id; };
+		std::sort(roots.begin()+sortedRoots, roots.end(), byId);
+		std::inplace_merge(roots.begin(), roots.begin()+sortedRoots, roots.end(), byId);
+		sortedRoots = roots.size();
+	}
+}
+
+/**
+ * Recreates the index of all roots by id, and the roots with more than one node from the root tree
+ */
+void RootSystem::rebuildRootIndex()
+{
+	rootsById.assign(rid+1, nullptr);
+	std::vector<Root*> stack(baseRoots.begin(), baseRoots.end());
+	while (!stack.empty()) {
+		Root* r = stack.back();
+		stack.pop_back();
+		rootsById.at(r->id) = r;
+		stack.insert(stack.end(), r->laterals.begin(), r->laterals.end());
+	}
+	roots.clear();
+	for (auto r : rootsById) {
+		if ((r!=nullptr) && (r->nodes.size()>1)) {
+			roots.push_back(r);
 		}
-		return roots;
-	} else { // return buffer
-		return roots;
 	}
+	sortedRoots = roots.size();
 }
 
 /**
@@ -460,7 +1078,7 @@ std::vector<Root*> RootSystem::getRoots() const
  */
 std::vector<int> RootSystem::getRootTips() const
 {
-	this->getRoots(); // update roots (if necessary)
+	updateRoots();
 	std::vector<int> tips;
 	for (auto& r : roots) {
 		tips.push_back(r->getNodeId(r->getNumberOfNodes()-1));
@@ -473,7 +1091,7 @@ std::vector<int> RootSystem::getRootTips() const
  */
 std::vector<int> RootSystem::getRootBases() const
 {
-	this->getRoots(); // update roots (if necessary)
+	updateRoots();
 	std::vector<int> bases;
 	for (auto& r : roots) {
 		bases.push_back(r->getNodeId(0));
@@ -487,20 +1105,11 @@ std::vector<int> RootSystem::getRootBases() const
  */
 std::vector<Vector3d> RootSystem::getNodes() const
 {
-	this->getRoots(); // update roots (if necessary)
 	int non = getNumberOfNodes();
 	std::vector<Vector3d> nv = std::vector<Vector3d>(non); // reserve big enough vector
-	// copy initial nodes (roots might not have developed)
-	for (auto const& r: baseRoots) {
-		nv.at(r->getNodeId(0)) = r->getNode(0);
-	}
-	// copy root nodes
-	for (auto const& r: roots) {
-		for (size_t i=0; i<r->getNumberOfNodes(); i++) { // loop over all nodes of all roots
-			nv.at(r->getNodeId(i)) = r->getNode(i); // pray that ids are correct
-		}
+	for (int i=0; i<non; i++) {
+		nv[i] = nodeStore.getNode(i);
 	}
-	nv.at(0) = Vector3d(0.,0.,3.); // add artificial shoot
 	return nv;
 }
 
@@ -509,7 +1118,7 @@ std::vector<Vector3d> RootSystem::getNodes() const
  */
 std::vector<std::vector<Vector3d>> RootSystem::getPolylines() const
 {
-	this->getRoots(); // update roots (if necessary)
+	updateRoots();
 	std::vector<std::vector<Vector3d>> nodes = std::vector<std::vector<Vector3d>>(roots.size()); // reserve big enough vector
 	for (size_t j=0; j<roots.size(); j++) {
 		std::vector<Vector3d>  rn = std::vector<Vector3d>(roots[j]->getNumberOfNodes());
@@ -522,24 +1131,44 @@ std::vector<std::vector<Vector3d>> RootSystem::getPolylines() const
 }
 
 /**
- * Return the segments of the root system at the current simulation time
+ * Return the segments of the root system at the current simulation time, from the node store
+ * (in the order of RootSystem::getRoots, and from base to tip per root)
  */
 std::vector<Vector2i> RootSystem::getSegments() const
 {
-	this->getRoots(); // update roots (if necessary)
-	int nos=getNumberOfSegments();
-	std::vector<Vector2i> s(nos);
-	int c=0;
-	for (auto const& r:roots) {
-		for (size_t i=0; i<r->getNumberOfNodes()-1; i++) {
-			Vector2i v(r->getNodeId(i),r->getNodeId(i+1));
-			s.at(c) = v;
-			c++;
-		}
+	std::vector<int> ends = getSegmentEnds();
+	std::vector<Vector2i> s(ends.size());
+	for (size_t i=0; i<ends.size(); i++) {
+		s[i] = Vector2i(nodeStore.parents[ends[i]], ends[i]);
 	}
 	return s;
 }
 
+/**
+ * Returns the end node ids of the segments from the node store, in the order of the roots (@see RootSystem::getRoots),
+ * and from base to tip, by sorting the nodes (in the order of their ids) by the id of their root
+ */
+std::vector<int> RootSystem::getSegmentEnds() const
+{
+	const std::vector<int>& rootIds = nodeStore.rootIds;
+	const std::vector<int>& parents = nodeStore.parents;
+	std::vector<int> start(rid+2, 0); // first segment per root id
+	for (size_t i=0; i<nodeStore.size(); i++) {
+		if (parents[i]>=0) {
+			start[rootIds[i]+1]++;
+		}
+	}
+	std::partial_sum(start.begin(), start.end(), start.begin());
+	std::vector<int> ends(start.back());
+	for (size_t i=0; i<nodeStore.size(); i++) {
+		if (parents[i]>=0) {
+			ends[start[rootIds[i]]++] = i;
+		}
+	}
+	assert(int(ends.size())==getNumberOfSegments());
+	return ends;
+}
+
 /**
  * Return the segments connecting tap root, basal roots, and shoot borne roots.
  *
@@ -575,34 +1204,24 @@ std::vector<Vector2i> RootSystem::getShootSegments() const
  */
 std::vector<Root*> RootSystem::getSegmentsOrigin() const
 {
-	this->getRoots(); // update roots (if necessary)
-	int nos=getNumberOfSegments();
-	std::vector<Root*> s(nos);
-	int c=0;
-	for (auto const& r:roots) {
-		for (size_t i=0; i<r->getNumberOfNodes()-1; i++) {
-			s.at(c) = r;
-			c++;
-		}
+	std::vector<int> ends = getSegmentEnds();
+	std::vector<Root*> s(ends.size());
+	for (size_t i=0; i<ends.size(); i++) {
+		s[i] = rootsById.at(nodeStore.rootIds[ends[i]]);
 	}
 	return s;
 }
 
 /**
- * Copies the node emergence times of the root systems into a sequential vector,
- * see RootSystem::getNodes()
+ * Copies the node emergence times of the segment end nodes into a sequential vector (one per segment),
+ * see RootSystem::getSegments()
  */
 std::vector<double> RootSystem::getNETimes() const
 {
-	this->getRoots(); // update roots (if necessary)
-	int nos=getNumberOfSegments();
-	std::vector<double> netv = std::vector<double>(nos); // reserve big enough vector
-	int c=0;
-	for (auto const& r: roots) {
-		for (size_t i=1; i<r->getNumberOfNodes(); i++) { // loop over all nodes of all roots
-			netv.at(c) = r->getNodeETime(i); // pray that ids are correct
-			c++;
-		}
+	std::vector<int> ends = getSegmentEnds();
+	std::vector<double> netv(ends.size());
+	for (size_t i=0; i<ends.size(); i++) {
+		netv[i] = nodeStore.netimes[ends[i]];
 	}
 	return netv;
 }
@@ -612,7 +1231,7 @@ std::vector<double> RootSystem::getNETimes() const
  */
 std::vector<std::vector<double>> RootSystem::getPolylinesNET() const
 {
-	this->getRoots(); // update roots (if necessary)
+	updateRoots();
 	std::vector<std::vector<double>> times = std::vector<std::vector<double>>(roots.size()); // reserve big enough vector
 	for (size_t j=0; j<roots.size(); j++) {
 		std::vector<double>  rt = std::vector<double>(roots[j]->getNumberOfNodes());
@@ -632,96 +1251,107 @@ std::vector<std::vector<double>> RootSystem::getPolylinesNET() const
  */
 std::vector<double> RootSystem::getScalar(int stype) const
 {
-	this->getRoots(); // update roots (if necessary)
+	updateRoots();
 	std::vector<double> scalars(roots.size());
 	for (size_t i=0; i<roots.size(); i++) {
-		double value=0;
-		switch(stype) {
-		case st_type:  // type
-			value = roots[i]->param.type;
-			break;
-		case st_radius: // root radius
-			value = roots[i]->param.a;
-			break;
-		case st_order: { // root order (calculate)
-			value = 0;
-			Root* r_ = roots[i];
-			while (r_->parent!=nullptr) {
-				value++;
-				r_=r_->parent;
-			}
-			break;
-		}
-		case st_time: // emergence time of the root
-			value = roots[i]->getNodeETime(0);
-			break;
-		case st_length:
-			value = roots[i]->length;
-			break;
-		case st_surface:
-			value =  roots[i]->length*2.*M_PI*roots[i]->param.a;
-			break;
-		case st_volume:
-			value =  roots[i]->length*M_PI*(roots[i]->param.a)*(roots[i]->param.a);
-			break;
-		case st_one:
-			value =  1;
-			break;
-		case st_parenttype: {
-			Root* r_ = roots[i];
-			if (r_->parent!=nullptr) {
-				value = r_->parent->param.type;
-			} else {
-				value = 0;
-			}
-			break;
-		}
-		case st_lb:
-			value = roots[i]->param.lb;
-			break;
-		case st_la:
-			value = roots[i]->param.la;
-			break;
-		case st_nob:
-			value = roots[i]->param.nob;
-			break;
-		case st_r:
-			value = roots[i]->param.r;
-			break;
-		case st_theta:
-			value = roots[i]->param.theta;
-			break;
-		case st_rlt:
-			value = roots[i]->param.rlt;
-			break;
-		case st_meanln: {
-			const std::vector<double>& v_ = roots[i]->param.ln;
-			value = std::accumulate(v_.begin(), v_.end(), 0.0) / v_.size();
-			break;
-		}
-		case st_sdln: {
-			const std::vector<double>& v_ = roots[i]->param.ln;
-			double mean = std::accumulate(v_.begin(), v_.end(), 0.0) / v_.size();
-			double sq_sum = std::inner_product(v_.begin(), v_.end(), v_.begin(), 0.0);
-			value = std::sqrt(sq_sum / v_.size() - mean * mean);
-			break;
-		}
-		default:
-			throw std::invalid_argument( "RootSystem::getScalar type not implemented" );
-		}
-		scalars[i]=value;
+		scalars[i] = getRootScalar(roots[i], stype);
 	}
 	return scalars;
 }
 
+/**
+ * A scalar that is constant per root
+ *
+ * @param r         the root
+ * @param stype     a scalar type (@see RootSystem::ScalarTypes)
+ */
+double RootSystem::getRootScalar(const Root* r, int stype)
+{
+	double value=0;
+	switch(stype) {
+	case st_type:  // type
+		value = r->param.type;
+		break;
+	case st_radius: // root radius
+		value = r->param.a;
+		break;
+	case st_order: { // root order (calculate)
+		value = 0;
+		const Root* r_ = r;
+		while (r_->parent!=nullptr) {
+			value++;
+			r_=r_->parent;
+		}
+		break;
+	}
+	case st_time: // emergence time of the root
+		value = r->getNodeETime(0);
+		break;
+	case st_length:
+		value = r->length;
+		break;
+	case st_surface:
+		value =  r->length*2.*M_PI*r->param.a;
+		break;
+	case st_volume:
+		value =  r->length*M_PI*(r->param.a)*(r->param.a);
+		break;
+	case st_one:
+		value =  1;
+		break;
+	case st_parenttype: {
+		const Root* r_ = r;
+		if (r_->parent!=nullptr) {
+			value = r_->parent->param.type;
+		} else {
+			value = 0;
+		}
+		break;
+	}
+	case st_lb:
+		value = r->param.lb;
+		break;
+	case st_la:
+		value = r->param.la;
+		break;
+	case st_nob:
+		value = r->param.nob;
+		break;
+	case st_r:
+		value = r->param.r;
+		break;
+	case st_theta:
+		value = r->param.theta;
+		break;
+	case st_rlt:
+		value = r->param.rlt;
+		break;
+	case st_meanln: {
+		const std::vector<double>& v_ = r->param.ln;
+		value = std::accumulate(v_.begin(), v_.end(), 0.0) / v_.size();
+		break;
+	}
+	case st_sdln: {
+		const std::vector<double>& v_ = r->param.ln;
+		double mean = std::accumulate(v_.begin(), v_.end(), 0.0) / v_.size();
+		double sq_sum = std::inner_product(v_.begin(), v_.end(), v_.begin(), 0.0);
+		value = std::sqrt(sq_sum / v_.size() - mean * mean);
+		break;
+	}
+	default:
+		throw std::invalid_argument( "RootSystem::getScalar type not implemented" );
+	}
+	return value;
+}
+
 /**
  * The indices of the nodes that were updated in the last time step
  */
 std::vector<int> RootSystem::getUpdatedNodeIndices() const
 {
-	this->getRoots(); // update roots (if necessary)
 	std::vector<int> ni = std::vector<int>(0);
-	for (auto const& r: roots) {
+	for (int id : grownRoots) { // the other roots did not change
+		const Root* r = rootsById.at(id);
 		if (r->old_non>0){
 			ni.push_back(r->getNodeId(r->old_non-1));
 		}
@@ -734,9 +1364,9 @@ std::vector<int> RootSystem::getUpdatedNodeIndices() const
  */
 std::vector<Vector3d> RootSystem::getUpdatedNodes() const
 {
-	this->getRoots(); // update roots (if necessary)
 	std::vector<Vector3d> nv = std::vector<Vector3d>(0);
-	for (auto const& r: roots) {
+	for (int id : grownRoots) {
+		const Root* r = rootsById.at(id);
 		if (r->old_non>0){
 			nv.push_back(r->getNode(r->old_non-1));
 		}
@@ -750,14 +1380,9 @@ std::vector<Vector3d> RootSystem::getUpdatedNodes() const
  */
 std::vector<Vector3d> RootSystem::getNewNodes() const
 {
-	roots.clear();
-	this->getRoots(); // update roots (if necessary)
 	std::vector<Vector3d> nv(this->getNumberOfNewNodes());
-	for (auto const& r: roots) {
-		int onon = std::abs(r->old_non);
-		for (size_t i=onon; i<r->getNumberOfNodes(); i++) { // loop over all new nodes
-			nv.at(r->getNodeId(i)-this->old_non) = r->getNode(i); // pray that ids are correct
-		}
+	for (size_t i=0; i<nv.size(); i++) { // new nodes have consecutive ids
+		nv[i] = nodeStore.getNode(this->old_non+i);
 	}
 	return nv;
 }
@@ -768,10 +1393,9 @@ std::vector<Vector3d> RootSystem::getNewNodes() const
  */
 std::vector<int> RootSystem::getNewNodeIndices() const
 {
-	roots.clear();
-	this->getRoots(); // update roots (if necessary)
 	std::vector<int> nv(this->getNumberOfNewNodes());
-	for (auto const& r: roots) {
+	for (int id : grownRoots) {
+		const Root* r = rootsById.at(id);
 		int onon = std::abs(r->old_non);
 		for (size_t i=onon; i<r->getNumberOfNodes(); i++) { // loop over all new nodes
 			nv.at(r->getNodeId(i)-this->old_non) = r->getNodeId(i); // pray that ids are correct
@@ -786,10 +1410,10 @@ std::vector<int> RootSystem::getNewNodeIndices() const
  */
 std::vector<Vector2i> RootSystem::getNewSegments() const
 {
-	this->getRoots(); // update roots (if necessary)
 	std::vector<Vector2i> si(this->getNumberOfNewNodes());
 	int c=0;
-	for (auto const& r:roots) {
+	for (int id : grownRoots) {
+		const Root* r = rootsById.at(id);
 		int onon = std::abs(r->old_non);
 		for (size_t i=onon-1; i<r->getNumberOfNodes()-1; i++) {
 			Vector2i v(r->getNodeId(i),r->getNodeId(i+1));
@@ -805,10 +1429,10 @@ std::vector<Vector2i> RootSystem::getNewSegments() const
  */
 std::vector<Root*> RootSystem::getNewSegmentsOrigin() const
 {
-	this->getRoots(); // update roots (if necessary)
 	std::vector<Root*> si(this->getNumberOfNewNodes());
 	int c=0;
-	for (auto& r:roots) {
+	for (int id : grownRoots) {
+		Root* r = rootsById.at(id);
 		int onon = std::abs(r->old_non);
 		for (size_t i=onon-1; i<r->getNumberOfNodes()-1; i++) {
 			si.at(c) = r;
@@ -819,18 +1443,417 @@ std::vector<Root*> RootSystem::getNewSegmentsOrigin() const
 }
 
 
+/**
+ * Saves the current state of the simulation, that can be restored by RootSystem::pop().
+ * States can be nested, a journaled state (@see RootSystem::setJournaling) is created in constant time.
+ */
 void RootSystem::push()
 {
-	stateStack.push(RootSystemState(*this));
+	stateStack.push(RootSystemState(*this, journaling));
+	if (journaling) {
+		stateStack.top().epoch = ++epochs;
+		rtparamEpochs.resize(rtparam->size(), 0);
+		rtrandomEpochs.resize(rtrandom.size(), 0);
+		tfEpochs.resize(tf.size(), 0);
+	}
+	setTopState();
 }
 
+/**
+ * Restores the last saved state, the costs of a journaled state are proportional to the recorded changes
+ */
 void RootSystem::pop()
 {
+	if (stateStack.empty()) {
+		throw std::invalid_argument("RootSystem::pop() no state was saved");
+	}
 	RootSystemState& rss = stateStack.top();
+	bool journaled = rss.journaled;
+	// roots created after push() are deleted by restore
+	roots.erase(std::remove_if(roots.begin(), roots.end(), [&rss](const Root* r) { return r->id>rss.rid; }), roots.end());
+	rootsById.resize(rss.rid+1);
 	rss.restore(*this);
+	// roots that emerged after push()
+	roots.erase(std::remove_if(roots.begin(), roots.end(), [](const Root* r) { return r->nodes.size()<=1; }), roots.end());
+	sortedRoots = std::min(sortedRoots, roots.size());
 	stateStack.pop();
+	if (!journaled) {
+		rebuildNodeStore();
+	}
+	setTopState();
+}
+
+/**
+ * Removes the last pushed state without restoring it,
+ * the records of a journaled state are taken over by the state below
+ */
+void RootSystem::discardState()
+{
+	RootSystemState rss = std::move(stateStack.top());
+	stateStack.pop();
+	if (rss.journaled && (!stateStack.empty())) {
+		stateStack.top().append(rss);
+	} else {
+		rss.discard();
+	}
+	setTopState();
 }
 
+/**
+ * Sets the journal and its epoch to the state on top of the stack
+ */
+void RootSystem::setTopState()
+{
+	if ((!stateStack.empty()) && stateStack.top().journaled) {
+		journal = &stateStack.top();
+		epoch = journal->epoch;
+	} else {
+		journal = nullptr;
+		epoch = 0;
+	}
+}
+
+/**
+ * Opt-in: push() creates journaled states, i.e. it copies only the counters and random number generators of
+ * the root system. Afterwards, roots, nodes, root type parameters, and tropisms are recorded before their first change,
+ * and pop() undoes only these changes. Therefore, the costs of push() and pop() are proportional to the changes,
+ * and not to the size of the root system. Call while no state is saved.
+ *
+ * @param journaling    use journaled states
+ */
+void RootSystem::setJournaling(bool journaling)
+{
+	if (!stateStack.empty()) {
+		throw std::invalid_argument("RootSystem::setJournaling() states are saved");
+	}
+	this->journaling = journaling;
+}
+
+/**
+ * Records root r (without its laterals) before its first change after the last push(),
+ * within a growth task the record is added to the task's journal
+ *
+ * @param r         the root that will change
+ */
+void RootSystem::journalRoot(Root* r)
+{
+	if ((journal!=nullptr) && (r->epoch!=epoch)) {
+		r->epoch = epoch;
+		if ((task!=nullptr) && (task->rs==this)) {
+			task->journal.addRoot(r);
+		} else {
+			journal->addRoot(r);
+		}
+	}
+}
+
+/**
+ * Records node i of the node store before it is changed, if it existed at the last push()
+ *
+ * @param i         node id
+ */
+void RootSystem::journalNode(int i)
+{
+	if ((journal!=nullptr) && (i<journal->non)) {
+		if ((task!=nullptr) && (task->rs==this)) {
+			task->journal.addNode(i, nodeStore.getNode(i), nodeStore.netimes[i]);
+		} else {
+			journal->addNode(i, nodeStore.getNode(i), nodeStore.netimes[i]);
+		}
+	}
+}
+
+
+/**
+ * Writes a binary checkpoint of the simulation to a file, @see RootSystem::writeState
+ *
+ * @param name      file name (e.g. "maize.ckpt")
+ */
+void RootSystem::saveState(std::string name) const
+{
+	std::ofstream fos(name.c_str(), std::ios::binary);
+	if (!fos.good()) {
+		throw std::invalid_argument("RootSystem::saveState() could not open file "+name);
+	}
+	writeState(fos);
+	fos.close();
+	if (fos.fail()) {
+		throw std::invalid_argument("RootSystem::saveState() could not write file "+name);
+	}
+}
+
+/**
+ * Restores a checkpoint written by RootSystem::saveState, @see RootSystem::readState
+ *
+ * @param name      file name
+ */
+void RootSystem::loadState(std::string name)
+{
+	CheckpointReader cr(name);
+	readState(cr);
+}
+
+/**
+ * Writes a binary checkpoint (@see CheckpointWriter) of everything that changes during the simulation
+ * (i.e. all data of RootSystemState and RootState), the roots including their parameters and nodes,
+ * the node store, the plant and root type parameters, and the states of all random number generators.
+ *
+ * Not written are the confining geometry, the soil, the scale functions of the root type parameters,
+ * and the options (parallel growth, candidates, journaling). Saved states (@see RootSystem::push) are not written.
+ *
+ * @param os        out stream (opened in binary mode)
+ */
+void RootSystem::writeState(std::ostream & os) const
+{
+	static_assert(sizeof(Vector3d)==3*sizeof(double), "RootSystem::writeState() Vector3d is expected to consist of three doubles");
+	static_assert(sizeof(int)==sizeof(int32_t), "RootSystem::writeState() int is expected to have 32 bits");
+	CheckpointWriter cw(os);
+	// plant and root type parameters
+	ParameterSet::write(cw, rsparam, *rtparam, (rtrandom.size()==rtparam->size()) ? &rtrandom : nullptr); // generators exist after initialize()
+	// counters and random number generators
+	cw.putTag("SYST");
+	cw.put(simtime);
+	cw.put(int32_t(rid)); cw.put(int32_t(nid));
+	cw.put(int32_t(old_non)); cw.put(int32_t(old_nor));
+	cw.put(int32_t(numberOfCrowns)); cw.put(int32_t(manualSeed));
+	cw.put(int32_t(deltaFirstNode)); cw.put(lengthIncrement);
+	std::stringstream ss;
+	ss << gen << " " << UD << " " << UID << " " << ND;
+	cw.putString(ss.str());
+	cw.put(int32_t(randomStreams)); cw.put(uint32_t(randomSeed));
+	// tropisms
+	cw.putTag("TROP");
+	cw.put(uint64_t(tf.size()));
+	for (size_t i=0; i<tf.size(); i++) {
+		cw.putString((rtparam->at(i).type>0) ? tf[i]->getRandomState() : std::string());
+	}
+	// root tree
+	cw.putTag("ROOT");
+	cw.put(uint64_t(baseRoots.size()));
+	for (auto r : baseRoots) {
+		writeRoot(cw, r);
+	}
+	// node store (in double precision, also if built with CROOTBOX_COMPACT)
+	cw.putTag("NODE");
+	std::vector<double> x(nodeStore.size()), y(nodeStore.size()), z(nodeStore.size());
+	for (size_t i=0; i<nodeStore.size(); i++) {
+		Vector3d n = nodeStore.getNode(i);
+		x[i] = n.x;
+		y[i] = n.y;
+		z[i] = n.z;
+	}
+	cw.putVector(x);
+	cw.putVector(y);
+	cw.putVector(z);
+	cw.putVector(std::vector<double>(nodeStore.netimes.begin(), nodeStore.netimes.end()));
+	cw.putVector(nodeStore.rootIds);
+	cw.putVector(nodeStore.parents);
+	// changes of the last time step
+	cw.putTag("DELT");
+	cw.putVector(deltaMovedNodes);
+	std::vector<int> newRootIds(deltaNewRoots.size());
+	for (size_t i=0; i<deltaNewRoots.size(); i++) {
+		newRootIds[i] = deltaNewRoots[i]->id;
+	}
+	cw.putVector(newRootIds);
+	cw.putTag("END ");
+}
+
+/**
+ * Writes a root and its laterals (pre-order)
+ */
+void RootSystem::writeRoot(CheckpointWriter& cw, const Root* r) const
+{
+	const RootParameter& p = r->param;
+	cw.put(int32_t(p.type));
+	cw.put(int32_t(p.nob));
+	const double v[] = { p.lb, p.la, p.r, p.a, p.theta, p.rlt, r->iheading.x, r->iheading.y, r->iheading.z,
+		r->parent_base_length, r->getCurrentAge(), r->length };
+	cw.putArray(v, sizeof(v)/sizeof(double));
+	cw.putVector(p.ln);
+	cw.put(int32_t(r->id));
+	cw.put(int32_t(r->parent_ni));
+	cw.put(int32_t(r->isAlive()));
+	cw.put(int32_t(r->active));
+	cw.put(int32_t(r->old_non));
+	std::vector<double> xyz(3*r->nodes.size());
+	for (size_t i=0; i<r->nodes.size(); i++) {
+		Vector3d n = r->nodes[i];
+		xyz[3*i] = n.x;
+		xyz[3*i+1] = n.y;
+		xyz[3*i+2] = n.z;
+	}
+	cw.putVector(xyz);
+	cw.putVector(r->nodeIds);
+	cw.putVector(std::vector<double>(r->netimes.begin(), r->netimes.end()));
+	cw.put(uint64_t(r->laterals.size()));
+	for (auto l : r->laterals) {
+		writeRoot(cw, l);
+	}
+}
+
+/**
+ * Restores a checkpoint from a buffer, @see RootSystem::readState(CheckpointReader&)
+ *
+ * @param data      the checkpoint (e.g. a memory mapped file)
+ * @param size      size of the buffer [bytes]
+ */
+void RootSystem::readState(const char* data, size_t size)
+{
+	CheckpointReader cr(data, size);
+	readState(cr);
+}
+
+/**
+ * Restores a checkpoint (@see RootSystem::writeState). Replaces the roots, the plant and root type parameters,
+ * and recreates the tropisms and growth functions (like RootSystem::initialize).
+ *
+ * Set the geometry, the soil, and the scale functions of the root type parameters before, and custom tropisms
+ * (@see RootSystem::setTropism) after calling this method. Roots are created as Root, not by RootSystem::createRoot.
+ *
+ * @param cr        the checkpoint
+ */
+void RootSystem::readState(CheckpointReader& cr)
+{
+	if (!stateStack.empty()) {
+		throw std::invalid_argument("RootSystem::readState() states are saved");
+	}
+	reset();
+	// plant and root type parameters (keeps the scale functions)
+	ParameterSet::read(cr, rsparam, rtparam.write(), &rtrandom);
+	// counters and random number generators
+	cr.expectTag("SYST");
+	simtime = cr.get<double>();
+	rid = cr.get<int32_t>(); nid = cr.get<int32_t>();
+	old_non = cr.get<int32_t>(); old_nor = cr.get<int32_t>();
+	numberOfCrowns = cr.get<int32_t>(); manualSeed = cr.get<int32_t>();
+	deltaFirstNode = cr.get<int32_t>(); lengthIncrement = cr.get<double>();
+	std::stringstream ss(cr.getString());
+	ss >> gen >> UD >> UID >> ND;
+	if (cr.getVersion()>=2) {
+		randomStreams = cr.get<int32_t>(); randomSeed = cr.get<uint32_t>();
+	}
+	// tropisms and growth functions
+	cr.expectTag("TROP");
+	if (cr.get<uint64_t>()!=rtparam->size()) {
+		throw std::invalid_argument("RootSystem::readState() corrupt checkpoint, wrong number of tropisms");
+	}
+	for (size_t i=0; i<rtparam->size(); i++) {
+		const RootTypeParameter& p = rtparam->at(i);
+		Tropism* tropism = this->createTropismFunction(p.tropismT, p.tropismN, p.tropismS);
+		std::string state = cr.getString();
+		if (!state.empty()) {
+			tropism->setRandomState(state);
+		}
+		tropism->setGeometry(geometry, geometryProjection);
+		tf.push_back(tropism);
+		gf.push_back(this->createGrowthFunction(p.gf));
+	}
+	// root tree
+	cr.expectTag("ROOT");
+	size_t n = cr.get<uint64_t>();
+	for (size_t i=0; i<n; i++) {
+		baseRoots.push_back(readRoot(cr, nullptr));
+	}
+	// node store
+	cr.expectTag("NODE");
+	std::vector<double> x = cr.getVector<double>();
+	std::vector<double> y = cr.getVector<double>();
+	std::vector<double> z = cr.getVector<double>();
+	std::vector<double> t = cr.getVector<double>();
+	nodeStore.rootIds = cr.getVector<int>();
+	nodeStore.parents = cr.getVector<int>();
+	size_t non = x.size();
+	if ((y.size()!=non) || (z.size()!=non) || (t.size()!=non) || (nodeStore.rootIds.size()!=non)
+		|| (nodeStore.parents.size()!=non) || (int(non)!=nid+1)) {
+		throw std::invalid_argument("RootSystem::readState() corrupt checkpoint, wrong number of nodes");
+	}
+	nodeStore.setOrigin(rsparam.seedPos);
+	nodeStore.x.resize(non);
+	nodeStore.y.resize(non);
+	nodeStore.z.resize(non);
+	nodeStore.netimes.resize(non);
+	for (size_t i=0; i<non; i++) {
+		nodeStore.setNode(i, Vector3d(x[i], y[i], z[i]), t[i]);
+	}
+	// changes of the last time step
+	cr.expectTag("DELT");
+	deltaMovedNodes = cr.getVector<int>();
+	std::vector<int> newRootIds = cr.getVector<int>();
+	if (!newRootIds.empty()) { // new roots have consecutive ids (@see RootSystem::RootSystem(const RootSystem&))
+		int firstId = newRootIds.front();
+		deltaNewRoots = std::vector<Root*>(newRootIds.size(), nullptr);
+		std::vector<Root*> stack(baseRoots.begin(), baseRoots.end());
+		while (!stack.empty()) {
+			Root* r = stack.back();
+			stack.pop_back();
+			if ((r->id>=firstId) && (r->id-firstId<int(deltaNewRoots.size()))) {
+				deltaNewRoots[r->id-firstId] = r;
+			}
+			stack.insert(stack.end(), r->laterals.begin(), r->laterals.end());
+		}
+	}
+	cr.expectTag("END ");
+	rebuildRootIndex();
+	for (auto r : roots) { // the checkpoint stores the ages of skipped subtrees, all roots are simulated again
+		if ((r->old_non>0) || (-r->old_non<int(r->nodes.size()))) {
+			grownRoots.push_back(r->id);
+		}
+	}
+}
+
+/**
+ * Reads a root and its laterals (pre-order)
+ */
+Root* RootSystem::readRoot(CheckpointReader& cr, Root* parent)
+{
+	Root* r = new(pool) Root(this);
+	r->parent = parent;
+	r->randomKey = RandomStream::getKey((parent!=nullptr) ? parent->randomKey : 0, (parent!=nullptr) ? parent->laterals.size() : baseRoots.size());
+	try {
+		RootParameter& p = r->param;
+		p.type = cr.get<int32_t>();
+		p.nob = cr.get<int32_t>();
+		std::vector<double> v = cr.getVector<double>();
+		if (v.size()!=12) {
+			throw std::invalid_argument("RootSystem::readRoot() corrupt checkpoint, wrong number of root parameters");
+		}
+		p.lb = v[0]; p.la = v[1]; p.r = v[2]; p.a = v[3]; p.theta = v[4]; p.rlt = v[5];
+		r->iheading = Vector3d(v[6], v[7], v[8]);
+		r->parent_base_length = v[9];
+		r->age = v[10];
+		r->length = v[11];
+		p.ln = cr.getVector<double>();
+		r->id = cr.get<int32_t>();
+		r->parent_ni = cr.get<int32_t>();
+		r->alive = cr.get<int32_t>();
+		r->active = cr.get<int32_t>();
+		r->old_non = cr.get<int32_t>();
+		if (parent!=nullptr) {
+			r->parentCreationTime = parent->getCreationTime(r->parent_base_length+parent->param.la);
+		}
+		std::vector<double> xyz = cr.getVector<double>();
+		r->nodeIds = cr.getVector<int>();
+		std::vector<double> t = cr.getVector<double>();
+		r->netimes.assign(t.begin(), t.end());
+		size_t non = xyz.size()/3;
+		if ((xyz.size()!=3*non) || (r->nodeIds.size()!=non) || (r->netimes.size()!=non) || (non==0)) {
+			throw std::invalid_argument("RootSystem::readRoot() corrupt checkpoint, wrong number of root nodes");
+		}
+		r->nodes.reserve(non);
+		for (size_t i=0; i<non; i++) {
+			r->nodes.push_back(Vector3d(xyz[3*i], xyz[3*i+1], xyz[3*i+2]));
+		}
+		size_t nol = cr.get<uint64_t>();
+		for (size_t i=0; i<nol; i++) {
+			r->laterals.push_back(readRoot(cr, r));
+		}
+	} catch (...) {
+		delete r;
+		throw;
+	}
+	return r;
+}
 
 /**
  * todo
@@ -840,6 +1863,38 @@ std::string RootSystem::toString() const
 	return "todo";
 }
 
+/**
+ * Returns the instrumentation counters (all zero, unless built with CROOTBOX_PROFILE).
+ * The counters accumulate over all calls of simulate, @see RootSystem::resetProfile
+ *
+ * @param type      root type, 0 for the root system level (simulate, output), -1 for the sum of all
+ */
+ProfileCounters RootSystem::getProfile(int type) const
+{
+	ProfileCounters sum;
+#ifdef CROOTBOX_PROFILE
+	if (type>=0) {
+		return profile.at(type);
+	}
+	for (const auto& p : profile) {
+		sum.add(p);
+	}
+#endif
+	return sum;
+}
+
+/**
+ * Sets all instrumentation counters to zero
+ */
+void RootSystem::resetProfile()
+{
+#ifdef CROOTBOX_PROFILE
+	for (auto& p : profile) {
+		p.reset();
+	}
+#endif
+}
+
 
 /**
  * Exports the simulation results with the type from the extension in name
@@ -847,17 +1902,25 @@ std::string RootSystem::toString() const
  *
  * @param name      file name e.g. output.vtp
  */
-void RootSystem::write(std::string name) const
+void RootSystem::write(std::string name, int encoding, bool compress) const
 {
 	std::ofstream fos;
-	fos.open(name.c_str());
+	if (encoding==VTPWriter::vtp_ascii) {
+		fos.open(name.c_str());
+	} else {
+		fos.open(name.c_str(), std::ios::binary);
+	}
 	std::string ext = name.substr(name.size()-3,name.size()); // pick the right writer
 	if (ext.compare("sml")==0) {
 		std::cout << "writing RSML... "<< name.c_str() <<"\n";
 		writeRSML(fos);
 	} else if (ext.compare("vtp")==0) {
 		std::cout << "writing VTP... "<< name.c_str() <<"\n";
-		writeVTP(fos);
+		if (encoding==VTPWriter::vtp_ascii) {
+			writeVTP(fos);
+		} else {
+			writeVTP(fos, encoding, compress);
+		}
 	} else if (ext.compare(".py")==0)  {
 		std::cout << "writing Geometry ... "<< name.c_str() <<"\n";
 		writeGeometry(fos);
@@ -874,6 +1937,7 @@ void RootSystem::write(std::string name) const
  */
 void RootSystem::writeRSML(std::ostream & os) const
 {
+	CROOTBOX_PROFILE_TIME(getProfileCounters(0), ProfileCounters::pp_output);
 	os << "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"; // i am not using utf-8, but not sure if ISO-8859-1 is correct
 	os << "<rsml>\n";
 	writeRSMLMeta(os);
@@ -929,25 +1993,28 @@ void RootSystem::writeRSMLPlant(std::ostream & os) const
  */
 void RootSystem::writeVTP(std::ostream & os) const
 {
-	this->getRoots(); // update roots (if necessary)
-	const auto& nodes = getPolylines();
-	const auto& times = getPolylinesNET();
+	CROOTBOX_PROFILE_TIME(getProfileCounters(0), ProfileCounters::pp_output);
+	updateRoots();
+	std::vector<std::vector<int>> ni(roots.size()); // written nodes per root
+	for (size_t i=0; i<roots.size(); i++) {
+		ni[i] = roots[i]->getSimplifiedNodes(outputTolerance);
+	}
 
 	os << "<?xml version=\"1.0\"?>";
 	os << "<VTKFile type=\"PolyData\" version=\"0.1\" byte_order=\"LittleEndian\">\n";
 	os << "<PolyData>\n";
 	int non = 0; // number of nodes
-	for (auto const& r : roots) {
-		non += r->getNumberOfNodes();
+	for (auto const& r : ni) {
+		non += r.size();
 	}
 	int nol=roots.size(); // number of lines
 	os << "<Piece NumberOfLines=\""<< nol << "\" NumberOfPoints=\""<<non<<"\">\n";
 
 	// POINTDATA
 	os << "<PointData Scalars=\" PointData\">\n" << "<DataArray type=\"Float32\" Name=\"time\" NumberOfComponents=\"1\" format=\"ascii\" >\n";
-	for (const auto& r: times) {
-		for (const auto& t : r) {
-			os << t << " ";
+	for (size_t i=0; i<roots.size(); i++) {
+		for (int j : ni[i]) {
+			os << roots[i]->getNodeETime(j) << " ";
 		}
 	}
 	os << "\n</DataArray>\n" << "\n</PointData>\n";
@@ -968,8 +2035,9 @@ void RootSystem::writeVTP(std::ostream & os) const
 
 	// POINTS (=nodes)
 	os << "<Points>\n"<<"<DataArray type=\"Float32\" Name=\"Coordinates\" NumberOfComponents=\"3\" format=\"ascii\" >\n";
-	for (auto const& r:nodes) {
-		for (auto const& n : r) {
+	for (size_t i=0; i<roots.size(); i++) {
+		for (int j : ni[i]) {
+			Vector3d n = roots[i]->getNode(j);
 			os << n.x << " "<< n.y <<" "<< n.z<< " ";
 		}
 	}
@@ -977,17 +2045,13 @@ void RootSystem::writeVTP(std::ostream & os) const
 
 	// LINES (polylines)
 	os << "<Lines>\n"<<"<DataArray type=\"Int32\" Name=\"connectivity\" NumberOfComponents=\"1\" format=\"ascii\" >\n";
-	int c=0;
-	for (auto const& r:roots) {
-		for (size_t i=0; i<r->getNumberOfNodes(); i++) {
-			os << c << " ";
-			c++;
-		}
+	for (int c=0; c<non; c++) {
+		os << c << " ";
 	}
 	os << "\n</DataArray>\n"<<"<DataArray type=\"Int32\" Name=\"offsets\" NumberOfComponents=\"1\" format=\"ascii\" >\n";
-	c = 0;
-	for (auto const& r:roots) {
-		c += r->getNumberOfNodes();
+	int c = 0;
+	for (auto const& r : ni) {
+		c += r.size();
 		os << c << " ";
 	}
 	os << "\n</DataArray>\n";
@@ -997,6 +2061,69 @@ void RootSystem::writeVTP(std::ostream & os) const
 	os << "</PolyData>\n" << "</VTKFile>\n";
 }
 
+/**
+ * Writes the current simulation results as VTP file with appended binary data (@see VTPWriter).
+ * The polylines are streamed from the root tree, they contain the same data as the ascii file.
+ *
+ * @param os            typically a file out stream (opened in binary mode for raw encoding)
+ * @param encoding      VTPWriter::vtp_raw, or VTPWriter::vtp_base64 (VTPWriter::vtp_ascii calls RootSystem::writeVTP(os))
+ * @param compress      zlib compression (@see VTPWriter::hasCompression)
+ */
+void RootSystem::writeVTP(std::ostream & os, int encoding, bool compress) const
+{
+	if (encoding==VTPWriter::vtp_ascii) {
+		writeVTP(os);
+		return;
+	}
+	CROOTBOX_PROFILE_TIME(getProfileCounters(0), ProfileCounters::pp_output);
+	updateRoots();
+	const std::vector<Root*>& roots = this->roots;
+	std::vector<std::vector<int>> ni(roots.size()); // written nodes per root
+	size_t non = 0; // number of nodes
+	for (size_t i=0; i<roots.size(); i++) {
+		ni[i] = roots[i]->getSimplifiedNodes(outputTolerance);
+		non += ni[i].size();
+	}
+	VTPWriter w(encoding, compress);
+	w.setPiece(non, roots.size());
+	w.addPointData("time", [&](VTPWriter& w) {
+		for (size_t i=0; i<roots.size(); i++) {
+			for (int j : ni[i]) {
+				w.putFloat32(roots[i]->getNodeETime(j));
+			}
+		}
+	});
+	for (int st : { st_type, st_order, st_radius }) { // CELLDATA (live on the polylines)
+		w.addCellData(scalarTypeNames[st], [&roots, st](VTPWriter& w) {
+			for (auto const& r : roots) {
+				w.putFloat32(getRootScalar(r, st));
+			}
+		});
+	}
+	w.setPoints([&](VTPWriter& w) {
+		for (size_t i=0; i<roots.size(); i++) {
+			for (int j : ni[i]) {
+				const Vector3d& n = roots[i]->nodes[j];
+				w.putFloat32(n.x);
+				w.putFloat32(n.y);
+				w.putFloat32(n.z);
+			}
+		}
+	});
+	w.setLines(non, [&](VTPWriter& w) {
+		for (size_t i=0; i<non; i++) {
+			w.putInt32(i);
+		}
+	}, [&](VTPWriter& w) {
+		int c = 0;
+		for (auto const& r : ni) {
+			c += r.size();
+			w.putInt32(c);
+		}
+	});
+	w.write(os);
+}
+
 /**
  * Writes the current confining geometry (e.g. a plant container) as paraview python script
  * Just adds the initial lines, before calling the method of the sdf.
@@ -1005,6 +2132,7 @@ void RootSystem::writeVTP(std::ostream & os) const
  */
 void RootSystem::writeGeometry(std::ostream & os) const
 {
+	CROOTBOX_PROFILE_TIME(getProfileCounters(0), ProfileCounters::pp_output);
 	os << "from paraview.simple import *\n";
 	os << "paraview.simple._DisableFirstRenderCameraReset()\n";
 	os << "renderView1 = GetActiveViewOrCreate('RenderView')\n\n";
@@ -1012,9 +2140,15 @@ void RootSystem::writeGeometry(std::ostream & os) const
 }
 
 
-RootSystemState::RootSystemState(const RootSystem& rs) :rtparam(rs.rtparam), simtime(rs.simtime), rid(rs.rid),nid(rs.nid), old_non(rs.old_non), old_nor(rs.old_nor),
-		numberOfCrowns(rs.numberOfCrowns), manualSeed(rs.manualSeed), gen(rs.gen), UD(rs.UD), ND(rs.ND)
+RootSystemState::RootSystemState(const RootSystem& rs, bool journaled) :journaled(journaled), non(rs.nodeStore.size()), simtime(rs.simtime), rid(rs.rid),nid(rs.nid), old_non(rs.old_non), old_nor(rs.old_nor),
+		numberOfCrowns(rs.numberOfCrowns), manualSeed(rs.manualSeed), deltaFirstNode(rs.deltaFirstNode), deltaMovedNodes(rs.deltaMovedNodes), deltaNewRoots(rs.deltaNewRoots),
+		lengthIncrement(rs.lengthIncrement), grownRoots(rs.grownRoots), numberOfTimeSteps(rs.timeSteps.size()), gen(rs.gen), UD(rs.UD), ND(rs.ND)
 {
+	if (journaled) { // everything else is recorded on change
+		return;
+	}
+	rtparam = rs.rtparam;
+	rtrandom = rs.rtrandom;
 	tf = std::vector<Tropism*>(rs.tf.size()); // deep copy tropisms
 	for (size_t i=0; i<rs.tf.size(); i++) {
 		tf[i]= rs.tf[i]->copy();
@@ -1032,8 +2166,6 @@ RootSystemState::RootSystemState(const RootSystem& rs) :rtparam(rs.rtparam), sim
 
 void RootSystemState::restore(RootSystem& rs)
 {
-	rs.roots.clear(); // clear buffer
-	rs.rtparam  = rtparam;
 	rs.simtime = simtime; // copy back everything
 	rs.rid = rid;
 	rs.nid = nid;
@@ -1041,9 +2173,38 @@ void RootSystemState::restore(RootSystem& rs)
 	rs.old_nor = old_nor;
 	rs.numberOfCrowns = numberOfCrowns;
 	rs.manualSeed = manualSeed;
+	rs.deltaFirstNode = deltaFirstNode;
+	rs.deltaMovedNodes = deltaMovedNodes;
+	rs.deltaNewRoots = deltaNewRoots;
+	rs.lengthIncrement = lengthIncrement;
+	rs.grownRoots = grownRoots;
+	rs.timeSteps.resize(numberOfTimeSteps);
 	rs.gen = gen;
 	rs.UD = UD;
 	rs.ND = ND;
+	if (journaled) { // undo the recorded changes in reverse order
+		for (auto it = roots.rbegin(); it!=roots.rend(); ++it) {
+			it->second.restore(*(it->first));
+		}
+		for (auto it = rtparams.rbegin(); it!=rtparams.rend(); ++it) {
+			rs.rtparam.write().at(it->first) = it->second;
+		}
+		for (auto it = rtrandoms.rbegin(); it!=rtrandoms.rend(); ++it) {
+			rs.rtrandom.at(it->first) = it->second;
+		}
+		for (auto it = tfs.rbegin(); it!=tfs.rend(); ++it) {
+			delete rs.tf.at(it->first);
+			rs.tf[it->first] = it->second;
+		}
+		tfs.clear(); // owned by the root system again
+		rs.nodeStore.resize(non);
+		for (int i=int(nodeIds.size())-1; i>=0; i--) {
+			rs.nodeStore.setNode(nodeIds[i], nodes[i], nodeTimes[i]);
+		}
+		return;
+	}
+	rs.rtparam = rtparam;
+	rs.rtrandom = rtrandom;
 	for (size_t i=0; i<rs.tf.size(); i++) { // restore tropism functions
 		delete rs.tf[i];
 	}
@@ -1061,3 +2222,116 @@ void RootSystemState::restore(RootSystem& rs)
 	}
 }
 
+void RootSystemState::addRoot(Root* r)
+{
+	roots.push_back(std::make_pair(r, RootState(*r, false)));
+}
+
+void RootSystemState::discard()
+{
+	for (auto t : tf) {
+		delete t;
+	}
+	for (auto g : gf) {
+		delete g;
+	}
+	for (auto& t : tfs) {
+		delete t.second;
+	}
+	tf.clear();
+	gf.clear();
+	tfs.clear();
+}
+
+void RootSystemState::append(RootSystemState& s)
+{
+	roots.insert(roots.end(), s.roots.begin(), s.roots.end());
+	nodeIds.insert(nodeIds.end(), s.nodeIds.begin(), s.nodeIds.end());
+	nodes.insert(nodes.end(), s.nodes.begin(), s.nodes.end());
+	nodeTimes.insert(nodeTimes.end(), s.nodeTimes.begin(), s.nodeTimes.end());
+	rtparams.insert(rtparams.end(), s.rtparams.begin(), s.rtparams.end());
+	rtrandoms.insert(rtrandoms.end(), s.rtrandoms.begin(), s.rtrandoms.end());
+	tfs.insert(tfs.end(), s.tfs.begin(), s.tfs.end());
+	s.roots.clear();
+	s.nodeIds.clear();
+	s.nodes.clear();
+	s.nodeTimes.clear();
+	s.rtparams.clear();
+	s.rtrandoms.clear();
+	s.tfs.clear();
+}
+
+
+
+
+GrowthTask::GrowthTask(RootSystem* rs, unsigned int seed) :rs(rs), seed(seed),
+		tf(rs->tf.size(), nullptr), rtrandom(rs->rtrandom.size(), nullptr), gen(seed),
+		UD(std::uniform_real_distribution<double>(0,1)), UID(std::uniform_int_distribution<unsigned int>()), ND(std::normal_distribution<double>(0,1))
+{ }
+
+GrowthTask::~GrowthTask()
+{
+	for (auto t : tf) {
+		delete t;
+	}
+	for (auto g : rtrandom) {
+		delete g;
+	}
+}
+
+/**
+ * Simulates the lateral subtrees in the order they were added
+ *
+ * @param silence   indicates if status is written to the console (cout)
+ */
+void GrowthTask::simulate(bool silence)
+{
+	RootSystem::task = this;
+	try {
+		for (const auto& l : laterals) {
+			if (!rs->skipQuiescent(l.first)) {
+				l.first->simulate(l.second, silence);
+			}
+		}
+	} catch (...) {
+		RootSystem::task = nullptr;
+		throw;
+	}
+	RootSystem::task = nullptr;
+}
+
+/**
+ * Assigns the unique node ids and root ids in order of creation,
+ * and updates the first node id of the new laterals (which are copies of their parent node)
+ */
+void GrowthTask::renumber()
+{
+	for (const auto& n : nodes) {
+		n.first->nodeIds.at(n.second) = rs->getNodeIndex();
+	}
+	for (auto r : roots) {
+		r->id = rs->getRootIndex();
+		r->nodeIds.at(0) = r->parent->getNodeId(r->parent_ni);
+		rs->deltaNewRoots.push_back(r);
+		rs->rootsById.push_back(r);
+	}
+	for (auto r : grownRoots) {
+		rs->grownRoots.push_back(r->id);
+	}
+	rs->deltaMovedNodes.insert(rs->deltaMovedNodes.end(), movedNodes.begin(), movedNodes.end());
+	rs->lengthIncrement += lengthIncrement;
+	if (rs->journal!=nullptr) {
+		rs->journal->append(journal);
+	}
+	for (const auto& n : nodes) { // ids are known now
+		Root* r = n.first;
+		int i = n.second;
+		rs->nodeStore.set(r->nodeIds[i], r->nodes[i], r->netimes[i], r->id, (i>0) ? r->nodeIds[i-1] : -1);
+		if ((r->parent!=nullptr) && (i==1)) { // emerged lateral
+			rs->setBranchingNode(r);
+		}
+		if (i==1) {
+			rs->roots.push_back(r);
+		}
+	}
+}
@@ -9,15 +9,23 @@
 #include <numeric>
 #include <cmath>
 #include <stack>
+#include <deque>
+#include <vector>
 
 #include "ModelParameter.h"
 #include "Root.h"
 #include "soil.h"
+#include "NodeStore.h"
+#include "profile.h"
 
 class Root;
 class RootState;
+class RootPool;
 class Tropism;
 class RootSystemState;
+class GrowthTask;
+class CheckpointWriter;
+class CheckpointReader;
 
 /**
  * RootSystem
@@ -32,6 +40,7 @@ class RootSystem
 
 	friend Root;  // obviously :-)
 	friend RootSystemState;
+	friend GrowthTask;
 
 public:
 
@@ -48,17 +57,23 @@ public:
 	virtual ~RootSystem();
 
 	// Parameter input output
-	void setRootTypeParameter(RootTypeParameter p) { rtparam.at(p.type-1) = p; } ///< set the root type parameter to the index type-1
-	RootTypeParameter* getRootTypeParameter(int type) { return &rtparam.at(type-1); } ///< returns the i-th root parameter set (i=1..n)
+	void setRootTypeParameter(RootTypeParameter p) { rtparam.write().at(p.type-1) = p; } ///< set the root type parameter to the index type-1
+	RootTypeParameter* getRootTypeParameter(int type); ///< returns the i-th root parameter set (i=1..n) for modifications (the parameters are not shared anymore)
+	const RootTypeParameter* readRootTypeParameter(int type) const { return &rtparam->at(type-1); } ///< returns the i-th root parameter set (i=1..n), and keeps sharing it
 	void setRootSystemParameter(const RootSystemParameter& rsp) { rsparam = rsp; } ///< sets the root system parameters
 	RootSystemParameter* getRootSystemParameter() { return &rsparam; } ///< gets the root system parameters
+	void setParameterSet(const ParameterSet& ps) { rsparam = ps.rsparam; rtparam = ps.rtparam; } ///< sets plant and root type parameters (shared until modified)
+	bool hasSharedParameters() const { return rtparam.isShared(); } ///< true if the root type parameters are shared with other root systems
 
 	void openFile(std::string filename, std::string subdir="modelparameter/"); ///< reads root paramter and plant parameter
+	void loadParameters(std::string filename, std::string subdir="modelparameter/", std::string cache="");
+	///< sets the parameters of a file from the library of parsed parameter sets, @see ParameterSet::load
 	int readParameters(std::istream & cin); ///< reads root parameters from an input stream
 	void writeParameters(std::ostream & os) const; ///< writes root parameters
 
 	// Simulation
-	void setGeometry(SignedDistanceFunction* geom) { geometry = geom; } ///< optionally, sets a confining geometry (call before RootSystem::initialize())
+	void setGeometry(SignedDistanceFunction* geom, bool projection = false) { geometry = geom; geometryProjection = projection; }
+	///< optionally, sets a confining geometry (call before RootSystem::initialize()), @see Tropism::setGeometry
 	void setSoil(SoilLookUp* soil_) { soil = soil_; } ///< optionally sets a soil for hydro tropism (call before RootSystem::initialize())
 	void reset(); ///< resets the root class, keeps the root type parameters
 	void initialize(int basal=4, int shootborne=5); ///< creates the base roots, call before simulation and after setting the plant and root parameters
@@ -67,6 +82,15 @@ public:
 	void simulate(); ///< simulates root system growth for the time defined in the root system parameters
 	void simulate(double dt, double maxinc, ProportionalElongation* se, bool silence = false);
 	double getSimTime() const { return simtime; } ///< returns the current simulation time
+	int getNumberOfTimeSteps() const { return timeSteps.size(); } ///< number of calls of simulate(dt) since initialize()
+	double getTimeStep(int i) const { return timeSteps.at(i); } ///< time step of the i-th call of simulate(dt) [days]
+	void setParallelGrowth(bool parallel, int threads = 0) { parallelGrowth = parallel; this->threads = threads; }
+	///< opt-in: grows the lateral subtrees of the base roots as parallel tasks (threads<=0 uses all hardware threads)
+	void setElongationCandidates(int n, int threads = 0) { candidates = n; candidateThreads = threads; }
+	///< opt-in: simulate(dt, maxinc, se) simulates n scales in parallel per search step (n<=1 is the sequential bisection, threads<=0 uses all hardware threads)
+	void setReserveNodes(bool reserve) { reserveNodes = reserve; }
+	///< opt-in: new roots reserve memory for their expected number of nodes (RootParameter::getK()/dx, costs memory for roots that stop early)
+	const RootPool* getRootPool() const { return pool; } ///< the memory of the roots (@see RootPool)
 
 	// call back functions (todo simplify)
 	virtual Root* createRoot(int lt, Vector3d  h, double delay, Root* parent, double pbl, int pni);
@@ -79,9 +103,11 @@ public:
 	// Analysis of simulation results
 	int getNumberOfNodes() const { return nid+1; } ///< Number of nodes of the root system (including nodes for seed, root crowns, and artificial shoot)
 	int getNumberOfSegments() const { return nid-numberOfCrowns-1; } ///< Number of segments of the root system ((nid+1)-1) - numberOfCrowns - 1 (artificial shoot)
-	int getNumberOfRoots(bool all = false) const { if (all) return rid+1; else return getRoots().size(); }
-	std::vector<Root*> getRoots() const; ///< Represents the root system as sequential vector of roots and buffers the result
+	int getNumberOfRoots(bool all = false) const { if (all) return rid+1; updateRoots(); return roots.size(); }
+	std::vector<Root*> getRoots() const; ///< Roots with more than one node in the order of their ids
+	Root* getRoot(int id) const { return rootsById.at(id); } ///< The root with a unique id (including roots with a single node)
 	std::vector<Root*> getBaseRoots() const { return baseRoots; } ///< Base roots are tap root, basal roots, and shoot borne roots
+	const NodeStore& getNodeStore() const { return nodeStore; } ///< All nodes (indexed by node id) as contiguous arrays, valid until the next simulation step
 	std::vector<Vector3d> getNodes() const; ///< Copies all root system nodes into a vector
 	std::vector<std::vector<Vector3d>> getPolylines() const; ///< Copies the nodes of each root into a vector return all resulting vectors
 	std::vector<Vector2i> getSegments() const; ///< Copies all root system segment indices into a vector
@@ -90,44 +116,80 @@ public:
 	std::vector<double> getNETimes() const; ///< Copies all node emergence times into a vector
 	std::vector<std::vector<double>> getPolylinesNET() const; ///< Copies the node emergence times of each root into a vector and returns all resulting vectors
 	std::vector<double> getScalar(int stype=RootSystem::st_length) const; ///< Copies a scalar root parameter that is constant per root to a vector
+	static double getRootScalar(const Root* r, int stype); ///< A scalar root parameter of a single root @see RootSystem::getScalar
 	std::vector<int> getRootTips() const; ///< Node indices of the root tips
 	std::vector<int> getRootBases() const; ///< Node indices of the root bases
 
 	// Dynamic information what happened last time step
 	int getNumberOfNewNodes() const { return getNumberOfNodes()-old_non; } ///< The number of new nodes created in the previous time step (ame number as new segments)
-	int getNumberOfNewRoots() const { return getRoots().size() -old_nor; }  ///< The number of new roots created in the previous time step
+	int getNumberOfNewRoots() const { updateRoots(); return roots.size() -old_nor; }  ///< The number of new roots created in the previous time step
 	std::vector<int> getUpdatedNodeIndices() const; ///< Indices of nodes that were updated in the previous time step
 	std::vector<Vector3d> getUpdatedNodes() const; ///< Values of the updated nodes
 	std::vector<Vector3d> getNewNodes() const; ///< Nodes created in the previous time step
 	std::vector<int> getNewNodeIndices() const; ///< Node indices that were created in the previous time step
 	std::vector<Vector2i> getNewSegments() const; ///< Segments created in the previous time step
 	std::vector<Root*> getNewSegmentsOrigin() const; ///< Copies a pointer to the root containing the new segments
-	void push();
-	void pop();
+	StepDelta getStepDelta() const; ///< All changes of the previous time step, in O(number of changes)
+	double getLengthIncrement() const { return lengthIncrement; } ///< Summed length increase of all roots in the previous time step [cm]
+	void push(); ///< saves the current state of the simulation (@see RootSystemState)
+	void pop(); ///< restores the last saved state
+	void setJournaling(bool journaling);
+	///< opt-in: push() records roots, nodes, and random number generators on their first change, pop() undoes only these changes
+
+	// Checkpoints
+	void saveState(std::string name) const; ///< writes a binary checkpoint of the simulation, @see RootSystem::writeState
+	void loadState(std::string name); ///< restores a checkpoint written by saveState (the file is memory mapped, if possible)
+	void writeState(std::ostream & os) const; ///< writes a binary checkpoint of the simulation (@see CheckpointWriter)
+	void readState(const char* data, size_t size); ///< restores a checkpoint from a buffer (e.g. a memory mapped file)
 
 	// Output Simulation results
-	void write(std::string name) const; /// writes simulation results (type is determined from file extension in name)
+	void write(std::string name, int encoding = 0, bool compress = false) const;
+	///< writes simulation results (type is determined from file extension in name, encoding and compress are used for VTP, @see VTPWriter)
 	void writeRSML(std::ostream & os) const; ///< writes current simulation results as RSML
 	void writeVTP(std::ostream & os) const; ///< writes current simulation results as VTP (VTK polydata file)
+	void writeVTP(std::ostream & os, int encoding, bool compress = false) const; ///< writes current simulation results as VTP (binary appended data, @see VTPWriter)
 	void writeGeometry(std::ostream & os) const; ///< writes the current confining geometry (e.g. a plant container) as paraview python script
+	void setOutputTolerance(double tolerance) { outputTolerance = tolerance; }
+	///< writeVTP and writeRSML write simplified polylines, removed nodes are within tolerance [cm] of the polylines (0 writes all nodes, @see Root::getSimplifiedNodes)
+	double getOutputTolerance() const { return outputTolerance; } ///< tolerance of the written polylines [cm]
 
 	std::string toString() const; ///< infos about current root system state (for debugging)
 
+	// Profiling (build with CROOTBOX_PROFILE)
+	ProfileCounters getProfile(int type = -1) const;
+	///< instrumentation counters of a root type, of the root system level (type 0), or summed over all (type -1), @see ProfileCounters
+	void resetProfile(); ///< sets all instrumentation counters to zero (e.g. before simulate(dt) to profile a single step)
+#ifdef CROOTBOX_PROFILE
+	ProfileCounters* getProfileCounters(int type) const { return &profile.at(type); } ///< counters updated by the instrumentation (type 0 for the root system level)
+#else
+	ProfileCounters* getProfileCounters(int type) const { return nullptr; } ///< no counters without instrumentation
+#endif
+
 	// random stuff
 	void setSeed(unsigned int seed); ///< help fate (sets the seed of all random generators)
-	double rand() { return UD(gen); } ///< Uniformly distributed random number (0,1)
-	double randn() { return ND(gen); } ///< Normally distributed random number (0,1)
+	double rand(); ///< Uniformly distributed random number (0,1)
+	double randn(); ///< Normally distributed random number (0,1)
+	void setRandomStreams(bool streams) { randomStreams = streams; }
+	///< draws the random numbers of each root from counter based streams, the plants do not depend on the order of growth (call before initialize())
+	bool hasRandomStreams() const { return randomStreams; } ///< true if counter based random streams are used
+	RandomStream getRandomStream(const Root* r, int purpose, uint64_t index) const;
+	///< stream of a root for a purpose (@see RandomStream::Purpose), or an inactive stream if random streams are not used
 
 private:
 
 	const int rsmlReduction = 5; ///< only each n-th node is written to the rsml file (to coarsely adjust axial resolution for output)
+	double outputTolerance = 0.; ///< tolerance of the written polylines [cm], 0 for all nodes (@see RootSystem::setOutputTolerance)
 
 	RootSystemParameter rsparam; ///< Plant parameter
-	std::vector<RootTypeParameter> rtparam; ///< Parameter set for each root type
+	CopyOnWrite<std::vector<RootTypeParameter>> rtparam; ///< Parameter set for each root type (shared by copies until modified)
+	std::vector<RandomGenerator> rtrandom; ///< Random numbers of the roots of each root type (per root system, @see RootSystem::getRandomGenerator)
 	std::vector<Root*> baseRoots;  ///< Base roots of the root system
 	std::vector<GrowthFunction*> gf; ///< Growth function per root type
 	std::vector<Tropism*> tf;  ///< Tropism per root type
+	RootPool* pool; ///< Memory of the roots, @see RootSystem::createRoot
+	bool reserveNodes = false; ///< new roots reserve their expected number of nodes
 	SignedDistanceFunction* geometry = new SignedDistanceFunction(); ///< Confining geometry (unconfined by default)
+	bool geometryProjection = false; ///< tropisms correct headings leaving the geometry by projection
 	SoilLookUp* soil = nullptr; ///< callback for hydro, or chemo tropism (needs to set before initialize()) TODO should be a part of tf, or rtparam
 
 	double simtime = 0;
@@ -136,21 +198,73 @@ private:
 
 	int old_non=0;
 	int old_nor=0;
-	mutable std::vector<Root*> roots = std::vector<Root*>(); // buffer for getRoots()
+	mutable std::vector<Root*> roots = std::vector<Root*>(); // roots with more than one node, sorted by id up to sortedRoots (@see RootSystem::getRoots)
+	mutable size_t sortedRoots = 0; // the remaining roots emerged since the last call of updateRoots()
+	std::vector<Root*> rootsById; // all roots indexed by their id, updated by getRootIndex(Root*) and GrowthTask::renumber
+	NodeStore nodeStore; // all nodes indexed by node id, updated by Root::addNode() and RootSystem::moveNode()
+	int deltaFirstNode = 0; // number of nodes at the start of the time step
+	std::vector<int> deltaMovedNodes; // existing nodes that were moved during the time step (might contain duplicates)
+	std::vector<Root*> deltaNewRoots; // roots created during the time step
+	double lengthIncrement = 0; // summed length increase of all roots during the time step
+	std::vector<int> grownRoots; // ids of the roots that called createSegments during the time step (sorted after the step)
+	std::vector<double> timeSteps; // time steps of all calls of simulate(dt), replayed for skipped subtrees (@see Root::getCurrentAge)
 
 	const int maxtypes = 100;
+#ifdef CROOTBOX_PROFILE
+	mutable std::vector<ProfileCounters> profile = std::vector<ProfileCounters>(maxtypes+1); // per root type, index 0 for the root system level
+#endif
 
 	int numberOfCrowns = 0;
 
 	bool manualSeed = false;
 
 	void initRTP(); // default values for rtparam vector
+	void initRandomGenerators(); // one generator per root type
+	RandomGenerator& getRandomGenerator(int type); ///< generator of the random root parameters of a root type (called by Root)
 
 	void writeRSMLMeta(std::ostream & os) const;
 	void writeRSMLPlant(std::ostream & os) const;
 
-	int getRootIndex() { rid++; return rid; } ///< returns next unique root id, called by the constructor of Root
-	int getNodeIndex() { nid++; return nid; } ///< returns next unique node id, called by Root::addNode()
+	int getRootIndex() { rid++; return rid; } ///< returns next unique root id
+	int getNodeIndex() { nid++; return nid; } ///< returns next unique node id
+	int getRootIndex(Root* r); ///< returns next unique root id, called by the constructor of Root
+	int getNodeIndex(Root* r); ///< returns next unique node id of the last node of r, called by Root::addNode()
+	void moveNode(Root* r, int i); ///< updates the node store after node i of root r was moved (called by Root::createSegments)
+	void setBranchingNode(Root* r); ///< uses the lateral's copy of its first node in the node store (called when r emerges)
+	void discardState(); ///< removes the last pushed state without restoring it
+	void setTopState(); ///< sets the journal and epoch of the state on top of the stack
+	void journalRoot(Root* r); ///< records root r before its first change after push() (called by Root::simulate)
+	void journalNode(int i); ///< records node i of the node store before it is changed
+	void rebuildNodeStore(); ///< recreates the node store from the root tree (e.g. after RootSystem::pop)
+	void rebuildRootIndex(); ///< recreates rootsById and roots from the root tree (e.g. after copying, or reading a checkpoint)
+	void updateRoots() const; ///< merges the roots that emerged since the last call into the sorted roots
+	std::vector<int> getSegmentEnds() const; ///< end node ids of the segments in the order of RootSystem::getSegments
+	Tropism* getTropism(int type); ///< returns the tropism of the root type (i=1..n)
+	void addLengthIncrement(double dl); ///< adds the length increase of a root (called by Root::simulate)
+	void addGrownRoot(Root* r); ///< notes a root that grew in this time step (called by Root::simulate)
+	bool skipQuiescent(Root* r); ///< true if the subtree of r is quiescent, it is not simulated anymore
+
+	void readState(CheckpointReader& cr); ///< restores a checkpoint
+	void writeRoot(CheckpointWriter& cw, const Root* r) const; ///< writes the root tree r (called by writeState)
+	Root* readRoot(CheckpointReader& cr, Root* parent); ///< reads a root tree (called by readState)
+
+	void simulateLateral(Root* lateral, double dt, bool silence); ///< simulates a lateral, or defers it as growth task (called by Root)
+	void simulateTasks(bool silence); ///< simulates the deferred growth tasks in parallel, and renumbers the nodes and roots they created
+
+	bool parallelGrowth = false; // grow lateral subtrees of the base roots as parallel tasks
+	int threads = 0; // number of threads for the growth tasks
+	std::vector<std::pair<Root*, double>> pendingTasks; // deferred laterals and their time steps
+	static thread_local GrowthTask* task; // the growth task executed by the current thread (or nullptr)
+
+	void simulateCandidates(double dt, double maxinc, ProportionalElongation* se, double accuracy, int maxiter, bool silence);
+	///< parallel search for the scale of se (called by simulate(dt, maxinc, se))
+	void swapState(RootSystem& rs); ///< exchanges roots, tropisms, growth functions, and the simulation state with a copy of this root system
+
+	int candidates = 1; // number of scales simulated in parallel by simulate(dt, maxinc, se)
+	int candidateThreads = 0; // number of threads for the candidates
+
+	bool randomStreams = false; // counter based random streams per root (@see RootSystem::setRandomStreams)
+	unsigned int randomSeed = std::chrono::system_clock::now().time_since_epoch().count(); // seed of the random streams
 
 	std::mt19937 gen;
 	std::uniform_real_distribution<double> UD;
@@ -158,6 +272,13 @@ private:
 	std::normal_distribution<double> ND;
 
 	std::stack<RootSystemState> stateStack = std::stack<RootSystemState>();
+	bool journaling = false; // push() creates journaled states
+	RootSystemState* journal = nullptr; // the journaled state on top of the stack (or nullptr)
+	unsigned int epoch = 0; // epoch of the journaled state on top of the stack (0 if none)
+	unsigned int epochs = 0; // last used epoch
+	std::vector<unsigned int> rtparamEpochs; // epoch of the last record of each root type parameter
+	std::vector<unsigned int> rtrandomEpochs; // epoch of the last record of each generator of a root type
+	std::vector<unsigned int> tfEpochs; // epoch of the last record of each tropism
 
 };
 
@@ -167,6 +288,10 @@ private:
  * Sores a state of the RootSystem,
  * i.e. all data that changes over time (*), i.e. excluding node data that cannot change
  *
+ * A journaled state copies only the counters and generators of the root system. Roots, nodes,
+ * root type parameters, and tropisms are recorded before their first change (@see RootSystem::setJournaling),
+ * and restored in reverse order. Growth functions are assumed to have no state.
+ *
  * (*) excluding changes regarding RootSystemParameter, any RootTypeParameter, confining geometry, and soil
  */
 class RootSystemState
@@ -176,18 +301,36 @@ class RootSystemState
 
 public:
 
-	RootSystemState(const RootSystem& rs);
+	RootSystemState() : journaled(true) { } ///< empty journal (e.g. of a growth task)
+	RootSystemState(const RootSystem& rs, bool journaled = false);
 
 	void restore(RootSystem& rs);
+	void discard(); ///< deletes the copies of tropisms and growth functions, instead of restoring them
+
+	void addRoot(Root* r); ///< records root r (without its laterals)
+	void addNode(int i, const Vector3d& n, double t) { nodeIds.push_back(i); nodes.push_back(n); nodeTimes.push_back(t); } ///< records node i
+	void append(RootSystemState& s); ///< takes over the records of a later journaled state s
 
 private:
 
+	bool journaled = false;
+	unsigned int epoch = 0; // identifies the journaled state
+	int non = 0; // number of nodes in the node store
+	std::deque<std::pair<Root*, RootState>> roots; // recorded roots, in order of their first change
+	std::vector<int> nodeIds; // recorded nodes of the node store
+	std::vector<Vector3d> nodes;
+	std::vector<double> nodeTimes;
+	std::vector<std::pair<int, RootTypeParameter>> rtparams; // recorded root type parameters (index and copy)
+	std::vector<std::pair<int, RandomGenerator>> rtrandoms; // recorded generators of the root types (index and copy)
+	std::vector<std::pair<int, Tropism*>> tfs; // recorded tropisms (index and copy)
+
 	std::vector<RootState> baseRoots;  ///< Base roots of the root system
 
 	// copy because of random generator seeds
 	std::vector<Tropism*> tf;
 	std::vector<GrowthFunction*> gf;
-	std::vector<RootTypeParameter> rtparam;
+	CopyOnWrite<std::vector<RootTypeParameter>> rtparam; // shared with the root system, unless it was modified
+	std::vector<RandomGenerator> rtrandom;
 
 	double simtime = 0;
 	int rid = -1; // unique root id counter
@@ -196,6 +339,12 @@ private:
 	int old_nor=0;
 	int numberOfCrowns = 0;
 	bool manualSeed = false;
+	int deltaFirstNode = 0;
+	std::vector<int> deltaMovedNodes;
+	std::vector<Root*> deltaNewRoots;
+	double lengthIncrement = 0;
+	std::vector<int> grownRoots;
+	size_t numberOfTimeSteps = 0;
 
 	mutable std::mt19937 gen;
 	mutable std::uniform_real_distribution<double> UD;
@@ -205,4 +354,53 @@ private:
 
 
 
+/**
+ * Lateral subtrees of a base root, that are simulated independently of all other tasks (@see RootSystem::setParallelGrowth)
+ *
+ * Each task has its own random number generator, and lazy copies of the tropisms and generators of the root types it uses,
+ * all seeded from the task seed, which is drawn from the generator of the root system in task order. Nodes and roots created within the task
+ * obtain their unique ids after all tasks have finished.
+ */
+class GrowthTask
+{
+
+	friend RootSystem;
+
+public:
+
+	GrowthTask(RootSystem* rs, unsigned int seed);
+	GrowthTask(const GrowthTask& t) = delete;
+	virtual ~GrowthTask();
+
+	void addLateral(Root* lateral, double dt) { laterals.push_back(std::make_pair(lateral, dt)); } ///< adds a lateral that is simulated for time span dt
+	void simulate(bool silence); ///< simulates the subtrees within the current thread
+	void renumber(); ///< sets the unique node and root ids (call sequentially in task order)
+	unsigned int getSeed(int i) const { return uint32_t(RandomStream::hash(seed, i)); }
+	///< seed of the i-th lazy copy, independent of the order of their first use (e.g. if quiescent subtrees are skipped)
+
+private:
+
+	RootSystem* rs;
+	unsigned int seed; // seed of the task (drawn in task order)
+	std::vector<std::pair<Root*, double>> laterals; // laterals of a single base root and their time steps
+
+	std::vector<Tropism*> tf; // lazy copies, nullptr if unused
+	std::vector<RandomGenerator*> rtrandom; // lazy copies of the generators of the root types, nullptr if unused
+
+	std::vector<std::pair<Root*,int>> nodes; // created nodes (root and node index) in order of creation
+	std::vector<Root*> roots; // created roots in order of creation
+	std::vector<Root*> grownRoots; // roots that grew (ids are assigned by renumber)
+	std::vector<int> movedNodes; // existing nodes that were moved
+	double lengthIncrement = 0; // summed length increase of the roots of the task
+	RootSystemState journal; // roots and nodes recorded by the task (@see RootSystem::setJournaling)
+
+	std::mt19937 gen;
+	std::uniform_real_distribution<double> UD;
+	std::uniform_int_distribution<unsigned int> UID;
+	std::normal_distribution<double> ND;
+
+};
+
+
+
 #endif /* ROOTSYSTEM_H_ */
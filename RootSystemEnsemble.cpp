@@ -0,0 +1,234 @@
+#include "RootSystemEnsemble.h"
+#include "parallel.h"
+
+/**
+ * Destructor, deletes all plants
+ */
+RootSystemEnsemble::~RootSystemEnsemble()
+{
+	reset();
+}
+
+/**
+ * Deletes all plants, keeps parameters and positions
+ */
+void RootSystemEnsemble::reset()
+{
+	for (auto p : plants) {
+		delete p;
+	}
+	plants.clear();
+	simtime = 0;
+}
+
+/**
+ * Places nx*ny plants on a regular grid starting at (0,0,-depth), the x-index runs fastest
+ *
+ * @param nx        number of plants along the x-axis
+ * @param ny        number of plants along the y-axis
+ * @param dx        distance between the plants along the x-axis [cm]
+ * @param dy        distance between the plants along the y-axis [cm]
+ * @param depth     planting depth [cm]
+ */
+void RootSystemEnsemble::setGrid(int nx, int ny, double dx, double dy, double depth)
+{
+	positions.clear();
+	for (int j=0; j<ny; j++) {
+		for (int i=0; i<nx; i++) {
+			positions.push_back(Vector3d(i*dx, j*dy, -depth));
+		}
+	}
+}
+
+/**
+ * Creates one plant per position, copies the parameters, and initializes the plants.
+ *
+ * The seeds of the plants are drawn in plant order from a generator seeded with the ensemble seed
+ * (or the system clock, if no seed was set).
+ *
+ * @param basal         basal root type, @see RootSystem::initialize
+ * @param shootborne    shoot borne root type, @see RootSystem::initialize
+ */
+void RootSystemEnsemble::initialize(int basal, int shootborne)
+{
+	reset();
+	if (positions.empty()) {
+		throw std::invalid_argument("RootSystemEnsemble::initialize() no plant positions were set");
+	}
+	unsigned int s = seed;
+	if (!manualSeed) {
+		s = std::chrono::system_clock::now().time_since_epoch().count();
+	}
+	std::mt19937 gen(s);
+	std::uniform_int_distribution<unsigned int> UID;
+	for (const auto& pos : positions) { // serial, to keep the seeds in plant order
+		RootSystem* rs = new RootSystem(prototype);
+		rs->getRootSystemParameter()->seedPos = pos;
+		if (geometry!=nullptr) {
+			rs->setGeometry(geometry, geometryProjection);
+		}
+		if (soil!=nullptr) { // otherwise the soil of the prototype is kept
+			rs->setSoil(soil);
+		}
+		rs->setSeed(UID(gen));
+		plants.push_back(rs);
+	}
+	parallelFor(plants.size(), threads, [&](size_t i) {
+		plants[i]->initialize(basal, shootborne);
+	});
+}
+
+/**
+ * Simulates all plants for time span dt, each plant is simulated by a single thread
+ *
+ * @param dt        time step [days]
+ * @param silence   indicates if status is written to the console (cout) (default = false)
+ */
+void RootSystemEnsemble::simulate(double dt, bool silence)
+{
+	if (!silence) {
+		std::cout << "RootSystemEnsemble.simulate(dt) " << plants.size() << " plants from "<< simtime << " to " << simtime+dt << " days \n";
+	}
+	parallelFor(plants.size(), threads, [&](size_t i) {
+		plants[i]->simulate(dt, true);
+	});
+	simtime += dt;
+}
+
+/**
+ * Simulates all plants for the time span defined in the parameter set
+ */
+void RootSystemEnsemble::simulate()
+{
+	this->simulate(prototype.getRootSystemParameter()->simtime);
+}
+
+/**
+ * Summed number of nodes of all plants
+ */
+int RootSystemEnsemble::getNumberOfNodes() const
+{
+	int n = 0;
+	for (auto p : plants) {
+		n += p->getNumberOfNodes();
+	}
+	return n;
+}
+
+/**
+ * Summed number of segments of all plants
+ */
+int RootSystemEnsemble::getNumberOfSegments() const
+{
+	int n = 0;
+	for (auto p : plants) {
+		n += p->getNumberOfSegments();
+	}
+	return n;
+}
+
+/**
+ * Merges the segments of all plants (in plant order) into a single analyser
+ */
+SegmentAnalyser RootSystemEnsemble::getSegmentAnalyser() const
+{
+	SegmentAnalyser a;
+	for (auto p : plants) {
+		a.addSegments(*p);
+	}
+	return a;
+}
+
+/**
+ * The distribution of the segments of a single analyser
+ *
+ * @param a         the segments (e.g. of one plant)
+ */
+std::vector<double> EnsembleDistribution::evaluate(const SegmentAnalyser& a) const
+{
+	if (m<=0) {
+		return a.distribution(st, top, bot, n, exact);
+	}
+	std::vector<std::vector<double>> d = a.distribution2(st, top, bot, left, right, n, m, exact);
+	std::vector<double> v;
+	v.reserve(size());
+	for (const auto& row : d) {
+		v.insert(v.end(), row.begin(), row.end());
+	}
+	return v;
+}
+
+/**
+ * Monte Carlo study: simulates replicates of the parameter set (at the seed position of the parameters, with the geometry
+ * and soil of the ensemble), and folds the distributions of each plant into streaming statistics (mean, variance, and quantiles).
+ * Each plant is deleted right after its distributions are computed, the plants of the ensemble are not changed.
+ *
+ * The replicates are simulated in parallel in blocks, and their distributions are added in replicate order,
+ * therefore the results only depend on the ensemble seed, and not on the number of threads.
+ *
+ * @param replicates        number of plants
+ * @param simtime           simulation time of each plant [days]
+ * @param distributions     the distributions computed per plant
+ * @param probabilities     probabilities of the quantiles
+ *
+ * \return the statistics per distribution
+ */
+std::vector<EnsembleStatistics> RootSystemEnsemble::reduce(int replicates, double simtime, const std::vector<EnsembleDistribution>& distributions,
+	const std::vector<double>& probabilities) const
+{
+	std::vector<EnsembleStatistics> stats;
+	for (const auto& d : distributions) {
+		stats.push_back(EnsembleStatistics(d.size(), probabilities));
+	}
+	unsigned int s = seed;
+	if (!manualSeed) {
+		s = std::chrono::system_clock::now().time_since_epoch().count();
+	}
+	std::mt19937 gen(s);
+	std::uniform_int_distribution<unsigned int> UID;
+	std::vector<unsigned int> seeds(std::max(replicates, 0));
+	for (auto& x : seeds) { // in replicate order, like RootSystemEnsemble::initialize
+		x = UID(gen);
+	}
+	size_t bs = 4*::getNumberOfThreads(threads); // plants per block
+	for (size_t b0=0; b0<seeds.size(); b0+=bs) {
+		size_t nb = std::min(bs, seeds.size()-b0);
+		std::vector<RootSystem*> block(nb);
+		for (size_t i=0; i<nb; i++) { // copies are made serially (the prototype is shared)
+			block[i] = new RootSystem(prototype);
+			if (geometry!=nullptr) {
+				block[i]->setGeometry(geometry, geometryProjection);
+			}
+			if (soil!=nullptr) {
+				block[i]->setSoil(soil);
+			}
+			block[i]->setSeed(seeds[b0+i]);
+		}
+		std::vector<std::vector<std::vector<double>>> values(nb);
+		try {
+			parallelFor(nb, threads, [&](size_t i) {
+				block[i]->initialize();
+				block[i]->simulate(simtime, true);
+				{
+					SegmentAnalyser a(*block[i]);
+					for (const auto& d : distributions) {
+						values[i].push_back(d.evaluate(a));
+					}
+				}
+				delete block[i];
+				block[i] = nullptr;
+			});
+		} catch (...) {
+			for (auto p : block) {
+				delete p;
+			}
+			throw;
+		}
+		for (size_t i=0; i<nb; i++) {
+			for (size_t j=0; j<stats.size(); j++) {
+				stats[j].add(values[i][j]);
+			}
+		}
+	}
+	return stats;
+}
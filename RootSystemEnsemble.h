@@ -0,0 +1,114 @@
+#ifndef ROOTSYSTEMENSEMBLE_H_
+#define ROOTSYSTEMENSEMBLE_H_
+
+#include <vector>
+#include <random>
+
+#include "RootSystem.h"
+#include "analysis.h"
+#include "statistics.h"
+
+/**
+ * EnsembleDistribution
+ *
+ * A distribution of a parameter that is computed per plant, either vertical (@see SegmentAnalyser::distribution),
+ * or two dimensional in the x-z plane (@see SegmentAnalyser::distribution2, cells in row major order, i.e. index i*m+j)
+ */
+class EnsembleDistribution
+{
+
+public:
+
+	EnsembleDistribution(int st, double top, double bot, int n, bool exact = false)
+		: st(st), top(top), bot(bot), n(n), exact(exact) { } ///< vertical distribution of n layers
+	EnsembleDistribution(int st, double top, double bot, double left, double right, int n, int m, bool exact = false)
+		: st(st), top(top), bot(bot), left(left), right(right), n(n), m(m), exact(exact) { } ///< 2d distribution of n layers times m columns
+
+	size_t size() const { return (m>0) ? size_t(n)*m : size_t(n); } ///< number of cells
+	std::vector<double> evaluate(const SegmentAnalyser& a) const; ///< the distribution of the segments of a
+
+	int st; ///< parameter type @see RootSystem::ScalarType
+	double top; ///< vertical top position [cm]
+	double bot; ///< vertical bottom position [cm]
+	double left = 0.; ///< left position in x-direction [cm] (only 2d)
+	double right = 0.; ///< right position in x-direction [cm] (only 2d)
+	int n; ///< number of layers
+	int m = 0; ///< number of columns in x-direction (0 for vertical distributions)
+	bool exact; ///< cut the segments at the cell boundaries (@see SegmentAnalyser::distribution)
+
+};
+
+inline bool operator==(const EnsembleDistribution& lhs, const EnsembleDistribution& rhs){ return (&lhs==&rhs); } // only address wise, needed for boost python indexing suite
+inline bool operator!=(const EnsembleDistribution& lhs, const EnsembleDistribution& rhs){ return !(lhs == rhs); }
+
+/**
+ * RootSystemEnsemble
+ *
+ * Manages multiple plants (e.g. a field plot) sharing the same parameter set,
+ * and simulates them in parallel (each RootSystem owns its random number generators, tropisms, and growth functions).
+ *
+ * The seed of each plant is derived from the ensemble seed in plant order,
+ * therefore results only depend on the seed, and not on the number of threads.
+ *
+ * Note that soil look ups and geometries are shared by all plants, they must be thread safe
+ * (i.e. use a single thread for SoilLookUp classes implemented in Python)
+ */
+class RootSystemEnsemble
+{
+
+public:
+
+	RootSystemEnsemble(int threads = 0) : threads(threads) { } ///< threads<=0 uses all hardware threads
+	RootSystemEnsemble(const RootSystemEnsemble& e) = delete;
+	virtual ~RootSystemEnsemble();
+
+	// Parameter input
+	void openFile(std::string name, std::string subdir="modelparameter/") { prototype.openFile(name, subdir); } ///< reads root and plant parameters of all plants
+	RootSystem* getParameters() { return &prototype; } ///< the (not simulated) root system holding the parameters that are copied to each plant
+	void setPositions(const std::vector<Vector3d>& seedPos) { positions = seedPos; } ///< one plant is created per seed position [cm]
+	void setGrid(int nx, int ny, double dx, double dy, double depth); ///< places nx*ny plants on a regular grid
+
+	// Simulation
+	void setGeometry(SignedDistanceFunction* geom, bool projection = false) { geometry = geom; geometryProjection = projection; }
+	///< optionally, sets a confining geometry for all plants (call before initialize()), @see RootSystem::setGeometry
+	void setSoil(SoilLookUp* soil_) { soil = soil_; } ///< optionally sets a soil for hydro tropism (call before initialize()), replacing the soil of the prototype
+	void setSeed(unsigned int seed) { this->seed = seed; manualSeed = true; } ///< sets the ensemble seed (call before initialize())
+	void setNumberOfThreads(int threads) { this->threads = threads; } ///< threads<=0 uses all hardware threads
+	int getNumberOfThreads() const { return threads; } ///< number of threads, <=0 means all hardware threads
+	void initialize(int basal=4, int shootborne=5); ///< creates the plants, call after setting positions and parameters
+	void simulate(double dt, bool silence = false); ///< simulates all plants for time span dt
+	void simulate(); ///< simulates all plants for the time defined in the root system parameters
+	double getSimTime() const { return simtime; } ///< returns the current simulation time
+	void reset(); ///< deletes all plants
+
+	// Results
+	int getNumberOfPlants() const { return plants.size(); } ///< number of plants
+	RootSystem* getPlant(int i) const { return plants.at(i); } ///< the i-th plant (owned by the ensemble)
+	std::vector<RootSystem*> getPlants() const { return plants; } ///< all plants (owned by the ensemble)
+	int getNumberOfNodes() const; ///< summed number of nodes of all plants
+	int getNumberOfSegments() const; ///< summed number of segments of all plants
+	SegmentAnalyser getSegmentAnalyser() const; ///< the segments of all plants merged into a single analyser
+
+	// Monte Carlo studies
+	std::vector<EnsembleStatistics> reduce(int replicates, double simtime, const std::vector<EnsembleDistribution>& distributions,
+		const std::vector<double>& probabilities = { 0.05, 0.5, 0.95 }) const;
+	///< simulates replicates of the parameter set, and returns the statistics of the distributions without keeping the plants
+
+private:
+
+	RootSystem prototype; ///< holds the parameters
+	std::vector<Vector3d> positions; ///< seed position per plant
+	std::vector<RootSystem*> plants; ///< the simulated plants
+
+	SignedDistanceFunction* geometry = nullptr;
+	bool geometryProjection = false;
+	SoilLookUp* soil = nullptr;
+
+	int threads = 0;
+	double simtime = 0;
+	unsigned int seed = 0;
+	bool manualSeed = false;
+
+};
+
+#endif
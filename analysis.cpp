@@ -1,6 +1,17 @@
 #include "analysis.h"
+#include "vtp.h"
+#include "polyline.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+
+/*
+ * Moves, or converts the data into the storage types of the analyser (@see StoredReal)
+ */
+template<class T>
+static void store(std::vector<T>& a, std::vector<T>&& b) { a = std::move(b); }
+template<class T, class S>
+static void store(std::vector<T>& a, const std::vector<S>& b) { a.assign(b.begin(), b.end()); }
 
 /**
  * Copies the segments of the roots system into the analysis class
@@ -9,10 +20,14 @@
  */
 SegmentAnalyser::SegmentAnalyser(const RootSystem& rs)
 {
-	nodes = rs.getNodes();
+	store(nodes, rs.getNodes());
 	segments = rs.getSegments();
-	ctimes = rs.getNETimes();
-	segO = rs.getSegmentsOrigin();
+	store(ctimes, rs.getNETimes());
+	origins = rs.getRoots(); // in the order of RootSystem::getSegments
+	segO.reserve(segments.size());
+	for (size_t j=0; j<origins.size(); j++) {
+		segO.insert(segO.end(), origins[j]->getNumberOfNodes()-1, int(j));
+	}
 	assert(segments.size()==ctimes.size());
 	assert(segments.size()==segO.size());
 	this->rs = &rs; // needed for dgf writer, only
@@ -40,7 +55,19 @@ void SegmentAnalyser::addSegments(const SegmentAnalyser& a)
 	}
 	segments.insert(segments.end(),ns.begin(),ns.end()); // copy segments
 	ctimes.insert(ctimes.end(),a.ctimes.begin(),a.ctimes.end()); // copy times
-	segO.insert(segO.end(),a.segO.begin(),a.segO.end());// copy origins
+	int ro = origins.size();
+	for (int j : a.segO) { // copy origins, shift indices
+		segO.push_back(j+ro);
+	}
+	origins.insert(origins.end(),a.origins.begin(),a.origins.end());
+	if (!lengthScale.empty() || !a.lengthScale.empty()) { // copy length scales
+		lengthScale.resize(segments.size()-a.segments.size(), 1.);
+		if (a.lengthScale.empty()) {
+			lengthScale.resize(segments.size(), 1.);
+		} else {
+			lengthScale.insert(lengthScale.end(),a.lengthScale.begin(),a.lengthScale.end());
+		}
+	}
 	assert(segments.size()==ctimes.size());
 	assert(segments.size()==segO.size());
 }
@@ -56,7 +83,7 @@ std::vector<double> SegmentAnalyser::getScalar(int st) const
 	std::vector<double> data(segO.size());
 
 	if (st==RootSystem::st_time) {
-		data = ctimes;
+		data.assign(ctimes.begin(), ctimes.end());
 		return data;
 	}
 	if (st==RootSystem::st_userdata1) {
@@ -72,63 +99,91 @@ std::vector<double> SegmentAnalyser::getScalar(int st) const
 		return data;
 	}
 
-	double v = 0; // value
 	for (size_t i=0; i<segO.size(); i++) {
-		const auto& r = segO.at(i);
-		switch (st) {
-		case RootSystem::st_type:
-			v=r->param.type;
-			break;
-		case RootSystem::st_radius:
-			v=r->param.a;
-			break;
-		case RootSystem::st_order: {
-			Root* r_ = r;
-			while (r_->parent!=nullptr) { // find root order
-				v++;
-				r_=r_->parent;
-			}
-		}
-		break;
-		case RootSystem::st_length: { // compute segment length
-			v = getSegmentLength(i);
-		}
-		break;
-		case RootSystem::st_surface: { // compute segment surface
-			v = getSegmentLength(i)*2*M_PI*r->param.a;
-		}
-		break;
-		case RootSystem::st_volume: {
-			v =  getSegmentLength(i)*M_PI*(r->param.a)*(r->param.a);
-		}
-		break;
-		case RootSystem::st_one: { // e.g. for counting segments
-			v = 1;
-		}
-		break;
-		case RootSystem::st_parenttype: {
-			if (r->parent!=nullptr) {
-				v = r->parent->param.type;
-			} else {
-				v = 0;
-			}
-			break;
+		data.at(i) = getScalar(st, i, getDistance(i));
+	}
+	return data;
+}
+
+/**
+ * Returns a specific parameter of a single root segment
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param i         segment index
+ * @param length    segment length [cm] used for st_length, st_surface, and st_volume (e.g. of a cropped segment),
+ *                  it is scaled by the length scale of simplified segments (@see SegmentAnalyser::simplify)
+ * \return          parameter value of the segment
+ */
+double SegmentAnalyser::getScalar(int st, int i, double length) const
+{
+	Root* r = getOrigin(i);
+	if (!lengthScale.empty()) {
+		length *= lengthScale.at(i);
+	}
+	switch (st) {
+	case RootSystem::st_time:
+		return ctimes.at(i);
+	case RootSystem::st_userdata1:
+		return userData.at(0).at(i);
+	case RootSystem::st_userdata2:
+		return userData.at(1).at(i);
+	case RootSystem::st_userdata3:
+		return userData.at(2).at(i);
+	case RootSystem::st_type:
+		return r->param.type;
+	case RootSystem::st_radius:
+		return r->param.a;
+	case RootSystem::st_order: {
+		double v = 0;
+		Root* r_ = r;
+		while (r_->parent!=nullptr) { // find root order
+			v++;
+			r_=r_->parent;
 		}
-		default:
-			throw std::invalid_argument( "SegmentAnalyser::getScalar: Type not implemented" );
+		return v;
+	}
+	case RootSystem::st_length: // segment length
+		return length;
+	case RootSystem::st_surface: // segment surface
+		return length*2*M_PI*r->param.a;
+	case RootSystem::st_volume:
+		return length*M_PI*(r->param.a)*(r->param.a);
+	case RootSystem::st_one: // e.g. for counting segments
+		return 1;
+	case RootSystem::st_parenttype:
+		if (r->parent!=nullptr) {
+			return r->parent->param.type;
+		} else {
+			return 0;
 		}
-		data.at(i) = v;
+	default:
+		throw std::invalid_argument( "SegmentAnalyser::getScalar: Type not implemented" );
 	}
-	return data;
 }
 
 /**
- * Returns the length of a segment
+ * Returns the length of a segment, i.e. the length of the root represented by the segment
+ * (that is larger than the distance of its nodes, if the segment was simplified, @see SegmentAnalyser::simplify)
  *
  * @param i 	index of the segment
  * \return 		the length of segment i
  */
 double SegmentAnalyser::getSegmentLength(int i) const
+{
+	double l = getDistance(i);
+	if (!lengthScale.empty()) {
+		l *= lengthScale.at(i);
+	}
+	return l;
+}
+
+/**
+ * Returns the distance of the two nodes of a segment
+ *
+ * @param i 	index of the segment
+ * \return 		the distance of the nodes of segment i
+ */
+double SegmentAnalyser::getDistance(int i) const
 {
 	Vector2i s = segments.at(i);
 	Vector3d x = nodes.at(s.x);
@@ -137,28 +192,64 @@ double SegmentAnalyser::getSegmentLength(int i) const
 }
 
 /**
- * Crops the segments with some geometry
+ * Crops the segments with some geometry, segments crossing the geometry with both nodes outside are clipped
+ * as well (exactly for convex geometries, @see SegmentAnalyser::findInside)
  *
  * @param geometry      signed distance function of the geometry
  */
 void SegmentAnalyser::crop(SignedDistanceFunction* geometry)
 {
 	//std::cout << "cropping " << segments.size() << " segments...";
+	std::vector<signed char> status; // segments inside (1), outside (-1), or unknown (0)
+	classify(geometry, status);
+	// evaluate the geometry for all nodes of unknown segments at once
+	std::vector<int> ni(nodes.size(), -1); // index into pts
+	std::vector<Vector3d> pts;
+	for (size_t i=0; i<segments.size(); i++) {
+		if (status[i]==0) {
+			for (int j : { segments[i].x, segments[i].y }) {
+				if (ni.at(j)<0) {
+					ni[j] = pts.size();
+					pts.push_back(nodes[j]);
+				}
+			}
+		}
+	}
+	std::vector<double> dist;
+	geometry->getDists(pts, dist);
 	std::vector<Vector2i> seg;
-	std::vector<Root*> sO;
-	std::vector<double> ntimes;
+	std::vector<int> sO;
+	std::vector<StoredReal> ntimes;
+	std::vector<StoredReal> nscale;
 	for (size_t i=0; i<segments.size(); i++) {
 		auto s = segments.at(i);
 		Vector3d x = nodes.at(s.x);
 		Vector3d y = nodes.at(s.y);
-		bool x_ = geometry->getDist(x)<=0; // in?
-		bool y_ = geometry->getDist(y)<=0; // in?
+		bool x_ = status[i]>0; // in?
+		bool y_ = status[i]>0;
+		if (status[i]==0) {
+			x_ = dist[ni[s.x]]<=0;
+			y_ = dist[ni[s.y]]<=0;
+		}
 		if ((x_==true) && (y_==true)) { //segment is inside
 			seg.push_back(s);
 			sO.push_back(segO.at(i));
 			ntimes.push_back(ctimes.at(i));
-		} else if ((x_==false) && (y_==false)) { // segment is outside
-
+			if (!lengthScale.empty()) {
+				nscale.push_back(lengthScale.at(i));
+			}
+		} else if ((x_==false) && (y_==false)) { // segment is outside, or crosses the geometry
+			Vector3d in;
+			if ((status[i]==0) && findInside(x, y, dist[ni[s.x]], dist[ni[s.y]], geometry, in)) {
+				nodes.push_back(cut(in, x, geometry));
+				nodes.push_back(cut(in, y, geometry));
+				seg.push_back(Vector2i(nodes.size()-2, nodes.size()-1));
+				sO.push_back(segO.at(i));
+				ntimes.push_back(ctimes.at(i));
+				if (!lengthScale.empty()) {
+					nscale.push_back(lengthScale.at(i));
+				}
+			}
 		} else { // one node is inside, one outside
 			// sort
 			Vector3d in;
@@ -181,18 +272,23 @@ void SegmentAnalyser::crop(SignedDistanceFunction* geometry)
 			seg.push_back(newseg);
 			sO.push_back(segO.at(i));
 			ntimes.push_back(ctimes.at(i));
+			if (!lengthScale.empty()) {
+				nscale.push_back(lengthScale.at(i));
+			}
 		}
 
 	}
 	segments = seg;
 	segO  = sO;
 	ctimes = ntimes;
+	lengthScale = nscale;
+	clearIndex();
 	//std::cout << " cropped to " << segments.size() << " segments " << "\n";
 }
 
 /**
  * Filters the segments to the ones, where data is within [min,max], @see AnalysisSDF::getData,
- * i.e. all other segments are deleted.
+ * i.e. all other segments are deleted. The segments are compacted in place.
  *
  * @param st    parameter type @see RootSystem::ScalarType
  * @param min   minimal value
@@ -200,20 +296,25 @@ void SegmentAnalyser::crop(SignedDistanceFunction* geometry)
  */
 void SegmentAnalyser::filter(int st, double min, double max)
 {
-	std::vector<double> data = getScalar(st);
-	std::vector<Vector2i> seg;
-	std::vector<Root*> sO;
-	std::vector<double> ntimes;
+	size_t j = 0; // next kept segment (segment i is evaluated before it can be overwritten)
 	for (size_t i=0; i<segments.size(); i++) {
-		if ((data.at(i)>=min) && (data.at(i)<=max)) {
-			seg.push_back(segments.at(i));
-			sO.push_back(segO.at(i));
-			ntimes.push_back(ctimes.at(i));
+		double v = getScalar(st, i);
+		if ((v>=min) && (v<=max)) {
+			segments[j] = segments[i];
+			segO[j] = segO[i];
+			ctimes[j] = ctimes[i];
+			if (!lengthScale.empty()) {
+				lengthScale[j] = lengthScale[i];
+			}
+			j++;
 		}
 	}
-	segments = seg;
-	segO  = sO;
-	ctimes = ntimes;
+	segments.resize(j);
+	segO.resize(j);
+	ctimes.resize(j);
+	if (!lengthScale.empty()) {
+		lengthScale.resize(j);
+	}
 }
 
 /**
@@ -225,20 +326,7 @@ void SegmentAnalyser::filter(int st, double min, double max)
  */
 void SegmentAnalyser::filter(int st, double value)
 {
-	std::vector<double> data = getScalar(st);
-	std::vector<Vector2i> seg;
-	std::vector<Root*> sO;
-	std::vector<double> ntimes;
-	for (size_t i=0; i<segments.size(); i++) {
-		if (data.at(i)==value) {
-			seg.push_back(segments.at(i));
-			sO.push_back(segO.at(i));
-			ntimes.push_back(ctimes.at(i));
-		}
-	}
-	segments = seg;
-	segO  = sO;
-	ctimes = ntimes;
+	filter(st, value, value);
 }
 
 /**
@@ -248,7 +336,7 @@ void SegmentAnalyser::filter(int st, double value)
 void SegmentAnalyser::pack() {
 	std::vector<double> ni(nodes.size());
 	std::fill(ni.begin(),ni.end(), 0.);
-	std::vector<Vector3d> newnodes;
+	std::vector<StoredVector3d> newnodes;
 	for (auto& s:segments) {
 		if (ni.at(s.x)==0) { // the node is new
 			newnodes.push_back(nodes.at(s.x));
@@ -265,6 +353,66 @@ void SegmentAnalyser::pack() {
 	nodes = newnodes; // kabum!
 }
 
+/**
+ * Merges consecutive segments of the same root into coarse segments, that are at most tolerance [cm] away from the
+ * removed nodes (@see Polyline::simplify). Branch points, the first, and the last nodes of the roots are always kept,
+ * i.e. nodes that are not used by exactly two segments, and nodes where the root of the segments changes.
+ *
+ * The length, surface, and volume of the fine segments are aggregated exactly (@see SegmentAnalyser::lengthScale),
+ * the creation time of a coarse segment is the creation time of its last fine segment. Unused nodes are not deleted
+ * (@see SegmentAnalyser::pack), user data are not changed.
+ *
+ * @param tolerance     maximal distance of a removed node to its coarse segment [cm]
+ */
+void SegmentAnalyser::simplify(double tolerance)
+{
+	if (tolerance<=0) {
+		return;
+	}
+	std::vector<int> degree(nodes.size(), 0); // number of segments using the node
+	for (const auto& s : segments) {
+		degree.at(s.x)++;
+		degree.at(s.y)++;
+	}
+	std::vector<Vector2i> seg;
+	std::vector<int> sO;
+	std::vector<StoredReal> ntimes;
+	std::vector<StoredReal> nscale;
+	std::vector<Vector3d> p;
+	size_t i0 = 0;
+	while (i0<segments.size()) {
+		size_t i1 = i0; // chain i0..i1
+		while ((i1+1<segments.size()) && (segO[i1+1]==segO[i0]) && (segments[i1+1].x==segments[i1].y) && (degree[segments[i1].y]==2)) {
+			i1++;
+		}
+		p.clear();
+		p.push_back(nodes.at(segments[i0].x));
+		for (size_t i=i0; i<=i1; i++) {
+			p.push_back(nodes.at(segments[i].y));
+		}
+		std::vector<int> ni = Polyline::simplify(p, std::vector<bool>(), tolerance);
+		for (size_t k=0; k+1<ni.size(); k++) { // coarse segment from chain node ni[k] to ni[k+1]
+			size_t a = i0+ni[k];
+			size_t b = i0+ni[k+1]-1; // fine segments a..b
+			double l = 0.;
+			for (size_t i=a; i<=b; i++) {
+				l += getSegmentLength(i);
+			}
+			double d = p[ni[k+1]].minus(p[ni[k]]).length();
+			seg.push_back(Vector2i(segments[a].x, segments[b].y));
+			sO.push_back(segO[a]);
+			ntimes.push_back(ctimes[b]);
+			nscale.push_back((d>0) ? l/d : 1.); // d is only zero for a single fine segment of zero length
+		}
+		i0 = i1+1;
+	}
+	segments = seg;
+	segO = sO;
+	ctimes = ntimes;
+	lengthScale = nscale;
+	clearIndex();
+}
+
 /**
  *  Numerically computes the intersection point
  *
@@ -289,12 +437,140 @@ Vector3d SegmentAnalyser::cut(Vector3d in, Vector3d out, SignedDistanceFunction*
 	}
 }
 
+/**
+ * Searches a point of the segment [a,b] inside the geometry, if both nodes are outside, by bisection.
+ * Parts of the segment that are closer to a node than its distance are skipped, which assumes that the geometry
+ * is Lipschitz continuous with constant 1 (like exact signed distance functions, SDF_PlantBox, and SDF_RotateTranslate).
+ *
+ * Together with SegmentAnalyser::cut this clips segments exactly that cross a convex geometry (e.g. a layer)
+ * with both nodes outside, e.g. long segments after SegmentAnalyser::simplify.
+ *
+ * @param a        first node (outside)
+ * @param b        second node (outside)
+ * @param da       distance of a to the geometry (>0)
+ * @param db       distance of b to the geometry (>0)
+ * @param geometry signed distance function of the geometry
+ * @param in       a point of the segment inside the geometry (if found)
+ * \return         true if a point inside the geometry was found
+ */
+bool SegmentAnalyser::findInside(Vector3d a, Vector3d b, double da, double db, SignedDistanceFunction* geometry, Vector3d& in)
+{
+	double l = b.minus(a).length();
+	if ((da+db>=l) || (l<1e-6)) { // no point of [a,b] is inside
+		return false;
+	}
+	Vector3d c = a.plus(b).times(0.5); // mid
+	double dc = geometry->getDist(c);
+	if (dc<=0) {
+		in = c;
+		return true;
+	}
+	return findInside(a, c, da, dc, geometry, in) || findInside(c, b, dc, db, geometry, in);
+}
+
+/**
+ * Clips the segment [x,y] to the geometry, i.e. replaces the nodes by the ends of the part inside
+ * (for convex geometries, @see SegmentAnalyser::findInside)
+ *
+ * @param x        first node of the segment
+ * @param y        second node of the segment
+ * @param geometry signed distance function of the geometry
+ * \return         true if a part of the segment is inside
+ */
+bool SegmentAnalyser::clip(Vector3d& x, Vector3d& y, SignedDistanceFunction* geometry)
+{
+	double dx = geometry->getDist(x);
+	double dy = geometry->getDist(y);
+	bool x_ = dx<=0; // in?
+	bool y_ = dy<=0;
+	if (x_ && y_) { // segment is inside
+		return true;
+	} else if (x_) { // one node is inside, one outside
+		y = cut(x, y, geometry);
+		return true;
+	} else if (y_) {
+		x = cut(y, x, geometry);
+		return true;
+	}
+	Vector3d in;
+	if (findInside(x, y, dx, dy, geometry, in)) { // segment crosses the geometry
+		x = cut(in, x, geometry);
+		y = cut(in, y, geometry);
+		return true;
+	}
+	return false; // segment is outside
+}
+
 /**
  * \return The summed parameter of type @param st (@see RootSystem::ScalarType)
  */
 double SegmentAnalyser::getSummed(int st) const {
-	std::vector<double> v_ = getScalar(st);
-	return std::accumulate(v_.begin(), v_.end(), 0.0);
+	double v = 0;
+	for (size_t i=0; i<segments.size(); i++) {
+		v += getScalar(st, i);
+	}
+	return v;
+}
+
+/**
+ * Returns an analyser with the segments sel (in the given order), and the nodes they use (in the order of their first use)
+ *
+ * @param sel       segment indices
+ */
+SegmentAnalyser SegmentAnalyser::subset(const std::vector<int>& sel) const
+{
+	SegmentAnalyser a;
+	a.origins = origins;
+	a.segments.reserve(sel.size());
+	a.ctimes.reserve(sel.size());
+	a.segO.reserve(sel.size());
+	std::vector<int> ni(nodes.size(), -1); // new node indices
+	for (int i : sel) {
+		Vector2i s = segments.at(i);
+		for (int* j : { &s.x, &s.y }) {
+			if (ni.at(*j)<0) {
+				ni[*j] = a.nodes.size();
+				a.nodes.push_back(nodes[*j]);
+			}
+			*j = ni[*j];
+		}
+		a.segments.push_back(s);
+		a.ctimes.push_back(ctimes.at(i));
+		a.segO.push_back(segO.at(i));
+		if (!lengthScale.empty()) {
+			a.lengthScale.push_back(lengthScale.at(i));
+		}
+	}
+	return a;
+}
+
+/**
+ * Range of the layers [top-(k+1)*dz, top-k*dz], k = 0..n-1, that a segment from z1 to z2 might intersect,
+ * including one neighbour on both sides to be safe against rounding. All layers are returned if dz is not positive.
+ *
+ * @param top       top position of the first layer [cm]
+ * @param dz        layer height [cm]
+ * @param n         number of layers
+ * @param z1        coordinate of the first node [cm]
+ * @param z2        coordinate of the second node [cm]
+ * @param k0        first layer index (output)
+ * @param k1        last layer index (output)
+ */
+void SegmentAnalyser::layerRange(double top, double dz, int n, double z1, double z2, int& k0, int& k1)
+{
+	if (!(dz>0)) {
+		k0 = 0;
+		k1 = n-1;
+		return;
+	}
+	auto layer = [&](double z) {
+		double k = std::floor((top-z)/dz);
+		return int(std::max(std::min(k, double(n)), -1.));
+	};
+	int a = layer(z1);
+	int b = layer(z2);
+	k0 = std::max(std::min(a,b)-1, 0);
+	k1 = std::min(std::max(a,b)+1, n-1);
 }
 
 /**
@@ -303,19 +579,116 @@ double SegmentAnalyser::getSummed(int st) const {
  * To sum exactly, first crop to the geometry, then run SegmentAnalyser::getSummed(st).
  */
 double SegmentAnalyser::getSummed(int st, SignedDistanceFunction* g) const {
-	std::vector<double> data = getScalar(st);
-	double v = 0;
+	return SegmentView(*this).getSummed(st, g);
+}
+
+/**
+ * Builds a uniform grid over the segments, that is used by SegmentAnalyser::crop and SegmentAnalyser::getSummed(st, g)
+ * to classify whole cells as inside or outside of the geometry, based on a single distance evaluation at the cell center.
+ *
+ * The geometries passed to these methods must be Lipschitz continuous, |g(p)-g(q)| <= lipschitz*|p-q|,
+ * which holds e.g. for SDF_PlantBox, SDF_RotateTranslate, and their unions, intersections, or differences (with lipschitz = 1).
+ * The index becomes invalid when segments or nodes are changed (e.g. by crop, filter, or pack).
+ *
+ * @param cellSize      edge length of the cells [cm], or automatic (about 8 segments per cell) if <=0
+ * @param lipschitz     Lipschitz constant of the geometries (1 for exact signed distance functions)
+ */
+void SegmentAnalyser::buildIndex(double cellSize, double lipschitz)
+{
+	clearIndex();
+	if (segments.empty()) {
+		return;
+	}
+	Vector3d mi(1e100,1e100,1e100);
+	Vector3d ma(-1e100,-1e100,-1e100);
+	for (const auto& s : segments) {
+		for (int j : { s.x, s.y }) {
+			const Vector3d& n = nodes.at(j);
+			mi = Vector3d(std::min(mi.x,n.x), std::min(mi.y,n.y), std::min(mi.z,n.z));
+			ma = Vector3d(std::max(ma.x,n.x), std::max(ma.y,n.y), std::max(ma.z,n.z));
+		}
+	}
+	Vector3d e = ma.minus(mi);
+	double emax = std::max(std::max(std::max(e.x,e.y),e.z),1.e-6);
+	double h = cellSize;
+	if (h<=0) {
+		h = std::cbrt(std::max(e.x,1.e-3*emax)*std::max(e.y,1.e-3*emax)*std::max(e.z,1.e-3*emax)*8./segments.size());
+	}
+	h = std::max(h, 1.e-6*emax);
+	while ((double(int(e.x/h)+1)*(int(e.y/h)+1)*(int(e.z/h)+1)) > 4.*segments.size()+8.) { // limit the number of cells
+		h *= 1.25;
+	}
+	index.min = mi;
+	index.h = h;
+	index.nx = int(e.x/h)+1;
+	index.ny = int(e.y/h)+1;
+	index.nz = int(e.z/h)+1;
+	index.lipschitz = lipschitz;
+	index.nos = segments.size();
+	index.non = nodes.size();
+	auto cell = [&](const Vector3d& n) {
+		int i = std::min(int((n.x-mi.x)/h), index.nx-1);
+		int j = std::min(int((n.y-mi.y)/h), index.ny-1);
+		int k = std::min(int((n.z-mi.z)/h), index.nz-1);
+		return (i*index.ny+j)*index.nz+k;
+	};
+	std::vector<int> segCell(segments.size()); // cell of both nodes, or -1 if the nodes are in different cells
+	index.cellStart = std::vector<int>(index.nx*index.ny*index.nz+1, 0);
 	for (size_t i=0; i<segments.size(); i++) {
-		double d = data.at(i);
-		Vector2i s = segments.at(i);
-		Vector3d n1 = nodes.at(s.x);
-		Vector3d n2 = nodes.at(s.y);
-		Vector3d mid = n1.plus(n2).times(0.5);
-		if (g->getDist(mid)<0) {
-			v += d;
+		int c1 = cell(nodes.at(segments[i].x));
+		int c2 = cell(nodes.at(segments[i].y));
+		segCell[i] = (c1==c2) ? c1 : -1;
+		if (c1==c2) {
+			index.cellStart[c1+1]++;
+		}
+	}
+	std::partial_sum(index.cellStart.begin(), index.cellStart.end(), index.cellStart.begin());
+	index.cellSegments = std::vector<int>(index.cellStart.back());
+	std::vector<int> pos(index.cellStart.begin(), index.cellStart.end()-1);
+	for (size_t i=0; i<segments.size(); i++) {
+		if (segCell[i]>=0) {
+			index.cellSegments[pos[segCell[i]]++] = i;
+		}
+	}
+}
+
+/**
+ * Classifies the segments as inside (1) or outside (-1) of the geometry, if their whole cell is inside or outside,
+ * otherwise, or without valid index, the status is unknown (0).
+ *
+ * @param g         signed distance function of the geometry
+ * @param status    status per segment
+ */
+void SegmentAnalyser::classify(SignedDistanceFunction* g, std::vector<signed char>& status) const
+{
+	status = std::vector<signed char>(segments.size(), 0);
+	if (!hasIndex()) {
+		return;
+	}
+	const double hd = index.lipschitz*0.5*index.h*std::sqrt(3.)*(1.+1.e-9); // half diagonal
+	for (int i=0; i<index.nx; i++) {
+		for (int j=0; j<index.ny; j++) {
+			for (int k=0; k<index.nz; k++) {
+				int c = (i*index.ny+j)*index.nz+k;
+				if (index.cellStart[c]==index.cellStart[c+1]) { // empty
+					continue;
+				}
+				Vector3d mid(index.min.x+(i+0.5)*index.h, index.min.y+(j+0.5)*index.h, index.min.z+(k+0.5)*index.h);
+				double d = g->getDist(mid);
+				signed char s = 0;
+				if (d<-hd) {
+					s = 1;
+				} else if (d>hd) {
+					s = -1;
+				}
+				if (s!=0) {
+					for (int l = index.cellStart[c]; l<index.cellStart[c+1]; l++) {
+						status[index.cellSegments[l]] = s;
+					}
+				}
+			}
 		}
 	}
-	return v;
 }
 
 
@@ -326,8 +699,8 @@ double SegmentAnalyser::getSummed(int st, SignedDistanceFunction* g) const {
 std::vector<Root*> SegmentAnalyser::getRoots() const
 {
 	std::set<Root*> rootset;  // praise the stl
-	for (Root* r : segO) {
-		rootset.insert(r);
+	for (int j : segO) {
+		rootset.insert(origins[j]);
 	}
 	return std::vector<Root*>(rootset.begin(), rootset.end());
 }
@@ -356,7 +729,7 @@ SegmentAnalyser SegmentAnalyser::foto(const Vector3d& pos, const Matrix3d& ons,
 {
 	SegmentAnalyser f(*this); // copy
 	for (auto& n : f.nodes) { // translate
-		n = n.minus(pos);
+		n = Vector3d(n).minus(pos);
 	}
 	Matrix3d m = ons.inverse(); // rotate
 	for (auto& n : f.nodes) {
@@ -370,7 +743,8 @@ SegmentAnalyser SegmentAnalyser::foto(const Vector3d& pos, const Matrix3d& ons,
 	f.pack();
 	// project
 	for (auto& a : f.nodes) {
-		a = a.times(fl/(-plane.times(a)));
+		Vector3d v = a;
+		a = v.times(fl/(-plane.times(v)));
 		a.z = 0;
 	}
 	// final image crop
@@ -389,6 +763,7 @@ SegmentAnalyser SegmentAnalyser::cut(const SDF_HalfPlane& plane) const
 {
 	SegmentAnalyser f;
 	f.nodes = nodes; // copy all nodes
+	f.origins = origins;
 	for (size_t i=0; i<segments.size(); i++) {
 		Vector2i s = segments.at(i);
 		Vector3d n1 = nodes.at(s.x);
@@ -398,6 +773,9 @@ SegmentAnalyser SegmentAnalyser::cut(const SDF_HalfPlane& plane) const
 			f.segments.push_back(s);
 			f.ctimes.push_back(ctimes.at(i));
 			f.segO.push_back(segO.at(i));
+			if (!lengthScale.empty()) {
+				f.lengthScale.push_back(lengthScale.at(i));
+			}
 		}
 	}
 	f.pack(); // delete unused nodes
@@ -416,22 +794,7 @@ SegmentAnalyser SegmentAnalyser::cut(const SDF_HalfPlane& plane) const
  */
 std::vector<double> SegmentAnalyser::distribution(int st, double top, double bot, int n, bool exact) const
 {
-	std::vector<double> d(n);
-	double dz = (bot-top)/double(n);
-	SDF_PlantBox* layer = new SDF_PlantBox(1e100,1e100,dz);
-	for (int i=0; i<n; i++) {
-		Vector3d t(0,0,top-i*dz);
-		SDF_RotateTranslate g(layer,t);
-		if (exact) {
-			SegmentAnalyser a(*this); // copy everything
-			a.crop(&g); // crop exactly
-			d.at(i) = a.getSummed(st);
-		} else {
-			d.at(i) = this->getSummed(st, &g);
-		}
-	}
-	delete layer;
-	return d;
+	return SegmentView(*this).distribution(st, top, bot, n, exact);
 }
 
 /**
@@ -447,10 +810,19 @@ std::vector<SegmentAnalyser> SegmentAnalyser::distribution(double top, double bo
 	std::vector<SegmentAnalyser> d(n);
 	double dz = (bot-top)/double(n);
 	SDF_PlantBox* layer = new SDF_PlantBox(1e100,1e100,dz);
+	std::vector<std::vector<int>> candidates(n); // segments that might intersect the layer, in segment order
+	for (size_t i=0; i<segments.size(); i++) {
+		Vector2i s = segments.at(i);
+		int i0, i1;
+		layerRange(top, dz, n, nodes.at(s.x).z, nodes.at(s.y).z, i0, i1);
+		for (int k=i0; k<=i1; k++) {
+			candidates[k].push_back(i);
+		}
+	}
 	for (int i=0; i<n; i++) {
 		Vector3d t(0,0,top-i*dz);
 		SDF_RotateTranslate g(layer,t);
-		SegmentAnalyser a = SegmentAnalyser(*this); // copy everything
+		SegmentAnalyser a = subset(candidates[i]);
 		a.crop(&g); // crop exactly
 		d.at(i) = a;
 	}
@@ -473,33 +845,7 @@ std::vector<SegmentAnalyser> SegmentAnalyser::distribution(double top, double bo
  */
 std::vector<std::vector<double>> SegmentAnalyser::distribution2(int st, double top, double bot, double left, double right, int n, int m, bool exact) const
 {
-	std::vector<std::vector<double>> d(n);
-	double dz = (bot-top)/double(n);
-	double dx = (right-left)/double(m);
-	SDF_PlantBox* layer = new SDF_PlantBox(dx,1e9,dz);
-
-	for (int i=0; i<n; i++) {
-
-		std::vector<double> row(m); // m columns
-		for (int j=0; j<m; j++) {
-
-			Vector3d t(left+(j+0.5)*dx,0.,top-i*dz); // box is [-x/2,-y/2,0] - [x/2,y/2,-z]
-			SDF_RotateTranslate g(layer,t);
-
-			if (exact) {
-				SegmentAnalyser a(*this); // copy everything
-				a.crop(&g); // crop exactly
-				row.at(j) = a.getSummed(st);
-			} else {
-				row.at(j) = this->getSummed(st, &g);
-			}
-
-		}
-
-		d.at(i)=row; // store the row (n rows)
-	}
-	delete layer;
-	return d;
+	return SegmentView(*this).distribution2(st, top, bot, left, right, n, m, exact);
 }
 
 /**
@@ -520,11 +866,24 @@ std::vector<std::vector<SegmentAnalyser>> SegmentAnalyser::distribution2(double
 	double dx = (right-left)/double(m);
 	SDF_PlantBox* layer = new SDF_PlantBox(dx,1e4,dz);
 	// std::cout << "dx " << dx  <<", dz "<< dz << "\n";
+	std::vector<std::vector<int>> candidates(n*m); // segments that might intersect the cell, in segment order
+	for (size_t l=0; l<segments.size(); l++) {
+		Vector3d x = nodes.at(segments.at(l).x);
+		Vector3d y = nodes.at(segments.at(l).y);
+		int i0, i1, j0, j1;
+		layerRange(top, dz, n, x.z, y.z, i0, i1);
+		layerRange(-left, dx, m, -x.x, -y.x, j0, j1);
+		for (int i=i0; i<=i1; i++) {
+			for (int j=j0; j<=j1; j++) {
+				candidates[i*m+j].push_back(l);
+			}
+		}
+	}
 	for (int i=0; i<n; i++) {
 		for (int j=0; j<m; j++) {
 			Vector3d t(left+(j+0.5)*dx,0.,top-i*dz); // box is [-x/2,-y/2,0] - [x/2,y/2,-z]
 			SDF_RotateTranslate g(layer,t);
-			SegmentAnalyser a(*this); // copy everything
+			SegmentAnalyser a = subset(candidates[i*m+j]);
 			a.crop(&g); // crop exactly
 			d.at(i).push_back(a);
 
@@ -546,21 +905,489 @@ std::vector<std::vector<SegmentAnalyser>> SegmentAnalyser::distribution2(double
 	return d;
 }
 
+/**
+ *  Creates a three-dimensional distribution of the parameter of type @param st (@see RootSystem::ScalarType)
+ *  on a regular grid, in a single pass over the segments.
+ *
+ *  Each segment is traced through the grid (3D DDA). If exact, the segment is split at the cell faces,
+ *  and length, surface, and volume are summed per part (other parameters are added to each cell the segment intersects, as in
+ *  SegmentAnalyser::distribution). Otherwise, the parameter is added to the cell containing the segment mid point.
+ *  Segments or parts of segments outside of the box are ignored.
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param min       minimum of the bounding box (cm)
+ * @param max       maximum of the bounding box (cm)
+ * @param nx        number of cells along the x-axis
+ * @param ny        number of cells along the y-axis
+ * @param nz        number of cells along the z-axis
+ * @param exact     splits the segments at the cell faces (true), or only uses segment midpoints (false)
+ * \return          vector of size nx*ny*nz containing the summed parameter, cell (i,j,k) has the index (i*ny+j)*nz+k
+ */
+std::vector<double> SegmentAnalyser::distribution3(int st, Vector3d min, Vector3d max, int nx, int ny, int nz, bool exact) const
+{
+	return SegmentView(*this).distribution3(st, min, max, nx, ny, nz, exact);
+}
+
+/**
+ *  Creates a three-dimensional distribution of the parameter of type @param st (@see RootSystem::ScalarType),
+ *  and writes it into the data of a rectilinear grid (@see SegmentAnalyser::distribution3).
+ *
+ *  The grid points of the three Grid1D are the cell faces, the value of each cell is written to the
+ *  data index the grid maps the cell center to (@see RectilinearGrid3D::map).
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param grid      the grid, its data are overwritten
+ * @param exact     splits the segments at the cell faces (true), or only uses segment midpoints (false)
+ */
+void SegmentAnalyser::distribution3(int st, RectilinearGrid3D& grid, bool exact) const
+{
+	SegmentView(*this).distribution3(st, grid, exact);
+}
+
+/**
+ * Calls f(i, x, y) for each segment i of the view that passes all filters, and is (partly) inside all crop geometries,
+ * x and y are the nodes of the segment clipped by the crops (as SegmentAnalyser::crop).
+ *
+ * @param f         called in segment order
+ */
+template<class F>
+void SegmentView::forEach(F f) const
+{
+	std::vector<std::vector<signed char>> status(ops.size()); // per crop: segments inside (1), outside (-1), or unknown (0)
+	if (analyser.hasIndex()) { // a clipped segment is inside (or outside) if the segment is
+		for (size_t k=0; k<ops.size(); k++) {
+			if (ops[k].geometry!=nullptr) {
+				analyser.classify(ops[k].geometry, status[k]);
+			}
+		}
+	}
+	size_t n = all ? analyser.segments.size() : sel.size();
+	for (size_t l=0; l<n; l++) {
+		int i = all ? int(l) : sel[l];
+		Vector2i s = analyser.segments.at(i);
+		Vector3d x = analyser.nodes.at(s.x);
+		Vector3d y = analyser.nodes.at(s.y);
+		bool keep = true;
+		for (size_t k=0; (k<ops.size()) && keep; k++) {
+			const Operation& o = ops[k];
+			if (o.geometry==nullptr) { // filter
+				double v = analyser.getScalar(o.st, i, y.minus(x).length());
+				keep = (v>=o.min) && (v<=o.max);
+			} else if (status[k].empty() || (status[k][i]==0)) { // crop
+				keep = SegmentAnalyser::clip(x, y, o.geometry);
+			} else {
+				keep = status[k][i]>0;
+			}
+		}
+		if (keep) {
+			f(i, x, y);
+		}
+	}
+}
+
+/**
+ * \return The indices of the segments of the analyser that pass all filters, and are (partly) inside all crop geometries
+ */
+std::vector<int> SegmentView::getSelection() const
+{
+	std::vector<int> s;
+	forEach([&](int i, const Vector3d&, const Vector3d&) { s.push_back(i); });
+	return s;
+}
+
+/**
+ * \return The number of segments that pass all filters, and are (partly) inside all crop geometries
+ */
+int SegmentView::getNumberOfSegments() const
+{
+	int c = 0;
+	forEach([&](int, const Vector3d&, const Vector3d&) { c++; });
+	return c;
+}
+
+/**
+ * Returns a specific parameter per remaining segment, based on the cropped segment length (@see SegmentAnalyser::getScalar)
+ *
+ * @param st    parameter type @see RootSystem::ScalarType
+ * \return      vector containing parameter value per segment
+ */
+std::vector<double> SegmentView::getScalar(int st) const
+{
+	std::vector<double> data;
+	forEach([&](int i, const Vector3d& x, const Vector3d& y) { data.push_back(analyser.getScalar(st, i, y.minus(x).length())); });
+	return data;
+}
+
+/**
+ * \return The summed parameter of type @param st (@see RootSystem::ScalarType)
+ */
+double SegmentView::getSummed(int st) const
+{
+	double v = 0;
+	forEach([&](int i, const Vector3d& x, const Vector3d& y) { v += analyser.getScalar(st, i, y.minus(x).length()); });
+	return v;
+}
+
+/**
+ * \return The summed parameter of type @param st (@see RootSystem::ScalarType),
+ * that is within geometry @param g based on the segment mid point (i.e. not exact), @see SegmentAnalyser::getSummed
+ */
+double SegmentView::getSummed(int st, SignedDistanceFunction* g) const
+{
+	std::vector<signed char> status; // segments inside (1), outside (-1), or unknown (0)
+	analyser.classify(g, status);
+	std::vector<double> values; // of the segments that are inside or unknown, in segment order
+	std::vector<bool> unknown;
+	std::vector<Vector3d> mids; // evaluate the geometry for all unknown segments at once
+	forEach([&](int i, const Vector3d& x, const Vector3d& y) {
+		if (status[i]>=0) {
+			values.push_back(analyser.getScalar(st, i, y.minus(x).length()));
+			unknown.push_back(status[i]==0);
+			if (status[i]==0) {
+				mids.push_back(x.plus(y).times(0.5));
+			}
+		}
+	});
+	std::vector<double> dist;
+	g->getDists(mids, dist);
+	double v = 0;
+	size_t c = 0;
+	for (size_t l=0; l<values.size(); l++) {
+		if (!unknown[l] || (dist[c++]<0)) {
+			v += values[l];
+		}
+	}
+	return v;
+}
+
+/**
+ * Returns the parameter of the segment [x,y] of segment i after cropping it to the geometry g (@see SegmentAnalyser::crop),
+ * i.e. the parameter of the segment if it is inside, of the part inside, or 0 if it is outside.
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param i         segment index
+ * @param x         first node of the (clipped) segment
+ * @param y         second node of the (clipped) segment
+ * @param g         signed distance function of the geometry
+ * \return          parameter value of the cropped segment
+ */
+double SegmentView::getCropped(int st, int i, const Vector3d& x, const Vector3d& y, SignedDistanceFunction* g) const
+{
+	Vector3d x_ = x;
+	Vector3d y_ = y;
+	if (SegmentAnalyser::clip(x_, y_, g)) { // segment is (partly) inside
+		return analyser.getScalar(st, i, y_.minus(x_).length());
+	} else { // segment is outside
+		return 0.;
+	}
+}
+
+/**
+ *  Creates a vertical distribution of the parameter of type @param st (@see RootSystem::ScalarType)
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param top       vertical top position (cm)
+ * @param bot       vertical bot position (cm)
+ * @param n         number of layers (each with a height of (bot-top)/n )
+ * @param exact     calculates the intersection with the layer boundaries (true), only based on segment midpoints (false)
+ * \return Vector of size @param n containing the summed parameter in this layer
+ */
+std::vector<double> SegmentView::distribution(int st, double top, double bot, int n, bool exact) const
+{
+	std::vector<double> d(n);
+	double dz = (bot-top)/double(n);
+	SDF_PlantBox* layer = new SDF_PlantBox(1e100,1e100,dz);
+	std::vector<SDF_RotateTranslate> g;
+	for (int i=0; i<n; i++) {
+		g.push_back(SDF_RotateTranslate(layer, Vector3d(0,0,top-i*dz)));
+	}
+	// single pass over the segments, summing in segment order (as the layer wise crop)
+	forEach([&](int i, const Vector3d& x, const Vector3d& y) {
+		int i0, i1;
+		SegmentAnalyser::layerRange(top, dz, n, x.z, y.z, i0, i1);
+		for (int k=i0; k<=i1; k++) {
+			if (exact) {
+				d.at(k) += getCropped(st, i, x, y, &g.at(k));
+			} else {
+				Vector3d mid = x.plus(y).times(0.5);
+				if (g.at(k).getDist(mid)<0) {
+					d.at(k) += analyser.getScalar(st, i, y.minus(x).length());
+				}
+			}
+		}
+	});
+	delete layer;
+	return d;
+}
+
+/**
+ *  Creates a two-dimensional distribution of the parameter of type @param st (@see RootSystem::ScalarType)
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param top       vertical top position (cm)
+ * @param bot       vertical bot position (cm)
+ * @param left      left along x-axis (cm)
+ * @param right     right along x-axis (cm)
+ * @param n         number of vertical grid elements (each with height of (bot-top)/n )
+ * @param m 		number of horizontal grid elements (each with length of (right-left)/m)
+ * @param exact     calculates the intersection with the layer boundaries (true), only based on segment midpoints (false)
+ * \return Vector of size @param n containing the summed parameter in this layer
+ */
+std::vector<std::vector<double>> SegmentView::distribution2(int st, double top, double bot, double left, double right, int n, int m, bool exact) const
+{
+	std::vector<std::vector<double>> d(n);
+	double dz = (bot-top)/double(n);
+	double dx = (right-left)/double(m);
+	SDF_PlantBox* layer = new SDF_PlantBox(dx,1e9,dz);
+	std::vector<SDF_RotateTranslate> g;
+	for (int i=0; i<n; i++) {
+		d.at(i) = std::vector<double>(m); // m columns
+		for (int j=0; j<m; j++) {
+			Vector3d t(left+(j+0.5)*dx,0.,top-i*dz); // box is [-x/2,-y/2,0] - [x/2,y/2,-z]
+			g.push_back(SDF_RotateTranslate(layer,t));
+		}
+	}
+	// single pass over the segments, summing in segment order (as the cell wise crop)
+	forEach([&](int l, const Vector3d& x, const Vector3d& y) {
+		int i0, i1, j0, j1;
+		SegmentAnalyser::layerRange(top, dz, n, x.z, y.z, i0, i1);
+		SegmentAnalyser::layerRange(-left, dx, m, -x.x, -y.x, j0, j1); // columns: x in [left+j*dx, left+(j+1)*dx]
+		for (int i=i0; i<=i1; i++) {
+			for (int j=j0; j<=j1; j++) {
+				SDF_RotateTranslate& g_ = g.at(i*m+j);
+				if (exact) {
+					d.at(i).at(j) += getCropped(st, l, x, y, &g_);
+				} else {
+					Vector3d mid = x.plus(y).times(0.5);
+					if (g_.getDist(mid)<0) {
+						d.at(i).at(j) += analyser.getScalar(st, l, y.minus(x).length());
+					}
+				}
+			}
+		}
+	});
+	delete layer;
+	return d;
+}
+
+/**
+ *  Creates a three-dimensional distribution of the parameter of type @param st (@see RootSystem::ScalarType)
+ *  on a regular grid, in a single pass over the segments.
+ *
+ *  Each segment is traced through the grid (3D DDA). If exact, the segment is split at the cell faces,
+ *  and length, surface, and volume are summed per part (other parameters are added to each cell the segment intersects, as in
+ *  SegmentAnalyser::distribution). Otherwise, the parameter is added to the cell containing the segment mid point.
+ *  Segments or parts of segments outside of the box are ignored.
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param min       minimum of the bounding box (cm)
+ * @param max       maximum of the bounding box (cm)
+ * @param nx        number of cells along the x-axis
+ * @param ny        number of cells along the y-axis
+ * @param nz        number of cells along the z-axis
+ * @param exact     splits the segments at the cell faces (true), or only uses segment midpoints (false)
+ * \return          vector of size nx*ny*nz containing the summed parameter, cell (i,j,k) has the index (i*ny+j)*nz+k
+ */
+std::vector<double> SegmentView::distribution3(int st, Vector3d min, Vector3d max, int nx, int ny, int nz, bool exact) const
+{
+	if ((nx<1) || (ny<1) || (nz<1)) {
+		throw std::invalid_argument("SegmentView::distribution3() number of cells must be positive");
+	}
+	auto grid = [](double a, double b, int n) {
+		std::vector<double> g(n+1);
+		for (int i=0; i<=n; i++) {
+			g[i] = a+(b-a)*double(i)/double(n);
+		}
+		return g;
+	};
+	std::vector<double> data;
+	voxelize(st, grid(min.x,max.x,nx), grid(min.y,max.y,ny), grid(min.z,max.z,nz), exact, data);
+	return data;
+}
+
+/**
+ *  Creates a three-dimensional distribution of the parameter of type @param st (@see RootSystem::ScalarType),
+ *  and writes it into the data of a rectilinear grid (@see SegmentView::distribution3).
+ *
+ *  The grid points of the three Grid1D are the cell faces, the value of each cell is written to the
+ *  data index the grid maps the cell center to (@see RectilinearGrid3D::map).
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param grid      the grid, its data are overwritten
+ * @param exact     splits the segments at the cell faces (true), or only uses segment midpoints (false)
+ */
+void SegmentView::distribution3(int st, RectilinearGrid3D& grid, bool exact) const
+{
+	const auto& gx = grid.xgrid->grid;
+	const auto& gy = grid.ygrid->grid;
+	const auto& gz = grid.zgrid->grid;
+	if ((gx.size()<2) || (gy.size()<2) || (gz.size()<2)) {
+		throw std::invalid_argument("SegmentView::distribution3() grid needs at least two points per axis");
+	}
+	std::vector<double> data;
+	voxelize(st, gx, gy, gz, exact, data);
+	int ny = gy.size()-1;
+	int nz = gz.size()-1;
+	std::fill(grid.data.begin(), grid.data.end(), 0.);
+	for (size_t i=0; i<gx.size()-1; i++) {
+		for (int j=0; j<ny; j++) {
+			for (int k=0; k<nz; k++) {
+				size_t c = grid.map(0.5*(gx[i]+gx[i+1]), 0.5*(gy[j]+gy[j+1]), 0.5*(gz[k]+gz[k+1]));
+				grid.data.at(c) = data[(i*ny+j)*nz+k];
+			}
+		}
+	}
+}
+
+/**
+ * Sums the parameter of type @param st per cell of a rectilinear grid, @see SegmentAnalyser::distribution3
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param gx        cell faces along the x-axis (increasing)
+ * @param gy        cell faces along the y-axis (increasing)
+ * @param gz        cell faces along the z-axis (increasing)
+ * @param exact     splits the segments at the cell faces (true), or only uses segment midpoints (false)
+ * @param data      summed parameter per cell (i,j,k) at index (i*ny+j)*nz+k (output)
+ */
+void SegmentView::voxelize(int st, const std::vector<double>& gx, const std::vector<double>& gy, const std::vector<double>& gz,
+	bool exact, std::vector<double>& data) const
+{
+	const std::vector<double>* g[3] = { &gx, &gy, &gz };
+	const int n[3] = { int(gx.size())-1, int(gy.size())-1, int(gz.size())-1 };
+	data = std::vector<double>(n[0]*n[1]*n[2], 0.);
+	auto locate = [&](int a, double x, double dir) { // cell along axis a containing x, or -1
+		const auto& ga = *g[a];
+		if ((x<ga.front()) || (x>ga.back())) {
+			return -1;
+		}
+		int i = std::upper_bound(ga.begin(), ga.end(), x)-ga.begin()-1;
+		if ((dir<0) && (i>0) && (x==ga[i])) { // on a face, moving downwards
+			i--;
+		}
+		return std::min(std::max(i,0), n[a]-1);
+	};
+	forEach([&](int l, const Vector3d& x, const Vector3d& y) {
+		double p[3] = { x.x, x.y, x.z };
+		double d[3] = { y.x-x.x, y.y-x.y, y.z-x.z };
+		double length = y.minus(x).length();
+		if (!exact || (length==0)) { // mid point
+			int c[3];
+			bool in = true;
+			for (int a=0; a<3; a++) {
+				c[a] = locate(a, p[a]+0.5*d[a], 0.);
+				in = in && (c[a]>=0);
+			}
+			if (in) {
+				data[(c[0]*n[1]+c[1])*n[2]+c[2]] += analyser.getScalar(st, l, length);
+			}
+			return;
+		}
+		// clip the segment to the box
+		double t0 = 0., t1 = 1.;
+		for (int a=0; a<3; a++) {
+			const auto& ga = *g[a];
+			if (d[a]==0) {
+				if ((p[a]<ga.front()) || (p[a]>ga.back())) {
+					t1 = -1.;
+				}
+			} else {
+				double ta = (ga.front()-p[a])/d[a];
+				double tb = (ga.back()-p[a])/d[a];
+				t0 = std::max(t0, std::min(ta,tb));
+				t1 = std::min(t1, std::max(ta,tb));
+			}
+		}
+		if (t0>=t1) {
+			return;
+		}
+		// trace the segment through the cells
+		int c[3];
+		double tnext[3];
+		for (int a=0; a<3; a++) {
+			c[a] = locate(a, std::min(std::max(p[a]+t0*d[a], g[a]->front()), g[a]->back()), d[a]);
+			if (d[a]>0) {
+				tnext[a] = ((*g[a])[c[a]+1]-p[a])/d[a];
+			} else if (d[a]<0) {
+				tnext[a] = ((*g[a])[c[a]]-p[a])/d[a];
+			} else {
+				tnext[a] = 2.; // never
+			}
+		}
+		double t = t0;
+		while (t<t1) {
+			double tn = std::min(std::min(std::min(tnext[0], tnext[1]), tnext[2]), t1);
+			if (tn>t) {
+				data[(c[0]*n[1]+c[1])*n[2]+c[2]] += analyser.getScalar(st, l, (tn-t)*length);
+			}
+			t = tn;
+			bool inside = true;
+			for (int a=0; a<3; a++) {
+				if (tnext[a]<=tn) { // cross the face
+					if (d[a]>0) {
+						c[a]++;
+						inside = inside && (c[a]<n[a]);
+						tnext[a] = inside ? ((*g[a])[c[a]+1]-p[a])/d[a] : 2.;
+					} else {
+						c[a]--;
+						inside = inside && (c[a]>=0);
+						tnext[a] = inside ? ((*g[a])[c[a]]-p[a])/d[a] : 2.;
+					}
+				}
+			}
+			if (!inside) {
+				break;
+			}
+		}
+	});
+}
+
+/**
+ * Materializes the view: returns an analyser with the remaining segments (in segment order) cropped to the geometries,
+ * and the nodes they use. User data and the spatial index are not copied.
+ */
+SegmentAnalyser SegmentView::pack() const
+{
+	SegmentAnalyser p = analyser.subset(getSelection());
+	for (const auto& o : ops) { // the remaining segments are all (partly) inside, and are clipped as in the view
+		if (o.geometry!=nullptr) {
+			p.crop(o.geometry);
+		}
+	}
+	return p;
+}
+
+/**
+ * Writes the remaining segments, @see SegmentAnalyser::write
+ *
+ * @param name      file name e.g. output.vtp
+ */
+void SegmentView::write(std::string name, int encoding, bool compress) const
+{
+	SegmentAnalyser p = pack();
+	p.write(name, encoding, compress);
+}
+
+
+
 /**
  * Exports the simulation results with the type from the extension in name
  * (that must be lower case)
  *
  * @param name      file name e.g. output.vtp
  */
-void SegmentAnalyser::write(std::string name)
+void SegmentAnalyser::write(std::string name, int encoding, bool compress)
 {
 	this->pack(); // a good idea before writing any file
 	std::ofstream fos;
-	fos.open(name.c_str());
+	if (encoding==VTPWriter::vtp_ascii) {
+		fos.open(name.c_str());
+	} else {
+		fos.open(name.c_str(), std::ios::binary);
+	}
 	std::string ext = name.substr(name.size()-3,name.size()); // pick the right writer
 	if (ext.compare("vtp")==0) {
 		std::cout << "writing VTP: " << name << "\n";
-		this->writeVTP(fos,{ RootSystem::st_radius, RootSystem::st_type, RootSystem::st_time });
+		this->writeVTP(fos,{ RootSystem::st_radius, RootSystem::st_type, RootSystem::st_time }, encoding, compress);
 	} else if (ext.compare("txt")==0)  {
 		std::cout << "writing text file for Matlab import: "<< name << "\n";
 		writeRBSegments(fos);
@@ -631,6 +1458,60 @@ void SegmentAnalyser::writeVTP(std::ostream & os, std::vector<int> types) const
 	os << "</PolyData>\n" << "</VTKFile>\n";
 }
 
+/**
+ * Writes a VTP file with appended binary data (@see VTPWriter), the data are streamed from the segments.
+ *
+ * @param os        typically a file out stream (opened in binary mode for raw encoding)
+ * @param types     multiple parameter types (@see RootSystem::ScalarType) that are saved in the VTP file,
+ * 					additionally, all userdata is saved per default
+ * @param encoding  VTPWriter::vtp_raw, or VTPWriter::vtp_base64 (VTPWriter::vtp_ascii writes the ascii file)
+ * @param compress  zlib compression (@see VTPWriter::hasCompression)
+ */
+void SegmentAnalyser::writeVTP(std::ostream & os, std::vector<int> types, int encoding, bool compress) const
+{
+	if (encoding==VTPWriter::vtp_ascii) {
+		writeVTP(os, types);
+		return;
+	}
+	assert(segments.size() == segO.size());
+	assert(segments.size() == ctimes.size());
+	VTPWriter w(encoding, compress);
+	w.setPiece(nodes.size(), segments.size());
+	for (int st : types) {
+		w.addCellData(RootSystem::scalarTypeNames.at(st), [this, st](VTPWriter& w) {
+			for (size_t i=0; i<segments.size(); i++) {
+				w.putFloat32(getScalar(st, i));
+			}
+		});
+	}
+	for (size_t j=0; j<userData.size(); j++) { // user data
+		const auto& data = userData.at(j);
+		w.addCellData(userDataNames.at(j), [&data](VTPWriter& w) {
+			for (auto const& t : data) {
+				w.putFloat32(t);
+			}
+		});
+	}
+	w.setPoints([this](VTPWriter& w) {
+		for (auto const& n : nodes) {
+			w.putFloat32(n.x);
+			w.putFloat32(n.y);
+			w.putFloat32(n.z);
+		}
+	});
+	w.setLines(2*segments.size(), [this](VTPWriter& w) {
+		for (auto const& s : segments) {
+			w.putInt32(s.x);
+			w.putInt32(s.y);
+		}
+	}, [this](VTPWriter& w) {
+		for (size_t i=0; i<segments.size(); i++) {
+			w.putInt32(2*i+2);
+		}
+	});
+	w.write(os);
+}
+
 /**
  * Writes the (line)segments of the root system, and
  * mimics the Matlab script getSegments() of RootBox
@@ -644,7 +1525,7 @@ void SegmentAnalyser::writeRBSegments(std::ostream & os) const
 		Vector2i s = segments.at(i);
 		Vector3d n1 = nodes.at(s.x);
 		Vector3d n2 = nodes.at(s.y);
-		Root* r = segO.at(i);
+		Root* r = getOrigin(i);
 		double radius = r->param.a;
 		double red = r->getRootTypeParameter()->colorR;
 		double green = r->getRootTypeParameter()->colorG;
@@ -676,12 +1557,10 @@ void SegmentAnalyser::writeDGF(std::ostream & os) const
 	// node1ID, node2ID, type, branchID, surfaceIdx, length, radiusIdx, massIdx, axialPermIdx, radialPermIdx, creationTimeId
 	for (size_t i=0; i<segments.size(); i++) {
 		Vector2i s = segments.at(i);
-		Vector3d n1 = nodes.at(s.x);
-		Vector3d n2 = nodes.at(s.y);
-		Root* r = segO.at(i);
+		Root* r = getOrigin(i);
 		int branchnumber = r->id;
 		double radius = r->param.a;
-		double length = sqrt((n1.x-n2.x)*(n1.x-n2.x)+(n1.y-n2.y)*(n1.y-n2.y)+(n1.z-n2.z)*(n1.z-n2.z));
+		double length = getSegmentLength(i); // of simplified segments, the represented root length
 		double surface = 2*radius*M_PI*length;
 		double time = ctimes.at(i);
 		double type = r->param.type;
@@ -4,6 +4,21 @@
 #include "RootSystem.h"
 #include <set>
 
+/**
+ * Uniform grid over the segments of a SegmentAnalyser (@see SegmentAnalyser::buildIndex)
+ */
+struct SegmentIndex
+{
+    Vector3d min; ///< lower corner of the grid [cm]
+    double h = 0.; ///< cell size [cm]
+    int nx = 0, ny = 0, nz = 0; ///< number of cells per axis
+    double lipschitz = 1.; ///< Lipschitz constant assumed for the geometries
+    std::vector<int> cellStart; ///< the segments of cell c are cellSegments[cellStart[c]] .. cellSegments[cellStart[c+1]-1]
+    std::vector<int> cellSegments; ///< segment indices sorted by cell
+    size_t nos = 0; ///< number of segments the index was built for
+    size_t non = 0; ///< number of nodes the index was built for
+};
+
 /**
  * Meshfree analysis of the root system based on signed distance functions.
  */
@@ -14,7 +29,8 @@ public:
 
     SegmentAnalyser() { }; ///< creates an empty object (use AnalysisSDF::addSegments)
     SegmentAnalyser(const RootSystem& rs); ///< creates an analyser object containing the segments from the root system
-    SegmentAnalyser(const SegmentAnalyser& a) : nodes(a.nodes), segments(a.segments), ctimes(a.ctimes), segO(a.segO) { } ///< copy constructor, does not copy user data
+    SegmentAnalyser(const SegmentAnalyser& a) : nodes(a.nodes), segments(a.segments), ctimes(a.ctimes), segO(a.segO), origins(a.origins),
+        lengthScale(a.lengthScale) { } ///< copy constructor, does not copy user data and index
     virtual ~SegmentAnalyser() { }; ///< nothing to do here
 
     // merge segments
@@ -25,18 +41,27 @@ public:
     void crop(SignedDistanceFunction* geometry); ///< crops the data to a geometry
     void filter(int st, double min, double max); ///< filters the segments to the data @see AnalysisSDF::getScalar
     void filter(int st, double value); ///< filters the segments to the data @see AnalysisSDF::getScalar
+    // (use SegmentView to filter and crop lazily, without copying the segments)
     void pack(); ///< sorts the nodes and deletes unused nodes
+    void simplify(double tolerance); ///< merges straight segments of the same root into coarse segments (@see Polyline)
+
+    // optional spatial index
+    void buildIndex(double cellSize = 0., double lipschitz = 1.); ///< builds a uniform grid over the segments to speed up crop and getSummed(st, geometry)
+    void clearIndex() { index = SegmentIndex(); } ///< deletes the spatial index
+    bool hasIndex() const { return (index.h>0) && (index.nos==segments.size()) && (index.non==nodes.size()); } ///< true if the index is valid
 
     // some things we might want to know
     std::vector<double> getScalar(int st) const; ///< Returns a specific parameter per segment @see RootSystem::ScalarType
-    double getSegmentLength(int i) const; ///< returns the length of a segment
+    double getScalar(int st, int i) const { return getScalar(st, i, getDistance(i)); } ///< Returns a specific parameter of segment i
+    double getSegmentLength(int i) const; ///< returns the root length represented by a segment
     double getSummed(int st) const; ///< Sums up the parameter
     double getSummed(int st, SignedDistanceFunction* geometry) const; ///< Sums up the parameter within the geometry
     std::vector<double> distribution(int st, double top, double bot, int n, bool exact=false) const; ///< vertical distribution of a parameter
     std::vector<SegmentAnalyser> distribution(double top, double bot, int n) const; ///< vertical distribution of a parameter
     std::vector<std::vector<double>> distribution2(int st, double top, double bot, double left, double right, int n, int m, bool exact=false) const; ///< 2d distribution (x,z) of a parameter
     std::vector<std::vector<SegmentAnalyser>> distribution2(double top, double bot, double left, double right, int n, int m) const; ///< 2d distribution (x,z) of a parameter
-    // todo distribution3
+    std::vector<double> distribution3(int st, Vector3d min, Vector3d max, int nx, int ny, int nz, bool exact=false) const; ///< 3d distribution of a parameter on a regular grid
+    void distribution3(int st, RectilinearGrid3D& grid, bool exact=false) const; ///< 3d distribution of a parameter, written into the grid data
 
     // rather specialized things we want to know
     std::vector<Root*> getRoots() const; ///< segment origins
@@ -50,18 +75,25 @@ public:
     void clearUserData() { userData.clear(); userDataNames.clear(); } ///< resets the user data
 
     // some exports
-    void write(std::string name); ///< writes simulation results (type is determined from file extension in name)
+    void write(std::string name, int encoding = 0, bool compress = false); ///< writes simulation results (type is determined from file extension in name, @see VTPWriter)
     void writeVTP(std::ostream & os, std::vector<int> types = {RootSystem::st_radius}) const; ///< writes a VTP file
+    void writeVTP(std::ostream & os, std::vector<int> types, int encoding, bool compress = false) const; ///< writes a VTP file with appended binary data
     void writeRBSegments(std::ostream & os) const; ///< Writes the segments of the root system, mimics the Matlab script getSegments()
     void writeDGF(std::ostream & os) const; ///< Writes the segments of the root system in DGF format used by DuMux
 
     // auxiliary
     static Vector3d cut(Vector3d in, Vector3d out, SignedDistanceFunction* geometry); ///< intersects a line with  the geometry
+    static bool findInside(Vector3d a, Vector3d b, double da, double db, SignedDistanceFunction* geometry, Vector3d& in); ///< a point of a line inside the geometry, if both nodes are outside
+    static bool clip(Vector3d& x, Vector3d& y, SignedDistanceFunction* geometry); ///< clips a line to the geometry
+
+    Root* getOrigin(int i) const { return origins[segO.at(i)]; } ///< the root containing segment i
 
-    std::vector<Vector3d> nodes; ///< nodes
+    std::vector<StoredVector3d> nodes; ///< nodes (single precision if built with CROOTBOX_COMPACT)
     std::vector<Vector2i> segments; ///< connectivity of the nodes
-    std::vector<double> ctimes; ///< creation times of the segments
-    std::vector<Root*> segO; ///< to look up things
+    std::vector<StoredReal> ctimes; ///< creation times of the segments
+    std::vector<int> segO; ///< origin of each segment, as index into origins (@see SegmentAnalyser::getOrigin)
+    std::vector<Root*> origins; ///< roots containing the segments, to look up things
+    std::vector<StoredReal> lengthScale; ///< root length represented by a segment per segment length (@see SegmentAnalyser::simplify), empty if all are 1
 
 protected:
 
@@ -70,6 +102,77 @@ protected:
 
     const RootSystem* rs = nullptr;
 
+    SegmentIndex index; ///< optional spatial index, @see SegmentAnalyser::buildIndex
+
+    double getScalar(int st, int i, double length) const; ///< parameter of segment i, with a given (e.g. cropped) segment length
+    double getDistance(int i) const; ///< distance of the two nodes of segment i
+    void classify(SignedDistanceFunction* g, std::vector<signed char>& status) const; ///< classifies the segments using the index
+    SegmentAnalyser subset(const std::vector<int>& sel) const; ///< analyser with selected segments and the nodes they use
+    static void layerRange(double top, double dz, int n, double z1, double z2, int& k0, int& k1); ///< layers a segment might intersect
+
+    friend class SegmentView;
+
+};
+
+/**
+ * Lazy view of the segments of a SegmentAnalyser.
+ *
+ * Filters and crops are only recorded, and are evaluated per segment (in the given order) in a single pass, whenever the view
+ * is analysed. Cropped segments are clipped on the fly, the analyser is never changed or copied. The segments are only
+ * materialized by SegmentView::pack and SegmentView::write. The analyser and the geometries must exist as long as the view.
+ *
+ * The results are the same as of the corresponding calls of SegmentAnalyser::filter, SegmentAnalyser::crop, and the analysis
+ * methods on a copy of the analyser (up to the rounding of the cut nodes, if built with CROOTBOX_COMPACT). A spatial index
+ * of the analyser (@see SegmentAnalyser::buildIndex) is used for all crops.
+ */
+class SegmentView
+{
+
+public:
+
+    SegmentView(const SegmentAnalyser& a) : analyser(a) { } ///< view of all segments of the analyser
+    SegmentView(const SegmentAnalyser& a, const std::vector<int>& sel) : analyser(a), sel(sel), all(false) { } ///< view of the segments sel (in the given order)
+
+    // reduce number of segments (lazy)
+    void crop(SignedDistanceFunction* geometry) { ops.push_back(Operation{ 0, 0., 0., geometry }); } ///< crops the segments to a geometry
+    void filter(int st, double min, double max) { ops.push_back(Operation{ st, min, max, nullptr }); } ///< keeps the segments with data within [min,max]
+    void filter(int st, double value) { filter(st, value, value); } ///< keeps the segments with data equal to value
+
+    // some things we might want to know
+    std::vector<int> getSelection() const; ///< indices of the remaining segments in the analyser
+    int getNumberOfSegments() const; ///< number of remaining segments
+    std::vector<double> getScalar(int st) const; ///< parameter per remaining (cropped) segment @see RootSystem::ScalarType
+    double getSummed(int st) const; ///< sums up the parameter
+    double getSummed(int st, SignedDistanceFunction* geometry) const; ///< sums up the parameter within the geometry
+    std::vector<double> distribution(int st, double top, double bot, int n, bool exact=false) const; ///< vertical distribution of a parameter
+    std::vector<std::vector<double>> distribution2(int st, double top, double bot, double left, double right, int n, int m, bool exact=false) const; ///< 2d distribution (x,z) of a parameter
+    std::vector<double> distribution3(int st, Vector3d min, Vector3d max, int nx, int ny, int nz, bool exact=false) const; ///< 3d distribution of a parameter on a regular grid
+    void distribution3(int st, RectilinearGrid3D& grid, bool exact=false) const; ///< 3d distribution of a parameter, written into the grid data
+
+    // materialize
+    SegmentAnalyser pack() const; ///< analyser containing the remaining (cropped) segments, and only the nodes they use
+    void write(std::string name, int encoding = 0, bool compress = false) const; ///< writes the remaining segments @see SegmentAnalyser::write
+
+protected:
+
+    struct Operation {
+        int st; ///< parameter type of a filter
+        double min; ///< minimal value of a filter
+        double max; ///< maximal value of a filter
+        SignedDistanceFunction* geometry; ///< geometry of a crop, or nullptr for a filter
+    };
+
+    const SegmentAnalyser& analyser; ///< the segment store (not changed)
+    std::vector<int> sel; ///< selected segments (if not all)
+    bool all = true; ///< all segments of the analyser are selected
+    std::vector<Operation> ops; ///< filters and crops in the order they are applied
+
+    template<class F>
+    void forEach(F f) const; ///< calls f(i, x, y) for each remaining segment i, clipped to [x,y]
+    double getCropped(int st, int i, const Vector3d& x, const Vector3d& y, SignedDistanceFunction* g) const; ///< parameter of the segment [x,y] cropped to the geometry
+    void voxelize(int st, const std::vector<double>& gx, const std::vector<double>& gy, const std::vector<double>& gz, bool exact,
+        std::vector<double>& data) const; ///< sums the parameter per cell of a rectilinear grid
+
 };
 
 inline bool operator==(const SegmentAnalyser& lhs, const SegmentAnalyser& rhs){ return (&lhs==&rhs); } // only address wise, needed for boost python indexing suite
@@ -0,0 +1,313 @@
+/**
+ * Performance benchmark of CRootBox
+ *
+ * Times the hot paths (simulation, node and segment copies, segment analysis, push/pop, tropism heading search, and output)
+ * for the given plant parameter files at several scales (number of plants, axial resolution dx), and writes the results
+ * to the console, and as CSV and JSON files (one record per plant, scale, and operation).
+ *
+ * Usage: benchmark [-q] [-t days] [-j threads] [-d parameter folder] [-o output prefix] [plant names ...]
+ *
+ *  -q      quick run (10 days, small scales)
+ *  -t      simulation time [days] (default 20)
+ *  -j      number of threads of the ensemble (default 1, <=0 uses all hardware threads)
+ *  -d      folder of the parameter files (default modelparameter/ of the source tree, if built with CMake)
+ *  -o      writes prefix.csv and prefix.json (default benchmark)
+ *
+ * Throughput is given in segments per second (for the heading search in calls per second), peak memory is the maximum
+ * resident set size of the process so far (cases run with increasing size).
+ */
+#include "RootSystem.h"
+#include "RootSystemEnsemble.h"
+#include "analysis.h"
+#include "sdf.h"
+#include "tropism.h"
+#include "vtp.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+/**
+ * Time and throughput of one operation
+ */
+struct BenchmarkResult {
+	std::string plant;
+	int plants;
+	double dx;
+	double days;
+	std::string operation;
+	double seconds;
+	long items; // segments, or calls
+	long peakMemory; // [kB]
+};
+
+/**
+ * Maximum resident set size of the process [kB] (0 if unknown)
+ */
+long getPeakMemory()
+{
+#if defined(__unix__) || defined(__APPLE__)
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru)==0) {
+#ifdef __APPLE__
+		return ru.ru_maxrss/1024; // bytes
+#else
+		return ru.ru_maxrss; // kilobytes
+#endif
+	}
+#endif
+	return 0;
+}
+
+/**
+ * Discards the console output of the model (parameter files, simulation messages)
+ */
+class Silence {
+public:
+	Silence() : old(std::cout.rdbuf(&null)) { }
+	~Silence() { std::cout.rdbuf(old); }
+private:
+	struct NullBuffer : public std::streambuf { int overflow(int c) override { return c; } };
+	NullBuffer null;
+	std::streambuf* old;
+};
+
+/**
+ * Runs the cases and collects the results
+ */
+class Benchmark {
+public:
+
+	double days = 20.;
+	int threads = 1;
+#ifdef CROOTBOX_MODELPARAMETER
+	std::string folder = CROOTBOX_MODELPARAMETER;
+#else
+	std::string folder = "modelparameter/";
+#endif
+	std::vector<BenchmarkResult> results;
+
+	void run(const std::string& plant, int plants, double dx); ///< all operations for one scale
+	void runHeading(const std::string& plant); ///< tropism heading search (independent of the scale)
+	void writeCSV(std::ostream& os) const;
+	void writeJSON(std::ostream& os) const;
+
+private:
+
+	void time(const std::string& operation, std::function<long()> f); ///< f returns the number of processed items
+	std::string plant;
+	int plants = 1;
+	double dx = 1.;
+
+};
+
+/**
+ * Times f, and adds the result
+ */
+void Benchmark::time(const std::string& operation, std::function<long()> f)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	long items = f();
+	auto t1 = std::chrono::steady_clock::now();
+	BenchmarkResult r;
+	r.plant = plant;
+	r.plants = plants;
+	r.dx = dx;
+	r.days = days;
+	r.operation = operation;
+	r.seconds = std::chrono::duration<double>(t1-t0).count();
+	r.items = items;
+	r.peakMemory = getPeakMemory();
+	results.push_back(r);
+	std::cout << std::left << std::setw(36) << plant << std::right << std::setw(5) << plants << std::setw(6) << dx << "  "
+		<< std::left << std::setw(20) << operation << std::right << std::setw(12) << std::setprecision(4) << r.seconds << " s"
+		<< std::setw(14) << std::setprecision(4) << ((r.seconds>0) ? items/r.seconds : 0.) << " /s"
+		<< std::setw(10) << r.peakMemory/1024 << " MB\n";
+}
+
+/**
+ * Simulates an ensemble of plants with axial resolution dx, and times all operations on the result
+ */
+void Benchmark::run(const std::string& plant, int plants, double dx)
+{
+	this->plant = plant;
+	this->plants = plants;
+	this->dx = dx;
+
+	RootSystemEnsemble e(threads);
+	{
+		Silence s;
+		e.openFile(plant, folder);
+		RootSystem* p = e.getParameters();
+		for (int t=1; ; t++) { // all defined root types
+			RootTypeParameter* rtp;
+			try {
+				rtp = p->getRootTypeParameter(t);
+			} catch (const std::out_of_range&) {
+				break;
+			}
+			if (rtp->type>0) {
+				rtp->dx = dx;
+			}
+		}
+		int nx = std::round(std::sqrt(double(plants)));
+		int ny = plants/nx;
+		if (nx*ny!=plants) {
+			nx = plants;
+			ny = 1;
+		}
+		e.setGrid(nx, ny, 20., 20., 3.);
+		e.setSeed(1);
+		e.initialize();
+	}
+
+	time("simulate", [&]() { Silence s; e.simulate(days, true); return long(e.getNumberOfSegments()); });
+	long n = e.getNumberOfSegments();
+
+	time("getNodes", [&]() { for (auto rs : e.getPlants()) { rs->getNodes(); } return n; });
+	time("getSegments", [&]() { for (auto rs : e.getPlants()) { rs->getSegments(); } return n; });
+
+	SegmentAnalyser a;
+	time("SegmentAnalyser", [&]() { a = e.getSegmentAnalyser(); return n; });
+	SDF_PlantBox box(20., 20., 30.);
+	time("crop", [&]() { SegmentAnalyser c(a); c.crop(&box); return n; });
+	time("distribution", [&]() { a.distribution(RootSystem::st_length, 0., -100., 100, true); return n; });
+
+	time("push", [&]() { for (auto rs : e.getPlants()) { rs->push(); } return n; });
+	{
+		Silence s;
+		for (auto rs : e.getPlants()) {
+			rs->simulate(1., true);
+		}
+	}
+	time("pop", [&]() { for (auto rs : e.getPlants()) { rs->pop(); } return n; });
+
+	time("writeVTP ascii", [&]() { for (auto rs : e.getPlants()) { std::ostringstream os; rs->writeVTP(os); } return n; });
+	time("writeVTP raw", [&]() { for (auto rs : e.getPlants()) { std::ostringstream os; rs->writeVTP(os, VTPWriter::vtp_raw); } return n; });
+	time("writeRSML", [&]() { for (auto rs : e.getPlants()) { std::ostringstream os; rs->writeRSML(os); } return n; });
+}
+
+/**
+ * Times the random optimization of the heading (unconfined, and confined by a geometry)
+ */
+void Benchmark::runHeading(const std::string& plant)
+{
+	this->plant = plant;
+	this->plants = 1;
+	this->dx = 0.;
+	RootSystem rs;
+	{
+		Silence s;
+		rs.openFile(plant, folder);
+	}
+	RootTypeParameter* rtp = rs.getRootTypeParameter(1);
+	Gravitropism tropism(std::max(rtp->tropismN, 1.), rtp->tropismS);
+	tropism.setSeed(1);
+	const long calls = 100000;
+	Vector3d down(0.,0.,-1.);
+	Matrix3d old = Matrix3d::ons(down);
+	time("getHeading", [&]() {
+		for (long i=0; i<calls; i++) {
+			tropism.getHeading(Vector3d(0., 0., -1.-(i%100)*0.1), old, 1.);
+		}
+		return calls;
+	});
+	SDF_PlantBox box(5., 5., 20.);
+	tropism.setGeometry(&box);
+	time("getHeading confined", [&]() {
+		for (long i=0; i<calls; i++) {
+			tropism.getHeading(Vector3d(2.4, 0., -1.-(i%100)*0.1), old, 1.);
+		}
+		return calls;
+	});
+}
+
+void Benchmark::writeCSV(std::ostream& os) const
+{
+	os << "plant,plants,dx,days,operation,seconds,items,items_per_s,peak_memory_kb\n";
+	for (const auto& r : results) {
+		os << r.plant << "," << r.plants << "," << r.dx << "," << r.days << "," << r.operation << "," << r.seconds << ","
+			<< r.items << "," << ((r.seconds>0) ? r.items/r.seconds : 0.) << "," << r.peakMemory << "\n";
+	}
+}
+
+void Benchmark::writeJSON(std::ostream& os) const
+{
+	os << "{\n\"threads\": " << threads << ",\n\"results\": [\n";
+	for (size_t i=0; i<results.size(); i++) {
+		const auto& r = results[i];
+		os << "{\"plant\": \"" << r.plant << "\", \"plants\": " << r.plants << ", \"dx\": " << r.dx << ", \"days\": " << r.days
+			<< ", \"operation\": \"" << r.operation << "\", \"seconds\": " << r.seconds << ", \"items\": " << r.items
+			<< ", \"items_per_s\": " << ((r.seconds>0) ? r.items/r.seconds : 0.) << ", \"peak_memory_kb\": " << r.peakMemory << "}"
+			<< ((i+1<results.size()) ? ",\n" : "\n");
+	}
+	os << "]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	Benchmark b;
+	bool quick = false;
+	std::string prefix = "benchmark";
+	std::vector<std::string> plants;
+	for (int i=1; i<argc; i++) {
+		std::string arg = argv[i];
+		if (arg=="-q") {
+			quick = true;
+		} else if ((arg=="-t") && (i+1<argc)) {
+			b.days = std::stod(argv[++i]);
+		} else if ((arg=="-j") && (i+1<argc)) {
+			b.threads = std::stoi(argv[++i]);
+		} else if ((arg=="-d") && (i+1<argc)) {
+			b.folder = argv[++i];
+		} else if ((arg=="-o") && (i+1<argc)) {
+			prefix = argv[++i];
+		} else if ((!arg.empty()) && (arg[0]=='-')) {
+			std::cout << "Usage: benchmark [-q] [-t days] [-j threads] [-d parameter folder] [-o output prefix] [plant names ...]\n";
+			return 1;
+		} else {
+			plants.push_back(arg);
+		}
+	}
+	if (plants.empty()) {
+		plants = { "Anagallis_femina_Leitner_2010", "Zea_mays_1_Leitner_2010" };
+	}
+
+	std::vector<std::pair<int, double>> scales; // (plants, dx), increasing size
+	if (quick) {
+		b.days = 10.;
+		scales = { {1, 1.}, {1, 0.5}, {10, 1.} };
+	} else {
+		scales = { {1, 1.}, {1, 0.5}, {1, 0.1}, {10, 1.}, {100, 1.} };
+	}
+
+	try {
+		for (const auto& p : plants) {
+			b.runHeading(p);
+			for (const auto& s : scales) {
+				b.run(p, s.first, s.second);
+			}
+		}
+	} catch (const std::exception& e) {
+		std::cout << "benchmark failed: " << e.what() << "\n";
+		return 1;
+	}
+
+	std::ofstream csv((prefix+".csv").c_str());
+	b.writeCSV(csv);
+	std::ofstream json((prefix+".json").c_str());
+	b.writeJSON(json);
+	std::cout << "results written to " << prefix << ".csv and " << prefix << ".json\n";
+	return 0;
+}
@@ -0,0 +1,145 @@
+#include "checkpoint.h"
+
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CROOTBOX_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char magic[8] = { 'C','R','B','X','S','T','A','T' };
+
+const uint32_t CheckpointWriter::version;
+const uint32_t CheckpointWriter::byteOrderMark;
+
+/**
+ * Constructor, writes the file header
+ *
+ * @param os        out stream (opened in binary mode)
+ */
+CheckpointWriter::CheckpointWriter(std::ostream& os) :os(os)
+{
+	write(magic, 8);
+	put(version);
+	put(byteOrderMark);
+}
+
+
+
+/**
+ * Reads the checkpoint from a buffer
+ *
+ * @param data      the checkpoint, e.g. a memory mapped file
+ * @param size      size of the buffer [bytes]
+ */
+CheckpointReader::CheckpointReader(const char* data, size_t size) :data(data), size(size)
+{
+	readHeader();
+}
+
+/**
+ * Maps the file into memory (POSIX), or reads it into a buffer
+ *
+ * @param name      file name
+ */
+CheckpointReader::CheckpointReader(std::string name)
+{
+#ifdef CROOTBOX_MMAP
+	int fd = open(name.c_str(), O_RDONLY);
+	if (fd<0) {
+		throw std::invalid_argument("CheckpointReader::CheckpointReader() could not open file "+name);
+	}
+	struct stat st;
+	if ((fstat(fd, &st)==0) && (st.st_size>0)) {
+		void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m!=MAP_FAILED) {
+			mapping = m;
+			mappingSize = st.st_size;
+		}
+	}
+	close(fd);
+#endif
+	if (mapping!=nullptr) {
+		data = static_cast<const char*>(mapping);
+		size = mappingSize;
+	} else {
+		std::ifstream fis(name.c_str(), std::ios::binary);
+		if (!fis.good()) {
+			throw std::invalid_argument("CheckpointReader::CheckpointReader() could not open file "+name);
+		}
+		std::stringstream ss;
+		ss << fis.rdbuf();
+		buffer = ss.str();
+		data = buffer.data();
+		size = buffer.size();
+	}
+	readHeader();
+}
+
+/**
+ * Destructor, unmaps the file
+ */
+CheckpointReader::~CheckpointReader()
+{
+#ifdef CROOTBOX_MMAP
+	if (mapping!=nullptr) {
+		munmap(mapping, mappingSize);
+	}
+#endif
+}
+
+/**
+ * Checks magic, version, and byte order of the checkpoint
+ */
+void CheckpointReader::readHeader()
+{
+	if ((size<16) || (std::memcmp(data, magic, 8)!=0)) {
+		throw std::invalid_argument("CheckpointReader::readHeader() not a CRootBox checkpoint");
+	}
+	pos = 8;
+	fileVersion = get<uint32_t>();
+	if (get<uint32_t>()!=CheckpointWriter::byteOrderMark) {
+		throw std::invalid_argument("CheckpointReader::readHeader() the checkpoint was written with a different byte order");
+	}
+	if ((fileVersion<1) || (fileVersion>CheckpointWriter::version)) {
+		throw std::invalid_argument("CheckpointReader::readHeader() unsupported checkpoint version "+std::to_string(fileVersion));
+	}
+}
+
+/**
+ * Reads a four character record tag
+ *
+ * @param tag       the expected tag
+ */
+void CheckpointReader::expectTag(const char* tag)
+{
+	if (std::memcmp(take(4), tag, 4)!=0) {
+		throw std::invalid_argument("CheckpointReader::expectTag() corrupt checkpoint, expected record "+std::string(tag, 4));
+	}
+}
+
+/**
+ * Returns the next n bytes, throws if the buffer ends
+ */
+const char* CheckpointReader::take(size_t n)
+{
+	if (n>size-pos) {
+		throw std::invalid_argument("CheckpointReader::take() unexpected end of checkpoint");
+	}
+	const char* p = data+pos;
+	pos += n;
+	return p;
+}
+
+size_t CheckpointReader::getSize(size_t elementSize)
+{
+	uint64_t n = get<uint64_t>();
+	if (n>(size-pos)/elementSize) {
+		throw std::invalid_argument("CheckpointReader::getSize() unexpected end of checkpoint");
+	}
+	return size_t(n);
+}
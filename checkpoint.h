@@ -0,0 +1,101 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * CheckpointWriter
+ *
+ * Writes the binary checkpoint format of RootSystem::saveState. The file starts with the magic "CRBXSTAT",
+ * the format version (uint32), and a byte order mark (uint32 0x01020304), followed by tagged records (in the order
+ * written by RootSystem::writeState).
+ *
+ * Values are written in host byte order. Each array is written as its number of elements (uint64) at the next
+ * multiple of 8 bytes, directly followed by the elements. Therefore, all arrays are aligned within the file, and can be
+ * read in place from a memory mapped file (@see CheckpointReader).
+ */
+class CheckpointWriter
+{
+
+public:
+
+	static const uint32_t version = 2; ///< current version of the format (2: random streams)
+	static const uint32_t byteOrderMark = 0x01020304;
+
+	CheckpointWriter(std::ostream& os); ///< writes the file header
+
+	template<class T>
+	void put(const T& v) { write(reinterpret_cast<const char*>(&v), sizeof(T)); } ///< writes a plain value
+	template<class T>
+	void putArray(const T* v, size_t n) { pad(); put(uint64_t(n)); write(reinterpret_cast<const char*>(v), n*sizeof(T)); } ///< writes an aligned array
+	template<class T>
+	void putVector(const std::vector<T>& v) { putArray(v.data(), v.size()); } ///< writes an aligned array
+	void putString(const std::string& s) { putArray(s.data(), s.size()); } ///< writes a string
+	void putTag(const char* tag) { write(tag, 4); } ///< writes a four character record tag
+
+private:
+
+	void write(const char* p, size_t n) { os.write(p, n); pos += n; }
+	void pad() { static const char zeros[8] = { }; write(zeros, (8-pos%8)%8); }
+
+	std::ostream& os;
+	size_t pos = 0; // bytes written
+
+};
+
+
+
+/**
+ * CheckpointReader
+ *
+ * Reads the binary checkpoint format (@see CheckpointWriter) from memory, or from a file
+ * that is memory mapped (if available, otherwise it is read into memory).
+ *
+ * Arrays can be accessed in place (CheckpointReader::getArray), all reads are bounds checked.
+ */
+class CheckpointReader
+{
+
+public:
+
+	CheckpointReader(const char* data, size_t size); ///< reads from a buffer (that must be valid during the lifetime of the reader)
+	CheckpointReader(std::string name); ///< maps or reads the file
+	CheckpointReader(const CheckpointReader& r) = delete;
+	virtual ~CheckpointReader();
+
+	uint32_t getVersion() const { return fileVersion; } ///< format version of the checkpoint
+
+	template<class T>
+	T get() { T v; std::memcpy(&v, take(sizeof(T)), sizeof(T)); return v; } ///< reads a plain value
+	template<class T>
+	const T* getArray(size_t& n) { skipPadding(); n = getSize(sizeof(T)); return reinterpret_cast<const T*>(take(n*sizeof(T))); }
+	///< returns a pointer to the n elements of an array within the buffer (aligned, if the buffer is aligned to 8 bytes)
+	template<class T>
+	std::vector<T> getVector() { size_t n; const T* p = getArray<T>(n); std::vector<T> v(n); if (n>0) { std::memcpy(v.data(), p, n*sizeof(T)); } return v; } ///< copies an array
+	std::string getString() { size_t n; const char* p = getArray<char>(n); return std::string(p, n); } ///< copies a string
+	void expectTag(const char* tag); ///< reads a record tag, throws if it differs
+
+private:
+
+	void readHeader();
+	const char* take(size_t n);
+	size_t getSize(size_t elementSize); ///< reads the number of elements of an array, throws if the array exceeds the buffer
+	void skipPadding() { take((8-pos%8)%8); }
+
+	const char* data = nullptr;
+	size_t size = 0;
+	size_t pos = 0; // bytes read
+	uint32_t fileVersion = 0;
+
+	std::string buffer; // file content, if the file is not mapped
+	void* mapping = nullptr; // mapped file (or nullptr)
+	size_t mappingSize = 0;
+
+};
+
+#endif
@@ -21,8 +21,8 @@ rs.simulate(dt)
 #     rs.simulate(1) 
 
 # Create graph
-nodes = vv2a(rs.getNodes())/100 # convert from cm to m 
-rseg = seg2a(rs.getSegments()) # root system segments
+nodes = vv2a(rs.getNodesArray())/100 # convert from cm to m 
+rseg = seg2a(rs.getSegmentsArray()) # root system segments
 sseg = seg2a(rs.getShootSegments()) # additional shoot segments
 seg = np.vstack((sseg,rseg))
 print("number of segments",len(seg))
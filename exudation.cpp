@@ -0,0 +1,161 @@
+#include "exudation.h"
+
+#include "RootSystem.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <limits>
+
+/*
+ * 5-point Gauss-Legendre rule on [-1,1] (same rule as gauss_legendre(5,...))
+ */
+static const int glN = 5;
+static const double glX[glN] = { 0., -0.5384693101056831, 0.5384693101056831, -0.9061798459386640, 0.9061798459386640 };
+static const double glW[glN] = { 0.5688888888888889, 0.4786286704993665, 0.4786286704993665, 0.2369268850561891, 0.2369268850561891 };
+
+/**
+ * Moving point source of a single root tip, with the integrand evaluated at the quadrature points
+ */
+struct ExudationSource {
+	Vector3d a; // tip
+	Vector3d b; // source position at t = 0 (the other end of the source path)
+	double r; // cut-off radius around the source path
+	double amp[glN]; // quadrature weight times amplitude (including decay)
+	double c[glN]; // coefficient of the squared distance in the exponent
+	double sx[glN], sy[glN], sz[glN]; // source position
+};
+
+/**
+ * Returns the distance from the source path, beyond which the exponent of the integrand is smaller than ln(tol) for all times,
+ * i.e. the plume is below tol times its amplitude.
+ *
+ * The exponent is -(a/tau+b*tau), with a = d^2*R/(4*Dl), b = lambda_/R, and tau in (0, age].
+ * Its maximum over tau is -d*sqrt(lambda_/Dl) (at tau = sqrt(a/b)), or -(a/age+b*age) if sqrt(a/b)>age.
+ *
+ * @param params    exudation parameters (tol<=0 returns infinity)
+ * @param age       age of the root [s]
+ */
+double getExudationRadius(const ExudationParameters& params, double age)
+{
+	if ((params.tol<=0) || (params.tol>=1)) {
+		return (params.tol>=1) ? 0. : std::numeric_limits<double>::infinity();
+	}
+	double L = -std::log(params.tol);
+	const double& Dl = params.Dl;
+	const double& R = params.R;
+	const double& l = params.lambda_;
+	if (l>0) {
+		double d = L*std::sqrt(Dl/l);
+		if (d*R/(2.*std::sqrt(Dl*l))<=age) {
+			return d;
+		}
+	}
+	return std::sqrt(std::max(4.*Dl*age*(L-l*age/R)/R, 0.));
+}
+
+/**
+ * Exudate concentration of all root tips in a regular grid, computed as superposition of moving point sources
+ * (analytical solution based on Carslaw and Jaeger), integrated over the age of each root with a 5-point Gauss-Legendre rule.
+ *
+ * Voxels ([-width/2, width/2]^2 x [-depth,0]) farther than getExudationRadius from the source path of a root are skipped
+ * (if params.tol>0). The grid columns (x,y) are computed in parallel, each voxel sums the roots in the same order,
+ * therefore the result does not depend on the number of threads.
+ *
+ * @param rootsystem    the root system
+ * @param params        exudation parameters
+ * @param X             number of voxels in x-direction
+ * @param Y             number of voxels in y-direction
+ * @param Z             number of voxels in z-direction
+ * @param width         width of the domain in x- and y-direction [cm]
+ * @param depth         depth of the domain [cm]
+ *
+ * \return the concentration per voxel (index x*Y*Z+y*Z+z)
+ */
+std::vector<double> getExudateConcentration(RootSystem& rootsystem, ExudationParameters& params, int X, int Y, int Z, double width, double depth)
+{
+	const ExudationParameters& p = params;
+	double simtime = rootsystem.getSimTime();
+
+	std::vector<ExudationSource> sources;
+	for (const auto& r : rootsystem.getRoots()) {
+		double age = simtime - r->getNodeETime(0);
+		if (age<=0) {
+			continue;
+		}
+		ExudationSource s;
+		s.a = r->getNode(r->getNumberOfNodes()-1);
+		Vector3d v = r->getNode(0).minus(s.a); // towards the base
+		double vl = v.length();
+		v = (vl>0) ? v.times(1./vl) : Vector3d(0.,0.,0.);
+		s.b = s.a.plus(v.times(age/p.R));
+		s.r = getExudationRadius(p, age);
+		for (int k=0; k<glN; k++) {
+			double t = age/2.*(1.+glX[k]);
+			double tau = age-t;
+			s.amp[k] = age/2.*glW[k]*p.M/(8*p.theta*std::sqrt(M_PI*M_PI*M_PI*p.Dt*p.Dt*p.Dl*tau*tau*tau))*std::exp(-p.lambda_*tau/p.R);
+			s.c[k] = p.R/(4.*p.Dl*tau);
+			s.sx[k] = s.a.x+v.x*tau/p.R;
+			s.sy[k] = s.a.y+v.y*tau/p.R;
+			s.sz[k] = s.a.z+v.z*tau/p.R;
+		}
+		sources.push_back(s);
+	}
+
+	std::vector<double> allc = std::vector<double>(X*Y*Z, 0.);
+	std::vector<double> zc(Z);
+	for (int z=0; z<Z; z++) {
+		zc[z] = ((-double(z))/Z)*depth;
+	}
+
+	parallelFor(size_t(X)*Y, params.threads, [&](size_t i) {
+		int x = i/Y;
+		int y = i%Y;
+		double px = ((double(x)-double(X)/2.)/X)*width;
+		double py = ((double(y)-double(Y)/2.)/Y)*width;
+		double* col = &allc[i*Z];
+		for (const auto& s : sources) {
+			int z0 = 0, z1 = Z; // voxel range [z0,z1) in the cut-off radius
+			if (std::isfinite(s.r)) {
+				// part [s0,s1] of the path within the horizontal distance r of the column
+				double dx = s.b.x-s.a.x, dy = s.b.y-s.a.y;
+				double wx = px-s.a.x, wy = py-s.a.y;
+				double dd = dx*dx+dy*dy, wd = wx*dx+wy*dy, ww = wx*wx+wy*wy-s.r*s.r;
+				double s0 = 0., s1 = 1.;
+				if (dd>0) {
+					double disc = wd*wd-dd*ww;
+					if (disc<0) {
+						continue;
+					}
+					s0 = std::max((wd-std::sqrt(disc))/dd, 0.);
+					s1 = std::min((wd+std::sqrt(disc))/dd, 1.);
+				} else if (ww>0) {
+					continue;
+				}
+				if (s0>s1) {
+					continue;
+				}
+				double za = s.a.z+s0*(s.b.z-s.a.z), zb = s.a.z+s1*(s.b.z-s.a.z);
+				double top = std::max(za, zb)+s.r, bot = std::min(za, zb)-s.r;
+				if ((depth<=0) || (top<zc[Z-1]) || (bot>0)) {
+					continue;
+				}
+				z0 = std::max(int(std::ceil(-top*Z/depth)), 0);
+				z1 = std::min(int(std::floor(-bot*Z/depth))+1, Z);
+			}
+			for (int k=0; k<glN; k++) {
+				double dx = px-s.sx[k], dy = py-s.sy[k];
+				double e = s.amp[k]*std::exp(-s.c[k]*(dx*dx+dy*dy));
+				if (e==0.) {
+					continue;
+				}
+				double c = s.c[k], sz = s.sz[k];
+				for (int z=z0; z<z1; z++) { // contiguous, independent iterations
+					double dz = zc[z]-sz;
+					col[z] += e*std::exp(-c*dz*dz);
+				}
+			}
+		}
+	});
+
+	return allc;
+}
@@ -0,0 +1,43 @@
+#ifndef EXUDATION_H_
+#define EXUDATION_H_
+
+#include <vector>
+
+#include "mymath.h"
+
+class RootSystem;
+
+/**
+ * Parameters of the exudation
+ *
+ * Analytical solution of moving point sources based on Carslaw and Jaeger (@see getExudateConcentration)
+ */
+class ExudationParameters {
+public:
+	// static
+	double M=1e-5;
+	double Dt=1e-5;  //cm2/s
+	double Dl=Dt;
+	double theta=0.3;
+	double R=1;
+	double lambda_=1e-6;
+
+	// evaluation
+	double tol=0.; ///< relative cut-off of the plume, voxels beyond the resulting radius are skipped (0 evaluates all voxels), @see getExudationRadius
+	int threads=0; ///< number of threads (<=0 uses all hardware threads, 1 runs serially)
+
+	// update for each root (not used by getExudateConcentration)
+	double age_r;
+	Vector3d tip;
+	Vector3d v;
+
+	// update for each position (not used by getExudateConcentration)
+	Vector3d pos;
+};
+
+double getExudationRadius(const ExudationParameters& params, double age); ///< distance from the source path beyond which the plume is below params.tol
+
+std::vector<double> getExudateConcentration(RootSystem& rootsystem, ExudationParameters& params, int X, int Y, int Z, double width, double depth);
+///< exudate concentration of all root tips in a regular grid of X*Y*Z voxels (index x*Y*Z+y*Z+z)
+
+#endif
@@ -54,8 +54,11 @@ public:
 class LinearGrowth : public GrowthFunction
 {
 public:
-    virtual double getLength(double t, double r, double k, Root* root) const override { return std::min(k,r*t); } ///< @see GrowthFunction
-    virtual double getAge(double l, double r, double k, Root* root)  const override { return l/r; } ///< @see GrowthFunction
+    virtual double getLength(double t, double r, double k, Root* root) const override { return length(t, r, k); } ///< @see GrowthFunction
+    virtual double getAge(double l, double r, double k, Root* root)  const override { return age(l, r, k); } ///< @see GrowthFunction
+
+    static double length(double t, double r, double k) { return std::min(k,r*t); } ///< non virtual getLength (called inline by Root)
+    static double age(double l, double r, double k) { return l/r; } ///< non virtual getAge (called inline by Root)
 
     virtual GrowthFunction* copy() { return new LinearGrowth(*this); }
 };
@@ -67,13 +70,16 @@ public:
 class ExponentialGrowth : public GrowthFunction
 {
 public:
-    virtual double getLength(double t, double r, double k, Root* root) const override { return k*(1-exp(-(r/k)*t)); } ///< @see GrowthFunction
-    virtual double getAge(double l, double r, double k, Root* root) const override {
+    virtual double getLength(double t, double r, double k, Root* root) const override { return length(t, r, k); } ///< @see GrowthFunction
+    virtual double getAge(double l, double r, double k, Root* root) const override { return age(l, r, k); } ///< @see GrowthFunction
+
+    static double length(double t, double r, double k) { return k*(1-exp(-(r/k)*t)); } ///< non virtual getLength (called inline by Root)
+    static double age(double l, double r, double k) {
         if (l>(0.999*k)) { // 0.999*k is reached in finite time
             l=0.999*k;
         }
         return - k/r*log(1-l/k);
-    } ///< @see GrowthFunction
+    } ///< non virtual getAge (called inline by Root)
 
     virtual GrowthFunction* copy() { return new ExponentialGrowth(*this); }
 };
@@ -2,6 +2,7 @@
 
 #include "RootSystem.h"
 #include "analysis.h"
+#include "exudation.h"
 
 #include <iostream>
 #include <fstream>
@@ -0,0 +1,446 @@
+#include "RootSystemField.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+/**
+ * Creates an empty field on the ranks of the communicator, with a default decomposition of the ranks into tiles
+ * (@see MPI_Dims_create)
+ *
+ * @param comm      the communicator (all of its ranks must call the collective methods)
+ * @param threads   threads per rank for the simulation of its plants (<=0 uses all hardware threads)
+ */
+RootSystemField::RootSystemField(MPI_Comm comm, int threads) : comm(comm), threads(threads)
+{
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	int dims[2] = { 0, 0 };
+	MPI_Dims_create(size, 2, dims);
+	tx = dims[0];
+	ty = dims[1];
+}
+
+/**
+ * Destructor, deletes the plants of this rank
+ */
+RootSystemField::~RootSystemField()
+{
+	reset();
+}
+
+/**
+ * Deletes the plants of this rank, keeps parameters, positions, and tiles
+ */
+void RootSystemField::reset()
+{
+	for (auto p : plants) {
+		delete p;
+	}
+	plants.clear();
+	indices.clear();
+	simtime = 0;
+}
+
+/**
+ * Sets the seed positions of all plants of the field, the bounding box of the positions is split into the tiles
+ *
+ * @param seedPos   one seed position per plant [cm], the same on all ranks
+ */
+void RootSystemField::setPositions(const std::vector<Vector3d>& seedPos)
+{
+	positions = seedPos;
+	if (!positions.empty()) {
+		minPos = positions[0];
+		maxPos = positions[0];
+	}
+	for (const auto& p : positions) {
+		minPos = Vector3d(std::min(minPos.x, p.x), std::min(minPos.y, p.y), std::min(minPos.z, p.z));
+		maxPos = Vector3d(std::max(maxPos.x, p.x), std::max(maxPos.y, p.y), std::max(maxPos.z, p.z));
+	}
+}
+
+/**
+ * Places nx*ny plants on a regular grid starting at (0,0,-depth), the x-index runs fastest
+ *
+ * @param nx        number of plants along the x-axis
+ * @param ny        number of plants along the y-axis
+ * @param dx        distance between the plants along the x-axis [cm]
+ * @param dy        distance between the plants along the y-axis [cm]
+ * @param depth     planting depth [cm]
+ */
+void RootSystemField::setGrid(int nx, int ny, double dx, double dy, double depth)
+{
+	std::vector<Vector3d> pos;
+	for (int j=0; j<ny; j++) {
+		for (int i=0; i<nx; i++) {
+			pos.push_back(Vector3d(i*dx, j*dy, -depth));
+		}
+	}
+	setPositions(pos);
+}
+
+/**
+ * Sets the decomposition of the ranks into tiles, tile (i,j) is simulated by rank j*tx+i
+ *
+ * @param tx        number of tiles along the x-axis
+ * @param ty        number of tiles along the y-axis
+ */
+void RootSystemField::setTiles(int tx, int ty)
+{
+	if ((tx<1) || (ty<1) || (tx*ty!=size)) {
+		throw std::invalid_argument("RootSystemField::setTiles() the number of tiles must equal the number of ranks");
+	}
+	this->tx = tx;
+	this->ty = ty;
+}
+
+/**
+ * Tile column of a x-coordinate, coordinates beyond the bounding box of the positions belong to the first or last column
+ *
+ * @param x         x-coordinate [cm]
+ */
+int RootSystemField::getTileX(double x) const
+{
+	double w = maxPos.x-minPos.x;
+	int i = (w>0) ? int(std::floor((x-minPos.x)/w*tx)) : 0;
+	return std::max(std::min(i, tx-1), 0);
+}
+
+/**
+ * Tile row of a y-coordinate, coordinates beyond the bounding box of the positions belong to the first or last row
+ *
+ * @param y         y-coordinate [cm]
+ */
+int RootSystemField::getTileY(double y) const
+{
+	double h = maxPos.y-minPos.y;
+	int j = (h>0) ? int(std::floor((y-minPos.y)/h*ty)) : 0;
+	return std::max(std::min(j, ty-1), 0);
+}
+
+/**
+ * Creates the plants within the tile of this rank, copies the parameters, and initializes the plants.
+ *
+ * The seeds of all plants of the field are drawn in plant order from a generator seeded with the field seed
+ * (or the system clock of rank 0, if no seed was set), each rank keeps the seeds of its plants.
+ *
+ * @param basal         basal root type, @see RootSystem::initialize
+ * @param shootborne    shoot borne root type, @see RootSystem::initialize
+ */
+void RootSystemField::initialize(int basal, int shootborne)
+{
+	reset();
+	if (positions.empty()) {
+		throw std::invalid_argument("RootSystemField::initialize() no plant positions were set");
+	}
+	unsigned int s = seed;
+	if (!manualSeed) {
+		s = std::chrono::system_clock::now().time_since_epoch().count();
+		MPI_Bcast(&s, 1, MPI_UNSIGNED, 0, comm);
+	}
+	std::mt19937 gen(s);
+	std::uniform_int_distribution<unsigned int> UID;
+	for (size_t i=0; i<positions.size(); i++) {
+		unsigned int plantSeed = UID(gen); // drawn for every plant, to keep the seeds in plant order
+		if (getTile(positions[i])!=rank) {
+			continue;
+		}
+		RootSystem* rs = new RootSystem(prototype);
+		rs->getRootSystemParameter()->seedPos = positions[i];
+		if (geometry!=nullptr) {
+			rs->setGeometry(geometry, geometryProjection);
+		}
+		rs->setSoil(soil);
+		rs->setSeed(plantSeed);
+		plants.push_back(rs);
+		indices.push_back(i);
+	}
+	parallelFor(plants.size(), threads, [&](size_t i) {
+		plants[i]->initialize(basal, shootborne);
+	});
+}
+
+/**
+ * Simulates the plants of this rank for time span dt, each plant is simulated by a single thread
+ *
+ * @param dt        time step [days]
+ * @param silence   indicates if status is written to the console of rank 0 (cout) (default = false)
+ */
+void RootSystemField::simulate(double dt, bool silence)
+{
+	if ((!silence) && (rank==0)) {
+		std::cout << "RootSystemField.simulate(dt) " << positions.size() << " plants on " << size << " ranks from "<< simtime << " to "
+			<< simtime+dt << " days \n";
+	}
+	parallelFor(plants.size(), threads, [&](size_t i) {
+		plants[i]->simulate(dt, true);
+	});
+	simtime += dt;
+}
+
+/**
+ * Simulates the plants for the time span defined in the parameter set
+ */
+void RootSystemField::simulate()
+{
+	this->simulate(prototype.getRootSystemParameter()->simtime);
+}
+
+/**
+ * Summed number of segments of all plants of the field (collective)
+ */
+long long RootSystemField::getNumberOfSegments() const
+{
+	long long n = 0;
+	for (auto p : plants) {
+		n += p->getNumberOfSegments();
+	}
+	long long s = 0;
+	MPI_Allreduce(&n, &s, 1, MPI_LONG_LONG, MPI_SUM, comm);
+	return s;
+}
+
+/**
+ * Sums a vector over all ranks (collective), all ranks must pass vectors of the same size
+ *
+ * @param v         the values of this rank
+ * \return          the element wise sum, on all ranks
+ */
+std::vector<double> RootSystemField::allreduce(std::vector<double> v) const
+{
+	std::vector<double> s(v.size(), 0.);
+	if (!v.empty()) {
+		MPI_Allreduce(v.data(), s.data(), int(v.size()), MPI_DOUBLE, MPI_SUM, comm);
+	}
+	return s;
+}
+
+/**
+ * Analyses the local plants one after another (in plant order, to keep memory low), and sums the results over all ranks
+ *
+ * @param n         size of the results
+ * @param f         called as f(const SegmentAnalyser& a), returns n values
+ */
+template<class F>
+std::vector<double> RootSystemField::reduce(size_t n, F f) const
+{
+	std::vector<double> v(n, 0.);
+	for (auto p : plants) {
+		SegmentAnalyser a(*p);
+		std::vector<double> r = f(a);
+		for (size_t i=0; i<n; i++) {
+			v[i] += r[i];
+		}
+	}
+	return allreduce(v);
+}
+
+/**
+ * Sums up the parameter over all plants of the field (collective), @see SegmentAnalyser::getSummed
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ */
+double RootSystemField::getSummed(int st) const
+{
+	return reduce(1, [&](const SegmentAnalyser& a) { return std::vector<double>(1, a.getSummed(st)); })[0];
+}
+
+/**
+ * Sums up the parameter within the geometry over all plants of the field (collective), @see SegmentAnalyser::getSummed
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param geometry  signed distance function of the geometry
+ */
+double RootSystemField::getSummed(int st, SignedDistanceFunction* geometry) const
+{
+	return reduce(1, [&](const SegmentAnalyser& a) { return std::vector<double>(1, a.getSummed(st, geometry)); })[0];
+}
+
+/**
+ * Vertical distribution of a parameter over all plants of the field (collective), @see SegmentAnalyser::distribution
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param top       vertical top position (cm)
+ * @param bot       vertical bot position (cm)
+ * @param n         number of layers (each with a height of (bot-top)/n )
+ * @param exact     calculates the intersection with the layer boundaries (true), only based on segment center (false)
+ * \return          vector containing the summed parameter per layer, on all ranks
+ */
+std::vector<double> RootSystemField::distribution(int st, double top, double bot, int n, bool exact) const
+{
+	return reduce(n, [&](const SegmentAnalyser& a) { return a.distribution(st, top, bot, n, exact); });
+}
+
+/**
+ * 2d distribution (x,z) of a parameter over all plants of the field (collective), @see SegmentAnalyser::distribution2
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param top       vertical top position (cm)
+ * @param bot       vertical bot position (cm)
+ * @param left      left along x-axis (cm)
+ * @param right     right along x-axis (cm)
+ * @param n         number of vertical layers
+ * @param m         number of horizontal layers
+ * @param exact     calculates the intersection with the layer boundaries (true), only based on segment center (false)
+ * \return          n vectors of m values each, on all ranks
+ */
+std::vector<std::vector<double>> RootSystemField::distribution2(int st, double top, double bot, double left, double right, int n, int m,
+	bool exact) const
+{
+	std::vector<double> v = reduce(size_t(n)*m, [&](const SegmentAnalyser& a) {
+		std::vector<std::vector<double>> d = a.distribution2(st, top, bot, left, right, n, m, exact);
+		std::vector<double> r;
+		for (const auto& row : d) {
+			r.insert(r.end(), row.begin(), row.end());
+		}
+		return r;
+	});
+	std::vector<std::vector<double>> d(n);
+	for (int i=0; i<n; i++) {
+		d[i] = std::vector<double>(v.begin()+size_t(i)*m, v.begin()+size_t(i+1)*m);
+	}
+	return d;
+}
+
+/**
+ * 3d distribution of a parameter on a regular grid over all plants of the field (collective), @see SegmentAnalyser::distribution3
+ *
+ * @param st        parameter type @see RootSystem::ScalarType
+ * @param min       lower corner of the grid [cm]
+ * @param max       upper corner of the grid [cm]
+ * @param nx,ny,nz  number of cells along each axis
+ * @param exact     calculates the intersection with the cell boundaries (true), only based on segment center (false)
+ * \return          the summed parameter per cell (index (i*ny+j)*nz+k), on all ranks
+ */
+std::vector<double> RootSystemField::distribution3(int st, Vector3d min, Vector3d max, int nx, int ny, int nz, bool exact) const
+{
+	return reduce(size_t(nx)*ny*nz, [&](const SegmentAnalyser& a) { return a.distribution3(st, min, max, nx, ny, nz, exact); });
+}
+
+
+
+/**
+ * Index range of the grid points of one tile along an axis
+ *
+ * @param g         grid points along the axis (increasing)
+ * @param tile      tile of a coordinate along the axis
+ * @param t         the tile
+ * @param halo      halo width in grid points
+ * @param o, oe     owned points [o, oe) (output)
+ * @param l, le     local points [l, le), i.e. the owned points and the halo (output)
+ */
+template<class T>
+static void tileRange(const std::vector<double>& g, T tile, int t, int halo, size_t& o, size_t& oe, size_t& l, size_t& le)
+{
+	size_t n = g.size();
+	o = 0;
+	while ((o<n) && (tile(g[o])<t)) {
+		o++;
+	}
+	oe = o;
+	while ((oe<n) && (tile(g[oe])==t)) {
+		oe++;
+	}
+	l = (o>size_t(halo)) ? o-halo : 0;
+	le = std::min(oe+halo, n); // not empty, even if the tile owns no points
+}
+
+/**
+ * Creates the local grid of this rank, with all values zero (collective only in the sense that all ranks must use the same grid)
+ *
+ * @param field     the field defining the tiles (call after setting its positions and tiles)
+ * @param x,y,z     grid points of the global grid along each axis (increasing, at least one per axis)
+ * @param halo      width of the halo in grid points (at least 1, e.g. for trilinear interpolation)
+ */
+FieldGrid3D::FieldGrid3D(const RootSystemField& field, const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>& z,
+	int halo) : comm(field.getCommunicator()), rank(field.getRank()), size(field.getNumberOfRanks())
+{
+	if (x.empty() || y.empty() || z.empty()) {
+		throw std::invalid_argument("FieldGrid3D::FieldGrid3D() at least one grid point per axis is needed");
+	}
+	if (halo<1) {
+		throw std::invalid_argument("FieldGrid3D::FieldGrid3D() the halo must be at least one grid point wide");
+	}
+	ox.resize(size); oxe.resize(size); oy.resize(size); oye.resize(size);
+	lx.resize(size); lxe.resize(size); ly.resize(size); lye.resize(size);
+	auto tileX = [&](double c) { return field.getTileX(c); };
+	auto tileY = [&](double c) { return field.getTileY(c); };
+	for (int r=0; r<size; r++) {
+		tileRange(x, tileX, r%field.getTilesX(), halo, ox[r], oxe[r], lx[r], lxe[r]);
+		tileRange(y, tileY, r/field.getTilesX(), halo, oy[r], oye[r], ly[r], lye[r]);
+	}
+	std::vector<double> gx(x.begin()+lx[rank], x.begin()+lxe[rank]);
+	std::vector<double> gy(y.begin()+ly[rank], y.begin()+lye[rank]);
+	xgrid = Grid1D(gx.size(), gx, std::vector<double>(gx.size()-1, 0.));
+	ygrid = Grid1D(gy.size(), gy, std::vector<double>(gy.size()-1, 0.));
+	zgrid = Grid1D(z.size(), z, std::vector<double>(z.size()-1, 0.));
+	grid = std::unique_ptr<RectilinearGrid3D>(new RectilinearGrid3D(&xgrid, &ygrid, &zgrid));
+}
+
+/**
+ * True if the local grid point (i,j,k) is owned by this rank (for any k)
+ *
+ * @param i         local x-index
+ * @param j         local y-index
+ */
+bool FieldGrid3D::isOwned(size_t i, size_t j) const
+{
+	size_t gi = lx[rank]+i;
+	size_t gj = ly[rank]+j;
+	return (gi>=ox[rank]) && (gi<oxe[rank]) && (gj>=oy[rank]) && (gj<oye[rank]);
+}
+
+/**
+ * Copies the values of the owned grid points of each rank into the halos of the other ranks (collective).
+ * Only ranks with overlapping ranges exchange messages, i.e. the neighbouring tiles.
+ */
+void FieldGrid3D::exchangeHalo()
+{
+	size_t nz = grid->nz;
+	auto overlap = [](size_t a, size_t ae, size_t b, size_t be, size_t& c, size_t& ce) {
+		c = std::max(a, b);
+		ce = std::min(ae, be);
+		return c<ce;
+	};
+	std::vector<std::vector<double>> sendBuf(size), recvBuf(size);
+	std::vector<MPI_Request> requests;
+	for (int q=0; q<size; q++) { // receive the owned points of q within the local grid
+		size_t i0, i1, j0, j1;
+		if ((q!=rank) && overlap(lx[rank], lxe[rank], ox[q], oxe[q], i0, i1) && overlap(ly[rank], lye[rank], oy[q], oye[q], j0, j1)) {
+			recvBuf[q].resize((i1-i0)*(j1-j0)*nz);
+			requests.push_back(MPI_Request());
+			MPI_Irecv(recvBuf[q].data(), int(recvBuf[q].size()), MPI_DOUBLE, q, 0, comm, &requests.back());
+		}
+	}
+	for (int q=0; q<size; q++) { // send the owned points within the local grid of q
+		size_t i0, i1, j0, j1;
+		if ((q!=rank) && overlap(lx[q], lxe[q], ox[rank], oxe[rank], i0, i1) && overlap(ly[q], lye[q], oy[rank], oye[rank], j0, j1)) {
+			std::vector<double>& buf = sendBuf[q];
+			for (size_t i=i0; i<i1; i++) {
+				for (size_t j=j0; j<j1; j++) {
+					const double* d = &grid->data[grid->index(i-lx[rank], j-ly[rank], 0)];
+					buf.insert(buf.end(), d, d+nz);
+				}
+			}
+			requests.push_back(MPI_Request());
+			MPI_Isend(buf.data(), int(buf.size()), MPI_DOUBLE, q, 0, comm, &requests.back());
+		}
+	}
+	MPI_Waitall(int(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+	for (int q=0; q<size; q++) {
+		size_t i0, i1, j0, j1;
+		if (recvBuf[q].empty() || !overlap(lx[rank], lxe[rank], ox[q], oxe[q], i0, i1) || !overlap(ly[rank], lye[rank], oy[q], oye[q], j0, j1)) {
+			continue;
+		}
+		const double* d = recvBuf[q].data();
+		for (size_t i=i0; i<i1; i++) {
+			for (size_t j=j0; j<j1; j++) {
+				std::copy(d, d+nz, &grid->data[grid->index(i-lx[rank], j-ly[rank], 0)]);
+				d += nz;
+			}
+		}
+	}
+}
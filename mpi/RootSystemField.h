@@ -0,0 +1,149 @@
+#ifndef ROOTSYSTEMFIELD_H_
+#define ROOTSYSTEMFIELD_H_
+
+#include <mpi.h>
+
+#include <memory>
+#include <vector>
+
+#include "RootSystem.h"
+#include "analysis.h"
+#include "soil.h"
+
+/**
+ * RootSystemField
+ *
+ * A field of plants (sharing the same parameter set) distributed over the ranks of an MPI communicator. The plants are
+ * assigned to the ranks by spatial tiles: the bounding box of the seed positions is split into tx*ty tiles (x-index fastest),
+ * and rank r simulates the plants within tile r (optionally with several threads, @see parallelFor).
+ *
+ * The seeds of the plants are drawn in global plant order (as in RootSystemEnsemble::initialize), therefore each plant
+ * does not depend on the number of ranks, or of threads, and equals the plant of a RootSystemEnsemble with the same seed.
+ *
+ * The analysis methods are collective: each rank analyses its own plants, and the (small) results are summed over all
+ * ranks (MPI_Allreduce), segments are never sent. Results are available on all ranks, they only differ from a serial
+ * analysis by the rounding of the summation order.
+ *
+ * Soil coupling fields are distributed with the same tiles, @see FieldGrid3D
+ */
+class RootSystemField
+{
+
+public:
+
+	RootSystemField(MPI_Comm comm = MPI_COMM_WORLD, int threads = 1); ///< threads per rank, threads<=0 uses all hardware threads
+	RootSystemField(const RootSystemField& f) = delete;
+	virtual ~RootSystemField();
+
+	// Parameter input (on all ranks)
+	void openFile(std::string name, std::string subdir="modelparameter/") { prototype.openFile(name, subdir); } ///< reads root and plant parameters of all plants
+	RootSystem* getParameters() { return &prototype; } ///< the (not simulated) root system holding the parameters that are copied to each plant
+	void setPositions(const std::vector<Vector3d>& seedPos); ///< seed positions of all plants of the field [cm] (the same on all ranks)
+	void setGrid(int nx, int ny, double dx, double dy, double depth); ///< places nx*ny plants on a regular grid, @see RootSystemEnsemble::setGrid
+	void setTiles(int tx, int ty); ///< number of tiles along the x- and y-axis (tx*ty must equal the number of ranks)
+
+	// Simulation
+	void setGeometry(SignedDistanceFunction* geom, bool projection = false) { geometry = geom; geometryProjection = projection; }
+	///< optionally, sets a confining geometry for the plants of this rank (call before initialize()), @see RootSystem::setGeometry
+	void setSoil(SoilLookUp* soil_) { soil = soil_; } ///< optionally sets the soil of the plants of this rank, e.g. FieldGrid3D::getGrid() (call before initialize())
+	void setSeed(unsigned int seed) { this->seed = seed; manualSeed = true; } ///< sets the field seed (call before initialize())
+	void initialize(int basal=4, int shootborne=5); ///< creates the plants of this rank (collective)
+	void simulate(double dt, bool silence = false); ///< simulates the plants of this rank for time span dt
+	void simulate(); ///< simulates the plants for the time defined in the root system parameters
+	double getSimTime() const { return simtime; } ///< returns the current simulation time
+	void reset(); ///< deletes the plants of this rank
+
+	// Decomposition
+	MPI_Comm getCommunicator() const { return comm; } ///< the communicator of the field
+	int getRank() const { return rank; } ///< rank of this process
+	int getNumberOfRanks() const { return size; } ///< number of ranks (and tiles)
+	int getTilesX() const { return tx; } ///< number of tiles along the x-axis
+	int getTilesY() const { return ty; } ///< number of tiles along the y-axis
+	int getTileX(double x) const; ///< tile column of a x-coordinate
+	int getTileY(double y) const; ///< tile row of a y-coordinate
+	int getTile(const Vector3d& pos) const { return getTileY(pos.y)*tx+getTileX(pos.x); } ///< rank of the tile containing the position
+
+	// Results
+	int getNumberOfPlants() const { return positions.size(); } ///< number of plants of the field
+	int getNumberOfLocalPlants() const { return plants.size(); } ///< number of plants of this rank
+	RootSystem* getLocalPlant(int i) const { return plants.at(i); } ///< the i-th plant of this rank (owned by the field)
+	int getPlantIndex(int i) const { return indices.at(i); } ///< field index of the i-th plant of this rank
+	long long getNumberOfSegments() const; ///< number of segments of all plants (collective)
+
+	// Distributed analysis (collective, @see SegmentAnalyser)
+	double getSummed(int st) const; ///< sums up the parameter over all plants
+	double getSummed(int st, SignedDistanceFunction* geometry) const; ///< sums up the parameter within the geometry over all plants
+	std::vector<double> distribution(int st, double top, double bot, int n, bool exact=false) const; ///< vertical distribution of a parameter over all plants
+	std::vector<std::vector<double>> distribution2(int st, double top, double bot, double left, double right, int n, int m, bool exact=false) const; ///< 2d distribution (x,z) over all plants
+	std::vector<double> distribution3(int st, Vector3d min, Vector3d max, int nx, int ny, int nz, bool exact=false) const; ///< 3d distribution on a regular grid over all plants
+	std::vector<double> allreduce(std::vector<double> v) const; ///< sums v over all ranks (collective)
+
+private:
+
+	template<class F>
+	std::vector<double> reduce(size_t n, F f) const; // sums f(a) of the analysers a of the local plants over all ranks
+
+	MPI_Comm comm;
+	int rank = 0;
+	int size = 1;
+	int threads = 1;
+
+	RootSystem prototype; ///< holds the parameters
+	std::vector<Vector3d> positions; ///< seed position per plant of the field
+	Vector3d minPos; ///< bounding box of the positions, split into the tiles
+	Vector3d maxPos;
+	int tx = 1;
+	int ty = 1;
+
+	std::vector<RootSystem*> plants; ///< the simulated plants of this rank
+	std::vector<int> indices; ///< their field indices
+
+	SignedDistanceFunction* geometry = nullptr;
+	bool geometryProjection = false;
+	SoilLookUp* soil = nullptr;
+
+	double simtime = 0;
+	unsigned int seed = 0;
+	bool manualSeed = false;
+
+};
+
+/**
+ * FieldGrid3D
+ *
+ * A soil coupling field on a global rectilinear grid, distributed over the ranks by the tiles of a RootSystemField: each rank
+ * owns the grid points within its tile, and stores a local grid of its tile widened by a halo of grid points along x and y
+ * (all points along z). The roots of a rank grow beyond its tile, the halo holds the values of the neighbouring ranks there.
+ *
+ * Each rank sets the values of its owned points (e.g. from a soil model), and exchangeHalo() copies the owned values into
+ * the halos of the other ranks. Beyond the halo, the look up repeats the values at the boundary of the local grid.
+ */
+class FieldGrid3D
+{
+
+public:
+
+	FieldGrid3D(const RootSystemField& field, const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>& z, int halo = 1);
+	///< grid points of the global grid per axis (increasing), and the halo width in grid points
+	FieldGrid3D(const FieldGrid3D& g) = delete;
+	virtual ~FieldGrid3D() { }
+
+	RectilinearGrid3D& getGrid() { return *grid; } ///< local grid (tile and halo) of this rank, e.g. for RootSystemField::setSoil
+	size_t getOffsetX() const { return lx[rank]; } ///< global x-index of the first local grid point
+	size_t getOffsetY() const { return ly[rank]; } ///< global y-index of the first local grid point
+	bool isOwned(size_t i, size_t j) const; ///< true if the local grid point (i,j,k) is owned by this rank
+	void exchangeHalo(); ///< copies the values of the owned points into the halos of the other ranks (collective)
+
+private:
+
+	MPI_Comm comm;
+	int rank;
+	int size;
+	// per rank: owned [ox, oxe) x [oy, oye), and local [lx, lxe) x [ly, lye) global indices
+	std::vector<size_t> ox, oxe, oy, oye, lx, lxe, ly, lye;
+	Grid1D xgrid, ygrid, zgrid; // local axes
+	std::unique_ptr<RectilinearGrid3D> grid;
+
+};
+
+#endif
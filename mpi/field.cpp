@@ -0,0 +1,120 @@
+/**
+ * Distributed field simulation with CRootBox (CMake option CROOTBOX_MPI, target field)
+ *
+ * Simulates a field of nx*ny plants distributed over the MPI ranks by spatial tiles, with a soil field distributed by the
+ * same tiles (each rank sets its owned values, the halo is exchanged), and writes the root length of the field,
+ * its vertical root length density profile, and the run time on rank 0. Segments are never gathered.
+ *
+ * Usage: mpirun -np 4 field [-t days] [-n nx ny] [-s spacing] [-j threads] [-d parameter folder] [plant name]
+ *
+ *  -t      simulation time [days] (default 30)
+ *  -n      number of plants along the x- and y-axis (default 4 4)
+ *  -s      distance between the plants [cm] (default 20)
+ *  -j      threads per rank (default 1)
+ *  -d      folder of the parameter files (default modelparameter/ of the source tree, if built with CMake)
+ */
+#include "RootSystemField.h"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	MPI_Init(&argc, &argv);
+	double days = 30.;
+	int nx = 4, ny = 4, threads = 1;
+	double spacing = 20.;
+#ifdef CROOTBOX_MODELPARAMETER
+	std::string folder = CROOTBOX_MODELPARAMETER;
+#else
+	std::string folder = "modelparameter/";
+#endif
+	std::string plant = "Zea_mays_1_Leitner_2010";
+	for (int i=1; i<argc; i++) {
+		std::string arg = argv[i];
+		if ((arg=="-t") && (i+1<argc)) {
+			days = std::stod(argv[++i]);
+		} else if ((arg=="-n") && (i+2<argc)) {
+			nx = std::stoi(argv[++i]);
+			ny = std::stoi(argv[++i]);
+		} else if ((arg=="-s") && (i+1<argc)) {
+			spacing = std::stod(argv[++i]);
+		} else if ((arg=="-j") && (i+1<argc)) {
+			threads = std::stoi(argv[++i]);
+		} else if ((arg=="-d") && (i+1<argc)) {
+			folder = argv[++i];
+		} else if ((!arg.empty()) && (arg[0]=='-')) {
+			std::cout << "Usage: field [-t days] [-n nx ny] [-s spacing] [-j threads] [-d parameter folder] [plant name]\n";
+			MPI_Finalize();
+			return 1;
+		} else {
+			plant = arg;
+		}
+	}
+
+	std::stringstream out; // keeps the parameter messages of the other ranks off the console
+	std::streambuf* old = std::cout.rdbuf();
+	try {
+		RootSystemField field(MPI_COMM_WORLD, threads);
+		if (field.getRank()!=0) {
+			std::cout.rdbuf(out.rdbuf());
+		}
+		field.openFile(plant, folder);
+		field.setGrid(nx, ny, spacing, spacing, 3.);
+		field.setSeed(1);
+
+		// soil field (saturation decreasing with depth), on a 5 cm grid
+		std::vector<double> x, y, z;
+		for (double c = -spacing; c<=nx*spacing; c += 5.) {
+			x.push_back(c);
+		}
+		for (double c = -spacing; c<=ny*spacing; c += 5.) {
+			y.push_back(c);
+		}
+		for (double c = -150.; c<=0.; c += 5.) {
+			z.push_back(c);
+		}
+		FieldGrid3D soil(field, x, y, z, 2);
+		RectilinearGrid3D& g = soil.getGrid();
+		for (size_t i=0; i<g.nx; i++) {
+			for (size_t j=0; j<g.ny; j++) {
+				if (soil.isOwned(i, j)) {
+					for (size_t k=0; k<g.nz; k++) {
+						g.setData(i, j, k, 1.+g.zgrid->grid[k]/150.);
+					}
+				}
+			}
+		}
+		soil.exchangeHalo();
+		field.setSoil(&g);
+
+		MPI_Barrier(MPI_COMM_WORLD);
+		auto t0 = std::chrono::steady_clock::now();
+		field.initialize();
+		field.simulate(days, true);
+		std::vector<double> rld = field.distribution(RootSystem::st_length, 0., 150., 30, true);
+		double length = field.getSummed(RootSystem::st_length);
+		long long segments = field.getNumberOfSegments();
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+		std::cout.rdbuf(old);
+
+		if (field.getRank()==0) {
+			std::cout << field.getNumberOfPlants() << " plants of " << plant << " on " << field.getNumberOfRanks() << " ranks ("
+				<< field.getTilesX() << "x" << field.getTilesY() << " tiles), " << days << " days\n";
+			std::cout << "segments " << segments << ", root length " << length << " cm, time " << t << " s\n";
+			std::cout << "depth [cm]\tlength [cm]\n";
+			for (size_t i=0; i<rld.size(); i++) {
+				std::cout << 5.*i << "\t" << rld[i] << "\n";
+			}
+		}
+	} catch (const std::exception& e) {
+		std::cout.rdbuf(old);
+		std::cout << "field failed: " << e.what() << "\n";
+		MPI_Abort(MPI_COMM_WORLD, 1); // the other ranks may wait in a collective call
+	}
+	MPI_Finalize();
+	return 0;
+}
@@ -108,6 +108,40 @@ inline bool operator!=(const Vector3d& lhs, const Vector3d& rhs){ return !(lhs =
 
 
 
+/**
+ * Vector3f stores three float values, used to store coordinates (not for computations),
+ * converts implicitly from and to Vector3d
+ */
+class Vector3f
+{
+
+public:
+
+    Vector3f(): x(0),y(0),z(0) { } ///< Default constructor
+    Vector3f(const Vector3d& v): x(float(v.x)), y(float(v.y)), z(float(v.z)) { } ///< Rounds a Vector3d to single precision
+
+    operator Vector3d() const { return Vector3d(x,y,z); } ///< conversion to double precision
+
+    float x; ///< float number 1
+    float y; ///< float number 2
+    float z; ///< float number 3
+
+};
+
+/*
+ * Storage types of node coordinates and times, single precision if CRootBox is built with CROOTBOX_COMPACT
+ * (NodeStore, NodeVector, SegmentAnalyser), computations are always in double precision
+ */
+#ifdef CROOTBOX_COMPACT
+typedef float StoredReal;
+typedef Vector3f StoredVector3d;
+#else
+typedef double StoredReal;
+typedef Vector3d StoredVector3d;
+#endif
+
+
+
 /**
  * 3x3 Matrix class, compatible with Vector3d for basic linear algebra
  * (i.e. exactly the operations needed for CRootBox)
@@ -0,0 +1,80 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+/**
+ * Minimalistic thread parallelism used by CRootBox (e.g. RootSystemEnsemble)
+ *
+ * Work items are handed out dynamically (via an atomic counter) to the threads,
+ * therefore the loop body must not depend on which thread executes it, or in which order.
+ */
+
+/**
+ * Returns the number of threads that are used, i.e. the number of hardware threads if n<=0, otherwise n
+ *
+ * @param n     requested number of threads
+ */
+inline int getNumberOfThreads(int n)
+{
+	if (n>0) {
+		return n;
+	} else {
+		return std::max(int(std::thread::hardware_concurrency()),1);
+	}
+}
+
+/**
+ * Calls f(i) for i = 0..n-1 using up to threads threads (the calling thread included).
+ * The first exception thrown by f is re-thrown after all threads have finished.
+ *
+ * @param n         number of work items
+ * @param threads   number of threads (<=0 uses all hardware threads, 1 runs serially)
+ * @param f         loop body, called as f(size_t i)
+ */
+template<class F>
+void parallelFor(size_t n, int threads, F f)
+{
+	size_t nt = std::min(size_t(getNumberOfThreads(threads)), n);
+	if (nt<=1) { // serial
+		for (size_t i=0; i<n; i++) {
+			f(i);
+		}
+		return;
+	}
+	std::atomic<size_t> next(0);
+	std::exception_ptr error = nullptr;
+	std::mutex errorMutex;
+	auto worker = [&]() {
+		size_t i;
+		while ((i = next.fetch_add(1))<n) {
+			try {
+				f(i);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+				next = n; // stop handing out work
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	for (size_t t=0; t<nt-1; t++) {
+		pool.push_back(std::thread(worker));
+	}
+	worker(); // the calling thread works as well
+	for (auto& t : pool) {
+		t.join();
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef POLYLINE_H_
+#define POLYLINE_H_
+
+#include "mymath.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/**
+ * Polyline
+ *
+ * Error bounded simplification of polylines (Douglas-Peucker): a node is only removed if its distance to the coarse segment
+ * replacing it is at most the tolerance, the first node, the last node, and fixed nodes (e.g. branch points) are always kept.
+ * Used for output and coupling at a coarser resolution than the simulation (@see RootSystem::setOutputTolerance,
+ * SegmentAnalyser::simplify).
+ */
+class Polyline
+{
+
+public:
+
+	static double distance(const Vector3d& x, const Vector3d& a, const Vector3d& b) {
+		Vector3d d = b.minus(a);
+		double l2 = d.times(d);
+		double t = (l2>0) ? std::min(std::max(x.minus(a).times(d)/l2, 0.), 1.) : 0.;
+		return x.minus(a.plus(d.times(t))).length();
+	} ///< distance of the point x to the segment [a,b]
+
+	/**
+	 * Simplifies a polyline
+	 *
+	 * @param p             the nodes of the polyline
+	 * @param fixed         nodes that are kept (empty, or one flag per node)
+	 * @param tolerance     maximal distance of a removed node to its coarse segment [cm]
+	 * \return              the indices of the kept nodes (increasing)
+	 */
+	static std::vector<int> simplify(const std::vector<Vector3d>& p, const std::vector<bool>& fixed, double tolerance) {
+		int n = p.size();
+		std::vector<bool> keep(n, false);
+		if (n>0) {
+			keep.front() = true;
+			keep.back() = true;
+		}
+		for (int i=0; i<int(fixed.size()) && (i<n); i++) {
+			keep[i] = keep[i] || fixed[i];
+		}
+		std::vector<std::pair<int,int>> spans; // between kept nodes, refined without recursion
+		int a = 0;
+		for (int i=1; i<n; i++) {
+			if (keep[i]) {
+				spans.push_back(std::make_pair(a, i));
+				a = i;
+			}
+		}
+		while (!spans.empty()) {
+			int i = spans.back().first;
+			int j = spans.back().second;
+			spans.pop_back();
+			double dmax = 0.;
+			int k = -1;
+			for (int l=i+1; l<j; l++) {
+				double d = distance(p[l], p[i], p[j]);
+				if (d>dmax) {
+					dmax = d;
+					k = l;
+				}
+			}
+			// a coarse segment of zero length would represent a positive length, therefore it is split as well
+			if ((k>=0) && ((dmax>tolerance) || (p[j].minus(p[i]).length()==0))) {
+				keep[k] = true;
+				spans.push_back(std::make_pair(i, k));
+				spans.push_back(std::make_pair(k, j));
+			}
+		}
+		std::vector<int> ni;
+		for (int i=0; i<n; i++) {
+			if (keep[i]) {
+				ni.push_back(i);
+			}
+		}
+		return ni;
+	}
+
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+/**
+ * ProfileCounters
+ *
+ * Instrumentation counters and accumulated times of the hot paths of the simulation, collected per root system
+ * and per root type (@see RootSystem::getProfile).
+ *
+ * The instrumentation is compiled out by default, build with CROOTBOX_PROFILE to enable it (otherwise all counters stay zero,
+ * @see ProfileCounters::hasProfiling). Counters are relaxed atomics, therefore they may be incremented by parallel growth.
+ *
+ * Times are inclusive, e.g. the time of createSegments contains the heading search, and the soil look ups of the
+ * tropisms are counted within the heading search as well.
+ */
+class ProfileCounters
+{
+
+public:
+
+	enum Counter {
+		pc_sdf = 0, ///< signed distance function evaluations of the confining geometry in the heading search (without gradients)
+		pc_objectives = 1, ///< evaluations of the tropism objective (number of trials)
+		pc_rejections = 2, ///< headings rejected by the confining geometry
+		pc_nodes = 3, ///< nodes created
+		pc_roots = 4, ///< roots created
+		pc_soil = 5, ///< soil look ups (scaling functions, and hydrotropism)
+		pc_size = 6
+	};
+
+	enum Phase {
+		pp_simulate = 0, ///< RootSystem::simulate (root system level)
+		pp_heading = 1, ///< Tropism::getHeading (including the geometry)
+		pp_segments = 2, ///< Root::createSegments
+		pp_laterals = 3, ///< creation of lateral roots (without their growth)
+		pp_soil = 4, ///< soil look ups of the scaling functions
+		pp_output = 5, ///< writing VTP, RSML, and geometry files (root system level)
+		pp_size = 6
+	};
+
+	ProfileCounters() { reset(); }
+	ProfileCounters(const ProfileCounters& p) { *this = p; }
+	ProfileCounters& operator=(const ProfileCounters& p) {
+		for (int i=0; i<pc_size; i++) {
+			counts[i].store(p.counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		for (int i=0; i<pp_size; i++) {
+			times[i].store(p.times[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		return *this;
+	}
+
+	static bool hasProfiling() {
+#ifdef CROOTBOX_PROFILE
+		return true;
+#else
+		return false;
+#endif
+	} ///< true if CRootBox was built with CROOTBOX_PROFILE
+
+	void add(int c, long long n = 1) { counts[c].fetch_add(n, std::memory_order_relaxed); } ///< increments a counter
+	void addTime(int p, long long ns) { times[p].fetch_add(ns, std::memory_order_relaxed); } ///< adds to the time of a phase [ns]
+	void add(const ProfileCounters& p) {
+		for (int i=0; i<pc_size; i++) {
+			add(i, p.getCount(i));
+		}
+		for (int i=0; i<pp_size; i++) {
+			addTime(i, p.times[i].load(std::memory_order_relaxed));
+		}
+	} ///< adds all counters and times of p
+
+	long long getCount(int c) const { return counts[c].load(std::memory_order_relaxed); } ///< value of a counter
+	double getTime(int p) const { return 1.e-9*times[p].load(std::memory_order_relaxed); } ///< accumulated time of a phase [s]
+	void reset() {
+		for (int i=0; i<pc_size; i++) {
+			counts[i].store(0, std::memory_order_relaxed);
+		}
+		for (int i=0; i<pp_size; i++) {
+			times[i].store(0, std::memory_order_relaxed);
+		}
+	} ///< sets all counters and times to zero
+
+	static std::string getCounterName(int c) {
+		static const char* names[pc_size] = { "sdf evaluations", "tropism objectives", "geometry rejections", "nodes", "roots", "soil look ups" };
+		return names[c];
+	} ///< name of a counter
+	static std::string getPhaseName(int p) {
+		static const char* names[pp_size] = { "simulate", "heading", "createSegments", "laterals", "soil look ups", "output" };
+		return names[p];
+	} ///< name of a phase
+
+	std::string toString() const {
+		std::stringstream str;
+		for (int i=0; i<pc_size; i++) {
+			str << getCounterName(i) << ": " << getCount(i) << "\n";
+		}
+		for (int i=0; i<pp_size; i++) {
+			str << getPhaseName(i) << ": " << getTime(i) << " s\n";
+		}
+		return str.str();
+	} ///< quick info for debugging
+
+private:
+
+	std::atomic<long long> counts[pc_size];
+	std::atomic<long long> times[pp_size]; // [ns]
+
+};
+
+/**
+ * Adds the lifetime of the object to a phase (if the counters are not nullptr)
+ */
+class ProfileTimer
+{
+public:
+	ProfileTimer(ProfileCounters* p, int phase) : p(p), phase(phase) {
+		if (p!=nullptr) {
+			start = std::chrono::steady_clock::now();
+		}
+	}
+	~ProfileTimer() {
+		if (p!=nullptr) {
+			p->addTime(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count());
+		}
+	}
+private:
+	ProfileCounters* p;
+	int phase;
+	std::chrono::steady_clock::time_point start;
+};
+
+/*
+ * Instrumentation macros, empty unless CROOTBOX_PROFILE is defined (the arguments are not evaluated)
+ */
+#ifdef CROOTBOX_PROFILE
+#define CROOTBOX_PROFILE_ONLY(...) __VA_ARGS__
+#define CROOTBOX_PROFILE_COUNT(p, counter, n) do { ProfileCounters* p_ = (p); if (p_!=nullptr) { p_->add(counter, n); } } while (false)
+#define CROOTBOX_PROFILE_CAT_(a, b) a##b
+#define CROOTBOX_PROFILE_CAT(a, b) CROOTBOX_PROFILE_CAT_(a, b)
+#define CROOTBOX_PROFILE_TIME(p, phase) ProfileTimer CROOTBOX_PROFILE_CAT(profileTimer_, __LINE__)(p, phase)
+#else
+#define CROOTBOX_PROFILE_ONLY(...)
+#define CROOTBOX_PROFILE_COUNT(p, counter, n) do { } while (false)
+#define CROOTBOX_PROFILE_TIME(p, phase) do { } while (false)
+#endif
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef RANDOM_STREAM_H_
+#define RANDOM_STREAM_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+/**
+ * RandomStream
+ *
+ * Counter based random numbers (Philox4x32-10, Salmon et al. 2011). A stream is defined by a seed, a key (e.g. of a root),
+ * the purpose of the draws, and an index (e.g. a node index), the numbers only depend on these values and on the number of
+ * previous draws of the same stream. Therefore streams can be created in any order, and by any thread.
+ *
+ * While a RandomStreamScope is alive, the random numbers of the current thread are drawn from its stream
+ * (@see RootSystem::setRandomStreams).
+ */
+class RandomStream
+{
+
+public:
+
+	enum Purpose {
+		dp_create = 0, ///< parameters and initial rotation of a new root
+		dp_emergence = 1, ///< probabilistic emergence of a root
+		dp_lateral = 2, ///< lateral type at a branching node
+		dp_heading = 3, ///< heading of a new node
+		dp_shift = 4 ///< heading of a node that is moved to the axial resolution
+	};
+
+	RandomStream() { } ///< inactive stream, @see RandomStream::isActive
+
+	/**
+	 * @param seed      seed, e.g. of the root system
+	 * @param key       key, e.g. of a root (@see RandomStream::getKey)
+	 * @param purpose   purpose of the draws (@see RandomStream::Purpose)
+	 * @param index     index within the key, e.g. a node index
+	 */
+	RandomStream(uint32_t seed, uint64_t key, int purpose, uint64_t index) : active(true) {
+		k[0] = seed;
+		k[1] = uint32_t(purpose);
+		uint64_t h = hash(key, index);
+		c[0] = 0;
+		c[1] = 0;
+		c[2] = uint32_t(h);
+		c[3] = uint32_t(h>>32);
+	}
+
+	bool isActive() const { return active; } ///< false for default constructed streams
+
+	double rand() {
+		if (used>2) {
+			next();
+		}
+		uint64_t x = (uint64_t(out[used])<<32) | out[used+1];
+		used += 2;
+		return (double(x>>11)+0.5)*(1./9007199254740992.);
+	} ///< Uniformly distributed random number (0,1)
+
+	double randn() {
+		if (hasNormal) {
+			hasNormal = false;
+			return normal;
+		}
+		double r = std::sqrt(-2.*std::log(rand()));
+		double phi = 2.*M_PI*rand();
+		normal = r*std::sin(phi);
+		hasNormal = true;
+		return r*std::cos(phi);
+	} ///< Normally distributed random number (0,1), Box-Muller transform
+
+	static uint64_t mix(uint64_t x) {
+		x ^= x>>30;
+		x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x>>27;
+		x *= 0x94d049bb133111ebULL;
+		x ^= x>>31;
+		return x;
+	} ///< bijective 64 bit hash (finalizer of splitmix64)
+
+	static uint64_t hash(uint64_t a, uint64_t b) { return mix(a^mix(b+0x9e3779b97f4a7c15ULL)); } ///< combines two values
+	static uint64_t getKey(uint64_t parent, uint64_t i) { return hash(parent, i+1); } ///< key of the i-th child of parent (parent 0 for the base roots)
+	static uint64_t getIndex(double t) { uint64_t i; std::memcpy(&i, &t, sizeof(i)); return i; } ///< index from a time, e.g. the simulation time
+
+	/**
+	 * Philox4x32-10: encrypts the counter ctr with the key
+	 */
+	static void philox(uint32_t ctr[4], const uint32_t key[2]) {
+		uint32_t k0 = key[0], k1 = key[1];
+		for (int r=0; r<10; r++) {
+			uint64_t p0 = uint64_t(0xD2511F53)*ctr[0];
+			uint64_t p1 = uint64_t(0xCD9E8D57)*ctr[2];
+			uint32_t c0 = uint32_t(p1>>32)^ctr[1]^k0;
+			uint32_t c2 = uint32_t(p0>>32)^ctr[3]^k1;
+			ctr[0] = c0;
+			ctr[1] = uint32_t(p1);
+			ctr[2] = c2;
+			ctr[3] = uint32_t(p0);
+			k0 += 0x9E3779B9;
+			k1 += 0xBB67AE85;
+		}
+	}
+
+	static RandomStream*& current() { static thread_local RandomStream* s = nullptr; return s; } ///< stream of the current thread (or nullptr)
+
+private:
+
+	void next() {
+		std::memcpy(out, c, sizeof(out));
+		philox(out, k);
+		if (++c[0]==0) {
+			c[1]++;
+		}
+		used = 0;
+	}
+
+	bool active = false;
+	uint32_t k[2] = { 0, 0 }; // seed and purpose
+	uint32_t c[4] = { 0, 0, 0, 0 }; // block counter (64 bit), and hash of key and index
+	uint32_t out[4] = { 0, 0, 0, 0 }; // current block
+	int used = 4; // used words of the current block
+	bool hasNormal = false; // the second value of Box-Muller is kept
+	double normal = 0.;
+
+};
+
+/**
+ * Draws the random numbers of the current thread from a stream during the lifetime of the object (inactive streams are ignored)
+ */
+class RandomStreamScope
+{
+public:
+	RandomStreamScope(RandomStream& s) : old(RandomStream::current()) {
+		if (s.isActive()) {
+			RandomStream::current() = &s;
+		}
+	}
+	~RandomStreamScope() { RandomStream::current() = old; }
+	RandomStreamScope(const RandomStreamScope&) = delete;
+	RandomStreamScope& operator=(const RandomStreamScope&) = delete;
+private:
+	RandomStream* old;
+};
+
+/**
+ * LazyGenerator
+ *
+ * A std::mt19937 that is only created at its first draw, until then its state is the seed. Root type parameters and
+ * tropisms hold one generator each, but only the generators of the root types that grow are used, therefore copying and
+ * seeding the unused ones is cheap. The numbers are the same as the numbers of std::mt19937(seed).
+ */
+class LazyGenerator
+{
+
+public:
+
+	typedef std::mt19937::result_type result_type;
+
+	LazyGenerator(result_type seed = std::mt19937::default_seed) : s(seed) { }
+	LazyGenerator(const LazyGenerator& g) : s(g.s), gen(g.gen ? new std::mt19937(*g.gen) : nullptr) { }
+	LazyGenerator& operator=(const LazyGenerator& g) {
+		s = g.s;
+		gen.reset(g.gen ? new std::mt19937(*g.gen) : nullptr);
+		return *this;
+	}
+
+	void seed(result_type seed) { s = seed; gen.reset(); } ///< restarts the generator with a seed (in constant time)
+
+	static constexpr result_type min() { return std::mt19937::min(); }
+	static constexpr result_type max() { return std::mt19937::max(); }
+	result_type operator()() { return engine()(); } ///< next random number
+
+	friend std::ostream& operator<<(std::ostream& os, const LazyGenerator& g) {
+		if (g.gen) {
+			return os << *g.gen;
+		}
+		return os << std::mt19937(g.s);
+	} ///< writes the state in the format of std::mt19937
+	friend std::istream& operator>>(std::istream& is, LazyGenerator& g) { return is >> g.engine(); } ///< reads a state of std::mt19937
+
+private:
+
+	std::mt19937& engine() {
+		if (!gen) {
+			gen.reset(new std::mt19937(s));
+		}
+		return *gen;
+	}
+
+	result_type s;
+	std::unique_ptr<std::mt19937> gen; // nullptr until the first draw
+
+};
+
+/**
+ * RandomGenerator
+ *
+ * Uniformly and normally distributed random numbers (0,1) of a LazyGenerator, or of the stream of the current thread if there is one
+ * (@see RandomStreamScope). The root system holds one generator per root type for the draws of its roots, apart from the root type
+ * parameters, which can therefore be shared by many root systems (@see RootSystem::getRandomGenerator).
+ */
+class RandomGenerator
+{
+
+public:
+
+	RandomGenerator(LazyGenerator::result_type seed = std::mt19937::default_seed) : gen(seed) { }
+
+	void seed(LazyGenerator::result_type seed) { gen.seed(seed); } ///< restarts the generator with a seed (the distributions keep their state)
+	double rand() { RandomStream* s = RandomStream::current(); return (s!=nullptr) ? s->rand() : UD(gen); } ///< uniformly distributed random number (0,1)
+	double randn() { RandomStream* s = RandomStream::current(); return (s!=nullptr) ? s->randn() : ND(gen); } ///< normally distributed random number (0,1)
+	std::string getState() const { std::stringstream ss; ss << gen << " " << UD << " " << ND; return ss.str(); } ///< state of the generator (e.g. for checkpoints)
+	void setState(const std::string& s) { std::stringstream ss(s); ss >> gen >> UD >> ND; } ///< restores a state of the generator
+
+private:
+
+	LazyGenerator gen;
+	std::uniform_real_distribution<double> UD = std::uniform_real_distribution<double>(0,1);
+	std::normal_distribution<double> ND = std::normal_distribution<double>(0,1);
+
+};
+
+#endif
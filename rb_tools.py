@@ -7,12 +7,16 @@ import py_rootbox as rb
 # Auxiliary functions that could be moved to py_rootbox
 #
 def v2a(vd): # rb.std_vector_double_ to numpy array    
+    if isinstance(vd, memoryview): # e.g. rs.getScalarArray(), no copy
+        return np.asarray(vd).reshape((len(vd),1))
     l = np.zeros((len(vd),1)) 
     for i in range(0,len(vd)):
         l[i] = vd[i]
     return l
 
 def v2ai(vd): # rb.std_vector_int_ to numpy int array    
+    if isinstance(vd, memoryview): # e.g. rs.getNodeStore().parents, no copy
+        return np.asarray(vd)
     l = np.zeros(len(vd),dtype=np.int) 
     for i in range(0,len(vd)):
         l[i] = vd[i]
@@ -31,6 +35,8 @@ def a2i(a): #  numpy array to rb.std_vector_int
     return l
     
 def vv2a(vd): # rb.std_vector_Vector3_ to numpy array
+    if isinstance(vd, memoryview): # e.g. rs.getNodesArray(), no copy
+        return np.asarray(vd)
     N  = len(vd)
     l = np.zeros((N,3)) 
     for i in range(0,N):
@@ -38,6 +44,8 @@ def vv2a(vd): # rb.std_vector_Vector3_ to numpy array
     return l
 
 def seg2a(seg): # rb.std_vector_Vector2i_ to numpy array
+    if isinstance(seg, memoryview): # e.g. rs.getSegmentsArray() 
+        return np.asarray(seg).astype(np.uint32)
     Ns = len(seg)
     seg_ = np.zeros((Ns,2),dtype = np.uint32)
     for i in range(0,Ns):
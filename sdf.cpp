@@ -9,6 +9,47 @@ std::string SignedDistanceFunction::writePVPScript() const
     	return str.str();
 }
 
+/**
+ * Approximates the gradient by central differences (6 evaluations of getDist)
+ *
+ * @param v     spatial position [cm]
+ * @param eps   step size [cm]
+ * \return      gradient of the signed distance [1]
+ */
+Vector3d SignedDistanceFunction::getGradient(const Vector3d& v, double eps) const
+{
+  double dx = getDist(Vector3d(v.x+eps,v.y,v.z))-getDist(Vector3d(v.x-eps,v.y,v.z));
+  double dy = getDist(Vector3d(v.x,v.y+eps,v.z))-getDist(Vector3d(v.x,v.y-eps,v.z));
+  double dz = getDist(Vector3d(v.x,v.y,v.z+eps))-getDist(Vector3d(v.x,v.y,v.z-eps));
+  return Vector3d(dx,dy,dz).times(0.5/eps);
+}
+
+/**
+ * Returns the signed distances of multiple points
+ *
+ * @param v     spatial positions [cm]
+ * @param d     signed distances [cm] (output)
+ */
+void SignedDistanceFunction::getDists(const std::vector<Vector3d>& v, std::vector<double>& d) const
+{
+  d.resize(v.size());
+  for (size_t i=0; i<v.size(); i++) {
+      d[i] = getDist(v[i]);
+  }
+}
+
+/**
+ * Geometries that are not known by SDF_Compiled are called
+ *
+ * @param c     the compiled geometry
+ * @param M     rotation of the evaluation point
+ * @param t     translation of the evaluation point
+ */
+void SignedDistanceFunction::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  c.addCall(this, M, t);
+}
+
 
 
 /**
@@ -23,6 +64,35 @@ double SDF_PlantBox::getDist(const Vector3d& v) const
   return -std::min(std::min(std::min(std::min(std::min(dim.z+z,dim.z-z),dim.y+v.y),dim.y-v.y),dim.x+v.x),dim.x-v.x);
 }
 
+/**
+ * Returns the outer normal of the face that determines the distance (@see SDF_PlantBox::getDist)
+ *
+ * @param v     spatial position [cm]
+ * @param eps   not used
+ * \return      gradient of the signed distance [1]
+ */
+Vector3d SDF_PlantBox::getGradient(const Vector3d& v, double eps) const
+{
+  double z = v.z+dim.z; //  translate
+  double d[6] = { dim.z+z, dim.z-z, dim.y+v.y, dim.y-v.y, dim.x+v.x, dim.x-v.x };
+  const Vector3d n[6] = { Vector3d(0,0,-1), Vector3d(0,0,1), Vector3d(0,-1,0), Vector3d(0,1,0), Vector3d(-1,0,0), Vector3d(1,0,0) };
+  int j = 0;
+  for (int i=1; i<6; i++) {
+      if (d[i]<d[j]) {
+          j = i;
+      }
+  }
+  return n[j];
+}
+
+/**
+ * @see SignedDistanceFunction::compile
+ */
+void SDF_PlantBox::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  c.addLeaf(SDF_Compiled::op_box, M, t, dim);
+}
+
 /**
  * Writes a ParaView Phython script explicitly representing the implicit geometry
  *
@@ -81,6 +151,53 @@ double SDF_PlantContainer::getDist(const Vector3d& v) const
   return std::max(d,-std::min(h+v.z,0.-v.z));
 }
 
+/**
+ * Returns the gradient of the signed distance function (@see SDF_PlantContainer::getDist)
+ *
+ * @param v     spatial position [cm]
+ * @param eps   not used
+ * \return      gradient of the signed distance [1]
+ */
+Vector3d SDF_PlantContainer::getGradient(const Vector3d& v, double eps) const
+{
+  double z = v.z/h; // 0 .. -1
+  double r =  (1+z)*r1 - z*r2;
+  double drdz = (r1-r2)/h;
+  double d;
+  Vector3d g;
+  if (square) { // rectangular pot
+      d = std::max(std::abs(v.x),std::abs(v.y))-r;
+      if (std::abs(v.x)>=std::abs(v.y)) {
+          g = Vector3d((v.x>=0) ? 1. : -1., 0., -drdz);
+      } else {
+          g = Vector3d(0., (v.y>=0) ? 1. : -1., -drdz);
+      }
+  } else { // round pot
+      double rho = sqrt(v.x*v.x+v.y*v.y);
+      d = rho-r;
+      if (rho>0) {
+          g = Vector3d(v.x/rho, v.y/rho, -drdz);
+      } else {
+          g = Vector3d(0., 0., -drdz);
+      }
+  }
+  if (d>=-std::min(h+v.z,0.-v.z)) { // side wall
+      return g;
+  } else if (h+v.z<0.-v.z) { // bottom
+      return Vector3d(0,0,-1);
+  } else { // top
+      return Vector3d(0,0,1);
+  }
+}
+
+/**
+ * @see SignedDistanceFunction::compile
+ */
+void SDF_PlantContainer::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  c.addLeaf(square ? SDF_Compiled::op_square : SDF_Compiled::op_container, M, t, Vector3d(r1,r2,h));
+}
+
 /**
  * Writes a ParaView Phython script explicitly representing the implicit geometry
  *
@@ -166,6 +283,32 @@ double SDF_RotateTranslate::getDist(const Vector3d& v) const
   return sdf->getDist(p);
 }
 
+/**
+ * Gradient of the base geometry, rotated back
+ *
+ * @param v     spatial position [cm]
+ * @param eps   step size, if the base geometry uses central differences [cm]
+ * \return      gradient of the signed distance [1]
+ */
+Vector3d SDF_RotateTranslate::getGradient(const Vector3d& v, double eps) const
+{
+  Vector3d p = (A.times(v.minus(pos)));
+  Vector3d g = sdf->getGradient(p, eps);
+  return Vector3d(A.column(0).times(g), A.column(1).times(g), A.column(2).times(g)); // A^T g
+}
+
+/**
+ * Premultiplies the rotation and translation, A*(M*v+t-pos) = (A*M)*v + A*(t-pos)
+ */
+void SDF_RotateTranslate::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  Matrix3d AM;
+  AM.r0 = Vector3d(A.r0.times(M.column(0)), A.r0.times(M.column(1)), A.r0.times(M.column(2)));
+  AM.r1 = Vector3d(A.r1.times(M.column(0)), A.r1.times(M.column(1)), A.r1.times(M.column(2)));
+  AM.r2 = Vector3d(A.r2.times(M.column(0)), A.r2.times(M.column(1)), A.r2.times(M.column(2)));
+  sdf->compile(c, AM, A.times(t.minus(pos)));
+}
+
 /**
  * Writes a ParaView Phython script explicitly representing the implicit geometry
  *
@@ -217,6 +360,40 @@ double SDF_Intersection::getDist(const Vector3d& v) const {
   return d;
 }
 
+/**
+ * Gradient of the geometry that determines the distance (@see SDF_Intersection::getDist)
+ *
+ * @param v     spatial position [cm]
+ * @param eps   step size, if a geometry uses central differences [cm]
+ * \return      gradient of the signed distance [1]
+ */
+Vector3d SDF_Intersection::getGradient(const Vector3d& v, double eps) const
+{
+  double d = sdfs[0]->getDist(v);
+  size_t j = 0;
+  for (size_t i=1; i<sdfs.size(); i++) {
+      double di = -sdfs[i]->getDist(v);
+      if (di>d) {
+          d = di;
+          j = i;
+      }
+  }
+  Vector3d g = sdfs[j]->getGradient(v, eps);
+  return (j==0) ? g : g.times(-1.);
+}
+
+/**
+ * @see SignedDistanceFunction::compile
+ */
+void SDF_Intersection::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  sdfs[0]->compile(c, M, t);
+  for (size_t i=1; i<sdfs.size(); i++) {
+      sdfs[i]->compile(c, M, t);
+      c.addOperation(SDF_Compiled::op_maxneg);
+  }
+}
+
 /**
  * Writes a ParaView Phython script explicitly representing the implicit geometry
  *
@@ -276,6 +453,39 @@ double SDF_Union::getDist(const Vector3d& v) const
   return d;
 }
 
+/**
+ * Gradient of the geometry that determines the distance (@see SDF_Union::getDist)
+ *
+ * @param v     spatial position [cm]
+ * @param eps   step size, if a geometry uses central differences [cm]
+ * \return      gradient of the signed distance [1]
+ */
+Vector3d SDF_Union::getGradient(const Vector3d& v, double eps) const
+{
+  double d = sdfs[0]->getDist(v);
+  size_t j = 0;
+  for (size_t i=1; i<sdfs.size(); i++) {
+      double di = sdfs[i]->getDist(v);
+      if (di<d) {
+          d = di;
+          j = i;
+      }
+  }
+  return sdfs[j]->getGradient(v, eps);
+}
+
+/**
+ * @see SignedDistanceFunction::compile
+ */
+void SDF_Union::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  sdfs[0]->compile(c, M, t);
+  for (size_t i=1; i<sdfs.size(); i++) {
+      sdfs[i]->compile(c, M, t);
+      c.addOperation(SDF_Compiled::op_min);
+  }
+}
+
 
 
 /**
@@ -293,6 +503,37 @@ double SDF_Difference::getDist(const Vector3d& v) const
   return d;
 }
 
+/**
+ * Gradient of the geometry that determines the distance (@see SDF_Difference::getDist)
+ *
+ * @param v     spatial position [cm]
+ * @param eps   step size, if a geometry uses central differences [cm]
+ * \return      gradient of the signed distance [1]
+ */
+Vector3d SDF_Difference::getGradient(const Vector3d& v, double eps) const
+{
+  return SDF_Intersection::getGradient(v, eps); // same construction as SDF_Intersection::getDist
+}
+
+/**
+ * @see SignedDistanceFunction::compile
+ */
+void SDF_Difference::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  SDF_Intersection::compile(c, M, t); // same construction as SDF_Intersection::getDist
+}
+
+
+
+/**
+ * @see SignedDistanceFunction::compile
+ */
+void SDF_Complement::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  sdf->compile(c, M, t);
+  c.addOperation(SDF_Compiled::op_neg);
+}
+
 
 
 /**
@@ -346,3 +587,274 @@ int SDF_HalfPlane::writePVPScript(std::ostream & cout, int c) const
 	  return c;
 }
 
+
+
+/**
+ * @see SignedDistanceFunction::compile
+ */
+void SDF_HalfPlane::compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const
+{
+  c.addLeaf(SDF_Compiled::op_plane, M, t, n, o);
+}
+
+
+
+/**
+ * Compiles the geometry
+ *
+ * @param sdf       the geometry (a tree of signed distance functions), it is not copied and must be kept alive
+ */
+SDF_Compiled::SDF_Compiled(SignedDistanceFunction* sdf): sdf(sdf)
+{
+  sdf->compile(*this, Matrix3d(), Vector3d());
+  assert(depth==1);
+}
+
+/**
+ * Appends a leaf, that is evaluated at M*v+t, and pushes its distance on the stack
+ *
+ * @param op    op_box, op_container, op_square, or op_plane
+ * @param M     rotation of the evaluation point
+ * @param t     translation of the evaluation point
+ * @param a     first parameters of the leaf
+ * @param b     second parameters of the leaf
+ */
+void SDF_Compiled::addLeaf(int op, const Matrix3d& M, const Vector3d& t, const Vector3d& a, const Vector3d& b)
+{
+  Matrix3d I;
+  Instruction i;
+  i.op = op;
+  i.M = M;
+  i.t = t;
+  i.transformed = !((M.r0==I.r0) && (M.r1==I.r1) && (M.r2==I.r2) && (t==Vector3d()));
+  i.a = a;
+  i.b = b;
+  i.sdf = nullptr;
+  code.push_back(i);
+  depth++;
+  maxDepth = std::max(maxDepth, depth);
+}
+
+/**
+ * Appends the call of a geometry, that cannot be compiled, and pushes its distance on the stack
+ *
+ * @param sdf   the geometry
+ * @param M     rotation of the evaluation point
+ * @param t     translation of the evaluation point
+ */
+void SDF_Compiled::addCall(const SignedDistanceFunction* sdf, const Matrix3d& M, const Vector3d& t)
+{
+  addLeaf(op_call, M, t);
+  code.back().sdf = sdf;
+}
+
+/**
+ * Appends an operation on the stack
+ *
+ * @param op    op_maxneg (pops b, a = max(a,-b)), op_min (pops b, a = min(a,b)), or op_neg (a = -a)
+ */
+void SDF_Compiled::addOperation(int op)
+{
+  if ((op!=op_maxneg) && (op!=op_min) && (op!=op_neg)) {
+      throw std::invalid_argument("SDF_Compiled::addOperation() unknown operation");
+  }
+  Instruction i;
+  i.op = op;
+  i.transformed = false;
+  i.sdf = nullptr;
+  code.push_back(i);
+  if (op!=op_neg) {
+      depth--;
+  }
+}
+
+/**
+ * Number of geometries that are called (i.e. not compiled)
+ */
+int SDF_Compiled::getNumberOfCalls() const
+{
+  int c = 0;
+  for (const auto& i : code) {
+      if (i.op==op_call) {
+          c++;
+      }
+  }
+  return c;
+}
+
+/**
+ * Evaluates a single leaf of the code
+ *
+ * @param i     the instruction
+ * @param v     spatial position [cm]
+ * \return      signed distance [cm]
+ */
+double SDF_Compiled::evalLeaf(const Instruction& i, const Vector3d& v) const
+{
+  Vector3d p = i.transformed ? i.M.times(v).plus(i.t) : v;
+  switch (i.op) {
+    case op_call:
+      return i.sdf->getDist(p);
+    case op_box: {
+      double z = p.z+i.a.z;
+      return -std::min(std::min(std::min(std::min(std::min(i.a.z+z,i.a.z-z),i.a.y+p.y),i.a.y-p.y),i.a.x+p.x),i.a.x-p.x);
+    }
+    case op_container:
+    case op_square: {
+      double z = p.z/i.a.z;
+      double r =  (1+z)*i.a.x - z*i.a.y;
+      double d;
+      if (i.op==op_square) {
+          d = std::max(std::abs(p.x),std::abs(p.y))-r;
+      } else {
+          d = sqrt(p.x*p.x+p.y*p.y)-r;
+      }
+      return std::max(d,-std::min(i.a.z+p.z,0.-p.z));
+    }
+    case op_plane:
+      return i.a.times(p.minus(i.b));
+  }
+  throw std::invalid_argument("SDF_Compiled::evalLeaf() unknown leaf");
+}
+
+/**
+ * Evaluates the compiled code
+ *
+ * @param v     spatial position [cm]
+ * \return      signed distance [cm], a minus sign means inside, plus outside
+ */
+double SDF_Compiled::getDist(const Vector3d& v) const
+{
+  if (code.size()==1) { // single leaf
+      return evalLeaf(code[0], v);
+  }
+  double stack_[32];
+  std::vector<double> heap;
+  double* stack = stack_;
+  if (maxDepth>32) {
+      heap.resize(maxDepth);
+      stack = heap.data();
+  }
+  stack[0] = -1e100; // (unconfined, if empty)
+  int sp = 0;
+  for (const auto& i : code) {
+      switch (i.op) {
+        case op_maxneg:
+          sp--;
+          stack[sp-1] = std::max(stack[sp-1], -stack[sp]);
+          break;
+        case op_min:
+          sp--;
+          stack[sp-1] = std::min(stack[sp-1], stack[sp]);
+          break;
+        case op_neg:
+          stack[sp-1] = -stack[sp-1];
+          break;
+        default:
+          stack[sp++] = evalLeaf(i, v);
+      }
+  }
+  return stack[0];
+}
+
+/**
+ * Evaluates the compiled code for blocks of points, instruction by instruction (i.e. in tight loops over the points)
+ *
+ * @param v     spatial positions [cm]
+ * @param d     signed distances [cm] (output)
+ */
+void SDF_Compiled::getDists(const std::vector<Vector3d>& v, std::vector<double>& d) const
+{
+  const int bs = blockSize;
+  d.resize(v.size());
+  std::vector<double> x(bs), y(bs), z(bs), px(bs), py(bs), pz(bs);
+  std::vector<double> stack(maxDepth*bs);
+  for (size_t b0=0; b0<v.size(); b0+=bs) {
+      int m = std::min(size_t(bs), v.size()-b0);
+      for (int j=0; j<m; j++) {
+          x[j] = v[b0+j].x;
+          y[j] = v[b0+j].y;
+          z[j] = v[b0+j].z;
+      }
+      int sp = 0;
+      for (const auto& i : code) {
+          double* r = &stack[sp*bs];
+          double* a = r-bs; // top of the stack
+          if ((i.op==op_maxneg) || (i.op==op_min) || (i.op==op_neg)) {
+              if (i.op==op_maxneg) {
+                  a = r-2*bs;
+                  double* b = r-bs;
+                  for (int j=0; j<m; j++) {
+                      a[j] = std::max(a[j], -b[j]);
+                  }
+                  sp--;
+              } else if (i.op==op_min) {
+                  a = r-2*bs;
+                  double* b = r-bs;
+                  for (int j=0; j<m; j++) {
+                      a[j] = std::min(a[j], b[j]);
+                  }
+                  sp--;
+              } else {
+                  for (int j=0; j<m; j++) {
+                      a[j] = -a[j];
+                  }
+              }
+              continue;
+          }
+          // leaf: transform the points
+          const double* qx = x.data();
+          const double* qy = y.data();
+          const double* qz = z.data();
+          if (i.transformed) {
+              const Matrix3d& M = i.M;
+              for (int j=0; j<m; j++) {
+                  px[j] = M.r0.x*x[j] + M.r0.y*y[j] + M.r0.z*z[j] + i.t.x;
+                  py[j] = M.r1.x*x[j] + M.r1.y*y[j] + M.r1.z*z[j] + i.t.y;
+                  pz[j] = M.r2.x*x[j] + M.r2.y*y[j] + M.r2.z*z[j] + i.t.z;
+              }
+              qx = px.data();
+              qy = py.data();
+              qz = pz.data();
+          }
+          const Vector3d& p = i.a;
+          switch (i.op) {
+            case op_box:
+              for (int j=0; j<m; j++) {
+                  double zz = qz[j]+p.z;
+                  r[j] = -std::min(std::min(std::min(std::min(std::min(p.z+zz,p.z-zz),p.y+qy[j]),p.y-qy[j]),p.x+qx[j]),p.x-qx[j]);
+              }
+              break;
+            case op_container:
+              for (int j=0; j<m; j++) {
+                  double zz = qz[j]/p.z;
+                  double rr = (1+zz)*p.x - zz*p.y;
+                  double dd = sqrt(qx[j]*qx[j]+qy[j]*qy[j])-rr;
+                  r[j] = std::max(dd,-std::min(p.z+qz[j],0.-qz[j]));
+              }
+              break;
+            case op_square:
+              for (int j=0; j<m; j++) {
+                  double zz = qz[j]/p.z;
+                  double rr = (1+zz)*p.x - zz*p.y;
+                  double dd = std::max(std::abs(qx[j]),std::abs(qy[j]))-rr;
+                  r[j] = std::max(dd,-std::min(p.z+qz[j],0.-qz[j]));
+              }
+              break;
+            case op_plane:
+              for (int j=0; j<m; j++) {
+                  r[j] = (qx[j]-i.b.x)*p.x + (qy[j]-i.b.y)*p.y + (qz[j]-i.b.z)*p.z;
+              }
+              break;
+            default: // op_call
+              for (int j=0; j<m; j++) {
+                  r[j] = i.sdf->getDist(Vector3d(qx[j],qy[j],qz[j]));
+              }
+          }
+          sp++;
+      }
+      for (int j=0; j<m; j++) {
+          d[b0+j] = stack[j];
+      }
+  }
+}
@@ -7,6 +7,8 @@
 
 #include "mymath.h"
 
+class SDF_Compiled;
+
 
 
 /**
@@ -29,6 +31,24 @@ public:
      */
     virtual double getDist(const Vector3d& v) const { return -1e100; } ///< Returns the signed distance to the next boundary
 
+    /**
+     * Returns the gradient of the signed distance function, i.e. the outer normal of the next boundary
+     * (of length 1 for exact signed distance functions). Per default, it is approximated by central differences,
+     * derived classes overwrite this function with the analytic gradient.
+     *
+     * @param v     spatial position [cm]
+     * @param eps   step size of the central differences [cm]
+     * \return      gradient of the signed distance [1]
+     */
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const;
+    ///< Returns the gradient of the signed distance function
+
+    virtual void getDists(const std::vector<Vector3d>& v, std::vector<double>& d) const;
+    ///< Returns the signed distances of multiple points (calls getDist per default)
+
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const;
+    ///< Appends the evaluation of this geometry at M*v+t to the compiled code, @see SDF_Compiled
+
     /**
      * Returns a string representation of the object (for debugging)
      */
@@ -68,6 +88,8 @@ public:
     SDF_PlantBox(double x, double y, double z) { dim = Vector3d(x/2.,y/2.,z/2.); } ///< creates a rectangular box
 
     virtual double getDist(const Vector3d& v) const; ///< @see SignedDistanceFunction::getDist
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override; ///< @see SignedDistanceFunction::getGradient
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override; ///< @see SignedDistanceFunction::compile
 
     virtual std::string toString()  { return "SDF_PlantBox"; } ///< @see SignedDistanceFunction::toString
 
@@ -91,6 +113,8 @@ public:
     SDF_PlantContainer(double r1_, double r2_, double h_, double sq=false); ///< Creates a cylindrical or square container
 
     virtual double getDist(const Vector3d& v) const; ///< @see SignedDistanceFunction::getDist
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override; ///< @see SignedDistanceFunction::getGradient
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override; ///< @see SignedDistanceFunction::compile
 
     virtual std::string toString()  { return "SDF_PlantContainer"; } ///< @see SignedDistanceFunction::toString
 
@@ -119,6 +143,8 @@ public:
     SDF_RotateTranslate(SignedDistanceFunction* sdf, Vector3d pos): SDF_RotateTranslate(sdf, 0., xaxis, pos) { } ///< Translate only
 
     virtual double getDist(const Vector3d& v) const; ///< @see SignedDistanceFunction::getDist
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override; ///< @see SignedDistanceFunction::getGradient
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override; ///< @see SignedDistanceFunction::compile
 
     virtual std::string toString()  { return "SDF_RotateTranslate"; } ///< @see SignedDistanceFunction::toString
 
@@ -147,6 +173,8 @@ public:
     ///< Constructs (sdf1 ∩ sdf2)
 
     virtual double getDist(const Vector3d& v) const;  ///< @see SignedDistanceFunction::getDist
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override; ///< @see SignedDistanceFunction::getGradient
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override; ///< @see SignedDistanceFunction::compile
 
     virtual std::string toString()  { return "SDF_Intersection"; } ///< @see SignedDistanceFunction::toString
 
@@ -169,6 +197,8 @@ public:
     SDF_Union(SignedDistanceFunction* sdf1, SignedDistanceFunction* sdf2): SDF_Intersection(sdf1,sdf2) { } ///< Constructs sdf1 U sdf2
 
     virtual double getDist(const Vector3d& v) const;  ///< @see SignedDistanceFunction::getDist
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override; ///< @see SignedDistanceFunction::getGradient
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override; ///< @see SignedDistanceFunction::compile
 
     virtual std::string toString()  { return "SDF_Union"; } ///< @see SignedDistanceFunction::toString
 };
@@ -182,10 +212,12 @@ class SDF_Difference : public SDF_Intersection
 {
 
 public:
-    SDF_Difference(std::vector<SignedDistanceFunction*> sdfs_) :SDF_Intersection(sdfs) { } ///< Constructs (...((sdfs_[0] \ sdfs_[1]) \ sdfs_[2])...)
+    SDF_Difference(std::vector<SignedDistanceFunction*> sdfs_) :SDF_Intersection(sdfs_) { } ///< Constructs (...((sdfs_[0] \ sdfs_[1]) \ sdfs_[2])...)
     SDF_Difference(SignedDistanceFunction* sdf1, SignedDistanceFunction* sdf2) :SDF_Intersection(sdf1,sdf2) { } ///< Constructs sdf1 \ sdf2
 
     virtual double getDist(const Vector3d& v) const;  ///< @see SignedDistanceFunction::getDist
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override; ///< @see SignedDistanceFunction::getGradient
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override; ///< @see SignedDistanceFunction::compile
 
     virtual std::string toString()  { return "SDF_Difference"; } ///< @see SignedDistanceFunction::toString
 };
@@ -202,6 +234,9 @@ public:
     SDF_Complement(SignedDistanceFunction* sdf_) { sdf=sdf_; } ///< Constructs the complement (sdf_)^c
 
     virtual double getDist(const Vector3d& v) const { return -sdf->getDist(v); } ///< @see SignedDistanceFunction::getDist
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override { return sdf->getGradient(v, eps).times(-1.); }
+    ///< @see SignedDistanceFunction::getGradient
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override; ///< @see SignedDistanceFunction::compile
 
     virtual int writePVPScript(std::ostream & cout, int c=1) const { return sdf->writePVPScript(cout,c); } ///< same as original geometry
 
@@ -224,6 +259,8 @@ public:
     SDF_HalfPlane(const Vector3d& o, const Vector3d& p1, const Vector3d& p2);  ///< half plane by origin and two linear independent vectors
 
     virtual double getDist(const Vector3d& v) const { return n.times(v.minus(o)); } ///< @see SignedDistanceFunction::getDist
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override { return n; } ///< @see SignedDistanceFunction::getGradient
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override; ///< @see SignedDistanceFunction::compile
 
     virtual int writePVPScript(std::ostream & cout, int c=1) const; ///< @see SignedDistanceFunction::writePVPScript
 
@@ -237,4 +274,64 @@ public:
 };
 
 
+/**
+ * SDF_Compiled flattens a tree of signed distance functions into a linear code (evaluated by a small stack machine),
+ * with the rotations and translations of all SDF_RotateTranslate premultiplied into the leaves.
+ *
+ * Plant boxes, plant containers, and half planes are evaluated inline, intersections, unions, differences, and complements
+ * are resolved into stack operations. Other geometries (e.g. implemented in Python) are called as they are.
+ * The compiled geometry references the original tree (that must be kept alive), e.g. for the gradient and visualisation.
+ * Distances can differ from the original tree by rounding errors, since the transformations are premultiplied.
+ */
+class SDF_Compiled : public SignedDistanceFunction
+{
+
+public:
+
+    enum OpCode { op_call=0, op_box=1, op_container=2, op_square=3, op_plane=4, op_maxneg=5, op_min=6, op_neg=7 }; ///< instructions
+
+    /**
+     * One instruction of the compiled code, leaves are evaluated at p = M*v+t
+     */
+    struct Instruction {
+        int op; ///< @see OpCode
+        Matrix3d M; ///< premultiplied rotation
+        Vector3d t; ///< premultiplied translation
+        bool transformed; ///< false if M is the identity and t is zero
+        Vector3d a; ///< parameters of the leaf (box dimensions; container radii and height; plane normal)
+        Vector3d b; ///< parameters of the leaf (plane origin)
+        const SignedDistanceFunction* sdf; ///< called geometry (op_call)
+    };
+
+    SDF_Compiled(SignedDistanceFunction* sdf); ///< compiles the geometry
+
+    virtual double getDist(const Vector3d& v) const override; ///< @see SignedDistanceFunction::getDist
+    virtual void getDists(const std::vector<Vector3d>& v, std::vector<double>& d) const override; ///< @see SignedDistanceFunction::getDists
+    virtual Vector3d getGradient(const Vector3d& v, double eps = 5.e-4) const override { return sdf->getGradient(v, eps); } ///< gradient of the original tree
+    virtual void compile(SDF_Compiled& c, const Matrix3d& M, const Vector3d& t) const override { sdf->compile(c, M, t); } ///< @see SignedDistanceFunction::compile
+
+    virtual std::string toString() override { return "SDF_Compiled"; } ///< @see SignedDistanceFunction::toString
+    virtual int writePVPScript(std::ostream & cout, int c=1) const override { return sdf->writePVPScript(cout,c); } ///< same as original geometry
+
+    void addLeaf(int op, const Matrix3d& M, const Vector3d& t, const Vector3d& a = Vector3d(), const Vector3d& b = Vector3d());
+    ///< appends a leaf (op_box, op_container, op_square, op_plane)
+    void addCall(const SignedDistanceFunction* sdf, const Matrix3d& M, const Vector3d& t); ///< appends a call of a geometry that cannot be compiled
+    void addOperation(int op); ///< appends op_maxneg, op_min, or op_neg
+
+    size_t getNumberOfInstructions() const { return code.size(); } ///< length of the compiled code
+    int getNumberOfCalls() const; ///< number of geometries that are called (i.e. not compiled)
+
+private:
+
+    double evalLeaf(const Instruction& i, const Vector3d& v) const; ///< evaluates a single leaf
+
+    SignedDistanceFunction* sdf; ///< original geometry
+    std::vector<Instruction> code; ///< compiled code
+    int depth = 0; ///< current stack depth while compiling
+    int maxDepth = 0; ///< stack size needed for evaluation
+
+    static const int blockSize = 256; ///< number of points evaluated together by getDists
+};
+
+
 #endif
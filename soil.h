@@ -3,6 +3,8 @@
 
 #include "mymath.h"
 #include <cmath>
+#include <atomic>
+#include <stdexcept>
 #include "sdf.h"
 
 class Root;
@@ -28,6 +30,21 @@ public:
 	 */
 	virtual double getValue(const Vector3d& pos, const Root* root = nullptr) const { return 1.; } ///< Returns a scalar property of the soil, 1. per default
 
+	/**
+	 * Returns the scalar soil property at multiple positions (e.g. the trials of hydrotropism),
+	 * per default getValue() is called for each position. Overwrite for faster look ups.
+	 *
+	 * @param pos       positions [cm]
+	 * @param root      the root that wants to know the scalar property
+	 * @param values    scalar soil property per position (output)
+	 */
+	virtual void getValues(const std::vector<Vector3d>& pos, const Root* root, std::vector<double>& values) const {
+		values.resize(pos.size());
+		for (size_t i=0; i<pos.size(); i++) {
+			values[i] = this->getValue(pos[i], root);
+		}
+	} ///< Returns the scalar soil property at multiple positions
+
 	virtual std::string toString() const { return "SoilLookUp base class"; } ///< Quick info about the object for debugging
 
 };
@@ -105,6 +122,26 @@ protected:
 
 
 
+/**
+ * Remembers the index of the last look up (e.g. of Grid1D::map),
+ * concurrent look ups (e.g. by growth tasks) share the hint without data races
+ */
+class LookUpHint
+{
+public:
+	LookUpHint() { }
+	LookUpHint(const LookUpHint& h) : i(h.get()) { }
+	LookUpHint& operator=(const LookUpHint& h) { set(h.get()); return *this; }
+
+	size_t get() const { return i.load(std::memory_order_relaxed); } ///< index of the last look up
+	void set(size_t j) const { i.store(j, std::memory_order_relaxed); } ///< sets the index of the last look up
+
+private:
+	mutable std::atomic<size_t> i { 0 };
+};
+
+
+
 /**
  * 1D look up table
  */
@@ -124,6 +161,10 @@ public:
 	};
 
 	virtual size_t map(double x) const {
+		size_t h = hint.get(); // successive look ups are often in the same cell
+		if ((h+1<n) && (grid[h]<=x) && (x<grid[h+1])) {
+			return h;
+		}
 		unsigned int jr,jm,jl;
 		jl=0;
 		jr=n;
@@ -134,14 +175,14 @@ public:
 			else
 				jr=jm;
 		}
+		hint.set(jl);
 		return jl;
-	} ///< Generic way to perform look up in an ordered table, overwrite by faster method if appropriate
+	} ///< Generic way to perform look up in an ordered table (starting with the cell of the last look up), overwrite by faster method if appropriate
 
 	virtual double getValue(const Vector3d& pos, const Root* root = nullptr) const override {
 		size_t i = map(pos.z);
-		i = std::max(int(i),0);
-		i = std::min(int(i),int(n-1));
-		return data[i];
+		i = std::min(int(i),int(n)-2); // data has n-1 entries
+		return data[std::max(int(i),0)];
 	} ///< Returns the data of the 1d table, repeats first or last entry if out of bound
 
 	virtual std::string toString() const override { return "RectilinearGrid1D"; } ///< Quick info about the object for debugging
@@ -149,6 +190,11 @@ public:
 	size_t n;
 	std::vector<double> grid;
 	std::vector<double> data;
+
+protected:
+
+	LookUpHint hint; ///< cell of the last look up
+
 };
 
 
@@ -180,8 +226,9 @@ public:
 	}
 
 	virtual size_t map(double x) const override {
-		return std::floor((x-a)/(b-a)*(n-1));
-	}
+		double i = std::floor((x-a)/(b-a)*(n-1));
+		return (i>0.) ? size_t(std::min(i, double(n-1))) : 0; // clamped like Grid1D::map (also for x<a, and NaN)
+	} ///< index of the cell containing x, 0 for x<a, and n-1 for x>=b
 
 	virtual std::string toString() const  override{ return "LinearGrid1D"; } ///< Quick info about the object for debugging
 
@@ -191,8 +238,18 @@ public:
 };
 
 
+
 /**
- * Fantastic
+ * 3D look up table on a rectilinear grid, given by three Grid1D (the grid points along x, y, and z).
+ *
+ * The data are given per grid point, point (i,j,k) has the index (i*ny+j)*nz+k (@see RectilinearGrid3D::index),
+ * previous versions used the index i*nx*ny+j*ny+k (which only agrees for nx==ny==nz).
+ * Per default, a look up returns the value of the lower corner of the cell containing the position,
+ * optionally the values of the eight corners are interpolated trilinearly (@see RectilinearGrid3D::setInterpolation).
+ * Positions outside of the grid are clamped to the grid.
+ *
+ * The data can be replaced by a soil model without copying, either by swapping vectors (RectilinearGrid3D::swapData),
+ * or by looking up the values directly in the memory of the soil model (RectilinearGrid3D::setDataView).
  */
 class RectilinearGrid3D  : public SoilLookUp
 {
@@ -207,20 +264,57 @@ public:
 
 	virtual ~RectilinearGrid3D() { };
 
+	size_t index(size_t i, size_t j, size_t k) const { return (i*ny+j)*nz+k; } ///< data index of grid point (i,j,k)
+
 	virtual size_t map(double x, double y, double z) const {
-		size_t i = xgrid->map(x);
-		size_t j = ygrid->map(y);
-		size_t k = zgrid->map(z);
-		return i*(nx*ny)+j*ny+k; // or whatever
-	}
+		size_t c[3];
+		double t[3];
+		locate(x, y, z, c, t);
+		for (int a=0; a<3; a++) {
+			c[a] += (t[a]>=1.); // beyond the last grid point
+		}
+		return index(c[0], c[1], c[2]);
+	} ///< data index of the lower corner of the cell containing the position
 
-	double getData(size_t i, size_t j, size_t k) {
-		return data.at(map(i,j,k));
-	}
+	virtual double getValue(const Vector3d& pos, const Root* root = nullptr) const override {
+		return value(pos);
+	} ///< Returns the value at the lower corner of the cell, or the trilinear interpolation
+
+	virtual void getValues(const std::vector<Vector3d>& pos, const Root* root, std::vector<double>& values) const override {
+		values.resize(pos.size());
+		for (size_t i=0; i<pos.size(); i++) {
+			values[i] = value(pos[i]);
+		}
+	} ///< Returns the values at multiple positions, @see RectilinearGrid3D::getValue
+
+	void setInterpolation(bool trilinear) { interpolation = trilinear; } ///< trilinear interpolation of the data (instead of the value of the lower corner)
+	bool getInterpolation() const { return interpolation; } ///< true if the data are interpolated
+
+	double getData(size_t i, size_t j, size_t k) const {
+		return getDataPointer()[index(i,j,k)];
+	} ///< value at grid point (i,j,k)
 
 	void setData(size_t i, size_t j, size_t k, double d) {
-		data.at(map(i,j,k)) = d;
-	}
+		data.at(index(i,j,k)) = d;
+	} ///< sets the value at grid point (i,j,k)
+
+	void swapData(std::vector<double>& d) {
+		if (d.size()!=nx*ny*nz) {
+			throw std::invalid_argument("RectilinearGrid3D::swapData() wrong number of values");
+		}
+		data.swap(d);
+	} ///< exchanges the data with a vector of the soil model (in constant time)
+
+	void setDataView(const double* d, size_t n) {
+		if ((d!=nullptr) && (n!=nx*ny*nz)) {
+			throw std::invalid_argument("RectilinearGrid3D::setDataView() wrong number of values");
+		}
+		view = d;
+	} ///< looks up the values in n doubles of external memory, that must stay valid (nullptr uses the data vector again)
+
+	const double* getDataPointer() const { return (view!=nullptr) ? view : data.data(); } ///< the values used by the look up
+
+	virtual std::string toString() const override { return "RectilinearGrid3D"; } ///< Quick info about the object for debugging
 
 	Grid1D* xgrid;
 	Grid1D* ygrid;
@@ -229,22 +323,118 @@ public:
 	size_t nx,ny,nz;
 	std::vector<double> data;
 
+protected:
+
+	/**
+	 * Finds the cell containing a position
+	 *
+	 * @param x,y,z     position [cm]
+	 * @param c         cell index per axis, in [0, n-2] (output)
+	 * @param t         local coordinate within the cell per axis, in [0,1] (output)
+	 */
+	virtual void locate(double x, double y, double z, size_t* c, double* t) const {
+		const double p[3] = { x, y, z };
+		const Grid1D* g[3] = { xgrid, ygrid, zgrid };
+		for (int a=0; a<3; a++) {
+			const std::vector<double>& ga = g[a]->grid;
+			size_t n = g[a]->n;
+			if (n<2) {
+				c[a] = 0;
+				t[a] = 0.;
+				continue;
+			}
+			long i = long(g[a]->map(p[a]));
+			i = std::max(std::min(i, long(n)-2), 0L);
+			c[a] = i;
+			t[a] = std::max(std::min((p[a]-ga[i])/(ga[i+1]-ga[i]), 1.), 0.);
+		}
+	}
+
+	double value(const Vector3d& pos) const {
+		size_t c[3];
+		double t[3];
+		locate(pos.x, pos.y, pos.z, c, t);
+		const double* d = getDataPointer();
+		if (!interpolation) {
+			return d[index(c[0]+(t[0]>=1.), c[1]+(t[1]>=1.), c[2]+(t[2]>=1.))];
+		}
+		const size_t i1 = std::min(c[0]+1, nx-1), j1 = std::min(c[1]+1, ny-1), k1 = std::min(c[2]+1, nz-1); // n==1 axes
+		const double* d0 = d+index(c[0], c[1], 0);
+		const double* d1 = d+index(c[0], j1, 0);
+		const double* d2 = d+index(i1, c[1], 0);
+		const double* d3 = d+index(i1, j1, 0);
+		const size_t k0 = c[2];
+		double v00 = d0[k0]+t[2]*(d0[k1]-d0[k0]);
+		double v01 = d1[k0]+t[2]*(d1[k1]-d1[k0]);
+		double v10 = d2[k0]+t[2]*(d2[k1]-d2[k0]);
+		double v11 = d3[k0]+t[2]*(d3[k1]-d3[k0]);
+		double v0 = v00+t[1]*(v01-v00);
+		double v1 = v10+t[1]*(v11-v10);
+		return v0+t[0]*(v1-v0);
+	} ///< look up (non virtual, for getValue and getValues)
+
+	bool interpolation = false;
+	const double* view = nullptr; // external data (or nullptr)
+
 };
 
+
+
 /**
- *  Even more fantastic
+ * 3D look up table on an equidistant grid, the cell containing a position is computed directly (in O(1)),
+ * @see RectilinearGrid3D
  */
 class EquidistantGrid3D : public RectilinearGrid3D
 {
-	EquidistantGrid3D(double x0, double xe, int nx, double y0, double ye, int ny, double z0, double ze, int nz) : RectilinearGrid3D(new EquidistantGrid1D(x0,xe,nx),new EquidistantGrid1D(y0,ye,ny),new EquidistantGrid1D(z0,ze,nz)) {
+public:
+
+	/**
+	 * Creates the grid points x0, x0+(xe-x0)/(nx-1), ..., xe along each axis
+	 *
+	 * @param x0,xe,nx  first and last grid point, and number of grid points along the x-axis
+	 * @param y0,ye,ny  first and last grid point, and number of grid points along the y-axis
+	 * @param z0,ze,nz  first and last grid point, and number of grid points along the z-axis
+	 */
+	EquidistantGrid3D(double x0, double xe, int nx, double y0, double ye, int ny, double z0, double ze, int nz) :
+		RectilinearGrid3D(new EquidistantGrid1D(x0,xe,nx),new EquidistantGrid1D(y0,ye,ny),new EquidistantGrid1D(z0,ze,nz)) {
+		if ((nx<1) || (ny<1) || (nz<1)) {
+			throw std::invalid_argument("EquidistantGrid3D::EquidistantGrid3D() at least one grid point per axis is needed");
+		}
+		const double a[3] = { x0, y0, z0 }, b[3] = { xe, ye, ze };
+		const int n[3] = { nx, ny, nz };
+		for (int i=0; i<3; i++) {
+			origin[i] = a[i];
+			invh[i] = (n[i]>1) ? (n[i]-1)/(b[i]-a[i]) : 0.;
+			cells[i] = std::max(n[i]-1, 1);
+		}
 	}
 
+	EquidistantGrid3D(const EquidistantGrid3D& g) = delete;
+
 	virtual ~EquidistantGrid3D() {
 		delete xgrid;
 		delete ygrid;
 		delete zgrid;
 	}
 
+	virtual std::string toString() const override { return "EquidistantGrid3D"; } ///< Quick info about the object for debugging
+
+protected:
+
+	virtual void locate(double x, double y, double z, size_t* c, double* t) const override {
+		const double p[3] = { x, y, z };
+		for (int a=0; a<3; a++) {
+			double s = std::max(std::min((p[a]-origin[a])*invh[a], double(cells[a])), 0.); // in cell units, clamped to the grid
+			long i = std::min(long(s), long(cells[a])-1);
+			c[a] = i;
+			t[a] = s-i;
+		}
+	}
+
+	double origin[3]; // first grid point per axis
+	double invh[3]; // inverse spacing per axis
+	int cells[3]; // number of cells per axis (at least one)
+
 };
 
 
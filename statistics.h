@@ -0,0 +1,187 @@
+#ifndef STATISTICS_H_
+#define STATISTICS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * P2Quantile
+ *
+ * Streaming estimate of a single quantile with constant memory, using the P^2 algorithm (Jain and Chlamtac 1985):
+ * five markers track the minimum, the p/2, p, (1+p)/2 quantiles, and the maximum, and are adjusted by piecewise
+ * parabolic interpolation. The estimate is exact for less than five samples.
+ */
+class P2Quantile
+{
+
+public:
+
+	P2Quantile(double p = 0.5) : p(p) {
+		if ((p<0) || (p>1)) {
+			throw std::invalid_argument("P2Quantile::P2Quantile() probability must be within [0,1]");
+		}
+		dn[0] = 0.; dn[1] = p/2.; dn[2] = p; dn[3] = (1.+p)/2.; dn[4] = 1.;
+	}
+
+	void add(double x) {
+		if (count<5) {
+			q[count++] = x;
+			if (count==5) {
+				std::sort(q, q+5);
+				for (int i=0; i<5; i++) {
+					n[i] = i;
+					np[i] = 4.*dn[i];
+				}
+			}
+			return;
+		}
+		count++;
+		int k; // cell of x
+		if (x<q[0]) {
+			q[0] = x;
+			k = 0;
+		} else if (x>=q[4]) {
+			q[4] = x;
+			k = 3;
+		} else {
+			k = 0;
+			while (x>=q[k+1]) {
+				k++;
+			}
+		}
+		for (int i=k+1; i<5; i++) {
+			n[i]++;
+		}
+		for (int i=0; i<5; i++) {
+			np[i] += dn[i];
+		}
+		for (int i=1; i<4; i++) { // adjust the inner markers
+			double d = np[i]-n[i];
+			if (((d>=1.) && (n[i+1]-n[i]>1)) || ((d<=-1.) && (n[i-1]-n[i]<-1))) {
+				int s = (d>0) ? 1 : -1;
+				double qp = parabolic(i, s);
+				if ((q[i-1]<qp) && (qp<q[i+1])) {
+					q[i] = qp;
+				} else { // linear
+					q[i] += s*(q[i+s]-q[i])/(n[i+s]-n[i]);
+				}
+				n[i] += s;
+			}
+		}
+	} ///< adds a sample
+
+	double get() const {
+		if (count==0) {
+			return 0.;
+		}
+		if (count<5) { // exact (linear interpolation of the sorted samples)
+			double s[5];
+			std::copy(q, q+count, s);
+			std::sort(s, s+count);
+			double r = p*(count-1);
+			int i = std::min(int(r), int(count)-1);
+			int j = std::min(i+1, int(count)-1);
+			return s[i]+(r-i)*(s[j]-s[i]);
+		}
+		return q[2];
+	} ///< the quantile estimate (0 if there are no samples)
+
+	double getProbability() const { return p; } ///< probability of the quantile
+	size_t getNumberOfSamples() const { return count; } ///< number of added samples
+
+private:
+
+	double parabolic(int i, int s) const {
+		return q[i]+double(s)/(n[i+1]-n[i-1])*((n[i]-n[i-1]+s)*(q[i+1]-q[i])/(n[i+1]-n[i])+(n[i+1]-n[i]-s)*(q[i]-q[i-1])/(n[i]-n[i-1]));
+	} // piecewise parabolic prediction of marker i moved by s
+
+	double p;
+	size_t count = 0;
+	double q[5] = { 0., 0., 0., 0., 0. }; // marker heights (the first samples, while count<5)
+	double n[5] = { 0., 0., 0., 0., 0. }; // marker positions
+	double np[5] = { 0., 0., 0., 0., 0. }; // desired marker positions
+	double dn[5]; // increments of the desired positions
+
+};
+
+/**
+ * EnsembleStatistics
+ *
+ * Streaming statistics of a profile (a vector of values, e.g. a vertical root length distribution) over many samples
+ * (e.g. plants): mean and variance per cell (Welford's algorithm), and quantiles per cell (@see P2Quantile).
+ * Memory does not depend on the number of samples, @see RootSystemEnsemble::reduce
+ */
+class EnsembleStatistics
+{
+
+public:
+
+	EnsembleStatistics(size_t n = 0, const std::vector<double>& probabilities = { 0.05, 0.5, 0.95 })
+		: probabilities(probabilities), mean(n, 0.), m2(n, 0.) {
+		for (double p : probabilities) {
+			quantiles.push_back(std::vector<P2Quantile>(n, P2Quantile(p)));
+		}
+	} ///< statistics of a profile with n cells
+
+	void add(const std::vector<double>& x) {
+		if (x.size()!=mean.size()) {
+			throw std::invalid_argument("EnsembleStatistics::add() sample has the wrong number of cells");
+		}
+		count++;
+		for (size_t i=0; i<x.size(); i++) {
+			double d = x[i]-mean[i];
+			mean[i] += d/count;
+			m2[i] += d*(x[i]-mean[i]);
+		}
+		for (auto& q : quantiles) {
+			for (size_t i=0; i<x.size(); i++) {
+				q[i].add(x[i]);
+			}
+		}
+	} ///< adds a sample (one value per cell)
+
+	size_t size() const { return mean.size(); } ///< number of cells
+	size_t getNumberOfSamples() const { return count; } ///< number of added samples
+	std::vector<double> getProbabilities() const { return probabilities; } ///< probabilities of the quantiles
+	std::vector<double> getMean() const { return mean; } ///< mean per cell
+	std::vector<double> getVariance() const {
+		std::vector<double> v(m2.size(), 0.);
+		if (count>1) {
+			for (size_t i=0; i<v.size(); i++) {
+				v[i] = m2[i]/(count-1);
+			}
+		}
+		return v;
+	} ///< sample variance per cell (0 for less than two samples)
+	std::vector<double> getStd() const {
+		std::vector<double> v = getVariance();
+		for (auto& x : v) {
+			x = std::sqrt(x);
+		}
+		return v;
+	} ///< sample standard deviation per cell
+	std::vector<double> getQuantile(int j) const {
+		const auto& q = quantiles.at(j);
+		std::vector<double> v(q.size());
+		for (size_t i=0; i<v.size(); i++) {
+			v[i] = q[i].get();
+		}
+		return v;
+	} ///< estimate of the j-th quantile (@see EnsembleStatistics::getProbabilities) per cell
+
+private:
+
+	std::vector<double> probabilities;
+	size_t count = 0;
+	std::vector<double> mean;
+	std::vector<double> m2; // summed squared deviations from the mean
+	std::vector<std::vector<P2Quantile>> quantiles; // per probability and cell
+
+};
+
+inline bool operator==(const EnsembleStatistics& lhs, const EnsembleStatistics& rhs){ return (&lhs==&rhs); } // only address wise, needed for boost python indexing suite
+inline bool operator!=(const EnsembleStatistics& lhs, const EnsembleStatistics& rhs){ return !(lhs == rhs); }
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/**
+ * Minimal helpers of the regression tests (see CMakeLists.txt, run ctest after building)
+ *
+ * Each test is a small program that returns 0 on success, failed checks are written to std::cerr.
+ */
+
+#ifdef CROOTBOX_MODELPARAMETER
+static const std::string testParameters = CROOTBOX_MODELPARAMETER;
+#else
+static const std::string testParameters = "modelparameter/";
+#endif
+
+static int testFailures = 0; ///< number of failed checks
+
+/**
+ * Records a failed check
+ */
+inline void check(bool ok, const std::string& what)
+{
+	if (!ok) {
+		std::cerr << "FAILED: " << what << "\n";
+		testFailures++;
+	}
+}
+
+/**
+ * Checks that |a-b| <= tol*max(1,|a|,|b|)
+ */
+inline void checkClose(double a, double b, double tol, const std::string& what)
+{
+	double s = std::max(1., std::max(std::fabs(a), std::fabs(b)));
+	if (!(std::fabs(a-b)<=tol*s)) {
+		std::stringstream ss;
+		ss << what << " (" << a << " != " << b << ")";
+		check(false, ss.str());
+	}
+}
+
+/**
+ * Discards the console output of the model (parameter files, simulation messages)
+ */
+class Silence {
+public:
+	Silence() : old(std::cout.rdbuf(&null)) { }
+	~Silence() { std::cout.rdbuf(old); }
+private:
+	struct NullBuffer : public std::streambuf { int overflow(int c) override { return c; } };
+	NullBuffer null;
+	std::streambuf* old;
+};
+
+/**
+ * Returns the exit code of a test program
+ */
+inline int testResult(const std::string& name)
+{
+	if (testFailures>0) {
+		std::cerr << name << ": " << testFailures << " check(s) failed\n";
+		return 1;
+	}
+	std::cout << name << ": passed\n";
+	return 0;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * Regression test of the binary checkpoints
+ *
+ * A root system restored from a checkpoint (RootSystem::writeState, RootSystem::readState, RootSystem::loadState)
+ * writes the same checkpoint, and continues to grow exactly like the original (with the same growth mode,
+ * parallel growth is not part of the checkpoint).
+ */
+#include "test.h"
+
+#include "RootSystem.h"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+/**
+ * The checkpoint of a root system, as fingerprint of its complete state
+ */
+std::string state(const RootSystem& rs)
+{
+	std::stringstream ss;
+	rs.writeState(ss);
+	return ss.str();
+}
+
+int main()
+{
+	const std::string name = "Zea_mays_1_Leitner_2010";
+	const std::string file = "test_checkpoint.ckpt";
+	for (bool streams : { false, true }) {
+		Silence s;
+		std::string what = streams ? " (random streams, parallel growth)" : "";
+		RootSystem a;
+		a.openFile(name, testParameters);
+		a.setSeed(6);
+		a.setRandomStreams(streams);
+		a.setParallelGrowth(streams, 4);
+		a.initialize();
+		a.simulate(8, true);
+		std::string s0 = state(a);
+
+		RootSystem b;
+		b.openFile(name, testParameters);
+		b.setParallelGrowth(streams, 4);
+		b.readState(s0.data(), s0.size());
+		check(state(b)==s0, "readState"+what+": same checkpoint");
+		a.simulate(7, true);
+		b.simulate(7, true);
+		check(state(b)==state(a), "readState"+what+": same growth");
+		check(b.getNumberOfNodes()==a.getNumberOfNodes(), "readState"+what+": same number of nodes");
+
+		a.saveState(file);
+		RootSystem c;
+		c.openFile(name, testParameters);
+		c.setParallelGrowth(streams, 4);
+		c.loadState(file);
+		std::remove(file.c_str());
+		check(state(c)==state(a), "loadState"+what+": same checkpoint");
+		a.simulate(5, true);
+		c.simulate(5, true);
+		check(state(c)==state(a), "loadState"+what+": same growth");
+	}
+	return testResult("checkpoint");
+}
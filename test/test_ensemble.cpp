@@ -0,0 +1,78 @@
+/**
+ * Regression test of RootSystemEnsemble
+ *
+ * The plants use the soil of the prototype, unless the ensemble sets a soil (RootSystemEnsemble::setSoil).
+ */
+#include "test.h"
+
+#include "RootSystemEnsemble.h"
+#include "soil.h"
+
+#include <atomic>
+#include <vector>
+
+/**
+ * Soil that counts its look ups (thread safe)
+ */
+class CountingSoil : public SoilLookUp
+{
+public:
+	virtual double getValue(const Vector3d& pos, const Root* root = nullptr) const override {
+		calls++;
+		return 1.+0.1*pos.x;
+	}
+	mutable std::atomic<long> calls { 0 };
+};
+
+/**
+ * Total length of all plants
+ */
+double totalLength(const RootSystemEnsemble& e)
+{
+	return e.getSegmentAnalyser().getSummed(RootSystem::st_length);
+}
+
+/**
+ * Seeded ensemble of the test, with hydrotropism for all root types
+ */
+void setUp(RootSystemEnsemble& e)
+{
+	e.openFile("Anagallis_femina_Leitner_2010", testParameters);
+	for (int t=1; t<=4; t++) {
+		RootTypeParameter* p = e.getParameters()->getRootTypeParameter(t);
+		if (p->type>0) {
+			p->tropismT = RootSystem::tt_hydro;
+		}
+	}
+	e.setGrid(2, 2, 10., 10., 3.);
+	e.setSeed(4);
+}
+
+int main()
+{
+	CountingSoil soil;
+	double prototypeSoil, ensembleSoil;
+	{
+		Silence s;
+		RootSystemEnsemble a(2);
+		setUp(a);
+		a.getParameters()->setSoil(&soil);
+		a.initialize();
+		a.simulate(10, true);
+		prototypeSoil = totalLength(a);
+	}
+	check(soil.calls>0, "the plants use the soil of the prototype");
+	soil.calls = 0;
+	{
+		Silence s;
+		RootSystemEnsemble b(2);
+		setUp(b);
+		b.setSoil(&soil);
+		b.initialize();
+		b.simulate(10, true);
+		ensembleSoil = totalLength(b);
+	}
+	check(soil.calls>0, "the plants use the soil of the ensemble");
+	check(prototypeSoil==ensembleSoil, "same plants with the soil of the prototype, or of the ensemble");
+	return testResult("ensemble");
+}
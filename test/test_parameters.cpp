@@ -0,0 +1,59 @@
+/**
+ * Regression test of the shared root type parameters
+ *
+ * Root systems using the same parameter set (RootSystem::loadParameters) keep sharing it during
+ * initialize and simulate, and grow like root systems with their own copy of the parameters.
+ */
+#include "test.h"
+
+#include "RootSystem.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Total length and number of nodes of a root system as string
+ */
+std::string summary(RootSystem& rs)
+{
+	std::vector<double> l = rs.getScalar(RootSystem::st_length);
+	double s = 0.;
+	for (double v : l) {
+		s += v;
+	}
+	return std::to_string(s)+" cm, "+std::to_string(rs.getNumberOfNodes())+" nodes";
+}
+
+int main()
+{
+	const std::string name = "Anagallis_femina_Leitner_2010";
+	for (bool parallel : { false, true }) {
+		Silence s;
+		std::string what = parallel ? " (parallel growth)" : "";
+		RootSystem ref;
+		ref.openFile(name, testParameters);
+		RootSystem a, b;
+		a.loadParameters(name, testParameters);
+		b.loadParameters(name, testParameters);
+		check(a.hasSharedParameters() && b.hasSharedParameters(), "shared after loadParameters"+what);
+		for (RootSystem* rs : { &ref, &a, &b }) {
+			rs->setSeed(7);
+			rs->setParallelGrowth(parallel, 2);
+			rs->initialize();
+		}
+		check(a.hasSharedParameters() && b.hasSharedParameters(), "shared after initialize"+what);
+		ref.simulate(10, true);
+		a.simulate(10, true);
+		b.simulate(10, true);
+		check(a.hasSharedParameters() && b.hasSharedParameters(), "shared after simulate"+what);
+		check(summary(a)==summary(ref), "shared parameters grow like own parameters"+what+": "+summary(a)+" vs "+summary(ref));
+		check(summary(b)==summary(ref), "same growth of a second root system"+what+": "+summary(b)+" vs "+summary(ref));
+
+		RootSystem c(a); // copies share the parameters, until they are modified
+		check(c.hasSharedParameters(), "shared by copies"+what);
+		c.getRootTypeParameter(1)->la *= 2.;
+		check(!c.hasSharedParameters(), "not shared after modification"+what);
+		check(a.readRootTypeParameter(1)->la*2.==c.readRootTypeParameter(1)->la, "the modification is not shared"+what);
+	}
+	return testResult("parameters");
+}
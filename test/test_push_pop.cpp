@@ -0,0 +1,66 @@
+/**
+ * Regression test of RootSystem::push and RootSystem::pop
+ *
+ * Popping a state restores the root system exactly (compared by its checkpoint, including the random number generators),
+ * with and without journaling (RootSystem::setJournaling), for serial and parallel growth.
+ */
+#include "test.h"
+
+#include "RootSystem.h"
+
+#include <sstream>
+#include <string>
+
+/**
+ * The checkpoint of a root system, as fingerprint of its complete state
+ */
+std::string state(const RootSystem& rs)
+{
+	std::stringstream ss;
+	rs.writeState(ss);
+	return ss.str();
+}
+
+int main()
+{
+	std::string grown[2]; // state after push, simulate, per growth mode
+	for (bool parallel : { false, true }) {
+		for (bool journaling : { false, true }) {
+			Silence s;
+			std::string what = std::string(journaling ? " (journaling" : " (full states")+(parallel ? ", parallel growth)" : ")");
+			RootSystem rs;
+			rs.openFile("Anagallis_femina_Leitner_2010", testParameters);
+			rs.setSeed(8);
+			rs.setParallelGrowth(parallel, 4);
+			rs.setJournaling(journaling);
+			rs.initialize();
+			rs.simulate(8, true);
+			std::string s0 = state(rs);
+
+			rs.push();
+			rs.simulate(5, true);
+			std::string s1 = state(rs);
+			rs.pop();
+			check(state(rs)==s0, "pop"+what);
+			rs.simulate(5, true);
+			check(state(rs)==s1, "same growth after pop"+what);
+			if (journaling) {
+				check(s1==grown[parallel], "same growth as with full states"+what);
+			} else {
+				grown[parallel] = s1;
+			}
+
+			rs.push(); // nested states
+			rs.simulate(3, true);
+			std::string s2 = state(rs);
+			rs.push();
+			rs.simulate(3, true);
+			rs.pop();
+			check(state(rs)==s2, "inner pop"+what);
+			rs.simulate(3, true);
+			rs.pop();
+			check(state(rs)==s1, "outer pop"+what);
+		}
+	}
+	return testResult("push_pop");
+}
@@ -0,0 +1,75 @@
+/**
+ * Regression test of the counter based random streams (RootSystem::setRandomStreams)
+ *
+ * With random streams, the plants do not depend on the order of growth: serial growth and parallel growth
+ * with 8 threads give the same plants, and so do ensembles simulated by 1 or 8 threads.
+ */
+#include "test.h"
+
+#include "RootSystem.h"
+#include "RootSystemEnsemble.h"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Coordinates and emergence times of all nodes, sorted (node indices depend on the order of growth)
+ */
+std::vector<std::vector<double>> sortedNodes(const RootSystem& rs)
+{
+	std::vector<Vector3d> nodes = rs.getNodes();
+	std::vector<std::vector<double>> n(nodes.size());
+	for (size_t i=0; i<nodes.size(); i++) {
+		n[i] = { nodes[i].x, nodes[i].y, nodes[i].z, rs.getNodeStore().netimes[i] };
+	}
+	std::sort(n.begin(), n.end());
+	return n;
+}
+
+int main()
+{
+	const std::string name = "Zea_mays_1_Leitner_2010"; // with basal and shoot borne roots
+	std::vector<std::vector<double>> serial;
+	for (int threads : { 0, 8 }) {
+		Silence s;
+		RootSystem rs;
+		rs.openFile(name, testParameters);
+		rs.setSeed(11);
+		rs.setRandomStreams(true);
+		rs.setParallelGrowth(threads>0, threads);
+		rs.initialize();
+		rs.simulate(20, true);
+		check(rs.hasRandomStreams(), "random streams are used");
+		if (threads==0) {
+			serial = sortedNodes(rs);
+		} else {
+			check(rs.getNumberOfNodes()==int(serial.size()), "same number of nodes with 8 threads");
+			check(sortedNodes(rs)==serial, "same nodes with 8 threads");
+		}
+	}
+
+	std::vector<std::vector<std::vector<double>>> plants;
+	for (int threads : { 1, 8 }) {
+		Silence s;
+		RootSystemEnsemble e(threads);
+		e.openFile(name, testParameters);
+		e.getParameters()->setRandomStreams(true);
+		e.setGrid(4, 2, 20., 20., 3.);
+		e.setSeed(3);
+		e.initialize();
+		e.simulate(15, true);
+		check(e.getNumberOfPlants()==8, "8 plants");
+		if (threads==1) {
+			for (RootSystem* p : e.getPlants()) {
+				plants.push_back(sortedNodes(*p));
+			}
+		} else {
+			bool same = true;
+			for (int i=0; i<e.getNumberOfPlants(); i++) {
+				same = same && (sortedNodes(*e.getPlant(i))==plants.at(i));
+			}
+			check(same, "same plants simulated by 1 or 8 threads");
+		}
+	}
+	return testResult("random_streams");
+}
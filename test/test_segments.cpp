@@ -0,0 +1,68 @@
+/**
+ * Regression test of the segment getters
+ *
+ * RootSystem::getSegments, RootSystem::getSegmentsOrigin, and RootSystem::getNETimes are served from the node store,
+ * they must equal the segments of the roots (in the order of RootSystem::getRoots, from base to tip),
+ * after serial and parallel growth, RootSystem::pop, and RootSystem::loadState.
+ */
+#include "test.h"
+
+#include "RootSystem.h"
+
+#include <cstdio>
+#include <vector>
+
+/**
+ * Compares the getters with the segments of the roots
+ */
+void checkSegments(const RootSystem& rs, const std::string& what)
+{
+	std::vector<Vector2i> seg = rs.getSegments();
+	std::vector<Root*> origin = rs.getSegmentsOrigin();
+	std::vector<double> netimes = rs.getNETimes();
+	size_t c = 0;
+	bool same = true;
+	for (Root* r : rs.getRoots()) {
+		for (size_t i=0; i+1<r->getNumberOfNodes(); i++) {
+			same = same && (c<seg.size()) && (seg[c].x==r->getNodeId(i)) && (seg[c].y==r->getNodeId(i+1));
+			same = same && (c<origin.size()) && (origin[c]==r);
+			same = same && (c<netimes.size()) && (netimes[c]==r->getNodeETime(i+1));
+			c++;
+		}
+	}
+	check(same, what+": segments of the roots");
+	check((c==seg.size()) && (c==origin.size()) && (c==netimes.size()), what+": number of segments");
+	check(int(c)==rs.getNumberOfSegments(), what+": RootSystem::getNumberOfSegments");
+}
+
+int main()
+{
+	const std::string name = "Zea_mays_1_Leitner_2010"; // with basal and shoot borne roots
+	const std::string ckpt = "test_segments.ckpt";
+	for (bool parallel : { false, true }) {
+		Silence s;
+		std::string what = parallel ? " (parallel growth)" : "";
+		RootSystem rs;
+		rs.openFile(name, testParameters);
+		rs.setSeed(2);
+		rs.setParallelGrowth(parallel, 4);
+		rs.initialize();
+		checkSegments(rs, "initialize"+what);
+		rs.simulate(10, true);
+		checkSegments(rs, "simulate"+what);
+		rs.push();
+		rs.simulate(10, true);
+		checkSegments(rs, "simulate after push"+what);
+		rs.pop();
+		checkSegments(rs, "pop"+what);
+		rs.simulate(5, true);
+		rs.saveState(ckpt);
+		RootSystem r2;
+		r2.openFile(name, testParameters);
+		r2.loadState(ckpt);
+		std::remove(ckpt.c_str());
+		checkSegments(r2, "loadState"+what);
+		check(r2.getSegments().size()==rs.getSegments().size(), "loadState"+what+": same segments");
+	}
+	return testResult("segments");
+}
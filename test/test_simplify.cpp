@@ -0,0 +1,77 @@
+/**
+ * Regression test of SegmentAnalyser::simplify
+ *
+ * The simplified segments represent the root length of the segments they replace, also when they are cropped
+ * to layers or boxes that are thinner than the coarse segments (i.e. with both nodes outside).
+ */
+#include "test.h"
+
+#include "RootSystem.h"
+#include "analysis.h"
+#include "sdf.h"
+
+#include <vector>
+
+double sum(const std::vector<double>& v)
+{
+	double s = 0.;
+	for (double x : v) {
+		s += x;
+	}
+	return s;
+}
+
+/**
+ * Checks the summed root length of the exact distributions and crops of the analyser against the total length L
+ */
+void checkLength(const SegmentAnalyser& a, double L, double depth, double width, const std::string& what)
+{
+	const int n = 37;
+	const double tol = 1.e-5;
+	checkClose(a.getSummed(RootSystem::st_length), L, tol, what+": total length");
+	checkClose(sum(a.distribution(RootSystem::st_length, 0., depth, n, true)), L, tol, what+": distribution");
+	double s = 0.;
+	for (const auto& l : a.distribution(0., depth, n)) {
+		s += l.getSummed(RootSystem::st_length);
+	}
+	checkClose(s, L, tol, what+": cropped layers");
+	s = 0.;
+	for (const auto& row : a.distribution2(RootSystem::st_length, 0., depth, -width, width, n, 12, true)) {
+		s += sum(row);
+	}
+	checkClose(s, L, tol, what+": distribution2");
+	SDF_PlantBox layer(1e100, 1e100, depth/n);
+	s = 0.;
+	for (int i=0; i<n; i++) {
+		SDF_RotateTranslate g(&layer, Vector3d(0, 0, -i*depth/n));
+		SegmentView v(a);
+		v.crop(&g);
+		s += v.getSummed(RootSystem::st_length);
+	}
+	checkClose(s, L, tol, what+": cropped views");
+}
+
+int main()
+{
+	RootSystem rs;
+	{
+		Silence s;
+		rs.openFile("Zea_mays_1_Leitner_2010", testParameters);
+		rs.setSeed(3);
+		rs.initialize();
+		rs.simulate(30, true);
+	}
+	SegmentAnalyser a(rs);
+	double L = a.getSummed(RootSystem::st_length);
+	double depth = 1., width = 1.; // bounding box of the nodes
+	for (const auto& n : a.nodes) {
+		depth = std::max(depth, 1.-n.z);
+		width = std::max(width, 1.+std::fabs(n.x));
+	}
+	checkLength(a, L, depth, width, "segments");
+	SegmentAnalyser b = a;
+	b.simplify(0.1);
+	check(b.segments.size()<a.segments.size()/2, "simplify merges segments");
+	checkLength(b, L, depth, width, "simplified segments");
+	return testResult("simplify");
+}
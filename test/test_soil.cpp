@@ -0,0 +1,131 @@
+/**
+ * Regression test of the soil grids (soil.h)
+ *
+ * RectilinearGrid3D stores grid point (i,j,k) at index (i*ny+j)*nz+k, EquidistantGrid3D finds the same cells as the
+ * rectilinear look up, trilinear interpolation is exact for linear fields, and positions outside of the grids are clamped.
+ */
+#include "test.h"
+
+#include "soil.h"
+
+#include <random>
+#include <vector>
+
+/**
+ * Grid points a, a+(b-a)/(n-1), ..., b
+ */
+Grid1D* equidistant(double a, double b, size_t n)
+{
+	std::vector<double> g(n);
+	for (size_t i=0; i<n; i++) {
+		g[i] = a+(b-a)/double(n-1)*i;
+	}
+	return new Grid1D(n, g, std::vector<double>(n-1));
+}
+
+double linear(double x, double y, double z)
+{
+	return 1.+2.*x-3.*y+0.5*z;
+}
+
+/**
+ * Sets the linear field at the grid points
+ */
+void fill(RectilinearGrid3D& g)
+{
+	for (size_t i=0; i<g.nx; i++) {
+		for (size_t j=0; j<g.ny; j++) {
+			for (size_t k=0; k<g.nz; k++) {
+				g.setData(i, j, k, linear(g.xgrid->grid[i], g.ygrid->grid[j], g.zgrid->grid[k]));
+			}
+		}
+	}
+}
+
+double clamp(double x, const Grid1D* g)
+{
+	return std::max(std::min(x, g->grid.back()), g->grid.front());
+}
+
+int main()
+{
+	// data layout, with a different number of grid points per axis
+	Grid1D* xg = equidistant(-2., 2., 3);
+	Grid1D* yg = equidistant(-4., 4., 4);
+	Grid1D* zg = new Grid1D(5, { -10., -6., -3., -1., 0. }, std::vector<double>(4)); // not equidistant
+	RectilinearGrid3D r(xg, yg, zg);
+	bool ok = (r.data.size()==3*4*5);
+	for (size_t i=0; i<3; i++) {
+		for (size_t j=0; j<4; j++) {
+			for (size_t k=0; k<5; k++) {
+				r.setData(i, j, k, 100.*i+10.*j+k);
+				ok = ok && (r.index(i, j, k)==(i*4+j)*5+k);
+			}
+		}
+	}
+	check(ok, "index (i*ny+j)*nz+k");
+	ok = true;
+	for (size_t i=0; i<3; i++) {
+		for (size_t j=0; j<4; j++) {
+			for (size_t k=0; k<5; k++) {
+				ok = ok && (r.data[(i*4+j)*5+k]==100.*i+10.*j+k) && (r.getData(i, j, k)==100.*i+10.*j+k);
+				ok = ok && (r.map(xg->grid[i], yg->grid[j], zg->grid[k])==r.index(i, j, k));
+				ok = ok && (r.getValue(Vector3d(xg->grid[i], yg->grid[j], zg->grid[k]))==100.*i+10.*j+k);
+			}
+		}
+	}
+	check(ok, "grid point values with setData, getData, data, map, and getValue");
+	check(r.getValue(Vector3d(-1.5, -3.5, -8.))==0., "lower corner of the cell");
+
+	// trilinear interpolation of a linear field, and clamping
+	fill(r);
+	EquidistantGrid3D e(-2., 2., 5, -3., 1., 3, -10., 0., 7);
+	fill(e);
+	Grid1D* exg = new Grid1D(5, e.xgrid->grid, std::vector<double>(4));
+	Grid1D* eyg = new Grid1D(3, e.ygrid->grid, std::vector<double>(2));
+	Grid1D* ezg = new Grid1D(7, e.zgrid->grid, std::vector<double>(6));
+	RectilinearGrid3D er(exg, eyg, ezg); // the same grid points and data, with binary search look ups
+	er.data = e.data;
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<double> u(-1., 1.);
+	bool exact = true, same = true, clamped = true;
+	for (int n=0; n<2000; n++) {
+		Vector3d p(3.*u(gen), 5.*u(gen), -5.+7.*u(gen)); // partly outside of the grids
+		for (RectilinearGrid3D* g : { &r, (RectilinearGrid3D*)&e, &er }) {
+			Vector3d c(clamp(p.x, g->xgrid), clamp(p.y, g->ygrid), clamp(p.z, g->zgrid));
+			g->setInterpolation(false);
+			double v0 = g->getValue(p);
+			clamped = clamped && (v0==g->getValue(c));
+			g->setInterpolation(true);
+			double v1 = g->getValue(p);
+			exact = exact && (std::fabs(v1-linear(c.x, c.y, c.z))<1.e-10);
+			clamped = clamped && (v1==g->getValue(c));
+		}
+		e.setInterpolation(false);
+		er.setInterpolation(false);
+		same = same && (e.map(p.x, p.y, p.z)==er.map(p.x, p.y, p.z)) && (e.getValue(p)==er.getValue(p));
+		e.setInterpolation(true);
+		er.setInterpolation(true);
+		same = same && (std::fabs(e.getValue(p)-er.getValue(p))<1.e-10);
+	}
+	check(exact, "trilinear interpolation is exact for linear fields");
+	check(clamped, "positions outside of the grid are clamped");
+	check(same, "EquidistantGrid3D finds the cells of the rectilinear look up");
+	std::vector<Vector3d> pos = { Vector3d(0.3, -0.2, -4.1), Vector3d(-5., 5., 1.) };
+	std::vector<double> values;
+	e.getValues(pos, nullptr, values);
+	check((values.size()==2) && (values[0]==e.getValue(pos[0])) && (values[1]==e.getValue(pos[1])), "getValues");
+
+	// 1D look ups out of bounds
+	EquidistantGrid1D l(-10., 0., { 1., 2., 3., 4. });
+	check((l.map(-20.)==0) && (l.map(-1.e300)==0) && (l.map(std::nan(""))==0), "EquidistantGrid1D::map below the grid");
+	check((l.map(5.)==4) && (l.map(1.e300)==4), "EquidistantGrid1D::map above the grid");
+	check((l.map(-7.4)==1) && (l.map(-2.5)==3), "EquidistantGrid1D::map within the grid");
+	check((l.getValue(Vector3d(0., 0., -20.))==1.) && (l.getValue(Vector3d(0., 0., 5.))==4.), "Grid1D::getValue repeats the first or last entry");
+	check(zg->getValue(Vector3d(0., 0., 5.))==0., "Grid1D::getValue above the grid");
+
+	for (Grid1D* g : { xg, yg, zg, exg, eyg, ezg }) {
+		delete g;
+	}
+	return testResult("soil");
+}
@@ -0,0 +1,80 @@
+/**
+ * Regression test of RootSystem::getStepDelta
+ *
+ * Applying the step deltas to the nodes and segments of the previous step reconstructs the root system,
+ * for serial and parallel growth.
+ */
+#include "test.h"
+
+#include "RootSystem.h"
+
+#include <algorithm>
+#include <vector>
+
+bool operator<(const Vector2i& a, const Vector2i& b)
+{
+	return (a.x<b.x) || ((a.x==b.x) && (a.y<b.y));
+}
+
+bool same(const Vector3d& a, const Vector3d& b)
+{
+	return (a.x==b.x) && (a.y==b.y) && (a.z==b.z);
+}
+
+int main()
+{
+	for (bool parallel : { false, true }) {
+		Silence s;
+		std::string what = parallel ? " (parallel growth)" : "";
+		RootSystem rs;
+		rs.openFile("Zea_mays_1_Leitner_2010", testParameters);
+		rs.setSeed(5);
+		rs.setParallelGrowth(parallel, 4);
+		rs.initialize();
+		rs.simulate(1, true);
+		std::vector<Vector3d> nodes = rs.getNodes(); // reconstructed by the deltas
+		std::vector<double> netimes(nodes.size());
+		for (size_t i=0; i<nodes.size(); i++) {
+			netimes[i] = rs.getNodeStore().netimes[i];
+		}
+		std::vector<Vector2i> segs = rs.getSegments();
+		size_t roots = rs.getNumberOfRoots(true);
+		for (int step=0; step<12; step++) {
+			rs.simulate(1.5, true);
+			StepDelta d = rs.getStepDelta();
+			std::string at = " at step "+std::to_string(step)+what;
+			check(d.simtime==rs.getSimTime(), "simulation time"+at);
+			check(d.firstNewNode==int(nodes.size()), "first new node"+at);
+			check(std::is_sorted(d.movedNodeIds.begin(), d.movedNodeIds.end()), "moved nodes are sorted"+at);
+			for (size_t i=0; i<d.movedNodeIds.size(); i++) {
+				nodes.at(d.movedNodeIds[i]) = d.movedNodes.at(i);
+				netimes.at(d.movedNodeIds[i]) = d.movedNETimes.at(i);
+			}
+			nodes.insert(nodes.end(), d.newNodes.begin(), d.newNodes.end());
+			netimes.insert(netimes.end(), d.newNETimes.begin(), d.newNETimes.end());
+			segs.insert(segs.end(), d.newSegments.begin(), d.newSegments.end());
+			check(d.newSegments.size()==d.newSegmentRootIds.size(), "a root per new segment"+at);
+			bool ok = true;
+			for (size_t i=0; i<d.newSegments.size(); i++) {
+				ok = ok && (d.newSegments[i].y==d.firstNewNode+int(i)) && (rs.getNodeStore().rootIds.at(d.newSegments[i].y)==d.newSegmentRootIds[i]);
+			}
+			check(ok, "new segments end in the new nodes"+at);
+			check(roots+d.newRoots.size()==size_t(rs.getNumberOfRoots(true)), "new roots"+at);
+			roots = rs.getNumberOfRoots(true);
+
+			std::vector<Vector3d> n = rs.getNodes();
+			ok = n.size()==nodes.size();
+			for (size_t i=0; ok && (i<n.size()); i++) {
+				ok = same(n[i], nodes[i]) && (netimes[i]==rs.getNodeStore().netimes[i]);
+			}
+			check(ok, "reconstructed nodes and emergence times"+at);
+			std::vector<Vector2i> sa = rs.getSegments();
+			std::vector<Vector2i> sb = segs;
+			std::sort(sa.begin(), sa.end());
+			std::sort(sb.begin(), sb.end());
+			check((sa.size()==sb.size()) && std::equal(sa.begin(), sa.end(), sb.begin(), [](const Vector2i& a, const Vector2i& b) { return (a.x==b.x) && (a.y==b.y); }),
+				"reconstructed segments"+at);
+		}
+	}
+	return testResult("step_delta");
+}
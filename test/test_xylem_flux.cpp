@@ -0,0 +1,170 @@
+/**
+ * Regression test of XylemFlux
+ *
+ * Compares the assembled linear system with a literal port of linear_system and bc_dirichlet of xylem_flux.py,
+ * checks the tree solver against the residual of that system, and the water balance of XylemFlux::radialFlux
+ * and XylemFlux::axialFlux (without gravity, where the assembly equals Eqns 6 and 7).
+ */
+#include "test.h"
+
+#include "RootSystem.h"
+#include "xylem_flux.h"
+
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+/**
+ * Soil matric potential decreasing towards the surface
+ */
+class TestSoil : public SoilLookUp
+{
+public:
+	virtual double getValue(const Vector3d& pos, const Root* root = nullptr) const override {
+		return -300.+2.*pos.z+0.5*pos.x;
+	}
+};
+
+/**
+ * Literal port of linear_system of xylem_flux.py (duplicate entries are summed, like sparse.coo_matrix)
+ */
+void linear_system(const std::vector<Vector2i>& seg, const std::vector<Vector3d>& nodes, const std::vector<double>& radius,
+	const std::vector<double>& kr, const std::vector<double>& kz, double rho, double g, const SoilLookUp& soil,
+	std::map<std::pair<int,int>, double>& Q, std::vector<double>& b)
+{
+	Q.clear();
+	b.assign(nodes.size(), 0.);
+	for (size_t c=0; c<seg.size(); c++) {
+		int i = seg[c].x;
+		int j = seg[c].y;
+		Vector3d n1 = nodes[i];
+		Vector3d n2 = nodes[j];
+		Vector3d mid = n1.plus(n2).times(0.5);
+		double p_s = soil.getValue(mid);
+		Vector3d v = n2.minus(n1);
+		double l = v.length();
+		double vz = v.z/l;
+		double a = radius[c];
+		double cii = a*M_PI*l*kr[c]/2+kz[c]/l; // Eqn (10)
+		double cij = a*M_PI*l*kr[c]/2-kz[c]/l; // Eqn (11)
+		double bi = a*M_PI*l*kr[c]*p_s; // first term of Eqn (12) & (13)
+		b[i] += (bi-kz[c]*rho*g*vz); // Eqn (12)
+		Q[std::make_pair(i, i)] += cii;
+		Q[std::make_pair(i, j)] += cij;
+		std::swap(i, j);
+		b[i] += (bi+kz[c]*rho*g*vz); // Eqn (13)
+		Q[std::make_pair(i, i)] += cii;
+		Q[std::make_pair(i, j)] += cij;
+	}
+}
+
+int main()
+{
+	RootSystem rs;
+	{
+		Silence s;
+		rs.openFile("Anagallis_femina_Leitner_2010", testParameters);
+		rs.setSeed(1);
+		rs.initialize();
+		rs.simulate(15, true);
+	}
+	std::vector<double> kr = { 1.e-4, 2.e-4, 3.e-4, 4.e-4 };
+	std::vector<double> kz = { 5.e-3, 2.e-3, 1.e-3, 5.e-4 };
+	double shootA = 0.2, shootKr = 0., shootKz = 1.e-2;
+	TestSoil soil;
+
+	XylemFlux xf(&rs);
+	xf.setKr(kr);
+	xf.setKz(kz);
+	xf.setShootParameters(shootA, shootKr, shootKz);
+	xf.linearSystem(&soil);
+	std::vector<int> indptr, indices;
+	std::vector<double> values, rhs;
+	xf.getCSR(indptr, indices, values, rhs);
+
+	// the input of linear_system per segment
+	const NodeStore& ns = rs.getNodeStore();
+	std::vector<Vector2i> seg = xf.getSegments();
+	std::vector<Vector3d> nodes;
+	for (size_t i=0; i<ns.size(); i++) {
+		nodes.push_back(ns.getNode(i));
+	}
+	std::vector<double> radius, segKr, segKz;
+	for (const auto& s : seg) {
+		if (ns.parents[s.y]<0) { // shoot segment
+			radius.push_back(shootA);
+			segKr.push_back(shootKr);
+			segKz.push_back(shootKz);
+		} else {
+			const Root* r = rs.getRoot(ns.rootIds[s.y]);
+			radius.push_back(r->param.a);
+			segKr.push_back(kr.at(r->param.type-1));
+			segKz.push_back(kz.at(r->param.type-1));
+		}
+	}
+	check(seg.size()+1==nodes.size(), "each node except the shoot ends one segment");
+	std::map<std::pair<int,int>, double> Q;
+	std::vector<double> b;
+	linear_system(seg, nodes, radius, segKr, segKz, xf.rho, xf.g, soil, Q, b);
+
+	// compare the matrices and right hand sides
+	std::map<std::pair<int,int>, double> csr;
+	for (size_t i=0; i+1<indptr.size(); i++) {
+		for (int k=indptr[i]; k<indptr[i+1]; k++) {
+			csr[std::make_pair(int(i), indices[k])] += values[k];
+		}
+	}
+	double qmax = 0.;
+	for (const auto& e : Q) {
+		qmax = std::max(qmax, std::fabs(e.second));
+	}
+	for (const auto& e : Q) {
+		checkClose(csr[e.first]/qmax, e.second/qmax, 1.e-12, "Q("+std::to_string(e.first.first)+","+std::to_string(e.first.second)+")");
+	}
+	check(csr.size()==Q.size(), "same sparsity pattern");
+	check(rhs.size()==b.size(), "same number of nodes");
+	double bmax = 0.;
+	for (double v : b) {
+		bmax = std::max(bmax, std::fabs(v));
+	}
+	for (size_t i=0; (i<b.size()) && (i<rhs.size()); i++) {
+		checkClose(rhs[i]/bmax, b[i]/bmax, 1.e-12, "b["+std::to_string(i)+"]");
+	}
+
+	// solve with a fixed collar pressure (bc_dirichlet), check the residual of the system of xylem_flux.py
+	double p0 = -500.;
+	xf.addDirichlet(0, p0);
+	std::vector<double> p = xf.solve();
+	for (auto it = Q.begin(); it!=Q.end(); ) {
+		it = (it->first.first==0) ? Q.erase(it) : std::next(it);
+	}
+	Q[std::make_pair(0, 0)] = 1.;
+	b[0] = p0;
+	std::vector<double> r = b;
+	for (const auto& e : Q) {
+		r[e.first.first] -= e.second*p[e.first.second];
+	}
+	for (size_t i=0; i<r.size(); i++) {
+		checkClose(r[i]/bmax, 0., 1.e-9, "residual at node "+std::to_string(i));
+	}
+
+	// without gravity, the radial uptake equals the axial flux at the collar
+	xf.g = 0.;
+	xf.linearSystem(&soil);
+	xf.addDirichlet(0, p0);
+	p = xf.solve();
+	std::vector<double> af = xf.axialFlux(p);
+	std::vector<double> rf = xf.radialFlux(p);
+	double collar = 0., uptake = 0.;
+	for (size_t c=0; c<seg.size(); c++) {
+		if (seg[c].x==0) {
+			collar += af[c];
+		}
+		uptake += rf[c];
+	}
+	checkClose(collar, uptake, 1.e-9, "water balance of the radial and axial fluxes");
+	check(uptake<0, "water uptake from the soil");
+
+	return testResult("xylem_flux");
+}
@@ -20,6 +20,29 @@ Vector3d Tropism::getPosition(const Vector3d& pos, Matrix3d old, double a, doubl
 	return pos.plus(old.column(0).times(dx));
 }
 
+/**
+ * Computes the candidate headings of all trials, i.e. the first column of old rotated by the angles a and b of each trial
+ * (the same as in Tropism::getPosition, but without building and multiplying the rotation matrices)
+ *
+ * @param old          rotation matrix, heading is old(:,1)
+ * @param trials       the rotation angles of the trials, the candidate headings are set
+ */
+void Tropism::setHeadings(const Matrix3d& old, TropismTrials& trials)
+{
+	const Vector3d& r0 = old.r0;
+	const Vector3d& r1 = old.r1;
+	const Vector3d& r2 = old.r2;
+	for (size_t i=0; i<trials.size(); i++) {
+		double ca = cos(trials.a[i]);
+		double sa = sin(trials.a[i]);
+		double cb = cos(trials.b[i]);
+		double sb = sin(trials.b[i]);
+		trials.hx[i] = ca*r0.x - sa*(cb*r0.y - sb*r0.z); // same operation order as old.times(rotX(b)).times(rotZ(a))
+		trials.hy[i] = ca*r1.x - sa*(cb*r1.y - sb*r1.z);
+		trials.hz[i] = ca*r2.x - sa*(cb*r2.y - sb*r2.z);
+	}
+}
+
 /**
  * Dices N times picking angles alpha and beta, takes the optimal direction according to the objective function
  *
@@ -34,7 +57,6 @@ Vector2d Tropism::getUCHeading(const Vector3d& pos, Matrix3d old, double dx,cons
 {
 	double a = sigma*randn()*sqrt(dx);
 	double b = rand()*2*M_PI;
-	double v;
 
 	double n_=n*sqrt(dx);
 	if (n_>0) {
@@ -44,21 +66,25 @@ Vector2d Tropism::getUCHeading(const Vector3d& pos, Matrix3d old, double dx,cons
 		} else {
 			n_ = floor(n_);
 		}
-		double bestA = a;
-		double bestB = b;
-		double bestV = this->tropismObjective(pos,old,a,b,dx,root);
-		for (int i=0; i<n_; i++) {
-			b = rand()*2*M_PI;
-			a = sigma*randn()*sqrt(dx);
-			v = this->tropismObjective(pos,old,a,b,dx,root);
-			if (v<bestV) {
-				bestV=v;
-				bestA=a;
-				bestB=b;
+		// dice all trials up front (in the same order as one by one)
+		trials.resize(size_t(n_)+1);
+		trials.a[0] = a;
+		trials.b[0] = b;
+		for (size_t i=1; i<trials.size(); i++) {
+			trials.b[i] = rand()*2*M_PI;
+			trials.a[i] = sigma*randn()*sqrt(dx);
+		}
+		setHeadings(old, trials);
+		this->tropismObjectives(pos, old, trials, dx, root, values);
+		CROOTBOX_PROFILE_COUNT((root!=nullptr) ? root->getProfileCounters() : nullptr, ProfileCounters::pc_objectives, trials.size());
+		size_t best = 0;
+		for (size_t i=1; i<trials.size(); i++) {
+			if (values[i]<values[best]) {
+				best = i;
 			}
 		}
-		a = bestA;
-		b = bestB;
+		a = trials.a[best];
+		b = trials.b[best];
 	}
 
 	return Vector2d(a,b);
@@ -77,12 +103,23 @@ Vector2d Tropism::getUCHeading(const Vector3d& pos, Matrix3d old, double dx,cons
  */
 Vector2d Tropism::getHeading(const Vector3d& pos, Matrix3d old, double dx, const Root* root)
 {
+	CROOTBOX_PROFILE_ONLY(ProfileCounters* profile = (root!=nullptr) ? root->getProfileCounters() : nullptr;)
+	CROOTBOX_PROFILE_TIME(profile, ProfileCounters::pp_heading);
 	Vector2d h = this->getUCHeading(pos, old, dx, root);
 	double a = h.x;
 	double b = h.y;
 
 	if (geometry!=nullptr) {
 		double d = geometry->getDist(this->getPosition(pos,old,a,b,dx));
+		CROOTBOX_PROFILE_COUNT(profile, ProfileCounters::pc_sdf, 1);
+		CROOTBOX_PROFILE_COUNT(profile, ProfileCounters::pc_rejections, (d>0) ? 1 : 0);
+		if ((d>0) && projection) {
+			double pa = a;
+			double pb = b;
+			if (projectHeading(pos, old, dx, pa, pb, root)) {
+				return Vector2d(pa,pb);
+			}
+		}
 		double dmin = d;
 
 		double bestA = a;
@@ -98,6 +135,8 @@ Vector2d Tropism::getHeading(const Vector3d& pos, Matrix3d old, double dx, const
 
 				b = 2*M_PI*rand(); // dice
 				d = geometry->getDist(this->getPosition(pos,old,a,b,dx));
+				CROOTBOX_PROFILE_COUNT(profile, ProfileCounters::pc_sdf, 1);
+				CROOTBOX_PROFILE_COUNT(profile, ProfileCounters::pc_rejections, (d>0) ? 1 : 0);
 				if (d<dmin) {
 					dmin = d;
 					bestA = a;
@@ -124,6 +163,54 @@ Vector2d Tropism::getHeading(const Vector3d& pos, Matrix3d old, double dx, const
 
 
 
+/**
+ * Moves the position reached by the angles a and b back into the geometry along the gradient of the signed distance function,
+ * and converts the direction towards the projected point into new angles. The projection is repeated (at most projectionN times)
+ * until the position dx ahead is inside. Compared to dicing (in Tropism::getHeading), this needs only a few evaluations of the geometry.
+ *
+ * @param pos        root tip postion
+ * @param old        rotation matrix, heading is old(:,1)
+ * @param dx         distance to look ahead
+ * @param a          angle alpha, is replaced by the corrected angle
+ * @param b          angle beta, is replaced by the corrected angle
+ * @param root       the root that called getHeading() (for the instrumentation counters)
+ *
+ * \return           true if a heading inside the geometry was found, a and b are unchanged otherwise
+ */
+bool Tropism::projectHeading(const Vector3d& pos, const Matrix3d& old, double dx, double& a, double& b, const Root* root) const
+{
+	CROOTBOX_PROFILE_ONLY(ProfileCounters* profile = (root!=nullptr) ? root->getProfileCounters() : nullptr;)
+	Vector3d p = getPosition(pos, old, a, b, dx);
+	double d = geometry->getDist(p);
+	CROOTBOX_PROFILE_COUNT(profile, ProfileCounters::pc_sdf, 1);
+	for (int i=0; i<projectionN; i++) {
+		Vector3d g = geometry->getGradient(p);
+		double gl = g.length();
+		if (!(gl>0)) { // no descent direction
+			return false;
+		}
+		Vector3d q = p.minus(g.times((d+1.e-2*dx)/(gl*gl))); // Newton step onto the boundary (and slightly inside)
+		Vector3d h = q.minus(pos);
+		double hl = h.length();
+		if (!(hl>0)) {
+			return false;
+		}
+		h = h.times(1./hl);
+		p = pos.plus(h.times(dx));
+		d = geometry->getDist(p);
+		CROOTBOX_PROFILE_COUNT(profile, ProfileCounters::pc_sdf, 1);
+		if (d<=0) { // convert heading to angles, heading = old(:,0)*cos(a) - old(:,1)*sin(a)*cos(b) + old(:,2)*sin(a)*sin(b)
+			double lx = old.column(0).times(h);
+			double ly = old.column(1).times(h);
+			double lz = old.column(2).times(h);
+			a = acos(std::max(std::min(lx,1.),-1.));
+			b = atan2(lz,-ly);
+			return true;
+		}
+	}
+	return false;
+}
+
 /**
  * getHeading() minimizes this function, @see TropismFunction::tropismObjective
  */
@@ -138,6 +225,23 @@ double Exotropism::tropismObjective(const Vector3d& pos, Matrix3d old, double a,
 	return acos(s)/M_PI; // 0..1
 }
 
+/**
+ * @see Tropism::tropismObjectives
+ */
+void Exotropism::tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v)
+{
+	v.resize(trials.size());
+	const Vector3d& iheading = root->iheading;
+	double il = 1./iheading.length();
+	for (size_t i=0; i<trials.size(); i++) {
+		Vector3d h = trials.getHeading(i);
+		double s = iheading.times(h);
+		s*=il;
+		s*=(1./h.length());
+		v[i] = acos(s)/M_PI; // 0..1
+	}
+}
+
 
 
 /**
@@ -148,10 +252,28 @@ double Hydrotropism::tropismObjective(const Vector3d& pos, Matrix3d old, double
 	assert(soil!=nullptr);
 	Vector3d newpos = this->getPosition(pos,old,a,b,dx);
 	double v = soil->getValue(newpos,root);
+	CROOTBOX_PROFILE_COUNT((root!=nullptr) ? root->getProfileCounters() : nullptr, ProfileCounters::pc_soil, 1);
 	// std::cout << "\n" << newpos.getString() << ", = "<< v;
 	return -v; ///< (-1) because we want to maximize the soil property
 }
 
+/**
+ * @see Tropism::tropismObjectives, the soil is looked up for all trials at once
+ */
+void Hydrotropism::tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v)
+{
+	assert(soil!=nullptr);
+	positions.resize(trials.size());
+	for (size_t i=0; i<trials.size(); i++) {
+		positions[i] = pos.plus(trials.getHeading(i).times(dx));
+	}
+	soil->getValues(positions, root, v);
+	CROOTBOX_PROFILE_COUNT((root!=nullptr) ? root->getProfileCounters() : nullptr, ProfileCounters::pc_soil, positions.size());
+	for (auto& v_ : v) {
+		v_ = -v_; // (-1) because we want to maximize the soil property
+	}
+}
+
 
 
 /**
@@ -186,6 +308,19 @@ double CombinedTropism::tropismObjective(const Vector3d& pos, Matrix3d old, doub
 	return v;
 }
 
-
-
-
+/**
+ * @see Tropism::tropismObjectives, each tropism evaluates all trials at once
+ */
+void CombinedTropism::tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v)
+{
+	tropisms[0]->tropismObjectives(pos, old, trials, dx, root, v);
+	for (auto& v_ : v) {
+		v_ *= weights[0];
+	}
+	for (size_t j = 1; j< tropisms.size(); j++) {
+		tropisms[j]->tropismObjectives(pos, old, trials, dx, root, tv);
+		for (size_t i=0; i<v.size(); i++) {
+			v[i] += tv[i]*weights[j];
+		}
+	}
+}
@@ -3,15 +3,39 @@
 
 #include <chrono>
 #include <random>
+#include <sstream>
 
 #include "Root.h"
 #include "soil.h"
+#include "random_stream.h"
 
 class Root;
 class SoilLookUp;
 
 
 
+/**
+ * The trials of the random optimization of Tropism::getUCHeading,
+ * i.e. the rotation angles and the resulting candidate headings (structure of arrays)
+ */
+class TropismTrials
+{
+public:
+
+    void resize(size_t n) { a.resize(n); b.resize(n); hx.resize(n); hy.resize(n); hz.resize(n); } ///< sets the number of trials
+    size_t size() const { return a.size(); } ///< number of trials
+    Vector3d getHeading(size_t i) const { return Vector3d(hx[i], hy[i], hz[i]); } ///< candidate heading of trial i
+
+    std::vector<double> a; ///< rotation angles alpha (angular change)
+    std::vector<double> b; ///< rotation angles beta (radial change)
+    std::vector<double> hx; ///< x-coordinates of the candidate headings
+    std::vector<double> hy; ///< y-coordinates of the candidate headings
+    std::vector<double> hz; ///< z-coordinates of the candidate headings
+
+};
+
+
+
 /**
  * Base class for all tropism functions, e.g. Gravitropism, Plagiotropism, Exotropism...
  */
@@ -34,7 +58,8 @@ public:
 
     virtual ~Tropism() {};
 
-    void setGeometry(SignedDistanceFunction* geom) { geometry = geom; }
+    void setGeometry(SignedDistanceFunction* geom, bool projection = false) { geometry = geom; this->projection = projection; }
+    ///< sets a confining geometry, optionally headings leaving the geometry are first corrected by projection (@see Tropism::projectHeading)
     void setTropismParameter(double n_,double sigma_) { n=n_; sigma=sigma_; }
 
     virtual Vector2d getHeading(const Vector3d& pos, Matrix3d old,  double dx, const Root* root = nullptr);
@@ -55,15 +80,40 @@ public:
     virtual double tropismObjective(const Vector3d& pos, Matrix3d old, double a, double b, double dx, const Root* root = nullptr) { std::cout << "TropismFunction::tropismObjective() not overwritten\n"; return 0; }
     ///< The objective function of the random optimization of getHeading().
 
+    /**
+     * The objective function evaluated for all trials at once, called by getUCHeading().
+     * Per default, tropismObjective() is called for each trial. Overwrite this function for faster tropisms.
+     *
+     * @param pos      current root tip position
+     * @param old      rotation matrix, old(:,1) is the root tip heading
+     * @param trials   rotation angles and candidate headings, @see Tropism::setHeadings
+     * @param dx       small distance to look ahead
+     * @param root     points to the root that called getHeading
+     * @param v        objective function value per trial (output)
+     */
+    virtual void tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v) {
+        v.resize(trials.size());
+        for (size_t i=0; i<trials.size(); i++) {
+            v[i] = this->tropismObjective(pos, old, trials.a[i], trials.b[i], dx, root);
+        }
+    }
+    ///< The objective function of the random optimization of getHeading() for all trials.
+
     virtual Tropism* copy() { return new Tropism(*this); } ///< factory method
 
     static Vector3d getPosition(const Vector3d& pos, Matrix3d old, double a, double b, double dx);
     ///< Auxiliary function: Applies angles a and b and goes dx [cm] into the new direction
+    static void setHeadings(const Matrix3d& old, TropismTrials& trials);
+    ///< Auxiliary function: Computes the candidate headings of all trials
 
     // random numbers
-    void setSeed(unsigned int seed) const { gen = std::mt19937(seed); } ///< Sets the seed of the random number generator
-    double rand() const { return UD(gen); } ///< Uniformly distributed random number (0,1)
-    double randn() const { return ND(gen); } ///< Normally distributed random number (0,1)
+    void setSeed(unsigned int seed) const { gen.seed(seed); } ///< Sets the seed of the random number generator
+    double rand() const { RandomStream* s = RandomStream::current(); return (s!=nullptr) ? s->rand() : UD(gen); }
+    ///< Uniformly distributed random number (0,1), from the stream of the current thread if there is one (@see RandomStreamScope)
+    double randn() const { RandomStream* s = RandomStream::current(); return (s!=nullptr) ? s->randn() : ND(gen); }
+    ///< Normally distributed random number (0,1), from the stream of the current thread if there is one (@see RandomStreamScope)
+    std::string getRandomState() const { std::stringstream ss; ss << gen << " " << ND << " " << UD; return ss.str(); } ///< state of the random number generator (e.g. for checkpoints)
+    void setRandomState(const std::string& s) const { std::stringstream ss(s); ss >> gen >> ND >> UD; } ///< restores a state of the random number generator
 
 protected:
 
@@ -76,9 +126,18 @@ protected:
     const int alphaN = 20;
     const int betaN = 5;
 
+    bool projection = false; ///< correct headings by projection along the gradient of the geometry, before dicing
+    const int projectionN = 5; ///< maximal number of projection steps
+
+    bool projectHeading(const Vector3d& pos, const Matrix3d& old, double dx, double& a, double& b, const Root* root = nullptr) const;
+    ///< moves a heading that leaves the geometry back into the geometry
+
+    TropismTrials trials; ///< buffer for getUCHeading()
+    std::vector<double> values; ///< buffer for getUCHeading()
+
 private:
 
-    mutable std::mt19937 gen = std::mt19937(std::chrono::system_clock::now().time_since_epoch().count());  // random stuff
+    mutable LazyGenerator gen = LazyGenerator(std::chrono::system_clock::now().time_since_epoch().count());  // random stuff (created at the first draw)
     mutable std::normal_distribution<double> ND = std::normal_distribution<double>(0,1);
     mutable std::uniform_real_distribution<double> UD = std::uniform_real_distribution<double>(0,1);
 };
@@ -104,6 +163,14 @@ public:
     }
     ///< TropismFunction::getHeading minimizes this function, @see TropismFunction::getHeading and @see TropismFunction::tropismObjective
 
+    virtual void tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v) override {
+        v.resize(trials.size());
+        for (size_t i=0; i<trials.size(); i++) {
+            v[i] = 0.5*(trials.hz[i]+1.);
+        }
+    }
+    ///< @see Tropism::tropismObjectives
+
 };
 
 
@@ -127,6 +194,14 @@ public:
     }
     ///< getHeading() minimizes this function, @see TropismFunction
 
+    virtual void tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v) override {
+        v.resize(trials.size());
+        for (size_t i=0; i<trials.size(); i++) {
+            v[i] = std::abs(trials.hz[i]);
+        }
+    }
+    ///< @see Tropism::tropismObjectives
+
 };
 
 
@@ -145,6 +220,8 @@ public:
 
     virtual double tropismObjective(const Vector3d& pos, Matrix3d old, double a, double b, double dx, const Root* root = nullptr) override;
     ///< getHeading() minimizes this function, @see TropismFunction
+    virtual void tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v) override;
+    ///< @see Tropism::tropismObjectives
 
 };
 
@@ -164,9 +241,12 @@ public:
 
     virtual double tropismObjective(const Vector3d& pos, Matrix3d old, double a, double b, double dx, const Root* root = nullptr) override;
     ///< getHeading() minimizes this function, @see TropismFunction
+    virtual void tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v) override;
+    ///< @see Tropism::tropismObjectives
 
 private:
     SoilLookUp* soil;
+    std::vector<Vector3d> positions; ///< buffer for the batched soil look up
 };
 
 
@@ -199,10 +279,13 @@ public:
 
     virtual double tropismObjective(const Vector3d& pos, Matrix3d old, double a, double b, double dx, const Root* root = nullptr) override;
     ///< getHeading() minimizes this function, @see TropismFunction
+    virtual void tropismObjectives(const Vector3d& pos, const Matrix3d& old, const TropismTrials& trials, double dx, const Root* root, std::vector<double>& v) override;
+    ///< @see Tropism::tropismObjectives
 
 private:
     std::vector<Tropism*> tropisms;
     std::vector<double> weights;
+    std::vector<double> tv; ///< buffer for the objective values of a single tropism
 };
 
 
@@ -0,0 +1,325 @@
+#include "vtp.h"
+
+#include "RootSystem.h"
+#include "analysis.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+#ifdef CROOTBOX_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * Constructor
+ *
+ * @param encoding      VTPWriter::vtp_raw, or VTPWriter::vtp_base64
+ * @param compress      zlib compression of the data arrays (@see VTPWriter::hasCompression)
+ */
+VTPWriter::VTPWriter(int encoding, bool compress) :encoding(encoding), compress(compress)
+{
+	if ((encoding!=vtp_raw) && (encoding!=vtp_base64)) {
+		throw std::invalid_argument("VTPWriter::VTPWriter() unknown encoding");
+	}
+	if (compress && (!hasCompression())) {
+		throw std::invalid_argument("VTPWriter::VTPWriter() compression is not available (build with CROOTBOX_ZLIB)");
+	}
+}
+
+/**
+ * True if CRootBox was built with zlib (CROOTBOX_ZLIB)
+ */
+bool VTPWriter::hasCompression()
+{
+#ifdef CROOTBOX_ZLIB
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Sets the lines (polylines or segments)
+ *
+ * @param n                 number of point indices
+ * @param connectivity      puts the n point indices of all lines
+ * @param offsets           puts the end offset (into the connectivity) of each line
+ */
+void VTPWriter::setLines(size_t n, Source connectivity, Source offsets)
+{
+	addArray("Lines", "Int32", "connectivity", 1, n, connectivity);
+	addArray("Lines", "Int32", "offsets", 1, nol, offsets);
+}
+
+void VTPWriter::addArray(const std::string& section, const std::string& type, const std::string& name, int components, size_t n, Source s)
+{
+	Array a;
+	a.section = section;
+	a.type = type;
+	a.name = name;
+	a.components = components;
+	a.n = n;
+	a.source = s;
+	arrays.push_back(a);
+}
+
+/**
+ * Writes the VTP file. Compressed arrays are compressed first, then the XML header (containing the offsets
+ * of the arrays) is written, followed by the appended data.
+ *
+ * @param os        typically a file out stream (opened in binary mode for raw encoding)
+ */
+void VTPWriter::write(std::ostream& os)
+{
+	this->os = &os;
+#ifdef CROOTBOX_ZLIB
+	if (compress) { // compress all arrays to know their sizes
+		for (auto& a : arrays) {
+			current = &a;
+			bytes = 0;
+			a.header.assign(3, 0);
+			a.data.clear();
+			a.source(*this);
+			flushBlock();
+			if (bytes!=4*a.n) {
+				throw std::invalid_argument("VTPWriter::write() wrong number of values in array "+a.name);
+			}
+			a.header[0] = a.header.size()-3; // number of blocks
+			a.header[1] = blockSize;
+			a.header[2] = bytes % blockSize; // size of the last partial block (0 if complete)
+			current = nullptr;
+		}
+	}
+#endif
+
+	std::vector<size_t> offsets; // of the arrays in the appended data
+	size_t offset = 0;
+	for (const auto& a : arrays) {
+		offsets.push_back(offset);
+		if (compress) {
+			offset += encodedSize(4*a.header.size())+encodedSize(a.data.size());
+		} else {
+			offset += encodedSize(4+4*a.n);
+		}
+	}
+
+	const uint16_t one = 1;
+	bool littleEndian = (*reinterpret_cast<const char*>(&one)==1);
+	os << "<?xml version=\"1.0\"?>\n";
+	os << "<VTKFile type=\"PolyData\" version=\"0.1\" byte_order=\"" << (littleEndian ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt32\"";
+	if (compress) {
+		os << " compressor=\"vtkZLibDataCompressor\"";
+	}
+	os << ">\n<PolyData>\n";
+	os << "<Piece NumberOfLines=\"" << nol << "\" NumberOfPoints=\"" << nop << "\">\n";
+	size_t k = 0;
+	writeSection(os, "PointData", offsets, k);
+	writeSection(os, "CellData", offsets, k);
+	writeSection(os, "Points", offsets, k);
+	writeSection(os, "Lines", offsets, k);
+	os << "</Piece>\n</PolyData>\n";
+	os << "<AppendedData encoding=\"" << ((encoding==vtp_base64) ? "base64" : "raw") << "\">\n_";
+
+	for (auto& a : arrays) {
+		if (compress) {
+			emit(reinterpret_cast<const char*>(a.header.data()), 4*a.header.size());
+			finishEmit(); // the header is encoded separately
+			emit(a.data.data(), a.data.size());
+			finishEmit();
+			a.data.clear();
+		} else {
+			uint32_t size = 4*a.n;
+			emit(reinterpret_cast<const char*>(&size), 4);
+			bytes = 0;
+			a.source(*this);
+			flushBlock();
+			finishEmit();
+			if (bytes!=4*a.n) {
+				throw std::invalid_argument("VTPWriter::write() wrong number of values in array "+a.name);
+			}
+		}
+	}
+	os << "\n</AppendedData>\n</VTKFile>\n";
+	this->os = nullptr;
+}
+
+/**
+ * Writes the XML tags of the arrays of a section (the arrays of a section must have been added consecutively)
+ */
+void VTPWriter::writeSection(std::ostream& os, const std::string& section, std::vector<size_t>& offsets, size_t& k) const
+{
+	if ((k>=arrays.size()) || (arrays[k].section!=section)) {
+		if ((section=="Points") || (section=="Lines")) {
+			throw std::invalid_argument("VTPWriter::write() missing "+section);
+		}
+		return;
+	}
+	os << "<" << section << ">\n";
+	while ((k<arrays.size()) && (arrays[k].section==section)) {
+		const Array& a = arrays[k];
+		os << "<DataArray type=\"" << a.type << "\" Name=\"" << a.name << "\" NumberOfComponents=\"" << a.components
+			<< "\" format=\"appended\" offset=\"" << offsets[k] << "\"/>\n";
+		k++;
+	}
+	os << "</" << section << ">\n";
+}
+
+/**
+ * Adds bytes to the current block, full blocks are compressed or emitted
+ */
+void VTPWriter::putBytes(const char* p, size_t n)
+{
+	block.append(p, n);
+	bytes += n;
+	if (block.size()>=blockSize) {
+		flushBlock();
+	}
+}
+
+/**
+ * Compresses the current block (adding its size to the header), or emits it
+ */
+void VTPWriter::flushBlock()
+{
+	if (block.empty()) {
+		return;
+	}
+	if (current!=nullptr) {
+#ifdef CROOTBOX_ZLIB
+		size_t start = 0;
+		while (start<block.size()) {
+			size_t n = std::min(blockSize, block.size()-start);
+			uLongf size = compressBound(n);
+			size_t old = current->data.size();
+			current->data.resize(old+size);
+			if (compress2(reinterpret_cast<Bytef*>(&current->data[old]), &size, reinterpret_cast<const Bytef*>(block.data()+start), n, Z_DEFAULT_COMPRESSION)!=Z_OK) {
+				throw std::runtime_error("VTPWriter::flushBlock() zlib compression failed");
+			}
+			current->data.resize(old+size);
+			current->header.push_back(size);
+			start += n;
+		}
+#endif
+	} else {
+		emit(block.data(), block.size());
+	}
+	block.clear();
+}
+
+/**
+ * Writes bytes to the output, encodes them if necessary (incomplete base64 groups are kept until the next call)
+ */
+void VTPWriter::emit(const char* p, size_t n)
+{
+	if (encoding==vtp_raw) {
+		os->write(p, n);
+		return;
+	}
+	static const char* table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+	char out[4*blockSize/3+8];
+	size_t m = 0;
+	for (size_t i=0; i<n; i++) {
+		carry[ncarry++] = u[i];
+		if (ncarry==3) {
+			out[m++] = table[carry[0]>>2];
+			out[m++] = table[((carry[0]&0x03)<<4)|(carry[1]>>4)];
+			out[m++] = table[((carry[1]&0x0f)<<2)|(carry[2]>>6)];
+			out[m++] = table[carry[2]&0x3f];
+			ncarry = 0;
+			if (m+4>sizeof(out)) {
+				os->write(out, m);
+				m = 0;
+			}
+		}
+	}
+	os->write(out, m);
+}
+
+/**
+ * Ends the current encoded stream (i.e. pads an incomplete base64 group)
+ */
+void VTPWriter::finishEmit()
+{
+	if ((encoding!=vtp_base64) || (ncarry==0)) {
+		return;
+	}
+	static const char* table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	if (ncarry==1) {
+		carry[1] = 0;
+	}
+	char out[4];
+	out[0] = table[carry[0]>>2];
+	out[1] = table[((carry[0]&0x03)<<4)|(carry[1]>>4)];
+	out[2] = (ncarry==2) ? table[(carry[1]&0x0f)<<2] : '=';
+	out[3] = '=';
+	os->write(out, 4);
+	ncarry = 0;
+}
+
+
+
+/**
+ * Writes the root system at its current simulation time as next step of the series
+ *
+ * @param rs        the root system
+ */
+void VTPSeries::write(const RootSystem& rs)
+{
+	std::string file = nextFile();
+	std::ofstream fos(file.c_str(), std::ios::binary);
+	rs.writeVTP(fos, encoding, compress);
+	fos.close();
+	times.push_back(rs.getSimTime());
+	files.push_back(file);
+	writeCollection();
+}
+
+/**
+ * Writes the segments as next step of the series
+ *
+ * @param a         the segments
+ * @param time      the time of the step [days]
+ * @param types     parameter types that are written per segment (@see RootSystem::ScalarType)
+ */
+void VTPSeries::write(const SegmentAnalyser& a, double time, std::vector<int> types)
+{
+	if (types.empty()) {
+		types = { RootSystem::st_radius, RootSystem::st_type, RootSystem::st_time };
+	}
+	std::string file = nextFile();
+	std::ofstream fos(file.c_str(), std::ios::binary);
+	a.writeVTP(fos, types, encoding, compress);
+	fos.close();
+	times.push_back(time);
+	files.push_back(file);
+	writeCollection();
+}
+
+std::string VTPSeries::nextFile() const
+{
+	std::stringstream ss;
+	ss << name << "_" << std::setw(4) << std::setfill('0') << times.size() << ".vtp";
+	return ss.str();
+}
+
+/**
+ * Writes the ParaView collection referencing all steps (file names relative to the collection)
+ */
+void VTPSeries::writeCollection() const
+{
+	std::ofstream fos((name+".pvd").c_str());
+	fos << "<?xml version=\"1.0\"?>\n";
+	fos << "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\"LittleEndian\">\n<Collection>\n";
+	for (size_t i=0; i<times.size(); i++) {
+		std::string file = files[i];
+		size_t j = file.find_last_of("/\\");
+		if (j!=std::string::npos) {
+			file = file.substr(j+1);
+		}
+		fos << "<DataSet timestep=\"" << times[i] << "\" group=\"\" part=\"0\" file=\"" << file << "\"/>\n";
+	}
+	fos << "</Collection>\n</VTKFile>\n";
+}
@@ -0,0 +1,118 @@
+#ifndef VTP_H_
+#define VTP_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+class RootSystem;
+class SegmentAnalyser;
+
+/**
+ * VTPWriter
+ *
+ * Writes VTK polydata (VTP) files with appended binary data, either raw or base64 encoded,
+ * and optionally zlib compressed (if CRootBox is built with CROOTBOX_ZLIB, @see VTPWriter::hasCompression).
+ *
+ * Each data array is described by a source, i.e. a function that puts the values of the array into the writer,
+ * therefore the values are streamed from the root tree (or segments), without intermediate vectors.
+ * Uncompressed arrays are written directly to the output stream, compressed arrays are compressed block-wise,
+ * and kept until the XML header (that needs their sizes) is written.
+ */
+class VTPWriter
+{
+
+public:
+
+	enum Encoding { vtp_ascii = 0, vtp_raw = 1, vtp_base64 = 2 }; ///< vtp_ascii is written by the writers of RootSystem and SegmentAnalyser
+	typedef std::function<void(VTPWriter& w)> Source; ///< puts all values of an array into the writer
+
+	VTPWriter(int encoding = vtp_raw, bool compress = false);
+
+	void setPiece(size_t nop, size_t nol) { this->nop = nop; this->nol = nol; } ///< sets the number of points and lines
+	void addPointData(const std::string& name, Source s) { addArray("PointData", "Float32", name, 1, nop, s); } ///< one Float32 per point
+	void addCellData(const std::string& name, Source s) { addArray("CellData", "Float32", name, 1, nol, s); } ///< one Float32 per line
+	void setPoints(Source s) { addArray("Points", "Float32", "Coordinates", 3, 3*nop, s); } ///< three Float32 per point
+	void setLines(size_t n, Source connectivity, Source offsets); ///< n Int32 point indices, and one Int32 offset per line
+
+	void putFloat32(double v) { float f = float(v); putBytes(reinterpret_cast<const char*>(&f), 4); } ///< puts the next value of the current array
+	void putInt32(int v) { int32_t i = v; putBytes(reinterpret_cast<const char*>(&i), 4); } ///< puts the next value of the current array
+
+	void write(std::ostream& os); ///< writes the file, calls each source once
+
+	static bool hasCompression(); ///< true if zlib compression is available
+
+private:
+
+	struct Array {
+		std::string section; // PointData, CellData, Points, or Lines
+		std::string type; // Float32, Int32
+		std::string name;
+		int components;
+		size_t n; // number of values
+		Source source;
+		std::vector<uint32_t> header; // compression header
+		std::string data; // compressed blocks
+	};
+
+	void addArray(const std::string& section, const std::string& type, const std::string& name, int components, size_t n, Source s);
+	void writeSection(std::ostream& os, const std::string& section, std::vector<size_t>& offsets, size_t& k) const;
+	void putBytes(const char* p, size_t n);
+	void flushBlock();
+	void emit(const char* p, size_t n);
+	void finishEmit();
+	size_t encodedSize(size_t n) const { return (encoding==vtp_base64) ? 4*((n+2)/3) : n; }
+
+	int encoding;
+	bool compress;
+	size_t nop = 0;
+	size_t nol = 0;
+	std::vector<Array> arrays;
+
+	static const size_t blockSize = 32768; // bytes per block
+	std::ostream* os = nullptr; // current output
+	Array* current = nullptr; // array that is compressed (or nullptr)
+	std::string block; // uncompressed bytes of the current block
+	size_t bytes = 0; // bytes put into the current array
+	unsigned char carry[3]; // base64 bytes of an incomplete group
+	int ncarry = 0;
+
+};
+
+
+
+/**
+ * VTPSeries
+ *
+ * Writes one VTP file per time step (name_0000.vtp, name_0001.vtp, ...) and the ParaView collection
+ * name.pvd referencing them, which is rewritten after each step (i.e. it is valid during the simulation).
+ */
+class VTPSeries
+{
+
+public:
+
+	VTPSeries(std::string name, int encoding = VTPWriter::vtp_raw, bool compress = false) : name(name), encoding(encoding), compress(compress) { }
+	///< name without extension, encoding and compression of the VTP files (@see VTPWriter)
+
+	void write(const RootSystem& rs); ///< writes the current root system at its simulation time
+	void write(const SegmentAnalyser& a, double time, std::vector<int> types = std::vector<int>());
+	///< writes the segments at a time (types default to radius, type, and time, as in SegmentAnalyser::write)
+	int getNumberOfSteps() const { return times.size(); } ///< number of written time steps
+
+private:
+
+	std::string nextFile() const; ///< file name of the next step
+	void writeCollection() const; ///< writes name.pvd
+
+	std::string name;
+	int encoding;
+	bool compress;
+	std::vector<double> times;
+	std::vector<std::string> files;
+
+};
+
+#endif
@@ -0,0 +1,351 @@
+#include "xylem_flux.h"
+
+#include "RootSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * Finds the start node of the segment ending at each node, i.e. the parent node in the node store for root segments,
+ * and the adjacent node towards the artificial shoot for the shoot segments (@see RootSystem::getShootSegments).
+ * If the parents of the existing nodes are unchanged (i.e. the root system grew), only the new nodes are added.
+ */
+void XylemFlux::updateTree()
+{
+	const NodeStore& ns = rs->getNodeStore();
+	size_t n = ns.size();
+	size_t n0 = storeParents.size();
+	bool keep = (n0>0) && (n0<=n) && std::equal(storeParents.begin(), storeParents.end(), ns.parents.begin());
+	if (!keep) { // rebuild
+		n0 = 0;
+		up.clear();
+		order.clear();
+	}
+	up.resize(n, -1);
+	for (size_t i=n0; i<n; i++) {
+		up[i] = ns.parents[i];
+	}
+	if (!keep) { // shoot segments, oriented from the artificial shoot (duplicate segments are skipped)
+		std::vector<Vector2i> shoot = rs->getShootSegments();
+		std::vector<bool> connected(n, false);
+		connected[0] = true;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (const auto& s : shoot) {
+				if (connected[s.x] && !connected[s.y] && (up[s.y]<0)) {
+					up[s.y] = s.x;
+					connected[s.y] = true;
+					changed = true;
+				} else if (connected[s.y] && !connected[s.x] && (up[s.x]<0)) {
+					up[s.x] = s.y;
+					connected[s.x] = true;
+					changed = true;
+				}
+			}
+		}
+	}
+	storeParents.assign(ns.parents.begin(), ns.parents.end());
+
+	// elimination order, the node order if each segment starts at a smaller node id
+	bool sorted = order.empty();
+	for (size_t i=(sorted ? n0 : 0); (i<n) && sorted; i++) {
+		sorted = (up[i]<int(i));
+	}
+	if (sorted) {
+		order.clear();
+	} else { // breadth first from the nodes without segment
+		std::vector<int> first(n, -1), next(n, -1); // children as linked lists
+		for (int i=n-1; i>=0; i--) {
+			if (up[i]>=0) {
+				next[i] = first[up[i]];
+				first[up[i]] = i;
+			}
+		}
+		order.clear();
+		order.reserve(n);
+		for (size_t i=0; i<n; i++) {
+			if (up[i]<0) {
+				order.push_back(i);
+			}
+		}
+		for (size_t k=0; k<order.size(); k++) {
+			for (int c=first[order[k]]; c>=0; c=next[c]) {
+				order.push_back(c);
+			}
+		}
+		if (order.size()!=n) {
+			throw std::invalid_argument("XylemFlux::updateTree() the segments do not form a tree");
+		}
+	}
+}
+
+/**
+ * Assembles the linear system (Eqns 10-13 of xylem_flux.py) for the current root system,
+ * previous boundary conditions are removed. The coefficients and the signs of the gravity terms are those of
+ * linear_system in xylem_flux.py (checked by test/test_xylem_flux.cpp).
+ *
+ * @param soil      the soil matric potential, looked up at the segment mid points (or nullptr for 0)
+ */
+void XylemFlux::linearSystem(const SoilLookUp* soil)
+{
+	updateTree();
+	const NodeStore& ns = rs->getNodeStore();
+	size_t n = up.size();
+
+	length.assign(n, 0.);
+	radius.assign(n, 0.);
+	segKr.assign(n, 0.);
+	segKz.assign(n, 0.);
+	vz.assign(n, 0.);
+	std::vector<Vector3d> mid;
+	mid.reserve(n);
+	for (size_t i=0; i<n; i++) {
+		int j = up[i];
+		Vector3d a = ns.getNode(i);
+		if (j<0) {
+			mid.push_back(a);
+			continue;
+		}
+		Vector3d b = ns.getNode(j);
+		double dx = a.x-b.x, dy = a.y-b.y, dz = a.z-b.z;
+		double l = std::sqrt(dx*dx+dy*dy+dz*dz);
+		mid.push_back(Vector3d(b.x+dx/2., b.y+dy/2., b.z+dz/2.));
+		length[i] = scale*l;
+		vz[i] = (l>0) ? dz/l : 0.;
+		if (ns.parents[i]<0) { // shoot segment
+			radius[i] = scale*shootRadius;
+			segKr[i] = shootKr;
+			segKz[i] = shootKz;
+		} else {
+			int rid = ns.rootIds[i];
+			Root* r = ((rid>=0) && (rid<rs->getNumberOfRoots(true))) ? rs->getRoot(rid) : nullptr;
+			if (r==nullptr) {
+				throw std::invalid_argument("XylemFlux::linearSystem() unknown root of node "+std::to_string(i));
+			}
+			size_t t = r->param.type-1;
+			if ((t>=kr.size()) || (t>=kz.size())) {
+				throw std::invalid_argument("XylemFlux::linearSystem() no conductivities for root type "+std::to_string(r->param.type));
+			}
+			radius[i] = scale*r->param.a;
+			segKr[i] = kr[t];
+			segKz[i] = kz[t];
+		}
+	}
+	soilP.assign(n, 0.);
+	if (soil!=nullptr) {
+		soil->getValues(mid, nullptr, soilP);
+	}
+
+	diag.assign(n, 0.);
+	off.assign(n, 0.);
+	rhs.assign(n, 0.);
+	dirichletNodes.clear();
+	dirichletValues.clear();
+	for (size_t i=0; i<n; i++) {
+		int j = up[i]; // segment from j to i
+		if ((j<0) || (length[i]<=0)) {
+			continue;
+		}
+		double l = length[i];
+		double radial = radius[i]*M_PI*l*segKr[i]/2.; // half of the radial conductance per node, @see XylemFlux::radialFlux
+		double axial = segKz[i]/l;
+		double cii = radial+axial; // Eqn 10
+		double cij = radial-axial; // Eqn 11
+		double bi = 2.*radial*soilP[i];
+		double gravity = segKz[i]*rho*g*vz[i];
+		diag[j] += cii;
+		diag[i] += cii;
+		off[i] += cij;
+		rhs[j] += bi-gravity; // Eqn 12 (start node)
+		rhs[i] += bi+gravity; // Eqn 13 (end node)
+	}
+}
+
+/**
+ * Fixes the xylem pressure at a node (the row is replaced by the identity, like bc_dirichlet in xylem_flux.py)
+ *
+ * @param node      node index
+ * @param p         xylem pressure
+ */
+void XylemFlux::addDirichlet(int node, double p)
+{
+	if ((node<0) || (size_t(node)>=up.size())) {
+		throw std::invalid_argument("XylemFlux::addDirichlet() node index out of range");
+	}
+	dirichletNodes.push_back(node);
+	dirichletValues.push_back(p);
+}
+
+/**
+ * Adds a flux at a node (like bc_neumann in xylem_flux.py)
+ *
+ * @param node      node index
+ * @param f         flux
+ */
+void XylemFlux::addNeumann(int node, double f)
+{
+	if ((node<0) || (size_t(node)>=up.size())) {
+		throw std::invalid_argument("XylemFlux::addNeumann() node index out of range");
+	}
+	rhs[node] += f;
+}
+
+/**
+ * Solves the linear system by Gaussian elimination along the tree: the nodes are eliminated from the tips
+ * towards the shoot, followed by the back substitution from the shoot (no fill in, linear in the number of nodes).
+ * The matrix is symmetric positive definite for positive conductivities, therefore no pivoting is needed.
+ *
+ * \return the xylem pressure per node
+ */
+std::vector<double> XylemFlux::solve() const
+{
+	size_t n = up.size();
+	std::vector<double> d = diag;
+	std::vector<double> o = off;
+	std::vector<double> x = rhs;
+
+	// Dirichlet nodes are moved to the right hand side
+	std::vector<bool> fixed(n, false);
+	for (size_t k=0; k<dirichletNodes.size(); k++) {
+		int i = dirichletNodes[k];
+		fixed[i] = true;
+		d[i] = 1.;
+		x[i] = dirichletValues[k];
+	}
+	if (!dirichletNodes.empty()) {
+		for (size_t i=0; i<n; i++) {
+			int j = up[i];
+			if ((j<0) || (!fixed[i] && !fixed[j])) {
+				continue;
+			}
+			if (!fixed[i]) {
+				x[i] -= o[i]*x[j];
+			}
+			if (!fixed[j]) {
+				x[j] -= o[i]*x[i];
+			}
+			o[i] = 0.;
+		}
+	}
+
+	bool sorted = order.empty();
+	for (size_t k=n; k-->0; ) { // elimination, tips first
+		int i = sorted ? k : order[k];
+		if (d[i]==0.) {
+			throw std::invalid_argument("XylemFlux::solve() singular system at node "+std::to_string(i)+" (check conductivities)");
+		}
+		int j = up[i];
+		if ((j>=0) && (o[i]!=0.)) {
+			double f = o[i]/d[i];
+			d[j] -= f*o[i];
+			x[j] -= f*x[i];
+		}
+	}
+	for (size_t k=0; k<n; k++) { // back substitution, shoot first
+		int i = sorted ? k : order[k];
+		int j = up[i];
+		if ((j>=0) && (o[i]!=0.)) {
+			x[i] -= o[i]*x[j];
+		}
+		x[i] /= d[i];
+	}
+	return x;
+}
+
+/**
+ * The segments of the network, i.e. the segment ending at each node (parent node, node), in the order of the
+ * end nodes, as used by XylemFlux::axialFlux and XylemFlux::radialFlux
+ */
+std::vector<Vector2i> XylemFlux::getSegments() const
+{
+	std::vector<Vector2i> seg;
+	for (size_t i=0; i<up.size(); i++) {
+		if (up[i]>=0) {
+			seg.push_back(Vector2i(up[i], i));
+		}
+	}
+	return seg;
+}
+
+/**
+ * Axial flux per segment (Eqn 6 of xylem_flux.py), @see XylemFlux::getSegments
+ *
+ * @param p         xylem pressure per node (@see XylemFlux::solve)
+ */
+std::vector<double> XylemFlux::axialFlux(const std::vector<double>& p) const
+{
+	if (p.size()!=up.size()) {
+		throw std::invalid_argument("XylemFlux::axialFlux() wrong number of pressures");
+	}
+	std::vector<double> f;
+	for (size_t i=0; i<up.size(); i++) {
+		int j = up[i];
+		if (j>=0) {
+			f.push_back((length[i]>0) ? -segKz[i]*((p[i]-p[j])/length[i]+rho*g*vz[i]) : 0.);
+		}
+	}
+	return f;
+}
+
+/**
+ * Radial flux per segment (Eqn 7 of xylem_flux.py) for the soil matric potential of the last assembly,
+ * @see XylemFlux::getSegments
+ *
+ * @param p         xylem pressure per node (@see XylemFlux::solve)
+ */
+std::vector<double> XylemFlux::radialFlux(const std::vector<double>& p) const
+{
+	if (p.size()!=up.size()) {
+		throw std::invalid_argument("XylemFlux::radialFlux() wrong number of pressures");
+	}
+	std::vector<double> f;
+	for (size_t i=0; i<up.size(); i++) {
+		int j = up[i];
+		if (j>=0) {
+			f.push_back(-2.*radius[i]*M_PI*length[i]*segKr[i]*(soilP[i]-(p[i]+p[j])/2.));
+		}
+	}
+	return f;
+}
+
+/**
+ * The assembled system including the boundary conditions (Dirichlet rows are replaced by the identity),
+ * as compressed sparse rows with sorted column indices
+ *
+ * @param indptr    start of each row in indices and values (size number of nodes + 1)
+ * @param indices   column indices
+ * @param values    matrix entries
+ * @param b         right hand side
+ */
+void XylemFlux::getCSR(std::vector<int>& indptr, std::vector<int>& indices, std::vector<double>& values, std::vector<double>& b) const
+{
+	size_t n = up.size();
+	std::vector<std::vector<std::pair<int,double>>> rows(n);
+	for (size_t i=0; i<n; i++) {
+		rows[i].push_back(std::make_pair(int(i), diag[i]));
+		int j = up[i];
+		if (j>=0) {
+			rows[i].push_back(std::make_pair(j, off[i]));
+			rows[j].push_back(std::make_pair(int(i), off[i]));
+		}
+	}
+	b = rhs;
+	for (size_t k=0; k<dirichletNodes.size(); k++) {
+		int i = dirichletNodes[k];
+		rows[i].assign(1, std::make_pair(i, 1.));
+		b[i] = dirichletValues[k];
+	}
+	indptr.assign(1, 0);
+	indices.clear();
+	values.clear();
+	for (auto& r : rows) {
+		std::sort(r.begin(), r.end());
+		for (const auto& e : r) {
+			indices.push_back(e.first);
+			values.push_back(e.second);
+		}
+		indptr.push_back(indices.size());
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef XYLEM_FLUX_H_
+#define XYLEM_FLUX_H_
+
+#include <vector>
+
+#include "mymath.h"
+#include "soil.h"
+
+class RootSystem;
+class Root;
+
+/**
+ * XylemFlux
+ *
+ * Water flux within the xylem network of a root system (C++ version of xylem_flux.py).
+ *
+ * The linear system (Eqns 10-13 of xylem_flux.py) is assembled from the node store of the root system,
+ * including the segments connecting the artificial shoot, the seed, and the root crowns (@see RootSystem::getShootSegments).
+ * Since the network is a tree, each node (except the artificial shoot, node 0) is the end node of exactly one segment, and
+ * the system is solved directly by eliminating the nodes from the tips towards the shoot (in linear time, without fill in).
+ *
+ * The tree is kept between time steps (and extended by the new nodes), as long as the existing nodes keep their segments.
+ *
+ * Units must be consistent, the node coordinates and radii (in cm) can be scaled (@see XylemFlux::setScale),
+ * the soil matric potential is looked up at the segment mid points (in cm).
+ */
+class XylemFlux
+{
+
+public:
+
+	XylemFlux(RootSystem* rs) : rs(rs) { } ///< the root system (must outlive the object)
+	virtual ~XylemFlux() { }
+
+	// Parameters
+	void setKr(std::vector<double> kr) { this->kr = kr; } ///< radial conductivities per root type (index type-1) [L2 T M-1]
+	void setKz(std::vector<double> kz) { this->kz = kz; } ///< axial conductivities per root type (index type-1) [L5 T M-1]
+	void setShootParameters(double a, double kr, double kz) { shootRadius = a; shootKr = kr; shootKz = kz; }
+	///< radius [cm], radial [L2 T M-1], and axial [L5 T M-1] conductivities of the shoot segments
+	void setScale(double s) { scale = s; } ///< scales coordinates and radii (e.g. 0.01 from cm to m)
+
+	double rho = 1.e3; ///< density of soil water [M L-3]
+	double g = 9.8065; ///< gravitational acceleration [L T-2]
+
+	// Linear system
+	void linearSystem(const SoilLookUp* soil); ///< assembles the linear system for the current root system (Eqns 10-13)
+	void addDirichlet(int node, double p); ///< fixes the pressure at a node (e.g. the root collar, node 0)
+	void addNeumann(int node, double f); ///< adds a flux at a node (e.g. the potential transpiration at node 0)
+	std::vector<double> solve() const; ///< solves the linear system, returns the xylem pressure per node
+
+	// Results
+	std::vector<Vector2i> getSegments() const; ///< the segments of the network (parent node, node), in node order
+	std::vector<double> axialFlux(const std::vector<double>& p) const; ///< axial flux per segment (Eqn 6)
+	std::vector<double> radialFlux(const std::vector<double>& p) const; ///< radial flux per segment (Eqn 7), for the soil of the last assembly
+	void getCSR(std::vector<int>& indptr, std::vector<int>& indices, std::vector<double>& values, std::vector<double>& rhs) const;
+	///< the linear system including boundary conditions as compressed sparse rows (e.g. for scipy.sparse.csr_matrix)
+	int getNumberOfNodes() const { return up.size(); } ///< number of nodes of the last assembly
+
+private:
+
+	void updateTree(); ///< finds the segment of each node, keeps the tree if the existing nodes did not change
+
+	RootSystem* rs;
+
+	std::vector<double> kr; // per root type
+	std::vector<double> kz; // per root type
+	double shootRadius = 1.;
+	double shootKr = 1.;
+	double shootKz = 1.;
+	double scale = 1.;
+
+	// tree
+	std::vector<int> up; // start node of the segment ending at each node (-1 for node 0, or unconnected nodes)
+	std::vector<int> storeParents; // node store parents the tree was built for
+	std::vector<int> order; // nodes in an order where each node comes after its start node (empty if that is the node order)
+
+	// segment data of the last assembly, per node (i.e. for the segment ending at the node)
+	std::vector<double> length; // scaled by scale
+	std::vector<double> radius; // scaled by scale
+	std::vector<double> segKr;
+	std::vector<double> segKz;
+	std::vector<double> vz; // z-component of the normed segment direction
+	std::vector<double> soilP; // soil matric potential at the segment mid point
+
+	// linear system: diagonal, coupling between each node and its start node, and right hand side
+	std::vector<double> diag;
+	std::vector<double> off;
+	std::vector<double> rhs;
+	std::vector<int> dirichletNodes;
+	std::vector<double> dirichletValues;
+
+};
+
+#endif